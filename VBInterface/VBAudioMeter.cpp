@@ -0,0 +1,216 @@
+#include "VBAudioMeter.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+# include <xmmintrin.h>
+# define VB_METER_SSE 1
+#else
+# define VB_METER_SSE 0
+#endif
+
+VBAudioMeter::VBAudioMeter( VBAudioStream::Stream stream, int windowMs ) : stream( stream ), windowMs( windowMs > 0 ? windowMs : 10 ), ring( new Slot[NUM_SLOTS] ) {
+}
+
+void VBAudioMeter::starting( const VBAudioStream::Format& format ) {
+	sampleRate = format.sampleRate;
+	windowSamples = (int) ( (long long) format.sampleRate * windowMs / 1000 );
+	if ( windowSamples < 1 ) {
+		windowSamples = 1;
+	}
+
+	filled = 0;
+	numChannels = 0;
+	sampleClock = 0;
+}
+
+void VBAudioMeter::process( const VBAudioStream::Buffer& buffer ) {
+	if ( buffer.stream != stream || windowSamples == 0 ) {
+		return;
+	}
+
+	int channels = buffer.numInputs < MAX_CHANNELS ? buffer.numInputs : MAX_CHANNELS;
+	if ( channels != numChannels ) {
+		if ( filled > 0 ) {
+			publish();
+		}
+		numChannels = channels;
+	}
+
+	// Windows end on exact samples, a buffer can finish one and start the next
+	int offset = 0;
+	while ( offset < buffer.frames ) {
+		int count = windowSamples - filled;
+		if ( count > buffer.frames - offset ) {
+			count = buffer.frames - offset;
+		}
+
+		for ( int c = 0; c < numChannels; c++ ) {
+			float bufferPeak, bufferSquares;
+			measure( buffer.inputs[c] + offset, count, bufferPeak, bufferSquares );
+			if ( bufferPeak > peak[c] ) {
+				peak[c] = bufferPeak;
+			}
+			squares[c] += bufferSquares;
+		}
+
+		filled += count;
+		offset += count;
+		if ( filled == windowSamples ) {
+			publish();
+		}
+	}
+}
+
+void VBAudioMeter::ending() {
+	if ( filled > 0 ) {
+		publish();
+	}
+}
+
+void VBAudioMeter::publish() {
+	sequence++;
+	Slot& slot = ring[sequence % NUM_SLOTS];
+
+	slot.guard.store( sequence * 2 - 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	Window& window = slot.window;
+	window.sequence = sequence;
+	window.firstSample = sampleClock;
+	window.sampleRate = sampleRate;
+	window.samples = filled;
+	window.numChannels = numChannels;
+	for ( int c = 0; c < numChannels; c++ ) {
+		window.peak[c] = peak[c];
+		window.rms[c] = (float) sqrt( squares[c] / filled );
+	}
+
+	slot.guard.store( sequence * 2, std::memory_order_release );
+	published.store( sequence, std::memory_order_release );
+
+	sampleClock += filled;
+	filled = 0;
+	for ( int c = 0; c < MAX_CHANNELS; c++ ) {
+		peak[c] = 0;
+		squares[c] = 0;
+	}
+}
+
+unsigned long long VBAudioMeter::latestSequence() const {
+	return published.load( std::memory_order_acquire );
+}
+
+bool VBAudioMeter::latest( Window& window ) const {
+	// The newest slot is only rewritten after NUM_SLOTS more windows, retry if that happened mid-copy
+	for ( int attempt = 0; attempt < 4; attempt++ ) {
+		if ( this->window( latestSequence(), window ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool VBAudioMeter::window( unsigned long long sequence, Window& window ) const {
+	if ( sequence == 0 ) {
+		return false;
+	}
+
+	const Slot& slot = ring[sequence % NUM_SLOTS];
+
+	if ( slot.guard.load( std::memory_order_acquire ) != sequence * 2 ) {
+		return false;
+	}
+
+	memcpy( &window, &slot.window, sizeof( Window ) );
+
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return slot.guard.load( std::memory_order_relaxed ) == sequence * 2;
+}
+
+bool VBAudioMeter::read( unsigned long long& cursor, Reading& reading ) const {
+	reading = Reading();
+
+	unsigned long long newest = latestSequence();
+	if ( newest <= cursor ) {
+		return false;
+	}
+
+	unsigned long long first = cursor + 1;
+	if ( newest - first >= NUM_SLOTS ) {
+		reading.missed = (int) ( newest - NUM_SLOTS + 1 - first );
+		first = newest - NUM_SLOTS + 1;
+	}
+
+	double squares[MAX_CHANNELS] = {};
+	Window copy;
+	for ( unsigned long long sequence = first; sequence <= newest; sequence++ ) {
+		if ( !window( sequence, copy ) ) {
+			reading.missed++;
+			continue;
+		}
+
+		reading.windows++;
+		reading.samples += copy.samples;
+		if ( copy.numChannels > reading.numChannels ) {
+			reading.numChannels = copy.numChannels;
+		}
+		for ( int c = 0; c < copy.numChannels; c++ ) {
+			if ( copy.peak[c] > reading.peak[c] ) {
+				reading.peak[c] = copy.peak[c];
+			}
+			squares[c] += (double) copy.rms[c] * copy.rms[c] * copy.samples;
+		}
+	}
+
+	if ( reading.samples > 0 ) {
+		for ( int c = 0; c < reading.numChannels; c++ ) {
+			reading.rms[c] = (float) sqrt( squares[c] / reading.samples );
+		}
+	}
+
+	cursor = newest;
+	return reading.windows > 0;
+}
+
+void VBAudioMeter::measure( const float* samples, int count, float& peak, float& sumOfSquares ) {
+	float maximum = 0;
+	float sum = 0;
+	int i = 0;
+
+#if VB_METER_SSE
+	// Two lanes of four, clearing the sign bit gives the absolute value
+	const __m128 sign = _mm_set1_ps( -0.0f );
+	__m128 peak0 = _mm_setzero_ps();
+	__m128 peak1 = _mm_setzero_ps();
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for ( ; i + 8 <= count; i += 8 ) {
+		__m128 a = _mm_loadu_ps( samples + i );
+		__m128 b = _mm_loadu_ps( samples + i + 4 );
+		peak0 = _mm_max_ps( peak0, _mm_andnot_ps( sign, a ) );
+		peak1 = _mm_max_ps( peak1, _mm_andnot_ps( sign, b ) );
+		sum0 = _mm_add_ps( sum0, _mm_mul_ps( a, a ) );
+		sum1 = _mm_add_ps( sum1, _mm_mul_ps( b, b ) );
+	}
+
+	float lanes[4];
+	_mm_storeu_ps( lanes, _mm_max_ps( peak0, peak1 ) );
+	for ( float lane : lanes ) {
+		maximum = lane > maximum ? lane : maximum;
+	}
+	_mm_storeu_ps( lanes, _mm_add_ps( sum0, sum1 ) );
+	sum = ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+#endif
+
+	for ( ; i < count; i++ ) {
+		float value = fabsf( samples[i] );
+		maximum = value > maximum ? value : maximum;
+		sum += samples[i] * samples[i];
+	}
+
+	peak = maximum;
+	sumOfSquares = sum;
+}
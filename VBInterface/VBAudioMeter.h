@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBAudioStream.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+* Sample accurate peak and RMS meter for a VBAudioStream
+*
+* Measures every input channel of one stream over windows of windowMs,
+* counted in samples so they line up with the audio rather than with when
+* buffers arrive. A window's peak is its largest absolute sample, so a
+* single sample transient is never missed the way polled VBVMR_GetLevel
+* readings miss it. The measuring loops use SSE wherever the compiler
+* targets it, x86-64 always, and plain loops elsewhere.
+*
+* Finished windows go into a ring of slots, each guarded by a sequence
+* number like VBLevelShm's, so readers on any thread copy them without
+* locks and the engine thread never waits for them. read() folds every
+* window since a reader's cursor into one reading.
+*
+* This header does not depend on Qt.
+**/
+class VBINTERFACE_EXPORT VBAudioMeter : public VBAudioStream::Processor {
+public:
+	static const int MAX_CHANNELS = VBAudioStream::MAX_CHANNELS;
+	/** Windows kept for readers, 640 ms of 10 ms windows */
+	static const int NUM_SLOTS = 64;
+
+	struct Window {
+		/** Increases by one per window, starts at 1 and carries on across restarts */
+		unsigned long long sequence = 0;
+		/** First sample of the window, counted from the stream's start */
+		long long firstSample = 0;
+		int sampleRate = 0;
+		int samples = 0;
+		int numChannels = 0;
+		/** Largest absolute sample, linear */
+		float peak[MAX_CHANNELS] = {};
+		float rms[MAX_CHANNELS] = {};
+	};
+
+	struct Reading {
+		int windows = 0;
+		/** Windows overwritten before the reader got to them */
+		int missed = 0;
+		long long samples = 0;
+		int numChannels = 0;
+		float peak[MAX_CHANNELS] = {};
+		float rms[MAX_CHANNELS] = {};
+	};
+
+	explicit VBAudioMeter( VBAudioStream::Stream stream = VBAudioStream::MAIN, int windowMs = 10 );
+	VBAudioMeter( const VBAudioMeter& ) = delete;
+	VBAudioMeter& operator=( const VBAudioMeter& ) = delete;
+
+	void starting( const VBAudioStream::Format& format ) override;
+	void process( const VBAudioStream::Buffer& buffer ) override;
+	/** Publishes the window in progress, however short */
+	void ending() override;
+
+	/** Sequence of the newest window, 0 before the first one */
+	unsigned long long latestSequence() const;
+	/** Copy the newest window, false if there is none */
+	bool latest( Window& window ) const;
+	/** Copy a window by sequence, false if it was overwritten or not published yet */
+	bool window( unsigned long long sequence, Window& window ) const;
+	/** Fold the windows after cursor into reading and move cursor to the newest, false if there are none */
+	bool read( unsigned long long& cursor, Reading& reading ) const;
+
+	/** Largest absolute sample and sum of squares of count samples, the loop process() runs per channel */
+	static void measure( const float* samples, int count, float& peak, float& sumOfSquares );
+
+private:
+	struct Slot {
+		/** Odd while the engine thread fills the slot, 2 * window sequence once complete */
+		std::atomic<unsigned long long> guard{ 0 };
+		Window window;
+	};
+
+	VBAudioStream::Stream stream;
+	int windowMs;
+
+	// Engine thread only
+	int sampleRate = 0;
+	int windowSamples = 0;
+	int filled = 0;
+	int numChannels = 0;
+	long long sampleClock = 0;
+	unsigned long long sequence = 0;
+	float peak[MAX_CHANNELS] = {};
+	double squares[MAX_CHANNELS] = {};
+
+	std::unique_ptr<Slot[]> ring;
+	std::atomic<unsigned long long> published{ 0 };
+
+	void publish();
+};
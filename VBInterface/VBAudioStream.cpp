@@ -0,0 +1,170 @@
+#include "VBAudioStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+VBAudioStream::VBAudioStream( VBCore& core ) : core( core ), running( false ), changed( false ), sampleRate( 0 ), frames( 0 ), bufferCount( 0 ) {
+}
+
+VBAudioStream::~VBAudioStream() {
+	stop();
+}
+
+bool VBAudioStream::addProcessor( Processor* processor ) {
+	if ( running || processor == nullptr ) {
+		return false;
+	}
+
+	processors.push_back( processor );
+	return true;
+}
+
+bool VBAudioStream::removeProcessor( Processor* processor ) {
+	if ( running ) {
+		return false;
+	}
+
+	auto it = std::find( processors.begin(), processors.end(), processor );
+	if ( it == processors.end() ) {
+		return false;
+	}
+
+	processors.erase( it );
+	return true;
+}
+
+bool VBAudioStream::setPassThrough( bool enabled ) {
+	if ( running ) {
+		return false;
+	}
+
+	passThrough = enabled;
+	return true;
+}
+
+long VBAudioStream::start( int streams, const char* clientName, std::string* otherClient ) {
+	if ( running ) {
+		return 0;
+	}
+
+	char name[64] = {};
+	strncpy( name, clientName ? clientName : "VBInterface", sizeof( name ) - 1 );
+
+	changed = false;
+	bufferCount = 0;
+
+	long result = core.registerAudioCallback( streams, dispatch, this, name );
+	if ( result != 0 ) {
+		if ( result == 1 && otherClient ) {
+			otherClient->assign( name, strnlen( name, sizeof( name ) ) );
+		}
+		return result;
+	}
+
+	result = core.startAudioCallback();
+	if ( result != 0 ) {
+		core.unregisterAudioCallback();
+		return result;
+	}
+
+	running = true;
+	return 0;
+}
+
+void VBAudioStream::stop() {
+	if ( !running ) {
+		return;
+	}
+
+	core.stopAudioCallback();
+	core.unregisterAudioCallback();
+	running = false;
+}
+
+bool VBAudioStream::isRunning() const {
+	return running;
+}
+
+bool VBAudioStream::restartRequested() const {
+	return changed;
+}
+
+VBAudioStream::Format VBAudioStream::format() const {
+	Format current;
+	current.sampleRate = sampleRate;
+	current.frames = frames;
+	return current;
+}
+
+unsigned long long VBAudioStream::buffers() const {
+	return bufferCount;
+}
+
+long __stdcall VBAudioStream::dispatch( void* user, long command, void* data, long ) {
+	VBAudioStream* self = static_cast<VBAudioStream*>( user );
+
+	switch ( command ) {
+	case VBVMR_CBCOMMAND_STARTING: {
+		const VBVMR_T_AUDIOINFO* info = static_cast<const VBVMR_T_AUDIOINFO*>( data );
+		Format format;
+		format.sampleRate = info->samplerate;
+		format.frames = info->nbSamplePerFrame;
+		self->sampleRate = format.sampleRate;
+		self->frames = format.frames;
+		for ( Processor* processor : self->processors ) {
+			processor->starting( format );
+		}
+		break;
+	}
+	case VBVMR_CBCOMMAND_ENDING:
+		for ( Processor* processor : self->processors ) {
+			processor->ending();
+		}
+		break;
+	case VBVMR_CBCOMMAND_CHANGE:
+		self->changed = true;
+		break;
+	case VBVMR_CBCOMMAND_BUFFER_IN:
+		self->process( INPUT, *static_cast<VBVMR_T_AUDIOBUFFER*>( data ) );
+		break;
+	case VBVMR_CBCOMMAND_BUFFER_OUT:
+		self->process( OUTPUT, *static_cast<VBVMR_T_AUDIOBUFFER*>( data ) );
+		break;
+	case VBVMR_CBCOMMAND_BUFFER_MAIN:
+		self->process( MAIN, *static_cast<VBVMR_T_AUDIOBUFFER*>( data ) );
+		break;
+	}
+
+	return 0;
+}
+
+void VBAudioStream::process( Stream stream, VBVMR_T_AUDIOBUFFER& buffer ) {
+	int numInputs = buffer.audiobuffer_nbi < MAX_CHANNELS ? (int) buffer.audiobuffer_nbi : MAX_CHANNELS;
+	int numOutputs = buffer.audiobuffer_nbo < MAX_CHANNELS ? (int) buffer.audiobuffer_nbo : MAX_CHANNELS;
+	size_t bytes = (size_t) buffer.audiobuffer_nbs * sizeof( float );
+
+	if ( passThrough ) {
+		// Inserts line up channel for channel, the main stream's buses follow its inputs
+		int first = stream == MAIN ? numInputs - numOutputs : 0;
+		for ( int c = 0; c < numOutputs && first + c >= 0 && first + c < numInputs; c++ ) {
+			if ( buffer.audiobuffer_w[c] != buffer.audiobuffer_r[first + c] ) {
+				memcpy( buffer.audiobuffer_w[c], buffer.audiobuffer_r[first + c], bytes );
+			}
+		}
+	}
+
+	Buffer view;
+	view.stream = stream;
+	view.sampleRate = buffer.audiobuffer_sr;
+	view.frames = buffer.audiobuffer_nbs;
+	view.numInputs = numInputs;
+	view.numOutputs = numOutputs;
+	view.inputs = buffer.audiobuffer_r;
+	view.outputs = buffer.audiobuffer_w;
+
+	for ( Processor* processor : processors ) {
+		processor->process( view );
+	}
+
+	bufferCount.fetch_add( 1, std::memory_order_relaxed );
+}
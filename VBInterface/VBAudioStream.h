@@ -0,0 +1,106 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBCore.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+* Voicemeeter audio callback as a chain of processors
+*
+* Registers one callback with the server for any of its three streams and
+* hands every buffer to the processors as the engine's own sample pointers,
+* on the engine's time critical thread. Nothing is copied but what the
+* server needs for audio to keep flowing: when an insert's output pointers
+* differ from its input ones the input is copied across first, and the
+* main stream's bus channels, which come after its inputs, are copied to
+* its outputs. Processors can then read the input and change the output in
+* place. Processors must not block, lock, allocate or call into the core
+* while processing.
+*
+* The chain is only changed while stopped, the engine thread reads it
+* without a lock. Start and stop from one thread.
+*
+* This header does not depend on Qt.
+**/
+class VBINTERFACE_EXPORT VBAudioStream {
+public:
+	enum Stream {
+		/** Strip inputs as an insert */
+		INPUT = VBVMR_AUDIOCALLBACK_IN,
+		/** Bus outputs as an insert */
+		OUTPUT = VBVMR_AUDIOCALLBACK_OUT,
+		/** Every input and bus, then the buses to play */
+		MAIN = VBVMR_AUDIOCALLBACK_MAIN
+	};
+
+	struct Format {
+		int sampleRate = 0;
+		/** Samples per channel in every buffer */
+		int frames = 0;
+	};
+
+	/** One engine buffer, the pointers are the server's and only valid during process() */
+	struct Buffer {
+		Stream stream;
+		int sampleRate;
+		int frames;
+		int numInputs;
+		int numOutputs;
+		float* const* inputs;
+		float* const* outputs;
+	};
+
+	class VBINTERFACE_EXPORT Processor {
+	public:
+		virtual ~Processor() = default;
+		/** On the engine thread before the first buffer, may allocate */
+		virtual void starting( const Format& format ) { ( void ) format; }
+		virtual void process( const Buffer& buffer ) = 0;
+		/** On the engine thread after the last buffer */
+		virtual void ending() {}
+	};
+
+	/** Most channels a buffer has, as VBVMR_T_AUDIOBUFFER holds */
+	static const int MAX_CHANNELS = 128;
+
+	explicit VBAudioStream( VBCore& core );
+	/** Stops and unregisters */
+	~VBAudioStream();
+	VBAudioStream( const VBAudioStream& ) = delete;
+	VBAudioStream& operator=( const VBAudioStream& ) = delete;
+
+	/** Processors run in the order added, false while running */
+	bool addProcessor( Processor* processor );
+	bool removeProcessor( Processor* processor );
+	/** Copy inputs to outputs where the server needs it, on by default, false while running */
+	bool setPassThrough( bool enabled );
+
+	/** Register for a mask of Streams and start, returns 0, the core's result, or 1 with the name of the client holding the callback in otherClient */
+	long start( int streams, const char* clientName, std::string* otherClient = nullptr );
+	/** Waits for the engine thread to leave the callback */
+	void stop();
+	bool isRunning() const;
+	/** Set by the server's CHANGE command, the format changed and the stream has to be stopped and started again */
+	bool restartRequested() const;
+	/** As of the last STARTING command */
+	Format format() const;
+	/** Buffers processed since starting */
+	unsigned long long buffers() const;
+
+private:
+	VBCore& core;
+	std::vector<Processor*> processors;
+	bool passThrough = true;
+	std::atomic<bool> running;
+	std::atomic<bool> changed;
+	std::atomic<int> sampleRate;
+	std::atomic<int> frames;
+	std::atomic<unsigned long long> bufferCount;
+
+	static long __stdcall dispatch( void* user, long command, void* data, long nnn );
+	void process( Stream stream, VBVMR_T_AUDIOBUFFER& buffer );
+};
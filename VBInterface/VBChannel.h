@@ -0,0 +1,253 @@
+#pragma once
+
+#include "VBInterface.h"
+
+/**
+* Compile-time channel handles
+*
+* vb.strip<0>().setGain( -6 ) or vb.bus<3>().levels() resolve the channel,
+* its parameter names and what it supports at compile time. Asking a strip
+* for an output device or a bus for an input tap does not compile. Reads
+* and writes hand prebuilt names straight to VBCore, the same caching
+* and reconnect handling as the QString API applies.
+**/
+namespace VBChannel {
+	typedef VBInterface::Channel Channel;
+
+	constexpr const char* stripNames[MAX_STRIPS] = { "Strip[0]", "Strip[1]", "Strip[2]", "Strip[3]", "Strip[4]", "Strip[5]", "Strip[6]", "Strip[7]" };
+	constexpr const char* busNames[MAX_BUSES] = { "Bus[0]", "Bus[1]", "Bus[2]", "Bus[3]", "Bus[4]", "Bus[5]", "Bus[6]", "Bus[7]" };
+
+	/** Per-channel layout of a type, built from VBLayout's counts */
+	constexpr VBInterface::Layout makeLayout( const VBLayout::Counts& counts ) {
+		VBInterface::Layout layout = {};
+		layout.type = (VBInterface::Voicemeeter_Type) counts.type;
+		layout.numStrips = counts.physicalStrips + counts.virtualStrips;
+		layout.numBuses = counts.physicalBuses + counts.virtualBuses;
+
+		// Hardware strips have 2 level slots, virtual strips 8, all share the input taps
+		int slot = 0;
+		for ( int i = 0; i < MAX_STRIPS; i++ ) {
+			VBInterface::Channel_Info& info = layout.channels[VBInterface::STRIP1 + i];
+			info.prefix = stripNames[i];
+			if ( i >= layout.numStrips ) {
+				continue;
+			}
+
+			info.present = true;
+			info.physical = i < counts.physicalStrips;
+			info.levelFirst = slot;
+			info.levelCount = info.physical ? VBLayout::PHYSICAL_STRIP_SLOTS : CHANNEL_LEVEL_SIZE;
+			slot += info.levelCount;
+		}
+		layout.numLevels[VBInterface::PRE_FADER] = counts.numInputLevels;
+		layout.numLevels[VBInterface::POST_FADER] = counts.numInputLevels;
+		layout.numLevels[VBInterface::POST_MUTE] = counts.numInputLevels;
+
+		// Every bus has 8 level slots on the output tap
+		for ( int i = 0; i < MAX_BUSES; i++ ) {
+			VBInterface::Channel_Info& info = layout.channels[VBInterface::BUS1 + i];
+			info.prefix = busNames[i];
+			info.output = true;
+			if ( i >= layout.numBuses ) {
+				continue;
+			}
+
+			info.present = true;
+			info.physical = i < counts.physicalBuses;
+			info.levelFirst = i * CHANNEL_LEVEL_SIZE;
+			info.levelCount = CHANNEL_LEVEL_SIZE;
+		}
+		layout.numLevels[VBInterface::OUTPUT] = counts.numOutputLevels;
+
+		return layout;
+	}
+
+	/** Layout of a type, BANANA for anything unknown */
+	constexpr VBInterface::Layout layoutOf( VBInterface::Voicemeeter_Type type ) {
+		return makeLayout( VBLayout::countsOf( type ) );
+	}
+
+	/** A parameter name built at compile time, e.g. "Bus[3].mute" */
+	struct Name {
+		char text[24];
+	};
+
+	constexpr Name makeName( const char* prefix, const char* suffix ) {
+		Name name = {};
+		int length = 0;
+		for ( const char* c = prefix; *c != 0; c++ ) {
+			name.text[length++] = *c;
+		}
+		for ( const char* c = suffix; *c != 0; c++ ) {
+			name.text[length++] = *c;
+		}
+		return name;
+	}
+
+	/** What is known about a channel regardless of the Voicemeeter type */
+	template<Channel C>
+	struct Traits {
+		static_assert( C >= VBInterface::STRIP1 && C < VBInterface::NUM_CHANNELS, "No such channel" );
+
+		static constexpr bool output = C >= VBInterface::BUS1;
+		static constexpr int index = output ? C - VBInterface::BUS1 : C - VBInterface::STRIP1;
+		/** Tap levels are read from when none is given */
+		static constexpr VBInterface::Level_Tap defaultTap = output ? VBInterface::OUTPUT : VBInterface::PRE_FADER;
+		static constexpr const char* prefix = output ? busNames[index] : stripNames[index];
+
+		// Same names as getVolume()/getMute() so both APIs share cache entries
+		static constexpr Name gain = makeName( prefix, ".gain" );
+		static constexpr Name mute = makeName( prefix, ".mute" );
+		static constexpr Name solo = makeName( prefix, ".solo" );
+	};
+
+	template<Channel C> constexpr bool Traits<C>::output;
+	template<Channel C> constexpr int Traits<C>::index;
+	template<Channel C> constexpr VBInterface::Level_Tap Traits<C>::defaultTap;
+	template<Channel C> constexpr const char* Traits<C>::prefix;
+	template<Channel C> constexpr Name Traits<C>::gain;
+	template<Channel C> constexpr Name Traits<C>::mute;
+	template<Channel C> constexpr Name Traits<C>::solo;
+
+	/** What a channel looks like on a given Voicemeeter type */
+	template<VBInterface::Voicemeeter_Type T, Channel C>
+	struct Layout_Traits {
+		static constexpr VBInterface::Channel_Info info = layoutOf( T ).channels[C];
+
+		static constexpr bool present = info.present;
+		static constexpr bool physical = info.physical;
+		static constexpr int levelFirst = info.levelFirst;
+		static constexpr int levelCount = info.levelCount;
+	};
+
+	template<VBInterface::Voicemeeter_Type T, Channel C> constexpr VBInterface::Channel_Info Layout_Traits<T, C>::info;
+
+	/** The parts of VBInterface the handles use, kept out of its public API */
+	struct Access {
+		static float readFloat( VBInterface& vb, std::string_view name ) {
+			return vb.readFloatName( name );
+		}
+
+		static void setFloat( VBInterface& vb, std::string_view name, float val ) {
+			vb.setFloatName( name, val );
+		}
+	};
+
+	/** Operations every strip and bus has */
+	template<Channel C>
+	class Channel_Handle {
+	public:
+		typedef Traits<C> Channel_Traits;
+		static constexpr Channel channel = C;
+
+		explicit Channel_Handle( VBInterface& vb ) : vb( vb ) {}
+
+		/** False if the running Voicemeeter type lacks this channel */
+		bool present() const {
+			return vb.hasChannel( C );
+		}
+
+		float gain() const {
+			return Access::readFloat( vb, Channel_Traits::gain.text );
+		}
+
+		void setGain( float dB ) const {
+			Access::setFloat( vb, Channel_Traits::gain.text, dB );
+		}
+
+		bool mute() const {
+			return Access::readFloat( vb, Channel_Traits::mute.text ) != 0;
+		}
+
+		void setMute( bool mute ) const {
+			Access::setFloat( vb, Channel_Traits::mute.text, mute ? 1.f : 0.f );
+		}
+
+		bool toggleMute() const {
+			bool muted = !mute();
+			setMute( muted );
+			return muted;
+		}
+
+	protected:
+		VBInterface& vb;
+	};
+
+	template<Channel C> constexpr Channel Channel_Handle<C>::channel;
+
+	/** Strip N, see VBInterface::strip() */
+	template<int N>
+	class Strip : public Channel_Handle<(Channel) ( VBInterface::STRIP1 + N )> {
+		static_assert( N >= 0 && N < MAX_STRIPS, "Strip index out of range" );
+
+		typedef Channel_Handle<(Channel) ( VBInterface::STRIP1 + N )> Base;
+		using Base::vb;
+
+	public:
+		explicit Strip( VBInterface& vb ) : Base( vb ) {}
+
+		bool solo() const {
+			return Access::readFloat( vb, Base::Channel_Traits::solo.text ) != 0;
+		}
+
+		void setSolo( bool solo ) const {
+			Access::setFloat( vb, Base::Channel_Traits::solo.text, solo ? 1.f : 0.f );
+		}
+
+		/** Levels at an input tap, OUTPUT is not a strip tap */
+		VBInterface::Channel_Level levels( VBInterface::Level_Tap tap = VBInterface::PRE_FADER ) const {
+			return vb.getChannelLevel( Base::channel, tap == VBInterface::OUTPUT ? VBInterface::PRE_FADER : tap );
+		}
+
+		VBInterface::Device inputDevice() const {
+			return vb.getInputDevice( Base::channel );
+		}
+
+		void setInputDevice( VBInterface::Device device ) const {
+			vb.setInputDevice( Base::channel, device );
+		}
+
+		void setInputDevice( QString deviceName ) const {
+			vb.setInputDevice( Base::channel, deviceName );
+		}
+	};
+
+	/** Bus N, see VBInterface::bus() */
+	template<int N>
+	class Bus : public Channel_Handle<(Channel) ( VBInterface::BUS1 + N )> {
+		static_assert( N >= 0 && N < MAX_BUSES, "Bus index out of range" );
+
+		typedef Channel_Handle<(Channel) ( VBInterface::BUS1 + N )> Base;
+		using Base::vb;
+
+	public:
+		explicit Bus( VBInterface& vb ) : Base( vb ) {}
+
+		/** Buses only have the output tap */
+		VBInterface::Channel_Level levels() const {
+			return vb.getChannelLevel( Base::channel, VBInterface::OUTPUT );
+		}
+
+		VBInterface::Device outputDevice() const {
+			return vb.getOutputDevice( Base::channel );
+		}
+
+		void setOutputDevice( VBInterface::Device device ) const {
+			vb.setOutputDevice( Base::channel, device );
+		}
+
+		void setOutputDevice( QString deviceName ) const {
+			vb.setOutputDevice( Base::channel, deviceName );
+		}
+	};
+}
+
+template<int N>
+VBChannel::Strip<N> VBInterface::strip() {
+	return VBChannel::Strip<N>( *this );
+}
+
+template<int N>
+VBChannel::Bus<N> VBInterface::bus() {
+	return VBChannel::Bus<N>( *this );
+}
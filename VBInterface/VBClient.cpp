@@ -0,0 +1,484 @@
+#include "VBClient.h"
+
+#include <QDebug>
+
+using namespace VBProtocol;
+
+VBClient::VBClient( QObject* parent ) : QObject( parent ) {
+	QObject::connect( &socket, &QLocalSocket::readyRead, this, &VBClient::readFrames );
+	QObject::connect( &socket, &QLocalSocket::disconnected, this, &VBClient::disconnected );
+}
+
+bool VBClient::connectToServer( QString name, int msecs ) {
+	socket.connectToServer( name );
+	if ( !socket.waitForConnected( msecs ) ) {
+		qWarning() << "Cannot connect to VBServer" << name << socket.errorString();
+		return false;
+	}
+
+	// Learn the server's layout before the first channel call
+	QByteArray frame;
+	Writer request( frame );
+	quint32 id = nextId++;
+	request.begin( id, GET_STATE );
+	request.finish();
+	send( frame );
+
+	QByteArray payload;
+	if ( !waitForReply( id, payload ) ) {
+		return false;
+	}
+
+	Reader reply( payload.constData(), payload.size() );
+	state = (VBInterface::Connection_State) reply.get<quint8>();
+	type = (VBInterface::Voicemeeter_Type) reply.get<quint8>();
+	return true;
+}
+
+void VBClient::disconnectFromServer() {
+	socket.disconnectFromServer();
+	in.clear();
+	replies.clear();
+}
+
+bool VBClient::isConnected() {
+	return socket.state() == QLocalSocket::ConnectedState;
+}
+
+VBInterface::Connection_State VBClient::getConnectionState() {
+	return state;
+}
+
+VBInterface::Voicemeeter_Type VBClient::getType() {
+	return type;
+}
+
+void VBClient::setTimeout( int msecs ) {
+	timeout = msecs;
+}
+
+void VBClient::subscribe( bool enable ) {
+	QByteArray frame;
+	Writer request( frame );
+	request.begin( 0, SUBSCRIBE );
+	request.put<quint8>( enable );
+	request.finish();
+	send( frame );
+}
+
+void VBClient::beginBatch() {
+	batching = true;
+}
+
+void VBClient::commitBatch() {
+	batching = false;
+	if ( batch.isEmpty() ) {
+		return;
+	}
+
+	QByteArray frame;
+	Writer request( frame );
+
+	// Raw script lines stay in place, a later write to a parameter they set has to win
+	const std::vector<VBScript::Entry>& entries = batch.entries();
+	for ( size_t first = 0; first < entries.size(); first += MAX_BATCH_ENTRIES ) {
+		size_t count = entries.size() - first < (size_t) MAX_BATCH_ENTRIES ? entries.size() - first : (size_t) MAX_BATCH_ENTRIES;
+		request.begin( 0, BATCH );
+		request.put<quint16>( (quint16) count );
+
+		for ( size_t i = first; i < first + count; i++ ) {
+			const VBScript::Entry& entry = entries[i];
+			request.put<quint8>( entry.kind );
+			if ( entry.kind == VBScript::RAW ) {
+				request.putString( entry.text );
+			} else if ( entry.kind == VBScript::FLOAT ) {
+				request.putString( entry.req );
+				request.put<float>( entry.number );
+			} else {
+				request.putString( entry.req );
+				request.putString( entry.text );
+			}
+		}
+		request.finish();
+	}
+
+	batch.clear();
+	send( frame );
+}
+
+QString VBClient::readString( QString req ) {
+	QByteArray frame;
+	Writer request( frame );
+	quint32 id = nextId++;
+	request.begin( id, READ_STRING );
+	request.putString( req );
+	request.finish();
+	send( frame );
+
+	QByteArray payload;
+	if ( !waitForReply( id, payload ) ) {
+		return "";
+	}
+
+	Reader reply( payload.constData(), payload.size() );
+	return reply.getString();
+}
+
+float VBClient::readFloat( QString req ) {
+	std::vector<float> values = readFloats( QStringList() << req );
+	return values.front();
+}
+
+std::vector<float> VBClient::readFloats( QStringList reqs ) {
+	std::vector<float> values( reqs.size(), 0.f );
+	if ( reqs.isEmpty() ) {
+		return values;
+	}
+
+	// Pipeline every read, then collect the replies
+	QByteArray frame;
+	Writer request( frame );
+	quint32 firstId = nextId;
+	for ( const QString& req : reqs ) {
+		request.begin( nextId++, READ_FLOAT );
+		request.putString( req );
+		request.finish();
+	}
+	send( frame );
+
+	for ( int i = 0; i < (int) values.size(); i++ ) {
+		QByteArray payload;
+		if ( !waitForReply( firstId + i, payload ) ) {
+			break;
+		}
+
+		Reader reply( payload.constData(), payload.size() );
+		values[i] = reply.get<float>();
+	}
+
+	return values;
+}
+
+void VBClient::setString( QString req, QString val ) {
+	if ( batching ) {
+		batch.setString( req, val );
+		return;
+	}
+
+	QByteArray frame;
+	Writer request( frame );
+	request.begin( 0, SET_STRING );
+	request.putString( req );
+	request.putString( val );
+	request.finish();
+	send( frame );
+}
+
+void VBClient::setFloat( QString req, float val ) {
+	if ( batching ) {
+		batch.setFloat( req, val );
+		return;
+	}
+
+	QByteArray frame;
+	Writer request( frame );
+	request.begin( 0, SET_FLOAT );
+	request.putString( req );
+	request.put<float>( val );
+	request.finish();
+	send( frame );
+}
+
+void VBClient::setParameters( QString script ) {
+	if ( batching ) {
+		batch.appendRaw( script );
+		return;
+	}
+
+	QByteArray frame;
+	Writer request( frame );
+	request.begin( 0, SET_PARAMETERS );
+	request.putString( script );
+	request.finish();
+	send( frame );
+}
+
+void VBClient::apply( const VBScript& script ) {
+	bool wasBatching = batching;
+	batching = true;
+	batch.append( script );
+
+	if ( !wasBatching ) {
+		commitBatch();
+	}
+}
+
+float VBClient::getVolume( Channel channel ) {
+	return readFloat( channelToString( channel ) + ".gain" );
+}
+
+void VBClient::setVolume( Channel channel, float val ) {
+	setFloat( channelToString( channel ) + ".gain", val );
+}
+
+float VBClient::setVolumeRelative( Channel channel, float amt ) {
+	float vol = getVolume( channel );
+	setVolume( channel, vol + amt );
+
+	return vol + amt;
+}
+
+bool VBClient::getMute( Channel channel ) {
+	return (bool) readFloat( channelToString( channel ) + ".mute" );
+}
+
+void VBClient::setMute( Channel channel, bool mute ) {
+	setFloat( channelToString( channel ) + ".mute", mute );
+}
+
+bool VBClient::toggleMute( Channel channel ) {
+	bool mute = getMute( channel );
+	setMute( channel, !mute );
+	return !mute;
+}
+
+VBClient::Channel_Level VBClient::getChannelLevel( Channel channel, Level_Tap tap ) {
+	return VBInterface::frameToChannelLevel( VBInterface::getLayout( type ), getLevelFrame( tap ), channel );
+}
+
+std::map<VBClient::Channel, VBClient::Channel_Level> VBClient::getAllChannelLevels( Level_Tap inputTap ) {
+	std::map<Channel, Channel_Level> levels;
+	const VBInterface::Layout& layout = VBInterface::getLayout( type );
+	Level_Frame frame = getLevelFrame( inputTap );
+
+	for ( int i = VBInterface::STRIP1; i < VBInterface::NUM_CHANNELS; i++ ) {
+		if ( layout.channels[i].present ) {
+			levels[(Channel) i] = VBInterface::frameToChannelLevel( layout, frame, (Channel) i );
+		}
+	}
+
+	return levels;
+}
+
+VBClient::Level_Frame VBClient::getLevelFrame( Level_Tap inputTap ) {
+	Level_Frame frame;
+
+	QByteArray request;
+	Writer writer( request );
+	quint32 id = nextId++;
+	writer.begin( id, GET_LEVEL_FRAME );
+	writer.put<quint8>( inputTap );
+	writer.finish();
+	send( request );
+
+	QByteArray payload;
+	if ( !waitForReply( id, payload ) ) {
+		return frame;
+	}
+
+	Reader reply( payload.constData(), payload.size() );
+	frame.inputTap = (Level_Tap) reply.get<quint8>();
+	int numInputs = qMin<int>( reply.get<quint8>(), MAX_INPUT_LEVELS );
+	int numOutputs = qMin<int>( reply.get<quint8>(), MAX_OUTPUT_LEVELS );
+
+	if ( reply.getBytes( reinterpret_cast<char*>( frame.input ), numInputs * sizeof( float ) )
+		&& reply.getBytes( reinterpret_cast<char*>( frame.output ), numOutputs * sizeof( float ) ) ) {
+		frame.numInputs = numInputs;
+		frame.numOutputs = numOutputs;
+	}
+
+	return frame;
+}
+
+std::vector<VBClient::Device> VBClient::getOutputDevices() {
+	return getDevices( true );
+}
+
+VBClient::Device VBClient::getOutputDevice( Channel channel ) {
+	Device device;
+	device.name = readString( channelToString( channel ) + ".device.name" );
+	device.type = VBInterface::UNKNOWN;
+	return device;
+}
+
+void VBClient::setOutputDevice( Channel channel, int deviceIndex ) {
+	setOutputDevice( channel, getOutputDevices().at( deviceIndex ) );
+}
+
+void VBClient::setOutputDevice( Channel channel, QString deviceName ) {
+	Device device;
+	device.type = VBInterface::UNKNOWN;
+	device.name = deviceName;
+	setDevice( true, channel, device );
+}
+
+void VBClient::setOutputDevice( Channel channel, Device device ) {
+	setDevice( true, channel, device );
+}
+
+std::vector<VBClient::Device> VBClient::getInputDevices() {
+	return getDevices( false );
+}
+
+VBClient::Device VBClient::getInputDevice( Channel channel ) {
+	Device device;
+	device.name = readString( channelToString( channel ) + ".device.name" );
+	device.type = VBInterface::UNKNOWN;
+	return device;
+}
+
+void VBClient::setInputDevice( Channel channel, int deviceIndex ) {
+	setInputDevice( channel, getInputDevices().at( deviceIndex ) );
+}
+
+void VBClient::setInputDevice( Channel channel, QString deviceName ) {
+	Device device;
+	device.type = VBInterface::UNKNOWN;
+	device.name = deviceName;
+	setDevice( false, channel, device );
+}
+
+void VBClient::setInputDevice( Channel channel, Device device ) {
+	setDevice( false, channel, device );
+}
+
+std::vector<VBClient::Device> VBClient::getDevices( bool output ) {
+	std::vector<Device> devices;
+
+	QByteArray frame;
+	Writer request( frame );
+	quint32 id = nextId++;
+	request.begin( id, GET_DEVICES );
+	request.put<quint8>( output );
+	request.finish();
+	send( frame );
+
+	QByteArray payload;
+	if ( !waitForReply( id, payload ) ) {
+		return devices;
+	}
+
+	Reader reply( payload.constData(), payload.size() );
+	int count = reply.get<quint16>();
+	for ( int i = 0; i < count && reply.ok(); i++ ) {
+		Device device;
+		device.type = (VBInterface::Device_Type) reply.get<quint8>();
+		device.name = reply.getString();
+		device.hardwareID = reply.getString();
+		devices.push_back( device );
+	}
+
+	return devices;
+}
+
+void VBClient::setDevice( bool output, Channel channel, Device device ) {
+	QByteArray frame;
+	Writer request( frame );
+	request.begin( 0, SET_DEVICE );
+	request.put<quint8>( output );
+	request.put<quint8>( channel );
+	request.put<quint8>( device.type );
+	request.putString( device.name );
+	request.finish();
+	send( frame );
+}
+
+QString VBClient::channelToString( Channel channel ) {
+	if ( channel < 0 || channel >= VBInterface::NUM_CHANNELS ) {
+		channel = VBInterface::BUS1;
+	}
+
+	return QString( VBInterface::getLayout( type ).channels[channel].prefix );
+}
+
+void VBClient::send( const QByteArray& frame ) {
+	if ( !isConnected() ) {
+		qWarning() << "Attempting to talk to VBServer when not connected";
+		return;
+	}
+
+	socket.write( frame );
+	socket.flush();
+}
+
+bool VBClient::waitForReply( quint32 id, QByteArray& payload ) {
+	while ( isConnected() ) {
+		auto it = replies.find( id );
+		if ( it != replies.end() ) {
+			payload = it->second;
+			replies.erase( it );
+			return true;
+		}
+
+		if ( !socket.waitForReadyRead( timeout ) ) {
+			break;
+		}
+
+		readFrames();
+	}
+
+	// Calls are synchronous, nothing sent so far is waited for any more
+	abandoned = nextId - 1;
+	replies.clear();
+
+	qWarning() << "No reply from VBServer";
+	return false;
+}
+
+void VBClient::readFrames() {
+	in.append( socket.readAll() );
+
+	bool dirty = false;
+	bool changed = false;
+
+	int offset = 0;
+	for ( ;; ) {
+		int size = frameSize( in, offset );
+		if ( size == 0 ) {
+			break;
+		}
+
+		if ( size < 0 ) {
+			qWarning() << "Malformed frame from VBServer";
+			socket.abort();
+			in.clear();
+			return;
+		}
+
+		Reader reader( in.constData() + offset + sizeof( quint32 ), size - (int) sizeof( quint32 ) );
+		quint32 id = reader.get<quint32>();
+		quint8 op = reader.get<quint8>();
+
+		switch ( op ) {
+			case REPLY:
+				// Late replies to calls that gave up are dropped, they would never be collected
+				if ( id > abandoned ) {
+					replies[id] = in.mid( offset + HEADER_SIZE, size - HEADER_SIZE );
+				}
+				break;
+			case NOTIFY_DIRTY:
+				dirty = true;
+				break;
+			case NOTIFY_STATE:
+				state = (VBInterface::Connection_State) reader.get<quint8>();
+				type = (VBInterface::Voicemeeter_Type) reader.get<quint8>();
+				changed = true;
+				break;
+			default:
+				break;
+		}
+
+		offset += size;
+	}
+
+	in.remove( 0, offset );
+
+	// Emit once the buffer is consistent, slots may issue new requests
+	if ( changed ) {
+		emit stateChanged( state );
+	}
+
+	if ( dirty ) {
+		emit parametersDirty();
+	}
+}
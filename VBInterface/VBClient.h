@@ -0,0 +1,114 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QLocalSocket>
+#include <QStringList>
+#include <map>
+#include <vector>
+
+#include "VBInterface.h"
+#include "VBProtocol.h"
+
+/**
+* Talks to a VBServer instead of loading the DLL, mirrors the VBInterface API
+*
+* Writes are sent without waiting for the server so they pipeline, reads
+* block until their reply arrives or the timeout expires.
+**/
+class VBINTERFACE_EXPORT VBClient : public QObject {
+	Q_OBJECT
+
+public:
+	typedef VBInterface::Channel Channel;
+	typedef VBInterface::Channel_Level Channel_Level;
+	typedef VBInterface::Level_Frame Level_Frame;
+	typedef VBInterface::Level_Tap Level_Tap;
+	typedef VBInterface::Device Device;
+
+	VBClient( QObject* parent = nullptr );
+
+public slots:
+	/** Connect to a running VBServer */
+	bool connectToServer( QString name = VBProtocol::DEFAULT_SERVER_NAME, int msecs = 1000 );
+	void disconnectFromServer();
+	bool isConnected();
+	/** State of the server's own connection to Voicemeeter */
+	VBInterface::Connection_State getConnectionState();
+	VBInterface::Voicemeeter_Type getType();
+	/** How long reads wait for the server */
+	void setTimeout( int msecs );
+	/** Receive parametersDirty() when anything changes on the server */
+	void subscribe( bool enable = true );
+
+	/** Collect writes until commitBatch() and send them as one script */
+	void beginBatch();
+	void commitBatch();
+
+	/////////////////// Raw Access Functions ///////////////////////
+
+	QString readString( QString req );
+	float readFloat( QString req );
+	/** Read several floats with one round trip */
+	std::vector<float> readFloats( QStringList reqs );
+	void setString( QString req, QString val );
+	void setFloat( QString req, float val );
+	void setParameters( QString script );
+	void apply( const VBScript& script );
+
+	////////////////////// Helper Functions ///////////////////////
+
+	float getVolume( Channel channel );
+	void setVolume( Channel channel, float val );
+	float setVolumeRelative( Channel channel, float amt );
+	bool getMute( Channel channel );
+	void setMute( Channel channel, bool mute );
+	bool toggleMute( Channel channel );
+	Channel_Level getChannelLevel( Channel channel, Level_Tap tap = VBInterface::PRE_FADER );
+	std::map<Channel, Channel_Level> getAllChannelLevels( Level_Tap inputTap = VBInterface::PRE_FADER );
+	Level_Frame getLevelFrame( Level_Tap inputTap = VBInterface::PRE_FADER );
+
+	std::vector<Device> getOutputDevices();
+	Device getOutputDevice( Channel channel );
+	void setOutputDevice( Channel channel, int deviceIndex );
+	void setOutputDevice( Channel channel, QString deviceName );
+	void setOutputDevice( Channel channel, Device device );
+
+	std::vector<Device> getInputDevices();
+	Device getInputDevice( Channel channel );
+	void setInputDevice( Channel channel, int deviceIndex );
+	void setInputDevice( Channel channel, QString deviceName );
+	void setInputDevice( Channel channel, Device device );
+
+signals:
+	/** Parameters changed on the server, only sent while subscribed */
+	void parametersDirty();
+	/** The server's connection to Voicemeeter changed */
+	void stateChanged( VBInterface::Connection_State state );
+	void disconnected();
+
+private slots:
+	void readFrames();
+
+private:
+	QLocalSocket socket;
+	QByteArray in;
+	quint32 nextId = 1;
+	int timeout = 1000;
+	bool batching = false;
+	VBScript batch;
+
+	VBInterface::Connection_State state = VBInterface::DISCONNECTED;
+	VBInterface::Voicemeeter_Type type = VBInterface::BANANA;
+
+	/** Replies that arrived while waiting for another one */
+	std::map<quint32, QByteArray> replies;
+	/** Requests up to this id timed out, their replies are no longer kept */
+	quint32 abandoned = 0;
+
+	void send( const QByteArray& frame );
+	bool waitForReply( quint32 id, QByteArray& payload );
+	std::vector<Device> getDevices( bool output );
+	void setDevice( bool output, Channel channel, Device device );
+	QString channelToString( Channel channel );
+};
@@ -0,0 +1,562 @@
+#include "VBConnection.h"
+#include "VBTrace.h"
+
+#include <QSettings>
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+#include <algorithm>
+#include <mutex>
+
+namespace {
+	const int PROBE_INTERVAL = 50;
+
+	// Shared by every connection in the process, the registry is only read once
+	QString cachedDLLPath;
+
+	std::mutex sharedMutex;
+	std::weak_ptr<VBConnection> sharedConnection;
+
+	qint64 usecsSince( const QElapsedTimer& timer, qint64 start ) {
+		return ( timer.nsecsElapsed() - start ) / 1000;
+	}
+
+	/** The core's names are UTF-8, as the DLL's A functions take them */
+	std::string toCore( const QString& text ) {
+		return text.toStdString();
+	}
+
+	QString fromCore( const std::string& text ) {
+		return QString::fromStdString( text );
+	}
+}
+
+std::shared_ptr<VBConnection> VBConnection::shared() {
+	std::lock_guard<std::mutex> lock( sharedMutex );
+
+	std::shared_ptr<VBConnection> connection = sharedConnection.lock();
+	if ( !connection ) {
+		connection = std::make_shared<VBConnection>();
+		sharedConnection = connection;
+	}
+
+	return connection;
+}
+
+VBConnection::VBConnection() {
+	loginTimer.setSingleShot( true );
+	QObject::connect( &loginTimer, &QTimer::timeout, this, &VBConnection::onLoginTimeout );
+}
+
+VBConnection::~VBConnection() {
+	// The poller's callbacks post to this object
+	core.stopPolling();
+
+	// Handles release their references first, this only covers a handle that was never cleaned up
+	if ( loginRefs > 0 ) {
+		loginRefs = 1;
+		logout();
+	}
+
+	core.unload();
+}
+
+int VBConnection::connectCount() {
+	return connectRefs;
+}
+
+int VBConnection::loginCount() {
+	return loginRefs;
+}
+
+int VBConnection::connect() {
+	if ( isConnected() ) {
+		return 0;
+	}
+
+	qInfo() << "Connecting to Voicemeeter...";
+	if ( !startupTimer.isValid() ) {
+		startupTimer.start();
+	}
+
+	return loadDLL();
+}
+
+void VBConnection::disconnect() {
+	if ( loginRefs > 0 ) {
+		return;
+	}
+
+	qInfo() << "Disconnecting...";
+	core.unload();
+	startupTimer.invalidate();
+}
+
+bool VBConnection::isConnected() {
+	return core.isLoaded();
+}
+
+bool VBConnection::login() {
+	if ( loginRefs++ > 0 ) {
+		return true;
+	}
+
+	timings = VBInterface::Startup_Timings();
+	startupTimer.start();
+
+	if ( !isConnected() && connect() < 0 ) {
+		qCritical() << "Cannot login, failed to connect to Voicemeeter";
+		loginRefs = 0;
+		return false;
+	}
+
+	// Last session's values are served while the server starts and until they are read again
+	if ( !core.stateFile().empty() ) {
+		qint64 loadStart = startupTimer.nsecsElapsed();
+		loadState();
+		timings.loadState = usecsSince( startupTimer, loadStart );
+	}
+
+	qint64 start = startupTimer.nsecsElapsed();
+	long status = core.login();
+	timings.login = usecsSince( startupTimer, start );
+	reported = core.state();
+
+	if ( status == 1 ) {
+		qInfo() << "Voicemeeter not running... waiting...";
+		//startVoiceMeeter(); // For some reason this doesn't work
+	}
+
+	if ( !core.isLoggedIn() ) {
+		return true;
+	}
+
+	// Don't block on a parameter read, the poller asks for the server version until it answers
+	core.probe();
+	syncState();
+	startPolling();
+	if ( core.state() == VBCore::WAITING && loginTimeout > 0 ) {
+		loginTimer.start( loginTimeout );
+	}
+
+	return true;
+}
+
+void VBConnection::logout() {
+	if ( loginRefs == 0 || --loginRefs > 0 ) {
+		return;
+	}
+
+	loginTimer.stop();
+	core.stopPolling();
+
+	if ( isConnected() && core.isLoggedIn() ) {
+		core.logout();
+		qInfo() << "Logged out of Voicemeeter";
+	}
+	reported = VBCore::DISCONNECTED;
+}
+
+bool VBConnection::waitForReady( int msecs ) {
+	if ( msecs < 0 ) {
+		msecs = loginTimeout;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	while ( core.isLoggedIn() && ( core.state() == VBCore::WAITING || core.state() == VBCore::LOST ) ) {
+		if ( msecs > 0 && timer.elapsed() >= msecs ) {
+			return false;
+		}
+
+		// Not left to the poller, which backs off while the server is lost
+		QThread::msleep( PROBE_INTERVAL );
+		core.probe();
+	}
+
+	syncState();
+	return core.state() == VBCore::CONNECTED;
+}
+
+void VBConnection::setPollInterval( int msecs, int idleMsecs ) {
+	pollInterval = msecs > 0 ? msecs : VBCore::POLL_INTERVAL;
+	pollIdleInterval = idleMsecs > pollInterval ? idleMsecs : pollInterval;
+	if ( core.isPolling() ) {
+		startPolling();
+	}
+}
+
+void VBConnection::setBackend( const T_VBVMR_INTERFACE& functions ) {
+	core.setBackend( functions );
+}
+
+bool VBConnection::startRecording( const char* path ) {
+	if ( !VBRecord::start( path ) ) {
+		return false;
+	}
+
+	core.setRecording( true );
+	return true;
+}
+
+void VBConnection::stopRecording() {
+	VBRecord::stop();
+	core.setRecording( false );
+}
+
+VBInterface::Connection_State VBConnection::state() {
+	return (VBInterface::Connection_State) core.state();
+}
+
+const VBInterface::Layout* VBConnection::layout() {
+	return VBInterface::layoutForType( core.layout().type );
+}
+
+void VBConnection::startPolling() {
+	// Called on the poller thread, the work is posted to this one
+	VBCore::Poll_Callbacks callbacks;
+	callbacks.dirty = [this]( unsigned long long ) {
+		QMetaObject::invokeMethod( this, [this]() { emit parametersChanged(); }, Qt::QueuedConnection );
+	};
+	callbacks.state = [this]( VBCore::State ) {
+		QMetaObject::invokeMethod( this, [this]() { syncState(); }, Qt::QueuedConnection );
+	};
+	callbacks.conflicts = [this]( const std::vector<VBCore::Conflict>& conflicts ) {
+		QMetaObject::invokeMethod( this, [this, conflicts]() { onConflicts( conflicts ); }, Qt::QueuedConnection );
+	};
+	callbacks.warm = [this]( const VBCore::Warm_Result& result ) {
+		QMetaObject::invokeMethod( this, [this, result]() { onWarmVerified( result ); }, Qt::QueuedConnection );
+	};
+
+	core.startPolling( pollInterval, pollIdleInterval, callbacks );
+}
+
+void VBConnection::syncState() {
+	VBCore::State current = core.state();
+	if ( current == reported || loginRefs == 0 ) {
+		return;
+	}
+
+	VBCore::State before = reported;
+	reported = current;
+	if ( current == VBCore::CONNECTED ) {
+		loginTimer.stop();
+		onServerReady( before == VBCore::LOST );
+	} else if ( current == VBCore::LOST ) {
+		onServerLost();
+	}
+}
+
+void VBConnection::onServerReady( bool reconnecting ) {
+	// Stopped by the login timeout, waitForReady() got through after all
+	if ( !core.isPolling() ) {
+		startPolling();
+	}
+
+	qInfo() << "Detected Voicemeeter type" << core.layout().type;
+
+	// The core applied the writes queued meanwhile and, after a loss, read its caches again
+	if ( reconnecting ) {
+		qInfo() << "Reconnected to Voicemeeter";
+		emit reconnected();
+		return;
+	}
+
+	VBCore::Connect_Timings connected = core.connectTimings();
+	timings.waitForServer = connected.waitForServerUs;
+	timings.detectLayout = connected.detectLayoutUs;
+	timings.total = startupTimer.nsecsElapsed() / 1000;
+
+	qInfo() << "Logged in after" << timings.total << "us"
+		<< ( timings.cachedPath ? "(cached DLL path)" : "" );
+	emit ready();
+}
+
+void VBConnection::onServerLost() {
+	// The poller probes the server from here on, backing off
+	qWarning() << "Lost connection to Voicemeeter, reconnecting...";
+	emit connectionLost();
+}
+
+void VBConnection::onLoginTimeout() {
+	if ( core.state() != VBCore::WAITING ) {
+		return;
+	}
+
+	// Stop probing, waitForReady() still asks
+	core.stopPolling();
+	qWarning() << "Voicemeeter did not answer within" << loginTimeout << "ms";
+	emit loginTimedOut();
+}
+
+bool VBConnection::checkResult( long code, const char* function ) {
+	switch ( VBInterface::classifyResult( code ) ) {
+		case VBInterface::RESULT_OK:
+			return true;
+		case VBInterface::RESULT_NO_SERVER:
+			syncState();
+			return false;
+		default:
+			qWarning() << function << "failed with" << code;
+			return false;
+	}
+}
+
+bool VBConnection::pollDirty() {
+	long dirty = core.pollDirty();
+
+	// Negative values are errors, not a dirty state
+	if ( dirty < 0 ) {
+		checkResult( dirty, "VBVMR_IsParametersDirty" );
+		return false;
+	}
+
+	return dirty == 1;
+}
+
+float VBConnection::readFloat( std::string_view req ) {
+	float val = 0;
+	long rep = core.getFloat( req, val );
+
+	checkResult( rep, "VBVMR_GetParameterFloat" );
+	return val;
+}
+
+QString VBConnection::readString( const QString& req ) {
+	char response[VBCore::MAX_STRING];
+	long rep = core.getString( toCore( req ), response );
+	checkResult( rep, "VBVMR_GetParameterStringA" );
+	return QString( response );
+}
+
+std::vector<float> VBConnection::readFloats( const QStringList& reqs ) {
+	std::vector<std::string> names;
+	names.reserve( reqs.size() );
+	for ( const QString& req : reqs ) {
+		names.push_back( toCore( req ) );
+	}
+
+	std::vector<std::string_view> views( names.begin(), names.end() );
+	std::vector<float> values( names.size() );
+	long rep = core.getFloats( views.data(), (int) views.size(), values.data() );
+	checkResult( rep, "VBVMR_GetParameterFloat" );
+	return values;
+}
+
+void VBConnection::writeFloat( std::string_view req, float val ) {
+	long rep = core.setFloat( req, val );
+
+	checkResult( rep, "VBVMR_SetParameterFloat" );
+}
+
+void VBConnection::writeString( const QString& req, const QString& val ) {
+	long rep = core.setString( toCore( req ), toCore( val ) );
+	checkResult( rep, "VBVMR_SetParameterStringA" );
+}
+
+void VBConnection::writeRaw( const QString& script ) {
+	long rep = core.setParameters( toCore( script ) );
+	checkResult( rep, "VBVMR_SetParameters" );
+}
+
+void VBConnection::apply( const VBScript& script ) {
+	std::vector<VBCore::Write> writes;
+	writes.reserve( script.size() );
+	for ( const VBScript::Entry& entry : script.entries() ) {
+		VBCore::Write write;
+		write.kind = entry.kind == VBScript::FLOAT ? VBCore::FLOAT : entry.kind == VBScript::STRING ? VBCore::STRING : VBCore::RAW;
+		write.name = toCore( entry.req );
+		write.number = entry.number;
+		write.text = toCore( entry.text );
+		writes.push_back( write );
+	}
+
+	long rep = core.apply( writes );
+	checkResult( rep, "VBVMR_SetParameters" );
+}
+
+std::vector<VBInterface::Device> VBConnection::devices( bool output ) {
+	std::vector<VBCore::Device> listed;
+	long rep = core.getDevices( output, listed );
+	checkResult( rep, output ? "VBVMR_Output_GetDeviceNumber" : "VBVMR_Input_GetDeviceNumber" );
+
+	std::vector<VBInterface::Device> devices;
+	devices.reserve( listed.size() );
+	for ( const VBCore::Device& device : listed ) {
+		VBInterface::Device newDevice;
+		newDevice.name = fromCore( device.name );
+		newDevice.hardwareID = fromCore( device.hardwareID );
+
+		switch ( device.type ) {
+			default:
+				newDevice.type = output ? VBInterface::WDM : VBInterface::UNKNOWN;
+				break;
+			case VBVMR_DEVTYPE_WDM:
+				newDevice.type = VBInterface::WDM;
+				break;
+			case VBVMR_DEVTYPE_KS:
+				newDevice.type = VBInterface::KS;
+				break;
+			case VBVMR_DEVTYPE_MME:
+				newDevice.type = VBInterface::MME;
+				break;
+			case VBVMR_DEVTYPE_ASIO:
+				newDevice.type = output ? VBInterface::ASIO : VBInterface::UNKNOWN;
+				break;
+		}
+
+		devices.push_back( newDevice );
+	}
+
+	return devices;
+}
+
+quint64 VBConnection::deviceListHash( bool output ) {
+	unsigned long long hash = 0;
+	long rep = core.getDeviceListHash( output, hash );
+	checkResult( rep, output ? "VBVMR_Output_GetDeviceNumber" : "VBVMR_Input_GetDeviceNumber" );
+	return hash;
+}
+
+VBInterface::Level_Frame VBConnection::sweepLevels( VBInterface::Level_Tap inputTap ) {
+	VBInterface::Level_Frame frame;
+	frame.inputTap = inputTap == VBInterface::OUTPUT ? VBInterface::PRE_FADER : inputTap;
+
+	VBCore::Level_Sweep sweep;
+	long rep = core.sweepLevels( frame.inputTap, sweep );
+	if ( !checkResult( rep, "VBVMR_GetLevel" ) ) {
+		return frame;
+	}
+
+	frame.numInputs = sweep.numInputs;
+	frame.numOutputs = sweep.numOutputs;
+	std::copy( sweep.input, sweep.input + sweep.numInputs, frame.input );
+	std::copy( sweep.output, sweep.output + sweep.numOutputs, frame.output );
+	return frame;
+}
+
+float VBConnection::readLevel( long tap, int slot ) {
+	float val = 0;
+	long rep = core.getLevel( tap, slot, val );
+	checkResult( rep, "VBVMR_GetLevel" );
+	return val;
+}
+
+void VBConnection::setStateFile( const QString& path ) {
+	core.setStateFile( QFile::encodeName( path ).toStdString() );
+}
+
+bool VBConnection::loadState() {
+	QString path = QFile::decodeName( core.stateFile().c_str() );
+	int loaded = core.loadState();
+	if ( loaded < 0 ) {
+		qWarning() << "Ignoring state file" << path << "with unknown format or damage";
+		return false;
+	}
+
+	if ( loaded > 0 ) {
+		qInfo() << "Loaded" << loaded << "values from" << path;
+	}
+	return loaded > 0;
+}
+
+bool VBConnection::saveState() {
+	if ( core.stateFile().empty() ) {
+		return false;
+	}
+
+	if ( !core.saveState() ) {
+		qWarning() << "Cannot save state to" << QFile::decodeName( core.stateFile().c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+void VBConnection::onConflicts( const std::vector<VBCore::Conflict>& conflicts ) {
+	if ( loginRefs == 0 ) {
+		return;
+	}
+
+	for ( const VBCore::Conflict& conflict : conflicts ) {
+		if ( conflict.kind == VBCore::FLOAT ) {
+			emit floatConflict( fromCore( conflict.name ), conflict.written, conflict.server );
+		} else {
+			emit stringConflict( fromCore( conflict.name ), fromCore( conflict.writtenText ), fromCore( conflict.serverText ) );
+		}
+	}
+}
+
+void VBConnection::onWarmVerified( const VBCore::Warm_Result& result ) {
+	if ( loginRefs == 0 ) {
+		return;
+	}
+
+	if ( result.discarded ) {
+		qInfo() << "State file was saved for another Voicemeeter type than" << core.layout().type << ", discarding it";
+	}
+
+	if ( result.finished ) {
+		qInfo() << "Warm start verified after" << result.elapsedMs << "ms," << result.changed << "values changed";
+		emit stateVerified( result.changed, result.elapsedMs );
+	}
+}
+
+int VBConnection::loadDLL() {
+	qint64 start = startupTimer.nsecsElapsed();
+	QString path = findDLL();
+	timings.findDLL = usecsSince( startupTimer, start );
+
+	if ( path.isEmpty() ) {
+		qCritical() << "Can't find installed Voicemeeter";
+		return -100; // Can't find installed VoiceMeeter
+	}
+
+	VBCore::Load_Timings loaded;
+	int error = core.load( QFile::encodeName( path ).constData(), &loaded );
+
+	if ( !core.isLoaded() && timings.cachedPath ) {
+		// Voicemeeter moved since the path was cached
+		cachedDLLPath.clear();
+		QSettings( "VBInterface", "VBInterface" ).remove( "dllPath" );
+
+		path = findDLL();
+		error = path.isEmpty() ? -100 : core.load( QFile::encodeName( path ).constData(), &loaded );
+	}
+	timings.loadDLL = loaded.loadUs;
+	timings.resolveSymbols = loaded.resolveUs;
+
+	if ( !core.isLoaded() ) {
+		qCritical() << "Cannot load" << path;
+	}
+
+	return error;
+}
+
+QString VBConnection::findDLL() {
+	timings.cachedPath = true;
+	if ( !cachedDLLPath.isEmpty() ) {
+		return cachedDLLPath;
+	}
+
+	QSettings cache( "VBInterface", "VBInterface" );
+	QString path = cache.value( "dllPath" ).toString();
+	if ( !path.isEmpty() && QFile::exists( path ) ) {
+		cachedDLLPath = path;
+		return path;
+	}
+
+	timings.cachedPath = false;
+
+	// Get Voicemeeter DLL location
+	path = QString::fromStdString( VBCore::findDLL() ).replace( '\\', '/' );
+	if ( path.isEmpty() ) {
+		return path;
+	}
+
+	cachedDLLPath = path;
+	cache.setValue( "dllPath", path );
+
+	return path;
+}
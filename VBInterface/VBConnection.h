@@ -0,0 +1,128 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+#include <vector>
+
+#include "VBCore.h"
+#include "VBInterface.h"
+
+/**
+* Connection to Voicemeeter shared by VBInterface handles
+*
+* Qt adapter over VBCore. The core loads the DLL, follows the connection
+* state and keeps the caches, the shadow, the writes waiting for a
+* reconnect and the state file. This converts between QString and the
+* core's std::string_view and runs the core's poller while logged in. What
+* the poller reports from its thread is posted to this one and emitted as
+* signals. The DLL is loaded when the first
+* handle connects and unloaded when the last one disconnects, login and
+* logout are counted the same way, so one handle logging out does not log
+* out the others.
+*
+* VBInterface handles use the process-wide connection unless given their
+* own, e.g. one driven by VBReplay. A connection and its handles must live
+* on the same thread.
+**/
+class VBINTERFACE_EXPORT VBConnection : public QObject {
+	Q_OBJECT
+
+public:
+	/** The process-wide connection, created on first use, gone once no handle uses it */
+	static std::shared_ptr<VBConnection> shared();
+
+	VBConnection();
+	~VBConnection();
+
+	/** Handles that connected, i.e. keep the DLL loaded */
+	int connectCount();
+	/** Handles that logged in */
+	int loginCount();
+
+signals:
+	void ready();
+	void loginTimedOut();
+	void connectionLost();
+	void reconnected();
+	/** A shadowed write lost against a change made elsewhere, the server value is cached now */
+	void floatConflict( QString req, float written, float server );
+	void stringConflict( QString req, QString written, QString server );
+	/** Every value loaded from the state file was read from the server again */
+	void stateVerified( int changed, qint64 msecs );
+	/** The poller saw the server's dirty flag set */
+	void parametersChanged();
+
+private:
+	friend class VBInterface;
+
+	VBCore core;
+
+	int connectRefs = 0;
+	int loginRefs = 0;
+
+	/** Single shot, loginTimedOut() unless the server answered by then */
+	QTimer loginTimer;
+	/** Periodic work of the handles and what is built on them, the connection's own runs on the core's poller */
+	VBScheduler scheduler;
+	QElapsedTimer startupTimer;
+	VBInterface::Startup_Timings timings;
+	int loginTimeout = 10000;
+	int pollInterval = VBCore::POLL_INTERVAL;
+	int pollIdleInterval = VBCore::POLL_IDLE_INTERVAL;
+	/** Core state the signals emitted so far stand for */
+	VBCore::State reported = VBCore::DISCONNECTED;
+
+	/** Load the DLL unless already loaded, counted per handle by VBInterface */
+	int connect();
+	void disconnect();
+	bool isConnected();
+	bool login();
+	void logout();
+	bool waitForReady( int msecs );
+	/** Restarts the poller if it runs */
+	void setPollInterval( int msecs, int idleMsecs );
+	void setBackend( const T_VBVMR_INTERFACE& functions );
+	bool startRecording( const char* path );
+	void stopRecording();
+
+	VBInterface::Connection_State state();
+	const VBInterface::Layout* layout();
+
+	float readFloat( std::string_view req );
+	QString readString( const QString& req );
+	/** One wait for a clean state for all of them */
+	std::vector<float> readFloats( const QStringList& reqs );
+	void writeFloat( std::string_view req, float val );
+	void writeString( const QString& req, const QString& val );
+	void writeRaw( const QString& script );
+	void apply( const VBScript& script );
+
+	std::vector<VBInterface::Device> devices( bool output );
+	quint64 deviceListHash( bool output );
+	VBInterface::Level_Frame sweepLevels( VBInterface::Level_Tap inputTap );
+	float readLevel( long tap, int slot );
+
+	/** Ask the dirty flag, which bumps the core's dirty generation */
+	bool pollDirty();
+
+	void setStateFile( const QString& path );
+	bool loadState();
+	bool saveState();
+
+	int loadDLL();
+	QString findDLL();
+	void startPolling();
+	/** Emit what changed since the last call, whichever thread noticed it */
+	void syncState();
+	void onServerReady( bool reconnecting );
+	void onServerLost();
+	void onLoginTimeout();
+	bool checkResult( long code, const char* function );
+	void onConflicts( const std::vector<VBCore::Conflict>& conflicts );
+	void onWarmVerified( const VBCore::Warm_Result& result );
+};
@@ -0,0 +1,1692 @@
+#include "VBCore.h"
+#include "VBTrace.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# define NOMINMAX
+# include <windows.h>
+# pragma comment( lib, "advapi32" )
+#else
+# include <dlfcn.h>
+#endif
+
+namespace {
+	struct Symbol {
+		const char* name;
+		/** load()'s result if missing, 0 for optional functions */
+		int error;
+	};
+
+	// In T_VBVMR_INTERFACE member order
+	const Symbol symbols[] = {
+		{ "VBVMR_Login", -1 },
+		{ "VBVMR_Logout", -2 },
+		{ "VBVMR_RunVoicemeeter", -2 },
+		{ "VBVMR_GetVoicemeeterType", -3 },
+		{ "VBVMR_GetVoicemeeterVersion", -4 },
+		{ "VBVMR_IsParametersDirty", -5 },
+		{ "VBVMR_GetParameterFloat", -6 },
+		{ "VBVMR_GetParameterStringA", -7 },
+		{ "VBVMR_GetParameterStringW", -8 },
+		{ "VBVMR_GetLevel", -9 },
+		{ "VBVMR_GetMidiMessage", -15 },
+		{ "VBVMR_SetParameterFloat", -10 },
+		{ "VBVMR_SetParameters", -11 },
+		{ "VBVMR_SetParametersW", -12 },
+		{ "VBVMR_SetParameterStringA", -13 },
+		{ "VBVMR_SetParameterStringW", -14 },
+		{ "VBVMR_Output_GetDeviceNumber", -30 },
+		{ "VBVMR_Output_GetDeviceDescA", -31 },
+		{ "VBVMR_Output_GetDeviceDescW", -32 },
+		{ "VBVMR_Input_GetDeviceNumber", -33 },
+		{ "VBVMR_Input_GetDeviceDescA", -34 },
+		{ "VBVMR_Input_GetDeviceDescW", -35 },
+		// Newer than some installed DLLs, optional
+		{ "VBVMR_AudioCallbackRegister", 0 },
+		{ "VBVMR_AudioCallbackStart", 0 },
+		{ "VBVMR_AudioCallbackStop", 0 },
+		{ "VBVMR_AudioCallbackUnregister", 0 }
+	};
+
+	typedef void ( *Entry )();
+
+	const int NUM_SYMBOLS = sizeof( symbols ) / sizeof( symbols[0] );
+	static_assert( sizeof( T_VBVMR_INTERFACE ) == NUM_SYMBOLS * sizeof( Entry ), "Symbol table out of sync with T_VBVMR_INTERFACE" );
+
+	/** VBInterface::OUTPUT, the tap of bus levels */
+	const int OUTPUT_TAP = 3;
+	/** Sweeps younger than this are handed to every caller asking, one sweep serves a whole scheduler wakeup */
+	const long long LEVEL_REUSE_NS = 2000000;
+
+	/** A write is read back once a dirty transition followed it and this long passed */
+	const long long SHADOW_SETTLE_NS = 50000000;
+	/** Read back without a dirty transition, e.g. a write that changed nothing */
+	const long long SHADOW_MAX_AGE_NS = 1000000000;
+	/** Float writes matching the server within this are confirmed */
+	const float SHADOW_TOLERANCE = 0.01f;
+
+	/** Warm values read back per verifyWarm() */
+	const int WARM_BATCH = 64;
+
+	// State file, little-endian:
+	//   "VBWS" u32 version, u8 Voicemeeter type,
+	//   u32 count, per float: u16 name length, UTF-8 name, f32 value,
+	//   u32 count, per string: u16 name length, name, u16 value length, value,
+	//   outputs then inputs: u32 count, per device: u8 VBVMR_DEVTYPE_*, u16 length, name, u16 length, hardware ID.
+	const char STATE_MAGIC[4] = { 'V', 'B', 'W', 'S' };
+	/** Version 1 held VBInterface::Device_Type instead of the DLL's device types */
+	const unsigned STATE_VERSION = 2;
+	const size_t MAX_TEXT = 0xffff;
+
+	const char* VB_ID = "VB:Voicemeeter {17359A74-1236-5467}";
+
+	long long nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	/** NUL-terminated copy for the DLL, on the stack unless longer than N - 1 */
+	template<int N>
+	class Terminated {
+	public:
+		explicit Terminated( std::string_view text ) {
+			if ( text.size() < N ) {
+				memcpy( local, text.data(), text.size() );
+				local[text.size()] = 0;
+				data = local;
+			} else {
+				heap.assign( text.data(), text.size() );
+				data = &heap[0];
+			}
+		}
+
+		Terminated( const Terminated& ) = delete;
+		Terminated& operator=( const Terminated& ) = delete;
+
+		char* get() {
+			return data;
+		}
+
+	private:
+		char local[N];
+		std::string heap;
+		char* data;
+	};
+
+	void appendU16( std::string& out, unsigned value ) {
+		out += (char) ( value & 0xff );
+		out += (char) ( ( value >> 8 ) & 0xff );
+	}
+
+	void appendU32( std::string& out, unsigned value ) {
+		for ( int i = 0; i < 4; i++ ) {
+			out += (char) ( ( value >> ( i * 8 ) ) & 0xff );
+		}
+	}
+
+	void appendText( std::string& out, const std::string& text ) {
+		size_t size = text.size() < MAX_TEXT ? text.size() : MAX_TEXT;
+		appendU16( out, (unsigned) size );
+		out.append( text.data(), size );
+	}
+
+	/** Bounds-checked reads from the state file, fails once and stays failed */
+	struct State_Reader {
+		const unsigned char* data;
+		size_t size;
+		size_t pos = 0;
+		bool ok = true;
+
+		bool has( size_t bytes ) {
+			ok = ok && pos + bytes <= size;
+			return ok;
+		}
+
+		unsigned u8() {
+			return has( 1 ) ? data[pos++] : 0;
+		}
+
+		unsigned u16() {
+			if ( !has( 2 ) ) {
+				return 0;
+			}
+			unsigned value = data[pos] | ( data[pos + 1] << 8 );
+			pos += 2;
+			return value;
+		}
+
+		unsigned u32() {
+			if ( !has( 4 ) ) {
+				return 0;
+			}
+			unsigned value = 0;
+			for ( int i = 0; i < 4; i++ ) {
+				value |= (unsigned) data[pos + i] << ( i * 8 );
+			}
+			pos += 4;
+			return value;
+		}
+
+		float f32() {
+			unsigned bits = u32();
+			float value;
+			memcpy( &value, &bits, sizeof( value ) );
+			return value;
+		}
+
+		std::string text() {
+			unsigned length = u16();
+			if ( !has( length ) ) {
+				return std::string();
+			}
+			std::string value( reinterpret_cast<const char*>( data + pos ), length );
+			pos += length;
+			return value;
+		}
+
+		/** Count of entries at least minBytes each, 0 and failed if more than the file could hold */
+		unsigned count( size_t minBytes ) {
+			unsigned value = u32();
+			ok = ok && value <= ( size - pos ) / minBytes;
+			return ok ? value : 0;
+		}
+	};
+
+	bool readFile( const std::string& path, std::string& contents ) {
+		FILE* file = fopen( path.c_str(), "rb" );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		char chunk[1 << 16];
+		size_t read;
+		while ( ( read = fread( chunk, 1, sizeof( chunk ), file ) ) > 0 ) {
+			contents.append( chunk, read );
+		}
+		fclose( file );
+		return true;
+	}
+
+	/** Written aside and renamed over the old file, a crash never leaves half a file */
+	bool replaceFile( const std::string& path, const std::string& contents ) {
+		std::string aside = path + ".tmp";
+		FILE* file = fopen( aside.c_str(), "wb" );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		bool written = fwrite( contents.data(), 1, contents.size(), file ) == contents.size();
+		written = fclose( file ) == 0 && written;
+#ifdef _WIN32
+		written = written && MoveFileExA( aside.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+		written = written && rename( aside.c_str(), path.c_str() ) == 0;
+#endif
+		if ( !written ) {
+			remove( aside.c_str() );
+		}
+		return written;
+	}
+
+	bool sameDevices( const std::vector<VBCore::Device>& a, const std::vector<VBCore::Device>& b ) {
+		if ( a.size() != b.size() ) {
+			return false;
+		}
+
+		for ( size_t i = 0; i < a.size(); i++ ) {
+			if ( a[i].type != b[i].type || a[i].name != b[i].name || a[i].hardwareID != b[i].hardwareID ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** deviceCache and warmDevices index */
+	int direction( bool output ) {
+		return output ? 0 : 1;
+	}
+}
+
+VBCore::VBCore() : generation( 0 ) {
+}
+
+VBCore::~VBCore() {
+	stopPolling();
+	logout();
+	unload();
+}
+
+std::string VBCore::findDLL() {
+#ifdef _WIN32
+	const char* roots[] = {
+		"Software\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\",
+		"Software\\WOW6432Node\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\"
+	};
+
+	for ( const char* root : roots ) {
+		std::string key = std::string( root ) + VB_ID;
+		char value[MAX_PATH];
+		DWORD size = sizeof( value );
+		if ( RegGetValueA( HKEY_LOCAL_MACHINE, key.c_str(), "UninstallString", RRF_RT_REG_SZ, nullptr, value, &size ) != ERROR_SUCCESS ) {
+			continue;
+		}
+
+		std::string path( value );
+		size_t slash = path.find_last_of( '\\' );
+		if ( slash == std::string::npos ) {
+			continue;
+		}
+
+		path.resize( slash );
+		path += "\\VoicemeeterRemote64.dll";
+		return path;
+	}
+#endif
+	( void ) VB_ID;
+	return std::string();
+}
+
+int VBCore::load( const char* path, Load_Timings* timings ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( library ) {
+		return 0;
+	}
+
+	std::string found;
+	if ( !path ) {
+		found = findDLL();
+		if ( found.empty() ) {
+			return -100; // Can't find installed VoiceMeeter
+		}
+		path = found.c_str();
+	}
+
+	long long start = nowNs();
+#ifdef _WIN32
+	library = LoadLibraryA( path );
+#else
+	library = dlopen( path, RTLD_NOW | RTLD_LOCAL );
+#endif
+	if ( timings ) {
+		timings->loadUs = ( nowNs() - start ) / 1000;
+	}
+
+	if ( !library ) {
+		return -1;
+	}
+
+	start = nowNs();
+	Entry* entries = reinterpret_cast<Entry*>( &backend );
+	int error = 0;
+	for ( int i = 0; i < NUM_SYMBOLS; i++ ) {
+#ifdef _WIN32
+		entries[i] = reinterpret_cast<Entry>( GetProcAddress( static_cast<HMODULE>( library ), symbols[i].name ) );
+#else
+		entries[i] = reinterpret_cast<Entry>( dlsym( library, symbols[i].name ) );
+#endif
+
+		// check pointers are valid
+		if ( entries[i] == nullptr && error == 0 ) {
+			error = symbols[i].error;
+		}
+	}
+	if ( timings ) {
+		timings->resolveUs = ( nowNs() - start ) / 1000;
+	}
+
+	customBackend = false;
+	updateCalls();
+	return error;
+}
+
+void VBCore::unload() {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( !library ) {
+		return;
+	}
+
+#ifdef _WIN32
+	FreeLibrary( static_cast<HMODULE>( library ) );
+#else
+	dlclose( library );
+#endif
+	library = nullptr;
+
+	if ( !customBackend ) {
+		backend = T_VBVMR_INTERFACE();
+		updateCalls();
+	}
+}
+
+bool VBCore::isLoaded() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return customBackend || library;
+}
+
+void VBCore::setBackend( const T_VBVMR_INTERFACE& functions ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	backend = functions;
+	customBackend = true;
+	updateCalls();
+}
+
+void VBCore::setRecording( bool enabled ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	recording = enabled;
+	updateCalls();
+}
+
+bool VBCore::isRecording() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return recording;
+}
+
+void VBCore::updateCalls() {
+	calls = recording ? VBRecord::wrap( backend ) : backend;
+}
+
+long VBCore::login() {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( loggedIn ) {
+		return 0;
+	}
+
+	long status = VB_CALL( LOGIN, calls.VBVMR_Login() );
+	if ( status < 0 ) {
+		return status;
+	}
+
+	loggedIn = true;
+	currentState = WAITING;
+	loginNs = nowNs();
+	timings = Connect_Timings();
+	return status;
+}
+
+void VBCore::logout() {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( !loggedIn ) {
+		return;
+	}
+
+	// Warm values not read back yet are saved as they are, they are still the best guess
+	if ( !statePath.empty() ) {
+		saveStateLocked();
+	}
+
+	VB_CALL( LOGOUT, calls.VBVMR_Logout() );
+	loggedIn = false;
+	currentState = DISCONNECTED;
+	floatCache.clear();
+	stringCache.clear();
+	deviceCache[0].clear();
+	deviceCache[1].clear();
+	pending.clear();
+	floatShadow.clear();
+	stringShadow.clear();
+	forgetWarm();
+	stateLoaded = false;
+	invalidateLevels();
+}
+
+bool VBCore::isLoggedIn() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return loggedIn;
+}
+
+bool VBCore::probe() {
+	std::lock_guard<std::mutex> lock( mutex );
+	return probeLocked();
+}
+
+bool VBCore::probeLocked() {
+	long version = 0;
+	if ( VB_CALL( GET_VOICEMEETER_VERSION, calls.VBVMR_GetVoicemeeterVersion( &version ) ) != 0 ) {
+		if ( currentState == CONNECTED ) {
+			currentState = LOST;
+			invalidateLevels();
+		}
+		return false;
+	}
+
+	if ( !loggedIn || currentState == CONNECTED ) {
+		return true;
+	}
+
+	bool reconnecting = currentState == LOST;
+	currentState = CONNECTED;
+
+	long long start = nowNs();
+	detectLayout();
+	if ( !reconnecting ) {
+		timings.waitForServerUs = ( start - loginNs ) / 1000;
+		timings.detectLayoutUs = ( nowNs() - start ) / 1000;
+	}
+
+	// Writes made while the server was away, the caches already claim them
+	if ( !pending.empty() ) {
+		std::vector<Write> writes;
+		writes.swap( pending );
+		writeLocked( writes );
+		restartShadow();
+	}
+
+	if ( reconnecting ) {
+		resync();
+	}
+	return true;
+}
+
+VBCore::State VBCore::state() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return currentState;
+}
+
+VBCore::Layout VBCore::layout() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return currentLayout;
+}
+
+VBCore::Connect_Timings VBCore::connectTimings() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return timings;
+}
+
+long long VBCore::waitingUs() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return loggedIn && currentState == WAITING ? ( nowNs() - loginNs ) / 1000 : -1;
+}
+
+long VBCore::runVoicemeeter( long type ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	return VB_CALL( RUN_VOICEMEETER, calls.VBVMR_RunVoicemeeter( type ) );
+}
+
+void VBCore::detectLayout() {
+	long type = 0;
+	if ( VB_CALL( GET_VOICEMEETER_TYPE, calls.VBVMR_GetVoicemeeterType( &type ) ) == 0 ) {
+		currentLayout = VBLayout::countsOf( type );
+	}
+	invalidateLevels();
+}
+
+void VBCore::resync() {
+	if ( waitForCleanLocked( CLEAN_TIMEOUT ) < 0 ) {
+		return;
+	}
+
+	restartShadow();
+
+	// Warm values are left to verifyWarm(), which reports what changed
+	for ( auto it = floatCache.begin(); it != floatCache.end() && currentState == CONNECTED; ++it ) {
+		if ( floatShadow.find( it->first ) != floatShadow.end() || warmFloats.find( it->first ) != warmFloats.end() ) {
+			continue;
+		}
+
+		Terminated<MAX_NAME> cName( it->first );
+		float value;
+		if ( checked( VB_CALL( GET_PARAMETER_FLOAT, calls.VBVMR_GetParameterFloat( cName.get(), &value ) ) ) == 0 ) {
+			it->second = value;
+		}
+	}
+
+	char response[MAX_STRING];
+	for ( auto it = stringCache.begin(); it != stringCache.end() && currentState == CONNECTED; ++it ) {
+		if ( stringShadow.find( it->first ) != stringShadow.end() || warmStrings.find( it->first ) != warmStrings.end() ) {
+			continue;
+		}
+
+		Terminated<MAX_NAME> cName( it->first );
+		if ( checked( VB_CALL( GET_PARAMETER_STRING_A, calls.VBVMR_GetParameterStringA( cName.get(), response ) ) ) == 0 ) {
+			it->second = response;
+		}
+	}
+
+	for ( bool output : { true, false } ) {
+		if ( currentState == CONNECTED && !deviceCache[direction( output )].empty() && !warmDevices[direction( output )] ) {
+			std::vector<Device> devices;
+			enumerateDevices( output, devices );
+		}
+	}
+}
+
+long VBCore::checked( long result ) {
+	if ( result == NO_SERVER && currentState == CONNECTED ) {
+		currentState = LOST;
+		invalidateLevels();
+	}
+	return result;
+}
+
+long VBCore::getFloat( std::string_view name, float& value ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( caching ) {
+		// Read your own writes without waiting for the server to acknowledge them, and last session's values until they are read again
+		if ( floatShadow.find( name ) != floatShadow.end() || warmFloats.find( name ) != warmFloats.end() ) {
+			value = cachedFloatLocked( name );
+			return 0;
+		}
+
+		// Fail fast while the server is away
+		long clean = currentState == CONNECTED ? waitForCleanLocked( CLEAN_TIMEOUT ) : NO_SERVER;
+		if ( clean < 0 ) {
+			value = cachedFloatLocked( name );
+			return clean;
+		}
+	}
+
+	return readFloat( name, value );
+}
+
+long VBCore::getString( std::string_view name, char* out ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( caching ) {
+		bool cached = stringShadow.find( name ) != stringShadow.end() || warmStrings.find( name ) != warmStrings.end();
+		long clean = cached ? 0 : currentState == CONNECTED ? waitForCleanLocked( CLEAN_TIMEOUT ) : NO_SERVER;
+		if ( cached || clean < 0 ) {
+			auto it = stringCache.find( name );
+			strncpy( out, it != stringCache.end() ? it->second.c_str() : "", MAX_STRING - 1 );
+			out[MAX_STRING - 1] = 0;
+			return clean;
+		}
+	}
+
+	return readString( name, out );
+}
+
+long VBCore::getFloats( const std::string_view* names, int count, float* values ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	// One wait covers the whole batch, the parameters are then read straight from the DLL
+	long result = !caching ? 0 : currentState == CONNECTED ? waitForCleanLocked( CLEAN_TIMEOUT ) : NO_SERVER;
+	bool live = result >= 0;
+	result = live ? 0 : result;
+
+	for ( int i = 0; i < count; i++ ) {
+		bool cached = caching && ( floatShadow.find( names[i] ) != floatShadow.end() || warmFloats.find( names[i] ) != warmFloats.end() );
+		if ( !live || cached ) {
+			values[i] = cachedFloatLocked( names[i] );
+			continue;
+		}
+
+		long rep = readFloat( names[i], values[i] );
+		if ( rep != 0 ) {
+			result = rep;
+			live = !caching || currentState == CONNECTED;
+		}
+	}
+
+	return result;
+}
+
+long VBCore::readFloat( std::string_view name, float& value ) {
+	Terminated<MAX_NAME> cName( name );
+
+	float response = 0;
+	long result = checked( VB_CALL( GET_PARAMETER_FLOAT, calls.VBVMR_GetParameterFloat( cName.get(), &response ) ) );
+	if ( result != 0 ) {
+		value = cachedFloatLocked( name );
+		return result;
+	}
+
+	value = response;
+	if ( caching ) {
+		cacheFloat( name, response );
+	}
+	return result;
+}
+
+long VBCore::readString( std::string_view name, char* out ) {
+	Terminated<MAX_NAME> cName( name );
+
+	long result = checked( VB_CALL( GET_PARAMETER_STRING_A, calls.VBVMR_GetParameterStringA( cName.get(), out ) ) );
+	if ( result != 0 ) {
+		auto it = stringCache.find( name );
+		strncpy( out, it != stringCache.end() ? it->second.c_str() : "", MAX_STRING - 1 );
+		out[MAX_STRING - 1] = 0;
+		return result;
+	}
+
+	if ( caching ) {
+		cacheString( name, out );
+	}
+	return result;
+}
+
+long VBCore::setFloat( std::string_view name, float value ) {
+	Terminated<MAX_NAME> cName( name );
+	std::lock_guard<std::mutex> lock( mutex );
+	wakePoller();
+
+	if ( caching ) {
+		cacheFloat( name, value );
+		auto warm = warmFloats.find( name );
+		if ( warm != warmFloats.end() ) {
+			warmFloats.erase( warm );
+		}
+		shadow( floatShadow, name );
+
+		if ( currentState != CONNECTED ) {
+			queue( FLOAT, name, value, std::string_view() );
+			return NO_SERVER;
+		}
+	}
+
+	long result = checked( VB_CALL( SET_PARAMETER_FLOAT, calls.VBVMR_SetParameterFloat( cName.get(), value ) ) );
+	if ( caching && result != 0 && currentState == LOST ) {
+		queue( FLOAT, name, value, std::string_view() );
+	}
+	return result;
+}
+
+long VBCore::setString( std::string_view name, std::string_view value ) {
+	Terminated<MAX_NAME> cName( name );
+	Terminated<MAX_STRING> cValue( value );
+	std::lock_guard<std::mutex> lock( mutex );
+	wakePoller();
+
+	if ( caching ) {
+		cacheString( name, value );
+		auto warm = warmStrings.find( name );
+		if ( warm != warmStrings.end() ) {
+			warmStrings.erase( warm );
+		}
+		shadow( stringShadow, name );
+
+		if ( currentState != CONNECTED ) {
+			queue( STRING, name, 0, value );
+			return NO_SERVER;
+		}
+	}
+
+	long result = checked( VB_CALL( SET_PARAMETER_STRING_A, calls.VBVMR_SetParameterStringA( cName.get(), cValue.get() ) ) );
+	if ( caching && result != 0 && currentState == LOST ) {
+		queue( STRING, name, 0, value );
+	}
+	return result;
+}
+
+long VBCore::setParameters( std::string_view script ) {
+	Terminated<MAX_SCRIPT> cScript( script );
+	std::lock_guard<std::mutex> lock( mutex );
+	wakePoller();
+
+	if ( caching ) {
+		floatShadow.clear();
+		stringShadow.clear();
+
+		if ( currentState != CONNECTED ) {
+			queue( RAW, std::string_view(), 0, script );
+			return NO_SERVER;
+		}
+	}
+
+	long result = checked( VB_CALL( SET_PARAMETERS, calls.VBVMR_SetParameters( cScript.get() ) ) );
+	if ( caching && result != 0 && currentState == LOST ) {
+		queue( RAW, std::string_view(), 0, script );
+	}
+	return result;
+}
+
+long VBCore::apply( const std::vector<Write>& writes ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	wakePoller();
+
+	if ( caching ) {
+		for ( const Write& write : writes ) {
+			if ( write.kind == FLOAT ) {
+				cacheFloat( write.name, write.number );
+				warmFloats.erase( write.name );
+				shadow( floatShadow, write.name );
+			} else if ( write.kind == STRING ) {
+				cacheString( write.name, write.text );
+				warmStrings.erase( write.name );
+				shadow( stringShadow, write.name );
+			} else {
+				floatShadow.clear();
+				stringShadow.clear();
+			}
+		}
+	}
+
+	long result = caching && currentState != CONNECTED ? NO_SERVER : writeLocked( writes );
+	if ( caching && result != 0 && currentState != CONNECTED ) {
+		for ( const Write& write : writes ) {
+			queue( write.kind, write.name, write.number, write.text );
+		}
+	}
+	return result;
+}
+
+long VBCore::writeLocked( const std::vector<Write>& writes ) {
+	std::string script;
+	char number[32];
+	for ( const Write& write : writes ) {
+		switch ( write.kind ) {
+			case FLOAT:
+				snprintf( number, sizeof( number ), "%g", write.number );
+				script.append( write.name ).append( " = " ).append( number );
+				break;
+			case STRING:
+				if ( !canQuote( write.text ) ) {
+					continue;
+				}
+				script.append( write.name ).append( " = \"" ).append( write.text ).append( "\"" );
+				break;
+			case RAW:
+				script.append( write.text );
+				break;
+		}
+		script += '\n';
+	}
+
+	if ( !script.empty() ) {
+		Terminated<MAX_SCRIPT> cScript( script );
+		long result = checked( VB_CALL( SET_PARAMETERS, calls.VBVMR_SetParameters( cScript.get() ) ) );
+		if ( result != 0 ) {
+			return result;
+		}
+	}
+
+	// Strings the script could not quote
+	for ( const Write& write : writes ) {
+		if ( write.kind == STRING && !canQuote( write.text ) ) {
+			Terminated<MAX_NAME> cName( write.name );
+			Terminated<MAX_STRING> cValue( write.text );
+			long result = checked( VB_CALL( SET_PARAMETER_STRING_A, calls.VBVMR_SetParameterStringA( cName.get(), cValue.get() ) ) );
+			if ( result != 0 ) {
+				return result;
+			}
+		}
+	}
+
+	return 0;
+}
+
+void VBCore::queue( Write_Kind kind, std::string_view name, float number, std::string_view text ) {
+	// Raw lines may touch anything, only merge writes made after the last one
+	Write* write = nullptr;
+	if ( kind != RAW ) {
+		for ( auto it = pending.rbegin(); it != pending.rend() && it->kind != RAW; ++it ) {
+			if ( it->name == name ) {
+				write = &*it;
+				break;
+			}
+		}
+	}
+
+	if ( write == nullptr ) {
+		pending.push_back( Write() );
+		write = &pending.back();
+		write->name.assign( name.data(), name.size() );
+	}
+
+	write->kind = kind;
+	write->number = number;
+	write->text.assign( text.data(), text.size() );
+}
+
+void VBCore::setCaching( bool enabled ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	caching = enabled;
+	if ( !caching ) {
+		floatCache.clear();
+		stringCache.clear();
+		deviceCache[0].clear();
+		deviceCache[1].clear();
+		pending.clear();
+		floatShadow.clear();
+		stringShadow.clear();
+		forgetWarm();
+	}
+}
+
+bool VBCore::cachedFloat( std::string_view name, float& value ) const {
+	std::lock_guard<std::mutex> lock( mutex );
+	auto it = floatCache.find( name );
+	if ( it == floatCache.end() ) {
+		return false;
+	}
+
+	value = it->second;
+	return true;
+}
+
+bool VBCore::cachedString( std::string_view name, std::string& value ) const {
+	std::lock_guard<std::mutex> lock( mutex );
+	auto it = stringCache.find( name );
+	if ( it == stringCache.end() ) {
+		return false;
+	}
+
+	value = it->second;
+	return true;
+}
+
+int VBCore::pendingWrites() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return (int) pending.size();
+}
+
+float VBCore::cachedFloatLocked( std::string_view name ) const {
+	auto it = floatCache.find( name );
+	return it != floatCache.end() ? it->second : 0;
+}
+
+void VBCore::cacheFloat( std::string_view name, float value ) {
+	auto it = floatCache.find( name );
+	if ( it != floatCache.end() ) {
+		it->second = value;
+	} else {
+		floatCache.emplace( std::string( name ), value );
+	}
+}
+
+void VBCore::cacheString( std::string_view name, std::string_view value ) {
+	auto it = stringCache.find( name );
+	if ( it != stringCache.end() ) {
+		it->second.assign( value.data(), value.size() );
+	} else {
+		stringCache.emplace( std::string( name ), std::string( value ) );
+	}
+}
+
+bool VBCore::canQuote( std::string_view text ) {
+	return text.find_first_of( "\"\r\n" ) == std::string_view::npos;
+}
+
+bool VBCore::hasShadow() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return !floatShadow.empty() || !stringShadow.empty();
+}
+
+bool VBCore::reconcileShadow( std::vector<Conflict>& conflicts ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	return reconcileShadowLocked( conflicts );
+}
+
+bool VBCore::reconcileShadowLocked( std::vector<Conflict>& conflicts ) {
+	// Queued writes go out on reconnect, the shadow holds until then
+	if ( ( floatShadow.empty() && stringShadow.empty() ) || currentState != CONNECTED ) {
+		return false;
+	}
+
+	long long now = nowNs();
+	unsigned long long current = generation;
+	auto settled = [now, current]( const Shadow& shadow ) {
+		long long age = now - shadow.writtenNs;
+		return ( shadow.generation != current && age >= SHADOW_SETTLE_NS ) || age >= SHADOW_MAX_AGE_NS;
+	};
+
+	std::vector<std::string> floats, strings;
+	for ( const auto& entry : floatShadow ) {
+		if ( settled( entry.second ) ) {
+			floats.push_back( entry.first );
+		}
+	}
+	for ( const auto& entry : stringShadow ) {
+		if ( settled( entry.second ) ) {
+			strings.push_back( entry.first );
+		}
+	}
+
+	if ( ( floats.empty() && strings.empty() ) || waitForCleanLocked( CLEAN_TIMEOUT ) < 0 ) {
+		return false;
+	}
+
+	size_t before = conflicts.size();
+	for ( const std::string& name : floats ) {
+		Terminated<MAX_NAME> cName( name );
+		float server = 0;
+		long result = checked( VB_CALL( GET_PARAMETER_FLOAT, calls.VBVMR_GetParameterFloat( cName.get(), &server ) ) );
+
+		// Lost the server, the cache keeps the written value
+		if ( result != 0 && currentState != CONNECTED ) {
+			return true;
+		}
+
+		// A bad name is dropped as well
+		floatShadow.erase( name );
+		float written = cachedFloatLocked( name );
+		if ( result == 0 && fabsf( server - written ) > SHADOW_TOLERANCE ) {
+			cacheFloat( name, server );
+			Conflict conflict;
+			conflict.kind = FLOAT;
+			conflict.name = name;
+			conflict.written = written;
+			conflict.server = server;
+			conflicts.push_back( conflict );
+		}
+	}
+
+	char response[MAX_STRING];
+	for ( const std::string& name : strings ) {
+		Terminated<MAX_NAME> cName( name );
+		long result = checked( VB_CALL( GET_PARAMETER_STRING_A, calls.VBVMR_GetParameterStringA( cName.get(), response ) ) );
+		if ( result != 0 && currentState != CONNECTED ) {
+			return true;
+		}
+
+		stringShadow.erase( name );
+		auto written = stringCache.find( name );
+		if ( result == 0 && written != stringCache.end() && written->second != response ) {
+			Conflict conflict;
+			conflict.kind = STRING;
+			conflict.name = name;
+			conflict.writtenText = written->second;
+			conflict.serverText = response;
+			written->second = response;
+			conflicts.push_back( conflict );
+		}
+	}
+
+	// Callers that read the shadow while the other change came in get to read again
+	if ( conflicts.size() > before ) {
+		generation++;
+	}
+
+	return true;
+}
+
+void VBCore::clearShadow() {
+	std::lock_guard<std::mutex> lock( mutex );
+	floatShadow.clear();
+	stringShadow.clear();
+}
+
+void VBCore::shadow( Shadow_Map& shadows, std::string_view name ) {
+	auto it = shadows.find( name );
+	if ( it == shadows.end() ) {
+		it = shadows.emplace( std::string( name ), Shadow() ).first;
+	}
+
+	it->second.generation = generation;
+	it->second.writtenNs = nowNs();
+}
+
+void VBCore::restartShadow() {
+	// Shadowed values just went out, they are read back once the server took them
+	long long now = nowNs();
+	for ( auto& entry : floatShadow ) {
+		entry.second = { generation, now };
+	}
+	for ( auto& entry : stringShadow ) {
+		entry.second = { generation, now };
+	}
+}
+
+void VBCore::setStateFile( const std::string& path ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	statePath = path;
+	stateLoaded = false;
+	forgetWarm();
+}
+
+std::string VBCore::stateFile() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return statePath;
+}
+
+int VBCore::loadState() {
+	std::lock_guard<std::mutex> lock( mutex );
+	return loadStateLocked();
+}
+
+int VBCore::loadStateLocked() {
+	if ( statePath.empty() || stateLoaded ) {
+		return 0;
+	}
+	stateLoaded = true;
+
+	std::string contents;
+	if ( !readFile( statePath, contents ) ) {
+		return 0;
+	}
+
+	State_Reader reader{ reinterpret_cast<const unsigned char*>( contents.data() ), contents.size() };
+	bool magic = reader.has( 4 ) && memcmp( contents.data(), STATE_MAGIC, 4 ) == 0;
+	reader.pos = 4;
+	unsigned version = reader.u32();
+	if ( !magic || version != STATE_VERSION ) {
+		return -1;
+	}
+
+	long type = (long) reader.u8();
+
+	// Parse everything before touching the caches, a damaged file changes nothing
+	std::vector<std::pair<std::string, float>> floats;
+	unsigned count = reader.count( 6 );
+	for ( unsigned i = 0; i < count && reader.ok; i++ ) {
+		std::string name = reader.text();
+		floats.emplace_back( name, reader.f32() );
+	}
+
+	std::vector<std::pair<std::string, std::string>> strings;
+	count = reader.count( 4 );
+	for ( unsigned i = 0; i < count && reader.ok; i++ ) {
+		std::string name = reader.text();
+		strings.emplace_back( name, reader.text() );
+	}
+
+	std::vector<Device> devices[2];
+	for ( std::vector<Device>& list : devices ) {
+		count = reader.count( 5 );
+		for ( unsigned i = 0; i < count && reader.ok; i++ ) {
+			Device device;
+			device.type = (long) reader.u8();
+			device.name = reader.text();
+			device.hardwareID = reader.text();
+			list.push_back( device );
+		}
+	}
+
+	if ( !reader.ok ) {
+		return -1;
+	}
+
+	// Values this core already knows are newer than the file
+	int loaded = 0;
+	for ( const auto& entry : floats ) {
+		if ( floatCache.emplace( entry.first, entry.second ).second ) {
+			warmFloats.insert( entry.first );
+			loaded++;
+		}
+	}
+	for ( const auto& entry : strings ) {
+		if ( stringCache.emplace( entry.first, entry.second ).second ) {
+			warmStrings.insert( entry.first );
+			loaded++;
+		}
+	}
+	for ( int i = 0; i < 2; i++ ) {
+		if ( deviceCache[i].empty() && !devices[i].empty() ) {
+			deviceCache[i] = devices[i];
+			warmDevices[i] = true;
+		}
+	}
+
+	warmType = type;
+	warmChanged = 0;
+	warmStartNs = nowNs();
+	generation++;
+	return loaded;
+}
+
+bool VBCore::saveState() {
+	std::lock_guard<std::mutex> lock( mutex );
+	return saveStateLocked();
+}
+
+bool VBCore::saveStateLocked() {
+	if ( statePath.empty() ) {
+		return false;
+	}
+
+	std::string out;
+	out.append( STATE_MAGIC, 4 );
+	appendU32( out, STATE_VERSION );
+	out += (char) currentLayout.type;
+
+	appendU32( out, (unsigned) floatCache.size() );
+	for ( const auto& entry : floatCache ) {
+		appendText( out, entry.first );
+		unsigned bits;
+		memcpy( &bits, &entry.second, sizeof( bits ) );
+		appendU32( out, bits );
+	}
+
+	appendU32( out, (unsigned) stringCache.size() );
+	for ( const auto& entry : stringCache ) {
+		appendText( out, entry.first );
+		appendText( out, entry.second );
+	}
+
+	for ( const std::vector<Device>& list : deviceCache ) {
+		appendU32( out, (unsigned) list.size() );
+		for ( const Device& device : list ) {
+			out += (char) device.type;
+			appendText( out, device.name );
+			appendText( out, device.hardwareID );
+		}
+	}
+
+	return replaceFile( statePath, out );
+}
+
+bool VBCore::hasWarm() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return warmLeft();
+}
+
+bool VBCore::warmLeft() const {
+	return !warmFloats.empty() || !warmStrings.empty() || warmDevices[0] || warmDevices[1];
+}
+
+bool VBCore::verifyWarm( Warm_Result& result ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	return verifyWarmLocked( result );
+}
+
+bool VBCore::verifyWarmLocked( Warm_Result& result ) {
+	result = Warm_Result();
+	if ( !warmLeft() || currentState != CONNECTED ) {
+		return false;
+	}
+
+	// Parameter names differ between types, a state saved with another one is thrown away
+	if ( warmType != currentLayout.type ) {
+		for ( const std::string& name : warmFloats ) {
+			floatCache.erase( name );
+		}
+		for ( const std::string& name : warmStrings ) {
+			stringCache.erase( name );
+		}
+		for ( int i = 0; i < 2; i++ ) {
+			if ( warmDevices[i] ) {
+				deviceCache[i].clear();
+			}
+		}
+		forgetWarm();
+		generation++;
+		result.discarded = true;
+		return true;
+	}
+
+	if ( waitForCleanLocked( CLEAN_TIMEOUT ) < 0 ) {
+		return false;
+	}
+
+	std::vector<std::string> floats, strings;
+	for ( auto it = warmFloats.begin(); it != warmFloats.end() && floats.size() < WARM_BATCH; ++it ) {
+		floats.push_back( *it );
+	}
+	for ( auto it = warmStrings.begin(); it != warmStrings.end() && floats.size() + strings.size() < WARM_BATCH; ++it ) {
+		strings.push_back( *it );
+	}
+
+	int changed = 0;
+	bool lost = false;
+	for ( const std::string& name : floats ) {
+		Terminated<MAX_NAME> cName( name );
+		float server = 0;
+		if ( checked( VB_CALL( GET_PARAMETER_FLOAT, calls.VBVMR_GetParameterFloat( cName.get(), &server ) ) ) == 0 ) {
+			changed += server != cachedFloatLocked( name ) ? 1 : 0;
+			cacheFloat( name, server );
+		} else if ( currentState != CONNECTED ) {
+			lost = true;
+			break;
+		} else {
+			// Not a parameter of this server, e.g. saved by another version
+			floatCache.erase( name );
+		}
+		warmFloats.erase( name );
+	}
+
+	char response[MAX_STRING];
+	for ( size_t i = 0; i < strings.size() && !lost; i++ ) {
+		Terminated<MAX_NAME> cName( strings[i] );
+		if ( checked( VB_CALL( GET_PARAMETER_STRING_A, calls.VBVMR_GetParameterStringA( cName.get(), response ) ) ) == 0 ) {
+			auto cached = stringCache.find( strings[i] );
+			changed += cached == stringCache.end() || cached->second != response ? 1 : 0;
+			cacheString( strings[i], response );
+		} else if ( currentState != CONNECTED ) {
+			lost = true;
+			break;
+		} else {
+			stringCache.erase( strings[i] );
+		}
+		warmStrings.erase( strings[i] );
+	}
+
+	// Devices last, an enumeration costs more than a batch of parameters
+	if ( !lost && warmFloats.empty() && warmStrings.empty() ) {
+		for ( bool output : { true, false } ) {
+			if ( !warmDevices[direction( output )] ) {
+				continue;
+			}
+
+			std::vector<Device> saved = deviceCache[direction( output )];
+			std::vector<Device> server;
+			long rep = enumerateDevices( output, server );
+			if ( currentState != CONNECTED ) {
+				lost = true;
+				break;
+			}
+			changed += rep == 0 && !sameDevices( saved, server ) ? 1 : 0;
+			warmDevices[direction( output )] = false;
+		}
+	}
+
+	// Callers that read a warm value get to read the server's
+	if ( changed > 0 ) {
+		warmChanged += changed;
+		generation++;
+	}
+
+	result.changed = warmChanged;
+	result.elapsedMs = ( nowNs() - warmStartNs ) / 1000000;
+	result.finished = !lost && !warmLeft();
+	return true;
+}
+
+void VBCore::clearWarm() {
+	std::lock_guard<std::mutex> lock( mutex );
+	forgetWarm();
+}
+
+void VBCore::forgetWarm() {
+	warmFloats.clear();
+	warmStrings.clear();
+	warmDevices[0] = false;
+	warmDevices[1] = false;
+}
+
+long VBCore::pollDirty() {
+	std::lock_guard<std::mutex> lock( mutex );
+	return pollDirtyLocked();
+}
+
+long VBCore::pollDirtyLocked() {
+	long dirty = checked( VB_CALL( IS_PARAMETERS_DIRTY, calls.VBVMR_IsParametersDirty() ) );
+	if ( dirty == 1 ) {
+		generation++;
+	}
+	return dirty;
+}
+
+unsigned long long VBCore::dirtyGeneration() const {
+	return generation;
+}
+
+long VBCore::waitForClean( int timeoutMs ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	return waitForCleanLocked( timeoutMs );
+}
+
+long VBCore::waitForCleanLocked( int timeoutMs ) {
+	long long start = nowNs();
+	long long timeoutNs = timeoutMs * 1000000LL;
+
+	long dirty;
+	bool changed = false;
+	for ( ;; ) {
+		dirty = VB_CALL( IS_PARAMETERS_DIRTY, calls.VBVMR_IsParametersDirty() );
+		changed = changed || dirty > 0;
+
+		// Server keeps changing past the timeout, read whatever it has now
+		if ( dirty <= 0 || nowNs() - start >= timeoutNs ) {
+			break;
+		}
+
+		std::this_thread::sleep_for( std::chrono::microseconds( 10 ) );
+	}
+
+	VBMetrics::record( VBMetrics::WAIT_FOR_CLEAN, nowNs() - start, dirty < 0 ? dirty : 0 );
+
+	// The DLL cleared the flag for everyone, whoever polls next still has to hear about it
+	if ( changed ) {
+		generation++;
+	}
+
+	return checked( dirty );
+}
+
+long VBCore::registerAudioCallback( long modes, T_VBVMR_VBAUDIOCALLBACK callback, void* user, char* clientName ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( !calls.VBVMR_AudioCallbackRegister ) {
+		return NO_AUDIO_CALLBACK;
+	}
+	return VB_CALL( AUDIO_CALLBACK_REGISTER, calls.VBVMR_AudioCallbackRegister( modes, callback, user, clientName ) );
+}
+
+long VBCore::startAudioCallback() {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( !calls.VBVMR_AudioCallbackStart ) {
+		return NO_AUDIO_CALLBACK;
+	}
+	return VB_CALL( AUDIO_CALLBACK_START, calls.VBVMR_AudioCallbackStart() );
+}
+
+long VBCore::stopAudioCallback() {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( !calls.VBVMR_AudioCallbackStop ) {
+		return NO_AUDIO_CALLBACK;
+	}
+	return VB_CALL( AUDIO_CALLBACK_STOP, calls.VBVMR_AudioCallbackStop() );
+}
+
+long VBCore::unregisterAudioCallback() {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( !calls.VBVMR_AudioCallbackUnregister ) {
+		return NO_AUDIO_CALLBACK;
+	}
+	return VB_CALL( AUDIO_CALLBACK_UNREGISTER, calls.VBVMR_AudioCallbackUnregister() );
+}
+
+bool VBCore::hasAudioCallback() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return calls.VBVMR_AudioCallbackRegister && calls.VBVMR_AudioCallbackStart && calls.VBVMR_AudioCallbackStop && calls.VBVMR_AudioCallbackUnregister;
+}
+
+long VBCore::sweepLevels( int inputTap, Level_Sweep& sweep ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	int tap = inputTap >= 0 && inputTap < OUTPUT_TAP ? inputTap : 0;
+	if ( currentState != CONNECTED ) {
+		sweep = Level_Sweep();
+		sweep.inputTap = tap;
+		return NO_SERVER;
+	}
+
+	long long now = nowNs();
+	if ( sweptNs[tap] >= 0 && now - sweptNs[tap] < LEVEL_REUSE_NS ) {
+		sweep = sweeps[tap];
+		return 0;
+	}
+
+	long result = sweepLocked( tap, currentLayout.numInputLevels, currentLayout.numOutputLevels, sweep );
+	if ( result == 0 ) {
+		sweeps[tap] = sweep;
+		sweptNs[tap] = now;
+	}
+	return result;
+}
+
+long VBCore::getLevel( int tap, int slot, float& value ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	value = 0;
+	if ( currentState != CONNECTED ) {
+		return NO_SERVER;
+	}
+
+	float level = 0;
+	long result = checked( VB_CALL( GET_LEVEL, calls.VBVMR_GetLevel( tap, slot, &level ) ) );
+	if ( result == 0 ) {
+		value = floor( level * 1000 + 0.5f ) / 1000;
+	}
+	return result;
+}
+
+void VBCore::invalidateLevels() {
+	for ( long long& sweptAt : sweptNs ) {
+		sweptAt = -1;
+	}
+}
+
+long VBCore::getDevices( bool output, std::vector<Device>& devices ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if ( caching && ( currentState != CONNECTED || warmDevices[direction( output )] ) ) {
+		devices = deviceCache[direction( output )];
+		return currentState == CONNECTED ? 0 : NO_SERVER;
+	}
+
+	return enumerateDevices( output, devices );
+}
+
+long VBCore::enumerateDevices( bool output, std::vector<Device>& devices ) {
+	long num = output ? VB_CALL( OUTPUT_GET_DEVICE_NUMBER, calls.VBVMR_Output_GetDeviceNumber() ) : VB_CALL( INPUT_GET_DEVICE_NUMBER, calls.VBVMR_Input_GetDeviceNumber() );
+	if ( num < 0 ) {
+		devices = deviceCache[direction( output )];
+		return checked( num );
+	}
+
+	long type;
+	char name[256];
+	char hardwareID[256];
+	devices.clear();
+	for ( long i = 0; i < num; i++ ) {
+		long rep = output
+			? VB_CALL( OUTPUT_GET_DEVICE_DESC_A, calls.VBVMR_Output_GetDeviceDescA( i, &type, name, hardwareID ) )
+			: VB_CALL( INPUT_GET_DEVICE_DESC_A, calls.VBVMR_Input_GetDeviceDescA( i, &type, name, hardwareID ) );
+		if ( rep != 0 ) {
+			continue;
+		}
+
+		Device device;
+		device.type = type;
+		device.name = name;
+		device.hardwareID = hardwareID;
+		devices.push_back( device );
+	}
+
+	if ( caching ) {
+		deviceCache[direction( output )] = devices;
+	}
+	return 0;
+}
+
+long VBCore::getDeviceListHash( bool output, unsigned long long& hash ) {
+	std::lock_guard<std::mutex> lock( mutex );
+
+	hash = 0;
+	if ( currentState != CONNECTED ) {
+		return NO_SERVER;
+	}
+
+	long num = output ? VB_CALL( OUTPUT_GET_DEVICE_NUMBER, calls.VBVMR_Output_GetDeviceNumber() ) : VB_CALL( INPUT_GET_DEVICE_NUMBER, calls.VBVMR_Input_GetDeviceNumber() );
+	if ( num < 0 ) {
+		return checked( num );
+	}
+
+	// FNV-1a over the raw buffers, nothing is converted or allocated
+	unsigned long long fnv = 14695981039346656037ULL;
+	auto mix = [&fnv]( const char* data, size_t size ) {
+		for ( size_t i = 0; i < size; i++ ) {
+			fnv = ( fnv ^ (unsigned char) data[i] ) * 1099511628211ULL;
+		}
+	};
+
+	long type;
+	char name[256];
+	char hardwareID[256];
+	mix( reinterpret_cast<const char*>( &num ), sizeof( num ) );
+	for ( long i = 0; i < num; i++ ) {
+		long rep = output
+			? VB_CALL( OUTPUT_GET_DEVICE_DESC_A, calls.VBVMR_Output_GetDeviceDescA( i, &type, name, hardwareID ) )
+			: VB_CALL( INPUT_GET_DEVICE_DESC_A, calls.VBVMR_Input_GetDeviceDescA( i, &type, name, hardwareID ) );
+		if ( rep != 0 ) {
+			continue;
+		}
+
+		mix( reinterpret_cast<const char*>( &type ), sizeof( type ) );
+		mix( name, strnlen( name, sizeof( name ) ) );
+		mix( "", 1 );
+		mix( hardwareID, strnlen( hardwareID, sizeof( hardwareID ) ) );
+		mix( "", 1 );
+	}
+
+	// Never 0, that means not connected
+	hash = fnv != 0 ? fnv : 1;
+	return 0;
+}
+
+long VBCore::sweepLocked( int inputTap, int numInputs, int numOutputs, Level_Sweep& sweep ) {
+	sweep.inputTap = inputTap >= 0 && inputTap < OUTPUT_TAP ? inputTap : 0;
+	sweep.numInputs = numInputs < 0 ? 0 : numInputs > VBLayout::MAX_INPUT_SLOTS ? VBLayout::MAX_INPUT_SLOTS : numInputs;
+	sweep.numOutputs = numOutputs < 0 ? 0 : numOutputs > VBLayout::MAX_OUTPUT_SLOTS ? VBLayout::MAX_OUTPUT_SLOTS : numOutputs;
+	sweep.timestampNs = nowNs();
+
+	for ( int i = 0; i < sweep.numInputs; i++ ) {
+		long rep = VB_CALL( GET_LEVEL, calls.VBVMR_GetLevel( sweep.inputTap, i, &sweep.input[i] ) );
+		if ( rep == NO_SERVER ) {
+			return checked( rep );
+		}
+		sweep.input[i] = floor( sweep.input[i] * 1000 + 0.5f ) / 1000;
+	}
+
+	for ( int i = 0; i < sweep.numOutputs; i++ ) {
+		long rep = VB_CALL( GET_LEVEL, calls.VBVMR_GetLevel( OUTPUT_TAP, i, &sweep.output[i] ) );
+		if ( rep == NO_SERVER ) {
+			return checked( rep );
+		}
+		sweep.output[i] = floor( sweep.output[i] * 1000 + 0.5f ) / 1000;
+	}
+
+	return 0;
+}
+
+void VBCore::startPolling( int minMs, int maxMs, Poll_Callbacks callbacks ) {
+	stopPolling();
+
+	std::lock_guard<std::mutex> lock( mutex );
+	polling = true;
+	pollerWoken = false;
+	pollMinMs = minMs > 0 ? minMs : 1;
+	pollIntervalMs = pollMinMs;
+	poller = std::thread( &VBCore::pollLoop, this, maxMs > pollMinMs ? maxMs : pollMinMs, std::move( callbacks ) );
+}
+
+void VBCore::stopPolling() {
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		polling = false;
+	}
+	pollerWake.notify_all();
+
+	if ( poller.joinable() ) {
+		poller.join();
+	}
+}
+
+bool VBCore::isPolling() const {
+	std::lock_guard<std::mutex> lock( mutex );
+	return polling;
+}
+
+void VBCore::wakePoller() {
+	// Like VBScheduler::wake(), only a stretched interval is pulled in
+	if ( polling && pollIntervalMs > pollMinMs ) {
+		pollerWoken = true;
+		pollerWake.notify_all();
+	}
+}
+
+void VBCore::pollLoop( int maxMs, Poll_Callbacks callbacks ) {
+	typedef std::chrono::steady_clock Clock;
+
+	Level_Sweep sweep;
+	std::vector<Conflict> conflicts;
+	std::vector<State> changes;
+	Clock::time_point due = Clock::now();
+
+	std::unique_lock<std::mutex> lock( mutex );
+	State seen = currentState;
+	long long reconnectDelayMs = RECONNECT_MIN_DELAY;
+	long long nextProbeNs = 0;
+
+	// Any call may lose the server, a loss starts the backoff wherever it was noticed
+	auto notice = [&]() {
+		if ( currentState == seen ) {
+			return;
+		}
+		if ( currentState == LOST ) {
+			reconnectDelayMs = RECONNECT_MIN_DELAY;
+			nextProbeNs = nowNs() + reconnectDelayMs * 1000000;
+		}
+		seen = currentState;
+		changes.push_back( seen );
+	};
+
+	while ( polling ) {
+		Clock::time_point start = Clock::now();
+		long long latenessNs = std::chrono::duration_cast<std::chrono::nanoseconds>( start - due ).count();
+		int intervalMs = pollIntervalMs;
+
+		notice();
+		if ( loggedIn && currentState == WAITING ) {
+			probeLocked();
+		} else if ( loggedIn && currentState == LOST && nowNs() >= nextProbeNs && !probeLocked() ) {
+			reconnectDelayMs = reconnectDelayMs * 2 < RECONNECT_MAX_DELAY ? reconnectDelayMs * 2 : RECONNECT_MAX_DELAY;
+			nextProbeNs = nowNs() + reconnectDelayMs * 1000000;
+		}
+		notice();
+
+		// The dirty flag doubles as the watchdog, it fails once the server is gone
+		long dirty = 0;
+		long swept = -1;
+		bool shadowRead = false;
+		bool warmRead = false;
+		Warm_Result warm;
+		if ( currentState == CONNECTED ) {
+			dirty = pollDirtyLocked();
+		}
+		if ( currentState == CONNECTED && ( !floatShadow.empty() || !stringShadow.empty() ) ) {
+			shadowRead = reconcileShadowLocked( conflicts );
+		}
+		if ( currentState == CONNECTED && warmLeft() ) {
+			warmRead = verifyWarmLocked( warm );
+		}
+		if ( callbacks.levels && currentState == CONNECTED ) {
+			swept = sweepLocked( callbacks.levelTap, currentLayout.numInputLevels, currentLayout.numOutputLevels, sweep );
+		}
+		notice();
+		unsigned long long current = generation;
+		bool active = dirty == 1 || shadowRead || warmRead || swept == 0 || !changes.empty();
+
+		// Callbacks may call back into the core
+		lock.unlock();
+		if ( callbacks.state ) {
+			for ( State state : changes ) {
+				callbacks.state( state );
+			}
+		}
+		if ( dirty == 1 && callbacks.dirty ) {
+			callbacks.dirty( current );
+		}
+		if ( !conflicts.empty() && callbacks.conflicts ) {
+			callbacks.conflicts( conflicts );
+		}
+		if ( warmRead && ( warm.discarded || warm.finished ) && callbacks.warm ) {
+			callbacks.warm( warm );
+		}
+		if ( swept == 0 ) {
+			callbacks.levels( sweep );
+		}
+		if ( callbacks.round ) {
+			callbacks.round( latenessNs, intervalMs );
+		}
+		changes.clear();
+		conflicts.clear();
+		lock.lock();
+
+		// As VBScheduler: back to the minimum on activity, half as long again per idle round
+		if ( active ) {
+			pollIntervalMs = pollMinMs;
+		} else {
+			int stretched = ( pollIntervalMs * 3 + 1 ) / 2;
+			pollIntervalMs = stretched < maxMs ? stretched : maxMs;
+		}
+
+		// From the deadline rather than now keeps the phase, unless the round fell a whole interval behind
+		Clock::duration interval = std::chrono::milliseconds( pollIntervalMs );
+		due = start - due < interval ? due + interval : start + interval;
+
+		while ( polling ) {
+			if ( pollerWoken ) {
+				pollerWoken = false;
+				pollIntervalMs = pollMinMs;
+				Clock::time_point soonest = Clock::now() + std::chrono::milliseconds( pollMinMs );
+				due = due < soonest ? due : soonest;
+			}
+			if ( !pollerWake.wait_until( lock, due, [this]() { return !polling || pollerWoken; } ) ) {
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBLayout.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Brings in VoicemeeterRemote.h with __stdcall defined away off Windows
+#include "VBRecord.h"
+
+/**
+* Voicemeeter client core without Qt
+*
+* Loads the remote DLL, or uses a backend such as VBReplay::backend(),
+* logs in and follows the connection through waiting, connected and lost.
+* Parameters, devices and levels all go through it in plain C++17. Names
+* and values are taken as std::string_view and copied into fixed buffers
+* for the DLL, a call allocates nothing unless it caches a parameter for
+* the first time.
+*
+* The core keeps what a client needs to ride out the server going away:
+* the last value of every parameter and the device lists, served while the
+* server is away, writes made meanwhile, applied as one script once it is
+* back, a shadow of written parameters, served until they are read back,
+* and the state file of a warm start. Reads wait for a clean state first,
+* unless they are served from the cache. Reconnecting applies the queued
+* writes and reads every cached value again.
+*
+* One mutex guards the DLL and all of that, so the poller thread and
+* callers on other threads can share a core. The poller does the periodic
+* work: it reconnects, follows the dirty flag and reads back the shadow and
+* the warm values. VBConnection is the Qt adapter over it and runs the
+* poller; programs without Qt use the core directly.
+*
+* This header does not depend on Qt.
+**/
+class VBINTERFACE_EXPORT VBCore {
+public:
+	typedef VBLayout::Type Type;
+	typedef VBLayout::Counts Layout;
+
+	/** Same values as VBInterface::Connection_State */
+	enum State {
+		DISCONNECTED,
+		WAITING,
+		CONNECTED,
+		LOST
+	};
+
+	enum Write_Kind {
+		FLOAT,
+		STRING,
+		/** Script lines passed through as is */
+		RAW
+	};
+
+	/** Longest parameter name, e.g. "Strip[7].device.asio" */
+	static const int MAX_NAME = 64;
+	/** Size of string values, as VBVMR_GetParameterStringA writes them */
+	static const int MAX_STRING = 512;
+	/** Scripts longer than this are copied to the heap */
+	static const int MAX_SCRIPT = 4096;
+	static const int CLEAN_TIMEOUT = 500;
+	/** Poller intervals of VBConnection, the fastest while something changes and the slowest it backs off to when idle, see VBInterface::setPollInterval() */
+	static const int POLL_INTERVAL = 10;
+	static const int POLL_IDLE_INTERVAL = 500;
+	/** Probes of a lost server back off from the first to the second */
+	static const int RECONNECT_MIN_DELAY = 100;
+	static const int RECONNECT_MAX_DELAY = 5000;
+	/** Result of calls made while the server is away, as the DLL's own */
+	static const long NO_SERVER = -2;
+	/** Audio callback calls' result when the DLL predates them */
+	static const long NO_AUDIO_CALLBACK = -50;
+
+	struct Load_Timings {
+		long long loadUs = -1;
+		long long resolveUs = -1;
+	};
+
+	struct Connect_Timings {
+		/** From login() until the server first answered */
+		long long waitForServerUs = -1;
+		long long detectLayoutUs = -1;
+	};
+
+	/** One sweep of every level slot, linear values rounded to 1/1000 like VBInterface's */
+	struct Level_Sweep {
+		int inputTap = 0;
+		int numInputs = 0;
+		int numOutputs = 0;
+		/** std::chrono::steady_clock nanoseconds */
+		long long timestampNs = 0;
+		float input[VBLayout::MAX_INPUT_SLOTS] = {};
+		float output[VBLayout::MAX_OUTPUT_SLOTS] = {};
+	};
+
+	/** An audio device as the DLL lists it */
+	struct Device {
+		/** VBVMR_DEVTYPE_* */
+		long type = 0;
+		std::string name;
+		std::string hardwareID;
+	};
+
+	/** One write of a batch, see apply() */
+	struct Write {
+		Write_Kind kind = FLOAT;
+		std::string name;
+		float number = 0;
+		/** String value, or the lines of a RAW write */
+		std::string text;
+	};
+
+	/** A shadowed write that lost against a change made elsewhere, the cache holds the server's value now */
+	struct Conflict {
+		Write_Kind kind = FLOAT;
+		std::string name;
+		float written = 0;
+		float server = 0;
+		std::string writtenText;
+		std::string serverText;
+	};
+
+	struct Warm_Result {
+		/** The state was saved with another Voicemeeter type and thrown away */
+		bool discarded = false;
+		/** The last warm value was read back in this call */
+		bool finished = false;
+		/** Values that differed from the state file so far */
+		int changed = 0;
+		long long elapsedMs = 0;
+	};
+
+	/** Called on the poller thread without the core's lock held, any may be left empty */
+	struct Poll_Callbacks {
+		std::function<void( unsigned long long generation )> dirty;
+		/** The state changed, by the poller or by a call that lost the server */
+		std::function<void( State state )> state;
+		/** Shadowed writes that lost, see reconcileShadow() */
+		std::function<void( const std::vector<Conflict>& conflicts )> conflicts;
+		/** The warm state was discarded or its last value read back, see verifyWarm() */
+		std::function<void( const Warm_Result& result )> warm;
+		/** Set to also sweep levels every interval */
+		std::function<void( const Level_Sweep& sweep )> levels;
+		int levelTap = 0;
+		/** After every round, whether or not anything else was called, with how late it started and the interval it was planned at */
+		std::function<void( long long latenessNs, int intervalMs )> round;
+	};
+
+	VBCore();
+	~VBCore();
+	VBCore( const VBCore& ) = delete;
+	VBCore& operator=( const VBCore& ) = delete;
+
+	/** VoicemeeterRemote64.dll next to the installed Voicemeeter, from the registry, empty if none or not on Windows */
+	static std::string findDLL();
+
+	/** Load the DLL at path, or findDLL() if null, returns 0, -100 if not installed, -1 if it does not load or the error of the first missing function */
+	int load( const char* path = nullptr, Load_Timings* timings = nullptr );
+	void unload();
+	/** DLL loaded or a backend set */
+	bool isLoaded() const;
+	/** Use these functions instead of the DLL */
+	void setBackend( const T_VBVMR_INTERFACE& functions );
+	/** Send calls through VBRecord's wrappers */
+	void setRecording( bool recording );
+	bool isRecording() const;
+
+	/** VBVMR_Login's result, 1 if Voicemeeter is not running yet */
+	long login();
+	/** Saves the state file if there is one and forgets everything cached */
+	void logout();
+	bool isLoggedIn() const;
+	/** Ask the server for its version. WAITING or LOST become CONNECTED: the layout is detected, queued writes are applied and, after a loss, the caches are read again */
+	bool probe();
+	State state() const;
+	/** Detected on connecting, BANANA until then */
+	Layout layout() const;
+	/** Of the first connect since login() */
+	Connect_Timings connectTimings() const;
+	/** Microseconds since login() while still WAITING, -1 otherwise */
+	long long waitingUs() const;
+	/** VBVMR_RunVoicemeeter */
+	long runVoicemeeter( long type );
+
+	/** Calls return the DLL's result, 0 when fine, NO_SERVER while the server is away. Failed reads give the cached value, 0 or an empty string if there is none */
+	long getFloat( std::string_view name, float& value );
+	/** out holds at least MAX_STRING bytes */
+	long getString( std::string_view name, char* out );
+	/** Read count floats with a single wait for a clean state */
+	long getFloats( const std::string_view* names, int count, float* values );
+	long setFloat( std::string_view name, float value );
+	long setString( std::string_view name, std::string_view value );
+	/** A raw script may touch any parameter, the shadow is dropped */
+	long setParameters( std::string_view script );
+	/** Writes as one script, plus a call per string a script cannot quote */
+	long apply( const std::vector<Write>& writes );
+
+	/** Cache, shadow and queue as described above, on by default. Off, every call goes straight to the DLL */
+	void setCaching( bool enabled );
+	bool cachedFloat( std::string_view name, float& value ) const;
+	bool cachedString( std::string_view name, std::string& value ) const;
+	/** Writes waiting for the server */
+	int pendingWrites() const;
+
+	/** Scripts have no escapes, a value holding a quote or a line break has to be set on its own */
+	static bool canQuote( std::string_view text );
+
+	/** Written parameters not read back from the server yet */
+	bool hasShadow() const;
+	/** Read back the shadowed writes the server had time to take, returns whether any were read, conflicts get where the server holds something else */
+	bool reconcileShadow( std::vector<Conflict>& conflicts );
+	void clearShadow();
+
+	/** Warm-start file, loaded by loadState() and saved on logout(), empty for none */
+	void setStateFile( const std::string& path );
+	std::string stateFile() const;
+	/** Fill the caches with what they do not hold yet from the state file, once per login or file, returns the values loaded, 0 if there is no file, -1 if it does not parse */
+	int loadState();
+	bool saveState();
+	/** Values from the state file not read from the server yet */
+	bool hasWarm() const;
+	/** Read a batch of warm values from the server, returns whether any were read */
+	bool verifyWarm( Warm_Result& result );
+	void clearWarm();
+
+	/** Ask the dirty flag once, 1 if parameters changed, which bumps dirtyGeneration() */
+	long pollDirty();
+	/** Bumped whenever the server reports a change, a warm value changes or a write conflicts, users compare it to the last one they saw */
+	unsigned long long dirtyGeneration() const;
+	/** Wait until the server has no pending changes or timeoutMs passed, returns the last dirty flag, negative on errors */
+	long waitForClean( int timeoutMs = CLEAN_TIMEOUT );
+
+	/** Sweep the detected layout's level slots, inputTap as VBInterface::Level_Tap, sweeps of the last 2 ms are handed out again so one serves every caller of a wakeup */
+	long sweepLevels( int inputTap, Level_Sweep& sweep );
+	/** One level slot, rounded like a sweep */
+	long getLevel( int tap, int slot, float& value );
+
+	/** The device list, cached while the server is away or the list is still warm */
+	long getDevices( bool output, std::vector<Device>& devices );
+	/** FNV-1a of the raw device list, 0 while the server is away */
+	long getDeviceListHash( bool output, unsigned long long& hash );
+
+	/** Register for VBVMR_AUDIOCALLBACK_* modes, clientName holds 64 bytes and gets the other client's name if the result is 1, see VBAudioStream */
+	long registerAudioCallback( long modes, T_VBVMR_VBAUDIOCALLBACK callback, void* user, char* clientName );
+	long startAudioCallback();
+	/** Waits for the callback to return, so the callback must never call into the core */
+	long stopAudioCallback();
+	long unregisterAudioCallback();
+	bool hasAudioCallback() const;
+
+	/**
+	* Run rounds on a std::thread: probe the server while it is away, backing
+	* off once it was lost, then poll the dirty flag, read back a due shadow
+	* and a batch of warm values, and sweep levels if asked for. Intervals
+	* follow VBScheduler's rules: minMs after a round with activity, half as
+	* long again after each idle one, up to maxMs, and a write pulls a
+	* stretched interval back in. Sweeping levels counts as activity, so
+	* minMs == maxMs or a levels callback poll at a fixed rate.
+	**/
+	void startPolling( int minMs, int maxMs, Poll_Callbacks callbacks );
+	/** Not from a callback, it waits for the poller thread */
+	void stopPolling();
+	bool isPolling() const;
+
+private:
+	/** Dirty generation and time of a write that was not read back from the server yet */
+	struct Shadow {
+		unsigned long long generation = 0;
+		long long writtenNs = 0;
+	};
+
+	// Transparent comparators, lookups by std::string_view do not allocate
+	typedef std::map<std::string, float, std::less<>> Float_Map;
+	typedef std::map<std::string, std::string, std::less<>> String_Map;
+	typedef std::map<std::string, Shadow, std::less<>> Shadow_Map;
+	typedef std::set<std::string, std::less<>> Name_Set;
+
+	mutable std::mutex mutex;
+	void* library = nullptr;
+	T_VBVMR_INTERFACE backend = {};
+	T_VBVMR_INTERFACE calls = {};
+	bool customBackend = false;
+	bool recording = false;
+	bool loggedIn = false;
+	State currentState = DISCONNECTED;
+	Layout currentLayout = VBLayout::countsOf( VBLayout::BANANA );
+	std::atomic<unsigned long long> generation;
+	long long loginNs = 0;
+	Connect_Timings timings;
+
+	bool caching = true;
+	Float_Map floatCache;
+	String_Map stringCache;
+	std::vector<Device> deviceCache[2];
+	/** Writes made while the server was away */
+	std::vector<Write> pending;
+	Shadow_Map floatShadow;
+	Shadow_Map stringShadow;
+
+	std::string statePath;
+	bool stateLoaded = false;
+	Name_Set warmFloats;
+	Name_Set warmStrings;
+	bool warmDevices[2] = {};
+	/** Voicemeeter type the state was saved with */
+	long warmType = 0;
+	int warmChanged = 0;
+	long long warmStartNs = 0;
+
+	/** Latest sweep per input tap */
+	Level_Sweep sweeps[3];
+	long long sweptNs[3] = { -1, -1, -1 };
+
+	std::thread poller;
+	std::condition_variable pollerWake;
+	bool polling = false;
+	/** A write asked for a round at the minimum interval */
+	bool pollerWoken = false;
+	int pollMinMs = 0;
+	/** Interval of the poller's current wait */
+	int pollIntervalMs = 0;
+
+	void updateCalls();
+	long checked( long result );
+	bool probeLocked();
+	void detectLayout();
+	void resync();
+	long pollDirtyLocked();
+	bool reconcileShadowLocked( std::vector<Conflict>& conflicts );
+	bool verifyWarmLocked( Warm_Result& result );
+	long waitForCleanLocked( int timeoutMs );
+	long sweepLocked( int inputTap, int numInputs, int numOutputs, Level_Sweep& sweep );
+	void invalidateLevels();
+
+	long readFloat( std::string_view name, float& value );
+	long readString( std::string_view name, char* out );
+	float cachedFloatLocked( std::string_view name ) const;
+	void cacheFloat( std::string_view name, float value );
+	void cacheString( std::string_view name, std::string_view value );
+	void shadow( Shadow_Map& shadows, std::string_view name );
+	void restartShadow();
+	void queue( Write_Kind kind, std::string_view name, float number, std::string_view text );
+	long writeLocked( const std::vector<Write>& writes );
+	long enumerateDevices( bool output, std::vector<Device>& devices );
+
+	int loadStateLocked();
+	bool saveStateLocked();
+	bool warmLeft() const;
+	void forgetWarm();
+	void wakePoller();
+	void pollLoop( int maxMs, Poll_Callbacks callbacks );
+};
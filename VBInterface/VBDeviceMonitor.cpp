@@ -0,0 +1,150 @@
+#include "VBDeviceMonitor.h"
+
+#include <QDebug>
+#include <algorithm>
+
+VBDeviceMonitor::VBDeviceMonitor( VBInterface* vb, QObject* parent ) : QObject( parent ), vb( vb ) {
+	job = vb->getScheduler().add( "device monitor", 1000, 1000, [this]() {
+		check();
+		return false;
+	} );
+}
+
+VBDeviceMonitor::~VBDeviceMonitor() {
+	vb->getScheduler().remove( job );
+}
+
+void VBDeviceMonitor::start( int msecs ) {
+	vb->getScheduler().setIntervals( job, msecs, msecs );
+	vb->getScheduler().setEnabled( job, true );
+	check();
+}
+
+void VBDeviceMonitor::stop() {
+	vb->getScheduler().setEnabled( job, false );
+}
+
+bool VBDeviceMonitor::isRunning() {
+	return vb->getScheduler().isEnabled( job );
+}
+
+void VBDeviceMonitor::setInterval( int msecs ) {
+	vb->getScheduler().setIntervals( job, msecs, msecs );
+}
+
+void VBDeviceMonitor::setAutoRebind( bool enabled ) {
+	autoRebind = enabled;
+}
+
+bool VBDeviceMonitor::isAutoRebind() {
+	return autoRebind;
+}
+
+void VBDeviceMonitor::check() {
+	if ( !vb->isReady() ) {
+		return;
+	}
+
+	update( true );
+	update( false );
+}
+
+void VBDeviceMonitor::update( bool output ) {
+	Device_List& list = output ? outputs : inputs;
+
+	quint64 hash = vb->getDeviceListHash( output );
+	if ( hash == 0 || hash == list.hash ) {
+		return;
+	}
+
+	std::vector<VBInterface::Device> devices = output ? vb->getOutputDevices() : vb->getInputDevices();
+
+	// The first list is the baseline, nothing was added or removed yet
+	bool baseline = list.hash == 0;
+	if ( !baseline ) {
+		for ( const VBInterface::Device& device : list.devices ) {
+			if ( std::find( devices.begin(), devices.end(), device ) == devices.end() ) {
+				emit deviceRemoved( device, output );
+			}
+		}
+
+		for ( const VBInterface::Device& device : devices ) {
+			if ( std::find( list.devices.begin(), list.devices.end(), device ) == list.devices.end() ) {
+				emit deviceAdded( device, output );
+			}
+		}
+	}
+
+	list.hash = hash;
+	list.devices.swap( devices );
+
+	if ( !baseline ) {
+		checkBindings( output );
+	}
+}
+
+void VBDeviceMonitor::checkBindings( bool output ) {
+	const Device_List& list = output ? outputs : inputs;
+	const VBInterface::Layout& layout = vb->getLayout();
+	int first = output ? VBInterface::BUS1 : VBInterface::STRIP1;
+
+	for ( int i = first; i < first + ( output ? MAX_BUSES : MAX_STRIPS ); i++ ) {
+		VBInterface::Channel channel = (VBInterface::Channel) i;
+		if ( !layout.channels[channel].present || !layout.channels[channel].physical ) {
+			continue;
+		}
+
+		auto lost = lostBindings.find( channel );
+		if ( lost != lostBindings.end() && hasDevice( list, lost->second ) ) {
+			if ( autoRebind ) {
+				qInfo() << "Device" << lost->second << "is back, rebinding" << channel;
+				if ( output ) {
+					vb->setOutputDevice( channel, lost->second );
+				} else {
+					vb->setInputDevice( channel, lost->second );
+				}
+			}
+			lostBindings.erase( lost );
+			continue;
+		}
+
+		QString name = ( output ? vb->getOutputDevice( channel ) : vb->getInputDevice( channel ) ).name;
+		if ( name.isEmpty() || hasDevice( list, name ) ) {
+			continue;
+		}
+
+		// Keep the original binding if the fallback disappears too
+		lostBindings.insert( std::make_pair( channel, name ) );
+		emit activeDeviceLost( channel );
+
+		if ( !autoRebind ) {
+			continue;
+		}
+
+		for ( int p = 0; p < NUM_PREFERRED_TYPES; p++ ) {
+			auto replacement = std::find_if( list.devices.begin(), list.devices.end(), [this, p]( const VBInterface::Device& device ) {
+				return device.type == vb->Preferred_Types[p];
+			} );
+
+			if ( replacement != list.devices.end() ) {
+				bind( channel, output, *replacement );
+				break;
+			}
+		}
+	}
+}
+
+void VBDeviceMonitor::bind( VBInterface::Channel channel, bool output, const VBInterface::Device& device ) {
+	qInfo() << "Rebinding" << channel << "to" << device.name;
+	if ( output ) {
+		vb->setOutputDevice( channel, device );
+	} else {
+		vb->setInputDevice( channel, device );
+	}
+}
+
+bool VBDeviceMonitor::hasDevice( const Device_List& list, const QString& name ) {
+	return std::any_of( list.devices.begin(), list.devices.end(), [&name]( const VBInterface::Device& device ) {
+		return device.name == name;
+	} );
+}
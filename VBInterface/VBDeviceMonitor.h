@@ -0,0 +1,64 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <map>
+#include <vector>
+
+#include "VBInterface.h"
+
+/**
+* Watches for audio devices coming and going
+*
+* Each check hashes the raw device descriptions straight from the DLL, the
+* Device lists are only rebuilt and compared when a hash changes. Hardware
+* strips and A buses whose device disappeared are reported and, with auto
+* rebind on, moved to the best available device by Preferred_Types and moved
+* back once their device returns.
+**/
+class VBINTERFACE_EXPORT VBDeviceMonitor : public QObject {
+	Q_OBJECT
+
+public:
+	/** vb must outlive the monitor, checks run on vb's scheduler */
+	VBDeviceMonitor( VBInterface* vb, QObject* parent = nullptr );
+	~VBDeviceMonitor();
+
+public slots:
+	void start( int msecs = 1000 );
+	void stop();
+	bool isRunning();
+	void setInterval( int msecs );
+	/** Rebind channels that lost their device, off by default */
+	void setAutoRebind( bool enabled );
+	bool isAutoRebind();
+	/** Check right away instead of waiting for the timer */
+	void check();
+
+signals:
+	void deviceAdded( VBInterface::Device device, bool output );
+	void deviceRemoved( VBInterface::Device device, bool output );
+	/** The device a hardware strip or A bus is bound to is gone */
+	void activeDeviceLost( VBInterface::Channel channel );
+
+private:
+	struct Device_List {
+		/** 0 until the first list was read */
+		quint64 hash = 0;
+		std::vector<VBInterface::Device> devices;
+	};
+
+	VBInterface* vb;
+	int job;
+	bool autoRebind = false;
+
+	Device_List inputs;
+	Device_List outputs;
+	/** Device names channels were bound to before theirs disappeared */
+	std::map<VBInterface::Channel, QString> lostBindings;
+
+	void update( bool output );
+	void checkBindings( bool output );
+	void bind( VBInterface::Channel channel, bool output, const VBInterface::Device& device );
+	bool hasDevice( const Device_List& list, const QString& name );
+};
@@ -0,0 +1,285 @@
+#include "VBDucker.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include "VBScript.h"
+
+namespace {
+	/** Gain changes smaller than this are not sent */
+	const float GAIN_STEP = 0.05f;
+	const float SILENCE_DB = -200;
+	/** Longest tick step fed to the envelopes, keeps a stalled scheduler from jumping */
+	const qint64 MAX_STEP_NS = 100000000;
+
+	QString gainRequest( const VBInterface::Layout& layout, VBInterface::Channel channel ) {
+		return QString( layout.channels[channel].prefix ) + ".gain";
+	}
+
+	/** Move value towards goal by at most depthDb per timeMs */
+	float approach( float value, float goal, float depthDb, int timeMs, qint64 stepNs ) {
+		if ( timeMs <= 0 ) {
+			return goal;
+		}
+
+		float step = depthDb * (float) stepNs / ( timeMs * 1000000.f );
+		return value < goal ? std::min( value + step, goal ) : std::max( value - step, goal );
+	}
+}
+
+VBDucker::VBDucker( VBInterface* vb, QObject* parent ) : QObject( parent ), vb( vb ) {
+	clock.start();
+
+	job = vb->getScheduler().add( "ducker", intervalMs, intervalMs, [this]() {
+		tick();
+		return false;
+	} );
+}
+
+VBDucker::~VBDucker() {
+	vb->getScheduler().remove( job );
+}
+
+void VBDucker::start( int msecs ) {
+	lastTickNs = -1;
+	setInterval( msecs );
+	vb->getScheduler().setEnabled( job, true );
+}
+
+void VBDucker::stop() {
+	vb->getScheduler().setEnabled( job, false );
+	restoreTargets();
+}
+
+bool VBDucker::isRunning() {
+	return vb->getScheduler().isEnabled( job );
+}
+
+void VBDucker::setInterval( int msecs ) {
+	intervalMs = msecs;
+	vb->getScheduler().setIntervals( job, msecs, msecs );
+}
+
+void VBDucker::setInputTap( VBInterface::Level_Tap tap ) {
+	inputTap = tap == VBInterface::OUTPUT ? VBInterface::POST_FADER : tap;
+}
+
+int VBDucker::addRule( VBDucker::Rule rule ) {
+	rule.depthDb = std::fabs( rule.depthDb );
+
+	Rule_State state;
+	state.rule = rule;
+	rules[nextId] = state;
+	return nextId++;
+}
+
+void VBDucker::removeRule( int id ) {
+	auto it = rules.find( id );
+	if ( it == rules.end() ) {
+		return;
+	}
+
+	if ( it->second.attenuationDb == 0 ) {
+		rules.erase( it );
+		return;
+	}
+
+	// Keep it until it has released, with nothing triggering it anymore
+	it->second.rule.thresholdDb = INFINITY;
+	it->second.rule.holdMs = 0;
+}
+
+void VBDucker::clearRules() {
+	for ( auto it = rules.begin(); it != rules.end(); ) {
+		int id = ( it++ )->first;
+		removeRule( id );
+	}
+}
+
+bool VBDucker::isDucking( VBInterface::Channel target ) {
+	return targets.count( target ) != 0;
+}
+
+VBDucker::Latency_Stats VBDucker::getLatencyStats() {
+	return latency;
+}
+
+void VBDucker::resetLatencyStats() {
+	latency = Latency_Stats();
+}
+
+void VBDucker::setLatencyBudget( int usecs ) {
+	latencyBudgetUs = usecs;
+}
+
+float VBDucker::peakDb( const VBInterface::Level_Frame& frame, VBInterface::Channel channel ) {
+	const VBInterface::Channel_Info& info = vb->getLayout().channels[channel];
+	if ( !info.present ) {
+		return SILENCE_DB;
+	}
+
+	const float* levels = info.output ? frame.output : frame.input;
+	int available = info.output ? frame.numOutputs : frame.numInputs;
+
+	float peak = 0;
+	for ( int i = info.levelFirst; i < info.levelFirst + info.levelCount && i < available; i++ ) {
+		peak = std::max( peak, levels[i] );
+	}
+
+	return peak > 0 ? 20 * std::log10( peak ) : SILENCE_DB;
+}
+
+void VBDucker::tick() {
+	if ( rules.empty() || !vb->isReady() ) {
+		lastTickNs = -1;
+		return;
+	}
+
+	VBInterface::Level_Frame frame = vb->getLevelFrame( inputTap );
+	qint64 sweptNs = clock.nsecsElapsed();
+	if ( frame.numInputs == 0 && frame.numOutputs == 0 ) {
+		return;
+	}
+
+	qint64 stepNs = lastTickNs < 0 ? intervalMs * 1000000LL : std::min( sweptNs - lastTickNs, MAX_STEP_NS );
+	lastTickNs = sweptNs;
+
+	std::map<VBInterface::Channel, float> wanted;
+
+	for ( auto it = rules.begin(); it != rules.end(); ) {
+		Rule_State& state = it->second;
+		const Rule& rule = state.rule;
+
+		if ( peakDb( frame, rule.trigger ) > rule.thresholdDb ) {
+			if ( !state.triggered && state.detectedNs < 0 ) {
+				state.detectedNs = sweptNs;
+			}
+			state.triggered = true;
+			state.lastAboveNs = sweptNs;
+		} else if ( state.triggered && sweptNs - state.lastAboveNs >= rule.holdMs * 1000000LL ) {
+			state.triggered = false;
+		}
+
+		if ( state.triggered ) {
+			state.attenuationDb = approach( state.attenuationDb, rule.depthDb, rule.depthDb, rule.attackMs, stepNs );
+		} else {
+			state.attenuationDb = approach( state.attenuationDb, 0, rule.depthDb, rule.releaseMs, stepNs );
+		}
+
+		float& attenuation = wanted[rule.target];
+		attenuation = std::max( attenuation, state.attenuationDb );
+
+		// Removed rules linger until released
+		if ( std::isinf( rule.thresholdDb ) && state.attenuationDb == 0 ) {
+			it = rules.erase( it );
+		} else {
+			++it;
+		}
+	}
+
+	const VBInterface::Layout& layout = vb->getLayout();
+	VBScript script;
+	// Targets the script ducks further, their rules' detections are measured once it is applied
+	std::set<VBInterface::Channel> deeper;
+
+	for ( const auto& entry : wanted ) {
+		VBInterface::Channel target = entry.first;
+		float attenuation = entry.second;
+		auto found = targets.find( target );
+
+		if ( found == targets.end() ) {
+			if ( attenuation == 0 || !layout.channels[target].present ) {
+				continue;
+			}
+
+			Target_State state;
+			state.baseDb = vb->getVolume( target );
+			state.writtenDb = state.baseDb;
+			found = targets.emplace( target, state ).first;
+			emit duckingChanged( target, true );
+		}
+
+		Target_State& state = found->second;
+		float gain = state.baseDb - attenuation;
+
+		if ( attenuation == 0 ) {
+			script.setFloat( gainRequest( layout, target ), state.baseDb );
+			targets.erase( found );
+			emit duckingChanged( target, false );
+		} else if ( std::fabs( gain - state.writtenDb ) >= GAIN_STEP ) {
+			if ( gain < state.writtenDb ) {
+				deeper.insert( target );
+			}
+			script.setFloat( gainRequest( layout, target ), gain );
+			state.writtenDb = gain;
+		}
+	}
+
+	if ( !script.isEmpty() ) {
+		vb->apply( script );
+	}
+
+	for ( auto& entry : rules ) {
+		Rule_State& state = entry.second;
+		if ( state.detectedNs < 0 ) {
+			continue;
+		}
+
+		if ( deeper.count( state.rule.target ) != 0 ) {
+			recordLatency( state.detectedNs );
+			state.detectedNs = -1;
+		} else if ( !state.triggered || state.attenuationDb >= state.rule.depthDb ) {
+			// Never changes the gain, e.g. released early or the target is ducked deeper by another rule
+			state.detectedNs = -1;
+		}
+	}
+}
+
+void VBDucker::recordLatency( qint64 detectedNs ) {
+	qint64 usecs = ( clock.nsecsElapsed() - detectedNs ) / 1000;
+	latency.count++;
+	latency.lastUs = usecs;
+	latency.maxUs = std::max( latency.maxUs, usecs );
+	latency.totalUs += usecs;
+
+	if ( latencyBudgetUs > 0 && usecs > latencyBudgetUs ) {
+		latency.overBudget++;
+		emit latencyExceeded( usecs );
+	}
+}
+
+void VBDucker::restoreTargets() {
+	if ( targets.empty() ) {
+		return;
+	}
+
+	if ( vb->isReady() ) {
+		const VBInterface::Layout& layout = vb->getLayout();
+		VBScript script;
+		for ( const auto& entry : targets ) {
+			script.setFloat( gainRequest( layout, entry.first ), entry.second.baseDb );
+		}
+		vb->apply( script );
+	} else {
+		qWarning() << "Ducked targets left attenuated, not connected";
+	}
+
+	for ( const auto& entry : targets ) {
+		emit duckingChanged( entry.first, false );
+	}
+
+	targets.clear();
+	for ( auto it = rules.begin(); it != rules.end(); ) {
+		if ( std::isinf( it->second.rule.thresholdDb ) ) {
+			it = rules.erase( it );
+			continue;
+		}
+
+		it->second.triggered = false;
+		it->second.attenuationDb = 0;
+		it->second.detectedNs = -1;
+		++it;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QElapsedTimer>
+#include <map>
+
+#include "VBInterface.h"
+
+/**
+* Automatic ducking
+*
+* Rules like "when Strip[0] goes above -30 dB, pull Bus[3] down by 12 dB"
+* are evaluated on every tick from a single level sweep. Each rule has its
+* own attack/release envelope, a target ducked by several rules follows the
+* deepest one. All gain changes of a tick go out as one script, so the
+* delay from a sweep detecting a trigger to its gain change is one script
+* call; it is measured on every detection that leads to a gain change,
+* however many ticks a slow attack takes to move the gain a whole step,
+* see Latency_Stats.
+*
+* A target's gain is read when it starts ducking and written back once it
+* is fully released, changes made to it in between are overwritten.
+**/
+class VBINTERFACE_EXPORT VBDucker : public QObject {
+	Q_OBJECT
+
+public:
+	struct Rule {
+		/** Sidechain, its peak across all its level slots is compared to thresholdDb */
+		VBInterface::Channel trigger = VBInterface::STRIP1;
+		float thresholdDb = -30;
+		VBInterface::Channel target = VBInterface::BUS4;
+		/** Attenuation in dB, positive */
+		float depthDb = 12;
+		/** Time to reach depthDb once triggered */
+		int attackMs = 50;
+		/** Time the trigger must stay below the threshold before releasing */
+		int holdMs = 200;
+		/** Time to come back from depthDb */
+		int releaseMs = 500;
+	};
+
+	struct Latency_Stats {
+		/** Detections measured */
+		qint64 count = 0;
+		/** Sweep detecting a trigger to the script with its first gain change returned, microseconds */
+		qint64 lastUs = 0;
+		qint64 maxUs = 0;
+		qint64 totalUs = 0;
+		/** Detections slower than the budget */
+		qint64 overBudget = 0;
+	};
+
+	/** vb must outlive the ducker, ticks run on vb's scheduler */
+	VBDucker( VBInterface* vb, QObject* parent = nullptr );
+	~VBDucker();
+
+public slots:
+	void start( int msecs = 10 );
+	/** Stop and restore every ducked target */
+	void stop();
+	bool isRunning();
+	void setInterval( int msecs );
+	/** Tap trigger strips are read at, POST_FADER by default so the strip's fader counts */
+	void setInputTap( VBInterface::Level_Tap tap );
+
+	/** Returns an id for removeRule() */
+	int addRule( VBDucker::Rule rule );
+	/** Targets the rule was ducking release normally */
+	void removeRule( int id );
+	void clearRules();
+	/** Whether a target is currently attenuated */
+	bool isDucking( VBInterface::Channel target );
+
+	Latency_Stats getLatencyStats();
+	void resetLatencyStats();
+	/** Detections slower than this are counted and signalled, 0 disables */
+	void setLatencyBudget( int usecs );
+
+signals:
+	void duckingChanged( VBInterface::Channel target, bool ducking );
+	void latencyExceeded( qint64 usecs );
+
+private:
+	struct Rule_State {
+		Rule rule;
+		bool triggered = false;
+		/** Last sweep the trigger was above the threshold */
+		qint64 lastAboveNs = 0;
+		/** Current attenuation of this rule's envelope */
+		float attenuationDb = 0;
+		/** Sweep that saw the trigger, until a script carrying a gain change for the target is applied */
+		qint64 detectedNs = -1;
+	};
+
+	struct Target_State {
+		/** Gain read when ducking started */
+		float baseDb = 0;
+		float writtenDb = 0;
+	};
+
+	VBInterface* vb;
+	int job;
+	int intervalMs = 10;
+	QElapsedTimer clock;
+	qint64 lastTickNs = -1;
+	VBInterface::Level_Tap inputTap = VBInterface::POST_FADER;
+
+	int nextId = 1;
+	std::map<int, Rule_State> rules;
+	std::map<VBInterface::Channel, Target_State> targets;
+
+	Latency_Stats latency;
+	qint64 latencyBudgetUs = 0;
+
+	void tick();
+	float peakDb( const VBInterface::Level_Frame& frame, VBInterface::Channel channel );
+	void restoreTargets();
+	void recordLatency( qint64 detectedNs );
+};
@@ -1,55 +1,258 @@
 #include "VBInterface.h"
+#include "VBConnection.h"
+#include "VBTrace.h"
 
-#include <QSettings>
 #include <QDebug>
-#include <QThread>
+#include <QFile>
+#include <algorithm>
+#include <climits>
+
+namespace {
+	const int DEVICE_RESUME_INTERVAL = 10;
+	/** Engine restarts usually take well under a second, give slow drivers plenty */
+	const qint64 DEVICE_RESUME_TIMEOUT = 10000;
+
+	// Built at compile time, channel lookups are plain table reads
+	constexpr VBInterface::Layout layouts[] = {
+		VBChannel::layoutOf( VBInterface::STANDARD ),
+		VBChannel::layoutOf( VBInterface::BANANA ),
+		VBChannel::layoutOf( VBInterface::POTATO )
+	};
+}
+
+float VBInterface::Channel_Level::* const VBInterface::Channel_Level::members[CHANNEL_LEVEL_SIZE] = {
+	&Channel_Level::left,
+	&Channel_Level::right,
+	&Channel_Level::CH3,
+	&Channel_Level::CH4,
+	&Channel_Level::CH5,
+	&Channel_Level::CH6,
+	&Channel_Level::CH7,
+	&Channel_Level::CH8
+};
+
+VBInterface::VBInterface() : VBInterface( VBConnection::shared() ) {
+}
+
+VBInterface::VBInterface( std::shared_ptr<VBConnection> connection ) : connection( connection ) {
+	deferredClock.start();
+	deferredTimer.setSingleShot( true );
+	deferredTimer.setTimerType( Qt::PreciseTimer );
+	QObject::connect( &deferredTimer, &QTimer::timeout, this, &VBInterface::runDeferred );
+
+	// Only handles that logged in hear about the connection
+	QObject::connect( connection.get(), &VBConnection::ready, this, [this]() {
+		if ( loggedIn ) {
+			emit ready();
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::loginTimedOut, this, [this]() {
+		if ( loggedIn ) {
+			emit loginTimedOut();
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::connectionLost, this, [this]() {
+		if ( loggedIn ) {
+			emit connectionLost();
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::reconnected, this, [this]() {
+		if ( loggedIn ) {
+			emit reconnected();
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::floatConflict, this, [this]( QString req, float written, float server ) {
+		if ( loggedIn ) {
+			emit writeConflict( req, written, server );
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::stringConflict, this, [this]( QString req, QString written, QString server ) {
+		if ( loggedIn ) {
+			emit stringWriteConflict( req, written, server );
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::stateVerified, this, [this]( int changed, qint64 msecs ) {
+		if ( loggedIn ) {
+			emit stateVerified( changed, msecs );
+		}
+	} );
+	QObject::connect( connection.get(), &VBConnection::parametersChanged, this, [this]() {
+		if ( loggedIn ) {
+			emit parametersChanged();
+		}
+	} );
+}
+
+VBInterface::~VBInterface() {
+	if ( resumeJob >= 0 ) {
+		connection->scheduler.remove( resumeJob );
+	}
 
-VBInterface::VBInterface() {}
+	disconnect();
+}
+
+VBInterface::Call_Result VBInterface::classifyResult( long code ) {
+	switch ( code ) {
+		case VBVMR_RESULT_OK:
+			return RESULT_OK;
+		case -1:
+			return RESULT_ERROR;
+		case -2:
+			return RESULT_NO_SERVER;
+		default:
+			return RESULT_REQUEST_ERROR;
+	}
+}
 
 int VBInterface::connect() {
-	qInfo() << "Connecting to Voicemeeter...";
-	return loadDLL();
+	VB_TRACE_SCOPE( "connect", "" );
+
+	if ( !connected ) {
+		connected = true;
+		connection->connectRefs++;
+	}
+
+	return connection->connect();
 }
 
 void VBInterface::disconnect() {
-	qInfo() << "Disconnecting...";
+	VB_TRACE_SCOPE( "disconnect", "" );
+
 	if ( loggedIn ) {
 		logout();
 	}
 
-	lib.unload();
+	if ( connected ) {
+		connected = false;
+		if ( --connection->connectRefs == 0 ) {
+			connection->disconnect();
+		}
+	}
 }
 
 bool VBInterface::isConnected() {
-	return lib.isLoaded();
+	return connected && connection->isConnected();
 }
 
 void VBInterface::login() {
-	if ( !isConnected() && connect() < 0 ) {
+	VB_TRACE_SCOPE( "login", "" );
+
+	if ( loggedIn ) {
+		return;
+	}
+
+	if ( connect() < 0 ) {
 		qCritical() << "Cannot login, failed to connect to Voicemeeter";
 		return;
 	}
 
+	bool alreadyReady = connection->state() == CONNECTED;
+	seenDirty = connection->core.dirtyGeneration();
 
-	if ( isConnected() && !loggedIn ) {
-		long status = iVMR.VBVMR_Login();
-		loggedIn = true;
-		if ( status == 1 ) {
-			qInfo() << "Voicemeeter not running... waiting...";
-			//startVoiceMeeter(); // For some reason this doesn't work
-			getVolume( BUS1 ); //  This will block until it can get a value
-			return;
-		}
+	// Set first, the connection may emit ready() before login() returns
+	loggedIn = true;
+	if ( !connection->login() ) {
+		loggedIn = false;
+		return;
+	}
+
+	// The connection was up before this handle joined, it will not emit ready() again
+	if ( alreadyReady ) {
+		emit ready();
+	}
+}
+
+bool VBInterface::waitForReady( int msecs ) {
+	return loggedIn && connection->waitForReady( msecs );
+}
+
+bool VBInterface::isReady() {
+	return loggedIn && connection->state() == CONNECTED;
+}
+
+VBInterface::Connection_State VBInterface::getConnectionState() {
+	return loggedIn ? connection->state() : DISCONNECTED;
+}
+
+void VBInterface::setLoginTimeout( int msecs ) {
+	connection->loginTimeout = msecs;
+}
+
+void VBInterface::setPollInterval( int msecs, int idleMsecs ) {
+	connection->setPollInterval( msecs, idleMsecs );
+}
+
+VBInterface::Startup_Timings VBInterface::getStartupTimings() {
+	return connection->timings;
+}
+
+VBMetrics::Snapshot VBInterface::metricsSnapshot() {
+	return VBMetrics::snapshot();
+}
+
+void VBInterface::resetMetrics() {
+	VBMetrics::reset();
+}
+
+void VBInterface::setTracing( bool enabled ) {
+	VBTrace::setEnabled( enabled );
+}
+
+bool VBInterface::isTracing() {
+	return VBTrace::isEnabled();
+}
+
+QByteArray VBInterface::exportTrace() {
+	return QByteArray::fromStdString( VBTrace::exportJson() );
+}
+
+bool VBInterface::saveTrace( QString path ) {
+	QFile file( path );
+	if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+		qWarning() << "Cannot write trace to" << path << file.errorString();
+		return false;
+	}
+
+	file.write( exportTrace() );
+	return true;
+}
 
-		qInfo() << "Logged in";
+bool VBInterface::startRecording( QString path ) {
+	if ( !connection->startRecording( QFile::encodeName( path ).constData() ) ) {
+		qWarning() << "Cannot record calls to" << path;
+		return false;
 	}
+
+	return true;
+}
+
+void VBInterface::stopRecording() {
+	connection->stopRecording();
+}
+
+bool VBInterface::isRecording() {
+	return connection->core.isRecording();
+}
+
+void VBInterface::setStateFile( QString path ) {
+	connection->setStateFile( path );
+
+	// Already logged in, the file only fills what was not read yet, the poller reads it back
+	if ( !path.isEmpty() && connection->loginRefs > 0 ) {
+		connection->loadState();
+	}
+}
+
+bool VBInterface::saveState() {
+	return connection->saveState();
 }
 
 void VBInterface::logout() {
-	if ( isConnected() && loggedIn ) {
-		iVMR.VBVMR_Logout();
+	VB_TRACE_SCOPE( "logout", "" );
+
+	if ( loggedIn ) {
 		loggedIn = false;
-		qInfo() << "Logged out of Voicemeeter";
+		connection->logout();
 	}
 }
 
@@ -58,87 +261,144 @@ bool VBInterface::isLoggedIn() {
 }
 
 void VBInterface::startVoiceMeeter() {
-	iVMR.VBVMR_RunVoicemeeter( 2 );
+	VB_TRACE_SCOPE( "startVoiceMeeter", "" );
+
+	connection->core.runVoicemeeter( connection->layout()->type );
 }
 
-QString VBInterface::readString( QString req ) {
-	if ( !isLoggedIn() ) {
-		qWarning() << "Attempting to readString when not logged in";
-		return "";
-	}
+VBInterface::Voicemeeter_Type VBInterface::getType() {
+	return connection->layout()->type;
+}
 
-	char* cReq = qStringToChar( req );
-	char* response = new char[512];
+const VBInterface::Layout& VBInterface::getLayout() {
+	return *connection->layout();
+}
 
-	waitForClean();
+const VBInterface::Layout& VBInterface::getLayout( Voicemeeter_Type type ) {
+	return *layoutForType( type );
+}
 
-	iVMR.VBVMR_GetParameterStringA( cReq, response );
+bool VBInterface::hasChannel( Channel channel ) {
+	return channel >= 0 && channel < NUM_CHANNELS && connection->layout()->channels[channel].present;
+}
 
-	QString val = QString( response );
+QString VBInterface::readString( QString req ) {
+	VB_TRACE_SCOPE( "readString", req.toUtf8().constData() );
 
-	delete cReq;
-	delete response;
+	if ( !isLoggedIn() ) {
+		qWarning() << "Attempting to readString when not logged in";
+		return "";
+	}
 
-	return val;
+	// Served from the core's cache while the server is away or the value was just written
+	return connection->readString( req );
 }
 
 float VBInterface::readFloat( QString req ) {
+	QByteArray name = req.toUtf8();
+	return readFloatName( std::string_view( name.constData(), name.size() ) );
+}
+
+float VBInterface::readFloatName( std::string_view name ) {
+	VB_TRACE_SCOPE( "readFloat", std::string( name ) );
+
 	if ( !isLoggedIn() ) {
 		qWarning() << "Attempting to readFloat when not logged in";
 		return 0;
 	}
 
-	char* cReq = qStringToChar( req );
-	float response;
+	// Served from the core's cache while the server is away or the value was just written
+	return connection->readFloat( name );
+}
 
-	waitForClean();
+void VBInterface::setString( QString req, QString val ) {
+	VB_TRACE_SCOPE( "setString", req.toUtf8().constData() );
 
-	iVMR.VBVMR_GetParameterFloat( cReq, &response );
+	if ( !isLoggedIn() ) {
+		qWarning() << "Attempting to setString when not logged in";
+		return;
+	}
 
-	delete cReq;
+	// Queued by the core while the server is away
+	connection->writeString( req, val );
+}
 
-	return response;
+void VBInterface::setFloat( QString req, float val ) {
+	QByteArray name = req.toUtf8();
+	setFloatName( std::string_view( name.constData(), name.size() ), val );
 }
 
-void VBInterface::setString( QString req, QString val ) {
+void VBInterface::setFloatName( std::string_view name, float val ) {
+	VB_TRACE_SCOPE( "setFloat", std::string( name ) );
+
 	if ( !isLoggedIn() ) {
-		qWarning() << "Attempting to setString when not logged in";
+		qWarning() << "Attempting to setFloat when not logged in";
 		return;
 	}
 
-	char* cReq = qStringToChar( req );
-	char* cVal = qStringToChar( val );
+	// Queued by the core while the server is away
+	connection->writeFloat( name, val );
+}
 
-	iVMR.VBVMR_SetParameterStringA( cReq, cVal );
+void VBInterface::setParameters( QString script ) {
+	VB_TRACE_SCOPE( "setParameters", script.toUtf8().constData() );
 
-	delete cReq;
-	delete cVal;
+	if ( !isLoggedIn() ) {
+		qWarning() << "Attempting to setParameters when not logged in";
+		return;
+	}
+
+	// A raw script may touch any parameter, the core drops its shadow and reads go back to the server
+	connection->writeRaw( script );
 }
 
-void VBInterface::setFloat( QString req, float val ) {
+void VBInterface::apply( const VBScript& script ) {
+	VB_TRACE_SCOPE( "apply", "" );
+
 	if ( !isLoggedIn() ) {
-		qWarning() << "Attempting to setFloat when not logged in";
+		qWarning() << "Attempting to apply a script when not logged in";
 		return;
 	}
 
-	char* cReq = qStringToChar( req );
-
-	iVMR.VBVMR_SetParameterFloat( cReq, val );
+	if ( script.isEmpty() ) {
+		return;
+	}
 
-	delete cReq;
+	connection->apply( script );
 }
 
 float VBInterface::getVolume( Channel channel ) {
+	VB_TRACE_SCOPE( "getVolume", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return 0;
+	}
+
 	QString req = channelToString( channel ) + ".gain";
 	return readFloat( req );
 }
 
 void VBInterface::setVolume( Channel channel, float val ) {
+	VB_TRACE_SCOPE( "setVolume", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
 	QString req = channelToString( channel ) + ".gain";
 	setFloat( req, val );
 }
 
 float VBInterface::setVolumeRelative( Channel channel, float amt ) {
+	VB_TRACE_SCOPE( "setVolumeRelative", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return 0;
+	}
+
 	float vol = getVolume( channel );
 	setVolume( channel, vol + amt );
 
@@ -146,16 +406,37 @@ float VBInterface::setVolumeRelative( Channel channel, float amt ) {
 }
 
 bool VBInterface::getMute( Channel channel ) {
+	VB_TRACE_SCOPE( "getMute", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return false;
+	}
+
 	QString req = channelToString( channel ) + ".mute";
 	return (bool) readFloat( req );
 }
 
 void VBInterface::setMute( Channel channel, bool mute ) {
+	VB_TRACE_SCOPE( "setMute", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
 	QString req = channelToString( channel ) + ".mute";
 	setFloat( req, mute );
 }
 
 bool VBInterface::toggleMute( Channel channel ) {
+	VB_TRACE_SCOPE( "toggleMute", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return false;
+	}
+
 	bool mute = getMute( channel );
 
 	QString req = channelToString( channel ) + ".mute";
@@ -163,7 +444,9 @@ bool VBInterface::toggleMute( Channel channel ) {
 	return !mute;
 }
 
-VBInterface::Channel_Level VBInterface::getChannelLevel( Channel channel ) {
+VBInterface::Channel_Level VBInterface::getChannelLevel( Channel channel, Level_Tap tap ) {
+	VB_TRACE_SCOPE( "getChannelLevel", channelToString( channel ).toUtf8().constData() );
+
 	Channel_Level levels;
 
 	if ( !loggedIn ) {
@@ -171,73 +454,299 @@ VBInterface::Channel_Level VBInterface::getChannelLevel( Channel channel ) {
 		return levels;
 	}
 
-	long type = isOutputChannel( channel ) ? 3 : 0;
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return levels;
+	}
+
+	if ( connection->state() != CONNECTED ) {
+		return levels;
+	}
+
+	long type = isOutputChannel( channel ) ? OUTPUT : tap;
 	pair range = channelLevelNums( channel );
 
 	unsigned index = 0;
 	for ( int i = range.first; i < range.last; i++ ) {
-		waitForClean();
-
-		float* val = indexToLevel( &levels, index );
-
-		iVMR.VBVMR_GetLevel( type, i, val );
-		*val = floor( *val * 1000 + 0.5 ) / 1000;
+		*indexToLevel( &levels, index ) = connection->readLevel( type, i );
+		if ( connection->state() != CONNECTED ) {
+			return Channel_Level();
+		}
 		index++;
 	}
 
 	return levels;
 }
 
-std::map<VBInterface::Channel, VBInterface::Channel_Level> VBInterface::getAllChannelLevels() {
+std::map<VBInterface::Channel, VBInterface::Channel_Level> VBInterface::getAllChannelLevels( Level_Tap inputTap ) {
+	VB_TRACE_SCOPE( "getAllChannelLevels", "" );
+
 	std::map<Channel, Channel_Level> levels;
 
-	for ( int i = STRIP1; i <= BUS5; i++ ) {
-		levels[(Channel) i] = getChannelLevel( (Channel) i );
+	if ( !loggedIn ) {
+		qWarning() << "Attempting to getAllChannelLevels when not logged in";
+		return levels;
+	}
+
+	Level_Frame frame = getLevelFrame( inputTap );
+
+	for ( int i = STRIP1; i < NUM_CHANNELS; i++ ) {
+		if ( connection->layout()->channels[i].present ) {
+			levels[(Channel) i] = frameToChannelLevel( frame, (Channel) i );
+		}
+	}
+
+	return levels;
+}
+
+VBInterface::Level_Frame VBInterface::getLevelFrame( Level_Tap inputTap ) {
+	VB_TRACE_SCOPE( "getLevelFrame", "" );
+
+	if ( !loggedIn ) {
+		qWarning() << "Attempting to getLevelFrame when not logged in";
+		Level_Frame frame;
+		frame.inputTap = inputTap == OUTPUT ? PRE_FADER : inputTap;
+		return frame;
+	}
+
+	return connection->sweepLevels( inputTap );
+}
+
+VBInterface::Channel_Level VBInterface::frameToChannelLevel( const Level_Frame& frame, Channel channel ) {
+	return frameToChannelLevel( *connection->layout(), frame, channel );
+}
+
+VBInterface::Channel_Level VBInterface::frameToChannelLevel( const Layout& layout, const Level_Frame& frame, Channel channel ) {
+	Channel_Level levels;
+
+	if ( channel < 0 || channel >= NUM_CHANNELS || !layout.channels[channel].present ) {
+		return levels;
+	}
+
+	const Channel_Info& info = layout.channels[channel];
+	const float* source = info.output ? frame.output : frame.input;
+
+	for ( int i = 0; i < info.levelCount; i++ ) {
+		levels.*Channel_Level::members[i] = source[info.levelFirst + i];
 	}
 
 	return levels;
 }
 
 std::vector<VBInterface::Device> VBInterface::getOutputDevices() {
-	std::vector<Device> devices;
-	long num, type;
-	char name[256];
-	char hardwareID[256];
+	VB_TRACE_SCOPE( "getOutputDevices", "" );
 
-	num = iVMR.VBVMR_Output_GetDeviceNumber();
+	// Cached by the core while the server is away or the list is still warm
+	return connection->devices( true );
+}
 
-	for ( int i = 0; i < num; i++ ) {
-		long rep = iVMR.VBVMR_Output_GetDeviceDescA( i, &type, name, hardwareID );
-		if ( rep != 0 ) {
-			continue;
+quint64 VBInterface::getDeviceListHash( bool output ) {
+	VB_TRACE_SCOPE( "getDeviceListHash", output ? "output" : "input" );
+
+	// 0 while the server is away
+	return connection->deviceListHash( output );
+}
+
+VBInterface::Routing_Matrix VBInterface::getRouting() {
+	VB_TRACE_SCOPE( "getRouting", "" );
+
+	const Layout& layout = *connection->layout();
+	Routing_Matrix routing;
+	routing.numStrips = layout.numStrips;
+	routing.numBuses = layout.numBuses;
+
+	if ( !isLoggedIn() ) {
+		qWarning() << "Attempting to getRouting when not logged in";
+		return routing;
+	}
+
+	QStringList reqs;
+	for ( int strip = 0; strip < layout.numStrips; strip++ ) {
+		for ( int bus = 0; bus < layout.numBuses; bus++ ) {
+			reqs.append( routeName( strip, bus ) );
+		}
+	}
+
+	// One wait covers the whole sweep, cells are then read straight from the DLL
+	std::vector<float> values = connection->readFloats( reqs );
+	for ( int strip = 0; strip < layout.numStrips; strip++ ) {
+		for ( int bus = 0; bus < layout.numBuses; bus++ ) {
+			routing.setRouted( Channel( STRIP1 + strip ), Channel( BUS1 + bus ), values[strip * layout.numBuses + bus] >= 0.5f );
+		}
+	}
+
+	return routing;
+}
+
+int VBInterface::setRouting( const Routing_Matrix& routing ) {
+	VB_TRACE_SCOPE( "setRouting", "" );
+
+	if ( !isLoggedIn() ) {
+		qWarning() << "Attempting to setRouting when not logged in";
+		return 0;
+	}
+
+	Routing_Matrix current = getRouting();
+	quint64 flipped = current.diff( routing );
+
+	VBScript script;
+	for ( int strip = 0; strip < current.numStrips; strip++ ) {
+		for ( int bus = 0; bus < current.numBuses; bus++ ) {
+			Channel stripChannel = Channel( STRIP1 + strip );
+			Channel busChannel = Channel( BUS1 + bus );
+			if ( ( flipped >> Routing_Matrix::cell( stripChannel, busChannel ) ) & 1 ) {
+				script.setFloat( routeName( strip, bus ), routing.isRouted( stripChannel, busChannel ) ? 1 : 0 );
+			}
 		}
+	}
+
+	apply( script );
+	return script.size();
+}
+
+void VBInterface::setGroup( const QString& name, const std::vector<Channel>& members ) {
+	VB_TRACE_SCOPE( "setGroup", name.toUtf8().constData() );
+
+	groups.erase( name );
+	for ( Channel channel : members ) {
+		addToGroup( name, channel );
+	}
+}
+
+void VBInterface::removeGroup( const QString& name ) {
+	groups.erase( name );
+}
+
+void VBInterface::addToGroup( const QString& name, Channel channel ) {
+	VB_TRACE_SCOPE( "addToGroup", name.toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
+	auto found = groups.find( name );
+	bool created = found == groups.end();
+	Channel_Group& group = groups[name];
+	if ( std::find( group.members.begin(), group.members.end(), channel ) != group.members.end() ) {
+		return;
+	}
+
+	// One read, served from the shadow when the gain was just written
+	float gain = getVolume( channel );
+	if ( created ) {
+		group.gain = gain;
+	}
+
+	group.members.push_back( channel );
+	group.offsets.push_back( gain - group.gain );
+}
+
+void VBInterface::removeFromGroup( const QString& name, Channel channel ) {
+	auto found = groups.find( name );
+	if ( found == groups.end() ) {
+		return;
+	}
+
+	Channel_Group& group = found->second;
+	auto member = std::find( group.members.begin(), group.members.end(), channel );
+	if ( member != group.members.end() ) {
+		group.offsets.erase( group.offsets.begin() + ( member - group.members.begin() ) );
+		group.members.erase( member );
+	}
+}
+
+void VBInterface::setGroupOffset( const QString& name, Channel channel, float offsetDb ) {
+	auto found = groups.find( name );
+	if ( found == groups.end() ) {
+		return;
+	}
+
+	Channel_Group& group = found->second;
+	auto member = std::find( group.members.begin(), group.members.end(), channel );
+	if ( member != group.members.end() ) {
+		group.offsets[member - group.members.begin()] = offsetDb;
+	}
+}
 
-		Device newDevice;
-		newDevice.name = QString( name );
-		newDevice.hardwareID = QString( hardwareID );
-
-		switch ( type ) {
-			default:
-			case VBVMR_DEVTYPE_WDM:
-				newDevice.type = WDM;
-				break;
-			case VBVMR_DEVTYPE_KS:
-				newDevice.type = KS;
-				break;
-			case VBVMR_DEVTYPE_MME:
-				newDevice.type = MME;
-				break;
-			case VBVMR_DEVTYPE_ASIO:
-				newDevice.type = ASIO;
-				break;
+VBInterface::Channel_Group VBInterface::getGroup( const QString& name ) {
+	auto found = groups.find( name );
+	return found != groups.end() ? found->second : Channel_Group();
+}
+
+QStringList VBInterface::getGroupNames() {
+	QStringList names;
+	for ( const auto& group : groups ) {
+		names.append( group.first );
+	}
+	return names;
+}
+
+void VBInterface::groupSetGain( const QString& name, float gainDb ) {
+	VB_TRACE_SCOPE( "groupSetGain", name.toUtf8().constData() );
+
+	auto found = groups.find( name );
+	if ( found == groups.end() ) {
+		qWarning() << "No channel group named" << name;
+		return;
+	}
+
+	// Offsets are kept as they are, members that run past the range are written clamped as the server would store them
+	Channel_Group& group = found->second;
+	group.gain = gainDb;
+
+	VBScript script;
+	for ( size_t i = 0; i < group.members.size(); i++ ) {
+		// Members the connected Voicemeeter lacks are left out rather than written as ".gain"
+		if ( !hasChannel( group.members[i] ) ) {
+			continue;
 		}
+		float gain = gainDb + group.offsets[i];
+		gain = gain < MIN_GAIN_DB ? MIN_GAIN_DB : gain > MAX_GAIN_DB ? MAX_GAIN_DB : gain;
+		script.setFloat( channelToString( group.members[i] ) + ".gain", gain );
+	}
+	apply( script );
+}
 
-		devices.push_back( newDevice );
+float VBInterface::groupNudge( const QString& name, float deltaDb ) {
+	auto found = groups.find( name );
+	if ( found == groups.end() ) {
+		qWarning() << "No channel group named" << name;
+		return 0;
 	}
-	return devices;
+
+	float gain = found->second.gain + deltaDb;
+	groupSetGain( name, gain );
+	return gain;
+}
+
+void VBInterface::groupMute( const QString& name, bool mute ) {
+	VB_TRACE_SCOPE( "groupMute", name.toUtf8().constData() );
+
+	auto found = groups.find( name );
+	if ( found == groups.end() ) {
+		qWarning() << "No channel group named" << name;
+		return;
+	}
+
+	VBScript script;
+	for ( Channel channel : found->second.members ) {
+		if ( !hasChannel( channel ) ) {
+			continue;
+		}
+		script.setFloat( channelToString( channel ) + ".mute", mute );
+	}
+	apply( script );
 }
 
 VBInterface::Device VBInterface::getOutputDevice( Channel channel ) {
+	VB_TRACE_SCOPE( "getOutputDevice", channelToString( channel ).toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return Device();
+	}
+
 	Device device;
 
 	if ( !isOutputChannel( channel ) ) {
@@ -253,58 +762,48 @@ VBInterface::Device VBInterface::getOutputDevice( Channel channel ) {
 }
 
 void VBInterface::setOutputDevice( Channel channel, Device device ) {
+	VB_TRACE_SCOPE( "setOutputDevice", device.name.toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
 	if ( !isOutputChannel( channel ) ) {
 		qWarning() << "Channel is not an output channel";
 		return;
 	}
 
-	QString req = channelToString( channel ) + ".device";
-	switch ( device.type ) {
-		case WDM:
-			req.append( ".wdm" );
-			break;
-		case KS:
-			req.append( ".ks" );
-			break;
-		case MME:
-			req.append( ".mme" );
-			break;
-		case ASIO:
-			req.append( ".asio" );
-			break;
-		default:
-			setOutputDevice( channel, device.name );
-			return;
+	QString req = deviceRequest( channel, device.type );
+	if ( req.isEmpty() ) {
+		setOutputDevice( channel, device.name );
+		return;
 	}
 
 	setString( req, device.name );
 }
 
 void VBInterface::setOutputDevice( Channel channel, QString deviceName ) {
+	VB_TRACE_SCOPE( "setOutputDevice", deviceName.toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
 	if ( !isOutputChannel( channel ) ) {
 		qWarning() << "Channel is not an output channel";
 		return;
 	}
 
-	std::vector<Device> devices = getOutputDevices();
-	std::vector<Device> viable;
-	for ( int i = 0; i < devices.size(); i++ ) {
-		if ( devices.at( i ).name == deviceName ) {
-			viable.push_back( devices.at( i ) );
-		}
+	// Only ever pass on a device of a known type, anything else would come straight back here
+	Device device = findDevice( getOutputDevices(), deviceName );
+	if ( device.type == UNKNOWN ) {
+		qWarning() << "No output device named" << deviceName;
+		return;
 	}
 
-	Device chosen;
-	for ( int i = 0; i < NUM_PREFERRED_TYPES; i++ ) {
-		for ( int k = 0; k < viable.size(); k++ ) {
-			if ( viable.at( k ).type == Preferred_Types[i] ) {
-				chosen = viable.at( k );
-				goto OUTPUTCHOSEN;
-			}
-		}
-	}
-OUTPUTCHOSEN:
-	setOutputDevice( channel, chosen );
+	setOutputDevice( channel, device );
 }
 
 void VBInterface::setOutputDevice( Channel channel, int deviceIndex ) {
@@ -312,45 +811,19 @@ void VBInterface::setOutputDevice( Channel channel, int deviceIndex ) {
 }
 
 std::vector<VBInterface::Device> VBInterface::getInputDevices() {
-	std::vector<Device> devices;
-	long num, type;
-	char name[256];
-	char hardwareID[256];
-
-	num = iVMR.VBVMR_Input_GetDeviceNumber();
-
-	for ( int i = 0; i<num; i++ ) {
-		long rep = iVMR.VBVMR_Input_GetDeviceDescA( i, &type, name, hardwareID );
-		if ( rep != 0 ) {
-			continue;
-		}
+	VB_TRACE_SCOPE( "getInputDevices", "" );
 
+	return connection->devices( false );
+}
 
-		Device newDevice;
-		newDevice.name = QString( name );
-		newDevice.hardwareID = QString( hardwareID );
-
-		switch ( type ) {
-			default:
-				newDevice.type = UNKNOWN;
-				break;
-			case VBVMR_DEVTYPE_WDM:
-				newDevice.type = WDM;
-				break;
-			case VBVMR_DEVTYPE_KS:
-				newDevice.type = KS;
-				break;
-			case VBVMR_DEVTYPE_MME:
-				newDevice.type = MME;
-				break;
-		}
+VBInterface::Device VBInterface::getInputDevice( Channel channel ) {
+	VB_TRACE_SCOPE( "getInputDevice", channelToString( channel ).toUtf8().constData() );
 
-		devices.push_back( newDevice );
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return Device();
 	}
-	return devices;
-}
 
-VBInterface::Device VBInterface::getInputDevice( Channel channel ) {
 	Device device;
 
 	if ( isOutputChannel( channel ) ) {
@@ -365,257 +838,391 @@ VBInterface::Device VBInterface::getInputDevice( Channel channel ) {
 }
 
 void VBInterface::setInputDevice( Channel channel, Device device ) {
+	VB_TRACE_SCOPE( "setInputDevice", device.name.toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
 	if ( isOutputChannel( channel ) ) {
 		qWarning() << "Channel is not an input channel";
 		return;
 	}
 
-	QString req = channelToString( channel ) + ".device";
-	switch ( device.type ) {
-		case WDM:
-			req.append( ".wdm" );
-			break;
-		case KS:
-			req.append( ".ks" );
-			break;
-		case MME:
-			req.append( ".mme" );
-			break;
-		default:
-			setOutputDevice( channel, device.name );
-			return;
+	QString req = deviceRequest( channel, device.type );
+	if ( req.isEmpty() ) {
+		setInputDevice( channel, device.name );
+		return;
 	}
 
 	setString( req, device.name );
 }
 
 void VBInterface::setInputDevice( Channel channel, QString deviceName ) {
+	VB_TRACE_SCOPE( "setInputDevice", deviceName.toUtf8().constData() );
+
+	if ( !hasChannel( channel ) ) {
+		qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+		return;
+	}
+
 	if ( isOutputChannel( channel ) ) {
 		qWarning() << "Channel is not an input channel";
 		return;
 	}
 
-	std::vector<Device> devices = getInputDevices();
-	std::vector<Device> viable;
-	for ( int i = 0; i < devices.size(); i++ ) {
-		if ( devices.at( i ).name == deviceName ) {
-			viable.push_back( devices.at( i ) );
-		}
+	// Only ever pass on a device of a known type, anything else would come straight back here
+	Device device = findDevice( getInputDevices(), deviceName );
+	if ( device.type == UNKNOWN ) {
+		qWarning() << "No input device named" << deviceName;
+		return;
 	}
 
-	Device chosen;
-	for ( int i = 0; i < NUM_PREFERRED_TYPES; i++ ) {
-		for ( int k = 0; k < viable.size(); k++ ) {
-			if ( viable.at( k ).type == Preferred_Types[i] ) {
-				chosen = viable.at( k );
-				goto INPUTCHOSEN;
-			}
-		}
-	}
-INPUTCHOSEN:
-	setInputDevice( channel, chosen );
+	setInputDevice( channel, device );
 }
 
 void VBInterface::setInputDevice( Channel channel, int deviceIndex ) {
 	setInputDevice( channel, getInputDevices().at( deviceIndex ) );
 }
 
-bool VBInterface::isDirty() {
-	long dirty = iVMR.VBVMR_IsParametersDirty();
-
-	return dirty != 0;
-}
+int VBInterface::setDevices( const std::map<Channel, Device>& devices ) {
+	VB_TRACE_SCOPE( "setDevices", "" );
 
-void VBInterface::waitForClean() {
-	while ( isDirty() ) {
-		// Blocking loop...
-		QThread::usleep( 10 );
+	if ( !isLoggedIn() ) {
+		qWarning() << "Attempting to setDevices when not logged in";
+		return 0;
 	}
-}
 
-int VBInterface::loadDLL() {
-	QString VB_ID = "VB:Voicemeeter {17359A74-1236-5467}";
+	// At most one enumeration per direction, and only if a name has to be resolved
+	std::vector<Device> outputs, inputs;
+	bool outputsRead = false, inputsRead = false;
+
+	VBScript script;
+	std::vector<Device_Resume> pending;
+	for ( const auto& assignment : devices ) {
+		Channel channel = assignment.first;
+		Device device = assignment.second;
+		if ( !hasChannel( channel ) ) {
+			qWarning() << "Channel" << channel << "is not available on this Voicemeeter";
+			continue;
+		}
+
+		bool output = isOutputChannel( channel );
+		if ( deviceRequest( channel, device.type ).isEmpty() ) {
+			if ( output && !outputsRead ) {
+				outputs = getOutputDevices();
+				outputsRead = true;
+			} else if ( !output && !inputsRead ) {
+				inputs = getInputDevices();
+				inputsRead = true;
+			}
+
+			device = findDevice( output ? outputs : inputs, assignment.second.name );
+			if ( device.type == UNKNOWN ) {
+				qWarning() << "No" << ( output ? "output" : "input" ) << "device named" << assignment.second.name;
+				continue;
+			}
+		}
+
+		script.setString( deviceRequest( channel, device.type ), device.name );
+		Device_Resume resume;
+		resume.channel = channel;
+		pending.push_back( resume );
+	}
 
-	QString path32 = "HKEY_LOCAL_MACHINE\\Software\\WOW6432Node\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\" + VB_ID;
-	QString path64 = "HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\" + VB_ID;
+	if ( script.isEmpty() ) {
+		return 0;
+	}
 
-	// Get Voicemeeter DLL location
-	QString path = QSettings( path64, QSettings::NativeFormat ).value( "UninstallString" ).toString();
-	
-	if ( path.isEmpty() ) {
-		path = QSettings( path32, QSettings::NativeFormat ).value( "UninstallString" ).toString();
+	// Only channels carrying signal now can be seen to drop and come back, silent ones are not waited for
+	Level_Frame before = getLevelFrame( PRE_FADER );
+	resumePending.clear();
+	for ( const Device_Resume& resume : pending ) {
+		if ( hasSignal( before, resume.channel ) ) {
+			resumePending.push_back( resume );
+		}
 	}
 
-	if ( path.isEmpty() ) {
-		qCritical() << "Can't find installed Voicemeeter";
-		return -100; // Can't find installed VoiceMeeter
+	apply( script );
+
+	resumeTimer.start();
+	if ( resumeJob < 0 ) {
+		resumeJob = connection->scheduler.add( "deviceResume", DEVICE_RESUME_INTERVAL, DEVICE_RESUME_INTERVAL, [this]() {
+			return pollDeviceResume();
+		} );
 	}
+	connection->scheduler.setEnabled( resumeJob, true );
 
-	QStringList parts = path.split( "\\" );
-	parts.removeLast();
-	path = parts.join( "/" );
-	path.append( "/VoicemeeterRemote64.dll" );
+	return (int) pending.size();
+}
 
-	lib.setFileName( path );
-	lib.load();
+bool VBInterface::isDirty() {
+	VB_TRACE_SCOPE( "isDirty", "" );
 
-	if ( !lib.isLoaded() ) {
-		qCritical() << lib.errorString();
-		return -1;
+	// Asking the DLL clears its flag for every handle, the generation tells each of them. The poller owns the flag while it runs
+	if ( !connection->core.isPolling() ) {
+		connection->pollDirty();
 	}
 
-	iVMR.VBVMR_Login = (T_VBVMR_Login) lib.resolve( "VBVMR_Login" );
-	iVMR.VBVMR_Logout = (T_VBVMR_Logout) lib.resolve( "VBVMR_Logout" );
-	iVMR.VBVMR_RunVoicemeeter = (T_VBVMR_RunVoicemeeter) lib.resolve( "VBVMR_RunVoicemeeter" );
-	iVMR.VBVMR_GetVoicemeeterType = (T_VBVMR_GetVoicemeeterType) lib.resolve( "VBVMR_GetVoicemeeterType" );
-	iVMR.VBVMR_GetVoicemeeterVersion = (T_VBVMR_GetVoicemeeterVersion) lib.resolve( "VBVMR_GetVoicemeeterVersion" );
+	quint64 generation = connection->core.dirtyGeneration();
+	bool dirty = seenDirty != generation;
+	seenDirty = generation;
+	return dirty;
+}
+
+void VBInterface::setBackend( const T_VBVMR_INTERFACE& functions ) {
+	connection->setBackend( functions );
+}
+
+VBScheduler& VBInterface::getScheduler() {
+	return connection->scheduler;
+}
+
+std::shared_ptr<VBConnection> VBInterface::getConnection() {
+	return connection;
+}
 
-	iVMR.VBVMR_IsParametersDirty = (T_VBVMR_IsParametersDirty) lib.resolve( "VBVMR_IsParametersDirty" );
-	iVMR.VBVMR_GetParameterFloat = (T_VBVMR_GetParameterFloat) lib.resolve( "VBVMR_GetParameterFloat" );
-	iVMR.VBVMR_GetParameterStringA = (T_VBVMR_GetParameterStringA) lib.resolve( "VBVMR_GetParameterStringA" );
-	iVMR.VBVMR_GetParameterStringW = (T_VBVMR_GetParameterStringW) lib.resolve( "VBVMR_GetParameterStringW" );
-	iVMR.VBVMR_GetLevel = (T_VBVMR_GetLevel) lib.resolve( "VBVMR_GetLevel" );
-	iVMR.VBVMR_GetMidiMessage = (T_VBVMR_GetMidiMessage) lib.resolve( "VBVMR_GetMidiMessage" );
+quint64 VBInterface::schedule( const VBScript& script, int msecs ) {
+	Deferred_Command command;
+	command.script = script;
+	command.dueNs = deferredClock.nsecsElapsed() + qMax( msecs, 0 ) * qint64( 1000000 );
 
-	iVMR.VBVMR_SetParameterFloat = (T_VBVMR_SetParameterFloat) lib.resolve( "VBVMR_SetParameterFloat" );
-	iVMR.VBVMR_SetParameters = (T_VBVMR_SetParameters) lib.resolve( "VBVMR_SetParameters" );
-	iVMR.VBVMR_SetParametersW = (T_VBVMR_SetParametersW) lib.resolve( "VBVMR_SetParametersW" );
-	iVMR.VBVMR_SetParameterStringA = (T_VBVMR_SetParameterStringA) lib.resolve( "VBVMR_SetParameterStringA" );
-	iVMR.VBVMR_SetParameterStringW = (T_VBVMR_SetParameterStringW) lib.resolve( "VBVMR_SetParameterStringW" );
+	// Round up, a command never runs before its time
+	const qint64 tickNs = DEFERRED_TICK_MS * qint64( 1000000 );
+	quint64 id = deferred.add( ( command.dueNs + tickNs - 1 ) / tickNs, std::move( command ) );
+	armDeferred();
+	return id;
+}
 
-	iVMR.VBVMR_Output_GetDeviceNumber = (T_VBVMR_Output_GetDeviceNumber) lib.resolve( "VBVMR_Output_GetDeviceNumber" );
-	iVMR.VBVMR_Output_GetDeviceDescA = (T_VBVMR_Output_GetDeviceDescA) lib.resolve( "VBVMR_Output_GetDeviceDescA" );
-	iVMR.VBVMR_Output_GetDeviceDescW = (T_VBVMR_Output_GetDeviceDescW) lib.resolve( "VBVMR_Output_GetDeviceDescW" );
-	iVMR.VBVMR_Input_GetDeviceNumber = (T_VBVMR_Input_GetDeviceNumber) lib.resolve( "VBVMR_Input_GetDeviceNumber" );
-	iVMR.VBVMR_Input_GetDeviceDescA = (T_VBVMR_Input_GetDeviceDescA) lib.resolve( "VBVMR_Input_GetDeviceDescA" );
-	iVMR.VBVMR_Input_GetDeviceDescW = (T_VBVMR_Input_GetDeviceDescW) lib.resolve( "VBVMR_Input_GetDeviceDescW" );
+quint64 VBInterface::scheduleAt( const VBScript& script, const QDateTime& when ) {
+	qint64 msecs = QDateTime::currentDateTime().msecsTo( when );
+	return schedule( script, (int) qBound( qint64( 0 ), msecs, qint64( INT_MAX ) ) );
+}
 
-	// check pointers are valid
-	if ( iVMR.VBVMR_Login == NULL ) return -1;
-	if ( iVMR.VBVMR_Logout == NULL ) return -2;
-	if ( iVMR.VBVMR_RunVoicemeeter == NULL ) return -2;
-	if ( iVMR.VBVMR_GetVoicemeeterType == NULL ) return -3;
-	if ( iVMR.VBVMR_GetVoicemeeterVersion == NULL ) return -4;
-	if ( iVMR.VBVMR_IsParametersDirty == NULL ) return -5;
-	if ( iVMR.VBVMR_GetParameterFloat == NULL ) return -6;
-	if ( iVMR.VBVMR_GetParameterStringA == NULL ) return -7;
-	if ( iVMR.VBVMR_GetParameterStringW == NULL ) return -8;
-	if ( iVMR.VBVMR_GetLevel == NULL ) return -9;
-	if ( iVMR.VBVMR_SetParameterFloat == NULL ) return -10;
-	if ( iVMR.VBVMR_SetParameters == NULL ) return -11;
-	if ( iVMR.VBVMR_SetParametersW == NULL ) return -12;
-	if ( iVMR.VBVMR_SetParameterStringA == NULL ) return -13;
-	if ( iVMR.VBVMR_SetParameterStringW == NULL ) return -14;
-	if ( iVMR.VBVMR_GetMidiMessage == NULL ) return -15;
+bool VBInterface::cancelScheduled( quint64 id ) {
+	if ( !deferred.cancel( id ) ) {
+		return false;
+	}
 
-	if ( iVMR.VBVMR_Output_GetDeviceNumber == NULL ) return -30;
-	if ( iVMR.VBVMR_Output_GetDeviceDescA == NULL ) return -31;
-	if ( iVMR.VBVMR_Output_GetDeviceDescW == NULL ) return -32;
-	if ( iVMR.VBVMR_Input_GetDeviceNumber == NULL ) return -33;
-	if ( iVMR.VBVMR_Input_GetDeviceDescA == NULL ) return -34;
-	if ( iVMR.VBVMR_Input_GetDeviceDescW == NULL ) return -35;
+	deferredStats.cancelled++;
+	armDeferred();
+	return true;
+}
+
+void VBInterface::cancelAllScheduled() {
+	deferredStats.cancelled += deferred.size();
+	deferred = VBTimerWheel<Deferred_Command>( deferred.currentTick() );
+	armDeferred();
+}
 
-	return 0;
+VBInterface::Deferred_Stats VBInterface::getDeferredStats() {
+	Deferred_Stats stats = deferredStats;
+	stats.pending = deferred.size();
+	return stats;
 }
 
-char* VBInterface::qStringToChar( QString input ) {
-	std::string str = input.toStdString();
-	char* cReq = new char[str.length() + 1];
+void VBInterface::resetDeferredStats() {
+	deferredStats = Deferred_Stats();
+}
+
+void VBInterface::runDeferred() {
+	VB_TRACE_SCOPE( "runDeferred", "" );
+
+	const qint64 tickNs = DEFERRED_TICK_MS * qint64( 1000000 );
+	std::vector<Deferred_Command> due;
+	deferred.advance( deferredClock.nsecsElapsed() / tickNs, [&due]( quint64, Deferred_Command&& command, long long ) {
+		due.push_back( std::move( command ) );
+	} );
+
+	if ( !due.empty() ) {
+		// Later commands win when they write the same parameter
+		std::stable_sort( due.begin(), due.end(), []( const Deferred_Command& a, const Deferred_Command& b ) {
+			return a.dueNs < b.dueNs;
+		} );
+
+		VBScript batch;
+		for ( const Deferred_Command& command : due ) {
+			batch.append( command.script );
+		}
+		apply( batch );
+
+		qint64 appliedNs = deferredClock.nsecsElapsed();
+		for ( const Deferred_Command& command : due ) {
+			qint64 latenessUs = ( appliedNs - command.dueNs ) / 1000;
+			deferredStats.lastLatenessUs = latenessUs;
+			deferredStats.maxLatenessUs = qMax( deferredStats.maxLatenessUs, latenessUs );
+			deferredStats.totalLatenessUs += latenessUs;
+		}
+		deferredStats.fired += due.size();
+		deferredStats.batches++;
+	}
+
+	armDeferred();
+}
 
-	strcpy( cReq, str.c_str() );
+void VBInterface::armDeferred() {
+	long long next = deferred.nextTick();
+	if ( next < 0 ) {
+		deferredTimer.stop();
+		return;
+	}
 
-	return cReq;
+	const qint64 tickNs = DEFERRED_TICK_MS * qint64( 1000000 );
+	qint64 waitNs = next * tickNs - deferredClock.nsecsElapsed();
+	// At most 2^24 ticks (46 h) out, within QTimer's range
+	deferredTimer.start( (int) qBound( qint64( 0 ), ( waitNs + 999999 ) / 1000000, qint64( INT_MAX ) ) );
 }
 
 QString VBInterface::channelToString( Channel channel ) {
-	switch ( channel ) {
-		case STRIP1:
-			return "Strip[0]";
-		case STRIP2:
-			return "Strip[1]";
-		case STRIP3:
-			return "Strip[2]";
-		case VIRT1:
-			return "Strip[3]";
-		case VIRT2:
-			return "Strip[4]";
-		default:
-		case BUS1:
-			return "Bus[0]";
-		case BUS2:
-			return "Bus[1]";
-		case BUS3:
-			return "Bus[2]";
-		case BUS4:
-			return "Bus[3]";
-		case BUS5:
-			return "Bus[4]";
+	if ( !hasChannel( channel ) ) {
+		return QString();
 	}
+
+	return QString( connection->layout()->channels[channel].prefix );
 }
 
 bool VBInterface::channelSize( Channel channel ) {
-	switch ( channel ) {
-		case VIRT1:
-		case VIRT2:
-		case BUS1:
-		case BUS2:
-		case BUS3:
-		case BUS4:
-		case BUS5:
-			return true;
-		default:
-			return false;
+	if ( !hasChannel( channel ) ) {
+		return false;
 	}
+
+	return connection->layout()->channels[channel].levelCount == CHANNEL_LEVEL_SIZE;
 }
 
 bool VBInterface::isOutputChannel( Channel channel ) {
-	switch ( channel ) {
-		case BUS1:
-		case BUS2:
-		case BUS3:
-		case BUS4:
-		case BUS5:
-			return true;
-		default:
-			return false;
+	if ( !hasChannel( channel ) ) {
+		return false;
 	}
+
+	return connection->layout()->channels[channel].output;
 }
 
 VBInterface::pair VBInterface::channelLevelNums( Channel channel ) {
-	pair firstLast;
-	if ( isOutputChannel( channel ) ) {
-		firstLast.first = ( channel - BUS1 ) * 8;
-		firstLast.last = firstLast.first + 8;
+	pair firstLast = { 0, 0 };
+	if ( !hasChannel( channel ) ) {
+		return firstLast;
+	}
+
+	const Channel_Info& info = connection->layout()->channels[channel];
+	firstLast.first = info.levelFirst;
+	firstLast.last = info.levelFirst + info.levelCount;
+	return firstLast;
+}
+
+QString VBInterface::routeName( int strip, int bus ) {
+	const Layout& layout = *connection->layout();
+
+	// A buses are the physical ones, B buses follow them
+	int physicalBuses = 0;
+	while ( physicalBuses < layout.numBuses && layout.channels[BUS1 + physicalBuses].physical ) {
+		physicalBuses++;
+	}
+
+	QString req = QString( layout.channels[STRIP1 + strip].prefix );
+	if ( bus < physicalBuses ) {
+		req += ".A" + QString::number( bus + 1 );
 	} else {
-		if ( channel < VIRT1 ) {
-			firstLast.first = channel * 2;
-			firstLast.last = firstLast.first + 2;
+		req += ".B" + QString::number( bus - physicalBuses + 1 );
+	}
+	return req;
+}
+
+QString VBInterface::deviceRequest( Channel channel, Device_Type type ) {
+	if ( !hasChannel( channel ) ) {
+		return QString();
+	}
+
+	QString req = channelToString( channel ) + ".device";
+	switch ( type ) {
+		case WDM:
+			return req + ".wdm";
+		case KS:
+			return req + ".ks";
+		case MME:
+			return req + ".mme";
+		case ASIO:
+			return req + ".asio";
+		default:
+			return QString();
+	}
+}
+
+VBInterface::Device VBInterface::findDevice( const std::vector<Device>& devices, const QString& name ) {
+	for ( int i = 0; i < NUM_PREFERRED_TYPES; i++ ) {
+		for ( const Device& device : devices ) {
+			if ( device.type == Preferred_Types[i] && device.name == name ) {
+				return device;
+			}
+		}
+	}
+
+	Device none;
+	none.name = name;
+	none.type = UNKNOWN;
+	return none;
+}
+
+bool VBInterface::hasSignal( const Level_Frame& frame, Channel channel ) {
+	if ( !hasChannel( channel ) ) {
+		return false;
+	}
+
+	const Channel_Info& info = connection->layout()->channels[channel];
+	const float* source = info.output ? frame.output : frame.input;
+	for ( int i = 0; i < info.levelCount; i++ ) {
+		if ( source[info.levelFirst + i] > 0.f ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool VBInterface::pollDeviceResume() {
+	if ( resumeTimer.elapsed() >= DEVICE_RESUME_TIMEOUT ) {
+		qWarning() << "Levels of" << resumePending.size() << "reassigned channels did not come back";
+		resumePending.clear();
+		connection->scheduler.setEnabled( resumeJob, false );
+		emit devicesResumed( -1 );
+		return false;
+	}
+
+	// One sweep covers strips and buses, it is shared with anything else reading levels this wakeup
+	Level_Frame frame = getLevelFrame( PRE_FADER );
+	for ( auto it = resumePending.begin(); it != resumePending.end(); ) {
+		bool signal = hasSignal( frame, it->channel );
+
+		// Every pending channel had signal before the change, levels from the old device still count until the engine restart silenced them
+		if ( !signal ) {
+			it->dropped = true;
+		}
+		if ( signal && it->dropped ) {
+			it = resumePending.erase( it );
 		} else {
-			firstLast.first = ( channel - VIRT1 ) * 8 + 6;
-			firstLast.last = firstLast.first + 8;
+			++it;
 		}
 	}
-	return firstLast;
+
+	if ( resumePending.empty() ) {
+		connection->scheduler.setEnabled( resumeJob, false );
+		emit devicesResumed( resumeTimer.elapsed() );
+	}
+
+	return true;
 }
 
 float* VBInterface::indexToLevel( Channel_Level *levels, unsigned index ) {
-	switch ( index ) {
-		default:
-		case 0:
-			return &( levels->left );
-		case 1:
-			return &( levels->right );
-		case 2:
-			return &( levels->CH3 );
-		case 3:
-			return &( levels->CH4 );
-		case 4:
-			return &( levels->CH5 );
-		case 5:
-			return &( levels->CH6 );
-		case 6:
-			return &( levels->CH7 );
-		case 7:
-			return &( levels->CH8 );
+	if ( index >= CHANNEL_LEVEL_SIZE ) {
+		index = 0;
+	}
+
+	return &( levels->*Channel_Level::members[index] );
+}
+
+const VBInterface::Layout* VBInterface::layoutForType( long type ) {
+	if ( type < STANDARD || type > POTATO ) {
+		type = BANANA;
 	}
+
+	return &layouts[type - STANDARD];
 }
@@ -2,29 +2,108 @@
 
 #include "vbinterface_global.h"
 
-#include <QLibrary>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <map>
+#include <memory>
+#include <string_view>
 #include <vector>
 
 #include "VoicemeeterRemote.h"
+#include "VBLayout.h"
+#include "VBMetrics.h"
+#include "VBRecord.h"
+#include "VBScheduler.h"
+#include "VBScript.h"
+#include "VBTimerWheel.h"
 
 #define NUM_PREFERRED_TYPES 4
 
+// Largest layout (Voicemeeter Potato), see VBLayout.h
+#define MAX_STRIPS VBLayout::MAX_STRIP_COUNT
+#define MAX_BUSES VBLayout::MAX_BUS_COUNT
+#define MAX_INPUT_LEVELS VBLayout::MAX_INPUT_SLOTS
+#define MAX_OUTPUT_LEVELS VBLayout::MAX_OUTPUT_SLOTS
+#define CHANNEL_LEVEL_SIZE VBLayout::CHANNEL_SLOTS
+
+class VBConnection;
+
+namespace VBChannel {
+	template<int N> class Strip;
+	template<int N> class Bus;
+	struct Access;
+}
+
 class VBINTERFACE_EXPORT VBInterface : public QObject {
 	Q_OBJECT
 
 public:
+	/** Channels map directly to Strip[i] / Bus[i], availability depends on the detected layout
+	*
+	* Breaking change: this numbering replaced the Banana-only one (STRIP1..STRIP3, VIRT1, VIRT2, BUS1..BUS5 = 0..9).
+	* The names kept their meaning, but BUS1..BUS5 moved from 5..9 to 8..12, and VIRT1/VIRT2 are now aliases of
+	* STRIP4/STRIP5 (still 3 and 4). Code or data holding channels as plain integers has to be updated, e.g. the old
+	* 5 is now BUS1 = 8. Strips and buses are each contiguous so that STRIP1 + i and BUS1 + i address Strip[i] and Bus[i].
+	**/
 	enum Channel {
 		STRIP1,
 		STRIP2,
 		STRIP3,
-		VIRT1,
-		VIRT2,
+		STRIP4,
+		STRIP5,
+		STRIP6,
+		STRIP7,
+		STRIP8,
 		BUS1,
 		BUS2,
 		BUS3,
 		BUS4,
-		BUS5
+		BUS5,
+		BUS6,
+		BUS7,
+		BUS8,
+		NUM_CHANNELS,
+
+		// Voicemeeter Banana names for its virtual strips
+		VIRT1 = STRIP4,
+		VIRT2 = STRIP5
+	};
+
+	enum Voicemeeter_Type {
+		STANDARD = 1,
+		BANANA = 2,
+		POTATO = 3
+	};
+
+	enum Connection_State {
+		DISCONNECTED,
+		/** Logged in, waiting for the server to answer */
+		WAITING,
+		CONNECTED,
+		/** Server went away, reconnecting with backoff */
+		LOST
+	};
+
+	/** Classification of the codes returned by the VBVMR_* functions */
+	enum Call_Result {
+		RESULT_OK,
+		/** -1, unexpected client error */
+		RESULT_ERROR,
+		/** -2, Voicemeeter is not running */
+		RESULT_NO_SERVER,
+		/** Unknown parameter, out of range, script error line... */
+		RESULT_REQUEST_ERROR
+	};
+
+	/** Level taps as accepted by VBVMR_GetLevel */
+	enum Level_Tap {
+		PRE_FADER = 0,
+		POST_FADER = 1,
+		POST_MUTE = 2,
+		OUTPUT = 3
 	};
 
 	struct Channel_Level {
@@ -36,6 +115,17 @@ public:
 		float CH6 = 0.f;
 		float CH7 = 0.f;
 		float CH8 = 0.f;
+
+		static float Channel_Level::* const members[CHANNEL_LEVEL_SIZE];
+	};
+
+	/** One sweep of every level slot of the current layout */
+	struct Level_Frame {
+		Level_Tap inputTap = PRE_FADER;
+		int numInputs = 0;
+		int numOutputs = 0;
+		float input[MAX_INPUT_LEVELS] = {};
+		float output[MAX_OUTPUT_LEVELS] = {};
 	};
 
 	struct pair {
@@ -43,6 +133,26 @@ public:
 		int last;
 	};
 
+	struct Channel_Info {
+		bool present = false;
+		bool output = false;
+		/** Hardware strip or A bus, i.e. can be bound to a device */
+		bool physical = false;
+		const char* prefix = "";
+		/** Offset into the input (taps 0-2) or output (tap 3) level slots */
+		int levelFirst = 0;
+		/** 2 for hardware strips, 8 for virtual strips and buses */
+		int levelCount = 0;
+	};
+
+	struct Layout {
+		Voicemeeter_Type type;
+		int numStrips;
+		int numBuses;
+		int numLevels[OUTPUT + 1];
+		Channel_Info channels[NUM_CHANNELS];
+	};
+
 	enum Device_Type {
 		WDM,
 		MME,
@@ -88,25 +198,183 @@ public:
 		return !( lhs == rhs );
 	}
 
+	/** Duration of each startup phase in microseconds, -1 if it did not run */
+	struct Startup_Timings {
+		/** DLL path came from the cache instead of the registry */
+		bool cachedPath = false;
+		qint64 findDLL = -1;
+		qint64 loadDLL = -1;
+		qint64 resolveSymbols = -1;
+		qint64 login = -1;
+		qint64 waitForServer = -1;
+		qint64 detectLayout = -1;
+		/** Reading the state file, see setStateFile() */
+		qint64 loadState = -1;
+		qint64 total = -1;
+	};
+
+	/** Strip to bus routing (Strip[i].A1, .B1, ...), one bit per cell */
+	struct Routing_Matrix {
+		int numStrips = 0;
+		int numBuses = 0;
+		/** Bit ( strip * MAX_BUSES + bus ) */
+		quint64 bits = 0;
+
+		/** Bit of a strip and bus pair, -1 if either is the wrong kind of channel */
+		static int cell( Channel strip, Channel bus ) {
+			if ( strip < STRIP1 || strip >= BUS1 || bus < BUS1 || bus >= NUM_CHANNELS ) {
+				return -1;
+			}
+			return ( strip - STRIP1 ) * MAX_BUSES + ( bus - BUS1 );
+		}
+
+		bool isRouted( Channel strip, Channel bus ) const {
+			int bit = cell( strip, bus );
+			return bit >= 0 && ( bits >> bit ) & 1;
+		}
+
+		void setRouted( Channel strip, Channel bus, bool routed ) {
+			int bit = cell( strip, bus );
+			if ( bit < 0 ) {
+				return;
+			}
+			bits = routed ? bits | ( 1ull << bit ) : bits & ~( 1ull << bit );
+		}
+
+		/** Cells routed differently in other */
+		quint64 diff( const Routing_Matrix& other ) const {
+			return bits ^ other.bits;
+		}
+	};
+
+	/** Channels adjusted together, each member's gain is the group gain plus its offset */
+	struct Channel_Group {
+		float gain = 0;
+		std::vector<Channel> members;
+		/** Same order as members */
+		std::vector<float> offsets;
+	};
+
+	/** Commands scheduled with schedule() / scheduleAt() */
+	struct Deferred_Stats {
+		int pending = 0;
+		qint64 fired = 0;
+		qint64 cancelled = 0;
+		/** SetParameters calls the fired commands went out in */
+		qint64 batches = 0;
+		/** Due time to the script being applied */
+		qint64 lastLatenessUs = 0;
+		qint64 maxLatenessUs = 0;
+		qint64 totalLatenessUs = 0;
+	};
+
+	/** Resolution of deferred commands, the ones due in the same tick are applied together */
+	static const int DEFERRED_TICK_MS = 10;
+	/** Gain range of strip and bus faders, the server clamps anything outside it */
+	static constexpr float MIN_GAIN_DB = -60;
+	static constexpr float MAX_GAIN_DB = 12;
+
 	Device_Type Preferred_Types[NUM_PREFERRED_TYPES] = { WDM, ASIO, KS, MME };
 
 private:
-	T_VBVMR_INTERFACE iVMR;
-	QLibrary lib;
+	struct Deferred_Command {
+		VBScript script;
+		/** deferredClock nanoseconds */
+		qint64 dueNs = 0;
+	};
+
+	std::shared_ptr<VBConnection> connection;
+	/** This handle holds a reference on the DLL */
+	bool connected = false;
+	/** This handle holds a reference on the login */
+	bool loggedIn = false;
+	/** Connection's dirty generation when this handle last asked */
+	quint64 seenDirty = 0;
+
+	VBTimerWheel<Deferred_Command> deferred;
+	/** Single shot, armed for the wheel's next tick, not a scheduler job since commands must not run early */
+	QTimer deferredTimer;
+	QElapsedTimer deferredClock;
+	Deferred_Stats deferredStats;
+
+	std::map<QString, Channel_Group> groups;
+
+	/** Channels of the last setDevices() that had signal, waiting for their levels to come back */
+	struct Device_Resume {
+		Channel channel;
+		/** Levels went silent once after having signal before the change, i.e. the engine restarted */
+		bool dropped = false;
+	};
+
+	std::vector<Device_Resume> resumePending;
+	QElapsedTimer resumeTimer;
+	int resumeJob = -1;
 
 public:
+	/** Handle on the process-wide connection, see VBConnection::shared() */
 	VBInterface();
+	/** Handle on a connection of its own, e.g. one replaying a recording */
+	explicit VBInterface( std::shared_ptr<VBConnection> connection );
+	~VBInterface();
+
+	static Call_Result classifyResult( long code );
+	/** Layout table of a Voicemeeter type */
+	static const Layout& getLayout( Voicemeeter_Type type );
+	/** Slice a channel's levels out of a frame taken with the given layout */
+	static Channel_Level frameToChannelLevel( const Layout& layout, const Level_Frame& frame, Channel channel );
+
+	/** Use these functions instead of loading the DLL, e.g. VBReplay::backend(), call before login(), affects every handle of the connection */
+	void setBackend( const T_VBVMR_INTERFACE& functions );
+
+	/** Runs the polling of VBServer, VBLevelPublisher and the other helpers, one per connection, the connection itself is polled by its core */
+	VBScheduler& getScheduler();
+	/** Connection this handle shares with others */
+	std::shared_ptr<VBConnection> getConnection();
+
+	/** Typed handle to Strip[N], invalid indexes and operations fail to compile, see VBChannel.h */
+	template<int N> VBChannel::Strip<N> strip();
+	/** Typed handle to Bus[N] */
+	template<int N> VBChannel::Bus<N> bus();
 
 public slots:
-	/** Find, Connect and Load VB's remote dll */
+	/** Find, Connect and Load VB's remote dll, already loaded if another handle did */
 	int connect();
-	/** Unload VB's DLL */
+	/** Release this handle's hold on VB's DLL, unloaded once no handle holds it */
 	void disconnect();
 	/** Check is we're connected */
 	bool isConnected();
-	/** Login to the remote server */
+	/** Login to the remote server, returns immediately and emits ready() once the server answers */
 	void login();
-	/** Logout from remote server */
+	/** Block until the server answers or msecs elapse (-1 = login timeout) */
+	bool waitForReady( int msecs = -1 );
+	/** Check if the server answered after login */
+	bool isReady();
+	/** Current state of the connection to the server */
+	Connection_State getConnectionState();
+	/** Give up waiting for the server after msecs, 0 waits forever */
+	void setLoginTimeout( int msecs );
+	/** How often the connection polls the server for changes, a lost server and writes to read back: every msecs while something changes, backing off to idleMsecs, VBCore::POLL_INTERVAL and POLL_IDLE_INTERVAL by default */
+	void setPollInterval( int msecs, int idleMsecs = 500 );
+	/** Timings of the last connect/login */
+	Startup_Timings getStartupTimings();
+	/** Per-function call counts, latency histograms, error codes and allocations for the whole process */
+	VBMetrics::Snapshot metricsSnapshot();
+	void resetMetrics();
+	/** Record public and VBVMR_* calls into the process-wide trace ring */
+	void setTracing( bool enabled );
+	bool isTracing();
+	/** Recorded calls as Chrome trace-event JSON (Perfetto, chrome://tracing) */
+	QByteArray exportTrace();
+	bool saveTrace( QString path );
+	/** Log every VBVMR_* call with its arguments, results and timing to a file for VBReplay */
+	bool startRecording( QString path );
+	void stopRecording();
+	bool isRecording();
+	/** Keep last known parameters and devices in path, loaded on login and served until read again from the server, saved on the last logout */
+	void setStateFile( QString path );
+	/** Save the last known state now, false without a state file */
+	bool saveState();
+	/** Logout from remote server, the connection stays logged in while other handles are */
 	void logout();
 	/** Start Voicemeeter Banana */
 	void startVoiceMeeter();
@@ -114,17 +382,27 @@ public slots:
 	bool isLoggedIn();
 	/** Check if remote parameters are dirty */
 	bool isDirty();
+	/** Detected Voicemeeter type, defaults to Banana until logged in */
+	Voicemeeter_Type getType();
+	/** Strip/bus layout of the detected Voicemeeter type */
+	const Layout& getLayout();
+	/** Check if a channel exists in the detected layout */
+	bool hasChannel( Channel channel );
 
 	/////////////////// Raw Access Functions ///////////////////////
 
-	/** Read raw parameter string */
+	/** Read raw parameter string, a value written through this connection is returned without asking the DLL */
 	QString readString( QString req );
-	/** Read raw parameter float */
+	/** Read raw parameter float, a value written through this connection is returned without asking the DLL */
 	float readFloat( QString req );
-	/** Set raw parameter string */
+	/** Set raw parameter string, reads return it right away until it is read back, see writeConflict() */
 	void setString( QString req, QString val );
-	/** Set raw parameter string */
+	/** Set raw parameter float, reads return it right away until it is read back, see writeConflict() */
 	void setFloat( QString req, float val );
+	/** Set several parameters at once with a script */
+	void setParameters( QString script );
+	/** Apply collected writes with a single VBVMR_SetParameters call */
+	void apply( const VBScript& script );
 
 	////////////////////// Helper Functions ///////////////////////
 
@@ -140,10 +418,14 @@ public slots:
 	void setMute( Channel channel, bool mute );
 	/** Toggle mute a channel */
 	bool toggleMute( Channel channel );
-	/** Get current levels of a channel */
-	Channel_Level getChannelLevel( Channel channel );
+	/** Get current levels of a channel, tap is ignored for output channels */
+	Channel_Level getChannelLevel( Channel channel, Level_Tap tap = PRE_FADER );
 	/** Get all current levels */
-	std::map<Channel, Channel_Level> getAllChannelLevels();
+	std::map<Channel, Channel_Level> getAllChannelLevels( Level_Tap inputTap = PRE_FADER );
+	/** Read every level slot of the current layout in one sweep */
+	Level_Frame getLevelFrame( Level_Tap inputTap = PRE_FADER );
+	/** Slice a channel's levels out of a frame */
+	Channel_Level frameToChannelLevel( const Level_Frame& frame, Channel channel );
 
 	std::vector<Device> getOutputDevices();
 
@@ -161,12 +443,83 @@ public slots:
 	void setInputDevice( Channel channel, QString deviceName );
 	void setInputDevice( Channel channel, Device device );
 
+	/** Hash of the raw device list, changes when a device comes or goes, 0 while not connected */
+	quint64 getDeviceListHash( bool output );
+
+	/** Assign devices to several strips and buses at once, names are resolved from one enumeration per direction and everything goes out in one script so the engine restarts once, devicesResumed() follows, returns how many were assigned */
+	int setDevices( const std::map<Channel, Device>& devices );
+
+	/////////////////////////// Routing ///////////////////////////
+
+	/** Read every strip to bus route of the current layout with a single wait for a clean state */
+	Routing_Matrix getRouting();
+	/** Change only the routes that differ from the current ones, in one script, returns how many changed */
+	int setRouting( const Routing_Matrix& routing );
+
+	//////////////////////// Channel Groups ////////////////////////
+
+	/** Create or replace a group, the first member's gain becomes the group gain and the others keep their distance to it */
+	void setGroup( const QString& name, const std::vector<Channel>& members );
+	void removeGroup( const QString& name );
+	/** Add a member at its current distance to the group gain, creates the group if needed */
+	void addToGroup( const QString& name, Channel channel );
+	void removeFromGroup( const QString& name, Channel channel );
+	void setGroupOffset( const QString& name, Channel channel, float offsetDb );
+	Channel_Group getGroup( const QString& name );
+	QStringList getGroupNames();
+	/** Set every member to the group gain plus its offset, clamped to the fader range, in one script */
+	void groupSetGain( const QString& name, float gainDb );
+	/** Move the whole group by deltaDb in one script, returns the new group gain */
+	float groupNudge( const QString& name, float deltaDb );
+	/** Mute or unmute every member in one script */
+	void groupMute( const QString& name, bool mute );
+
+	////////////////////// Deferred Commands //////////////////////
+
+	/** Apply a script in msecs, commands due in the same tick go out as one SetParameters call, returns an id for cancelScheduled() */
+	quint64 schedule( const VBScript& script, int msecs );
+	/** Apply a script at a wall clock time, right away if it already passed */
+	quint64 scheduleAt( const VBScript& script, const QDateTime& when );
+	/** False if the command already ran or was cancelled */
+	bool cancelScheduled( quint64 id );
+	/** Drop every pending command */
+	void cancelAllScheduled();
+	Deferred_Stats getDeferredStats();
+	void resetDeferredStats();
+
+signals:
+	/** Server answered after login, layout is detected */
+	void ready();
+	/** Server did not answer within the login timeout */
+	void loginTimedOut();
+	/** Server stopped answering, calls are served from cache until it comes back */
+	void connectionLost();
+	/** Server is back, pending writes were applied and the cache re-read */
+	void reconnected();
+	/** Levels of every channel reassigned by setDevices() that had signal dropped and came back, msecs after the script went out, -1 if some stayed silent. Channels silent before the change are not waited for */
+	void devicesResumed( qint64 msecs );
+	/** A write read back differently, a change made elsewhere won and reads return it now */
+	void writeConflict( QString req, float written, float server );
+	void stringWriteConflict( QString req, QString written, QString server );
+	/** Every value loaded from the state file was read from the server again, changed of them differed */
+	void stateVerified( int changed, qint64 msecs );
+	/** The connection's poller saw parameters change on the server, isDirty() reports it as well */
+	void parametersChanged();
+
+private slots:
+	void runDeferred();
+
 private:
-	bool loggedIn = false;
+	friend class VBConnection;
+	friend struct VBChannel::Access;
+
+	void armDeferred();
 
-	int loadDLL();
-	void waitForClean();
-	char* qStringToChar( QString input );
+	/** readFloat/setFloat by a name already in the DLL's encoding, e.g. a compile-time parameter name */
+	float readFloatName( std::string_view name );
+	void setFloatName( std::string_view name, float val );
+
+	/** Parameter prefix of a channel, e.g. "Bus[0]", empty if the layout lacks it */
 	QString channelToString( Channel channel );
 
 	/** Returns whether a channel has 2 or 7 levels
@@ -175,14 +528,32 @@ private:
 	* false = 2;
 	**/
 	bool channelSize( Channel channel );
+	/** false for channels the layout lacks */
 	bool isOutputChannel( Channel channel );
+	/** Empty range for channels the layout lacks */
 	pair channelLevelNums( Channel channel );
+	/** Parameter routing a strip to a bus, e.g. "Strip[0].B2" */
+	QString routeName( int strip, int bus );
+	/** Parameter selecting a device of a type, e.g. "Bus[0].device.wdm", empty for UNKNOWN */
+	QString deviceRequest( Channel channel, Device_Type type );
+	/** Device of the most preferred type among those named so, type UNKNOWN if there is none */
+	Device findDevice( const std::vector<Device>& devices, const QString& name );
+	/** Any level slot of the channel above silence in the frame */
+	bool hasSignal( const Level_Frame& frame, Channel channel );
+	/** setDevices() resume tracking, a scheduler job while channels are pending */
+	bool pollDeviceResume();
 	float* indexToLevel( Channel_Level* levels, unsigned index );
+
+	static const Layout* layoutForType( long type );
 };
 
 
 Q_DECLARE_METATYPE( VBInterface::Channel )
 Q_DECLARE_METATYPE( VBInterface::Channel_Level )
+Q_DECLARE_METATYPE( VBInterface::Level_Frame )
+Q_DECLARE_METATYPE( VBInterface::Routing_Matrix )
 Q_DECLARE_METATYPE( VBInterface::Device_Type )
 Q_DECLARE_METATYPE( VBInterface::Device )
 
+#include "VBChannel.h"
+
@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+* Strips, buses and level slots of each Voicemeeter type
+*
+* The one table of what each type has. VBCore sizes its level sweeps from
+* it and VBChannel builds VBInterface's per-channel layouts from it at
+* compile time, so the two can not disagree.
+*
+* This header does not depend on Qt.
+**/
+namespace VBLayout {
+	/** Same values as VBInterface::Voicemeeter_Type and VBVMR_GetVoicemeeterType */
+	enum Type {
+		STANDARD = 1,
+		BANANA = 2,
+		POTATO = 3
+	};
+
+	// Largest layout (Voicemeeter Potato)
+	constexpr int MAX_STRIP_COUNT = 8;
+	constexpr int MAX_BUS_COUNT = 8;
+	constexpr int MAX_INPUT_SLOTS = 34;
+	constexpr int MAX_OUTPUT_SLOTS = 64;
+
+	/** Level slots of a virtual strip or a bus */
+	constexpr int CHANNEL_SLOTS = 8;
+	/** Level slots of a hardware strip */
+	constexpr int PHYSICAL_STRIP_SLOTS = 2;
+
+	struct Counts {
+		Type type;
+		int physicalStrips;
+		int virtualStrips;
+		int physicalBuses;
+		int virtualBuses;
+		/** Level slots of the input taps, shared by every strip */
+		int numInputLevels;
+		/** Level slots of the output tap */
+		int numOutputLevels;
+	};
+
+	constexpr Counts makeCounts( Type type, int physicalStrips, int virtualStrips, int physicalBuses, int virtualBuses ) {
+		return { type, physicalStrips, virtualStrips, physicalBuses, virtualBuses,
+			physicalStrips * PHYSICAL_STRIP_SLOTS + virtualStrips * CHANNEL_SLOTS, ( physicalBuses + virtualBuses ) * CHANNEL_SLOTS };
+	}
+
+	/** Counts of a type, BANANA for anything unknown */
+	constexpr Counts countsOf( long type ) {
+		return type == STANDARD ? makeCounts( STANDARD, 2, 1, 1, 1 )
+			: type == POTATO ? makeCounts( POTATO, 5, 3, 5, 3 )
+			: makeCounts( BANANA, 3, 2, 3, 2 );
+	}
+
+	static_assert( countsOf( POTATO ).physicalStrips + countsOf( POTATO ).virtualStrips == MAX_STRIP_COUNT, "Potato has the most strips" );
+	static_assert( countsOf( POTATO ).physicalBuses + countsOf( POTATO ).virtualBuses == MAX_BUS_COUNT, "Potato has the most buses" );
+	static_assert( countsOf( POTATO ).numInputLevels == MAX_INPUT_SLOTS, "Potato has the most input level slots" );
+	static_assert( countsOf( POTATO ).numOutputLevels == MAX_OUTPUT_SLOTS, "Potato has the most output level slots" );
+}
@@ -0,0 +1,401 @@
+#include "VBLevelCodec.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+	const float STEP_8 = 0.5f;
+	const float STEP_16 = 1.f / 512;
+
+	unsigned short quantize( float level, float step ) {
+		// Also catches 0, negatives and NaN
+		if ( !( level > 0.f ) ) {
+			return 0;
+		}
+
+		float db = 20.f * std::log10( level );
+		if ( db < VBLevelCodec::FLOOR_DB ) {
+			return 0;
+		}
+		if ( db > VBLevelCodec::CEILING_DB ) {
+			db = VBLevelCodec::CEILING_DB;
+		}
+
+		return static_cast<unsigned short>( 1 + std::lround( ( db - VBLevelCodec::FLOOR_DB ) / step ) );
+	}
+
+	float dequantize( unsigned short code, float step ) {
+		if ( code == 0 ) {
+			return 0.f;
+		}
+
+		return std::pow( 10.f, ( VBLevelCodec::FLOOR_DB + ( code - 1 ) * step ) / 20.f );
+	}
+
+	/** 8 bit codes decode through a table, 16 bit ones are computed */
+	struct Level_Table {
+		float levels[256];
+
+		Level_Table() {
+			for ( int code = 0; code < 256; code++ ) {
+				levels[code] = dequantize( static_cast<unsigned short>( code ), STEP_8 );
+			}
+		}
+	};
+
+	void putU16( char* out, unsigned value ) {
+		out[0] = static_cast<char>( value & 0xff );
+		out[1] = static_cast<char>( ( value >> 8 ) & 0xff );
+	}
+
+	void putU32( char* out, unsigned long value ) {
+		putU16( out, value & 0xffff );
+		putU16( out + 2, ( value >> 16 ) & 0xffff );
+	}
+
+	void putI64( char* out, long long value ) {
+		unsigned long long bits = static_cast<unsigned long long>( value );
+		putU32( out, static_cast<unsigned long>( bits & 0xffffffff ) );
+		putU32( out + 4, static_cast<unsigned long>( bits >> 32 ) );
+	}
+
+	unsigned getU16( const char* data ) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>( data );
+		return bytes[0] | ( bytes[1] << 8 );
+	}
+
+	unsigned long getU32( const char* data ) {
+		return getU16( data ) | ( static_cast<unsigned long>( getU16( data + 2 ) ) << 16 );
+	}
+
+	long long getI64( const char* data ) {
+		unsigned long long bits = getU32( data ) | ( static_cast<unsigned long long>( getU32( data + 4 ) ) << 32 );
+		return static_cast<long long>( bits );
+	}
+
+	int countBits( const char* mask, int bytes ) {
+		int count = 0;
+		for ( int i = 0; i < bytes; i++ ) {
+			for ( unsigned byte = static_cast<unsigned char>( mask[i] ); byte; byte &= byte - 1 ) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+	/** Deterministic pseudo random numbers so benchmark runs compare */
+	struct Random {
+		unsigned long long state = 0x9e3779b97f4a7c15ull;
+
+		float next() {
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			return static_cast<float>( state >> 40 ) / static_cast<float>( 1ull << 24 );
+		}
+	};
+}
+
+float VBLevelCodec::stepDb( Precision precision ) {
+	return precision == BITS_16 ? STEP_16 : STEP_8;
+}
+
+float VBLevelCodec::errorBoundDb( const Settings& settings ) {
+	float step = stepDb( settings.precision );
+	float epsilon = settings.epsilonDb > 0 ? std::floor( settings.epsilonDb / step ) * step : 0.f;
+	return epsilon + step / 2;
+}
+
+VBLevelCodec::Encoder::Encoder( const Settings& settings ) {
+	setSettings( settings );
+}
+
+void VBLevelCodec::Encoder::setSettings( const Settings& settings ) {
+	this->settings = settings;
+	epsilonSteps = settings.epsilonDb > 0 ? static_cast<int>( settings.epsilonDb / stepDb( settings.precision ) ) : 0;
+	keyframePending = true;
+}
+
+const VBLevelCodec::Settings& VBLevelCodec::Encoder::getSettings() const {
+	return settings;
+}
+
+void VBLevelCodec::Encoder::requestKeyframe() {
+	keyframePending = true;
+}
+
+int VBLevelCodec::Encoder::encode( const float* input, int numInputs, const float* output, int numOutputs, long long timestampNs, char* out ) {
+	if ( numInputs < 0 || numInputs > MAX_INPUTS || numOutputs < 0 || numOutputs > MAX_OUTPUTS ) {
+		return 0;
+	}
+
+	long long elapsedUs = ( timestampNs - this->timestampNs ) / 1000;
+	bool keyframe = keyframePending
+		|| numInputs != this->numInputs || numOutputs != this->numOutputs
+		|| ( settings.keyframeInterval > 0 && sinceKeyframe >= settings.keyframeInterval )
+		|| elapsedUs < 0 || elapsedUs > 0xffffffffll;
+
+	float step = stepDb( settings.precision );
+	bool wide = settings.precision == BITS_16;
+	int numSlots = numInputs + numOutputs;
+	unsigned short codes[MAX_SLOTS];
+	for ( int i = 0; i < numInputs; i++ ) {
+		codes[i] = quantize( input[i], step );
+	}
+	for ( int i = 0; i < numOutputs; i++ ) {
+		codes[numInputs + i] = quantize( output[i], step );
+	}
+
+	out[0] = static_cast<char>( ( keyframe ? KEYFRAME : 0 ) | ( wide ? WIDE : 0 ) );
+	out[1] = static_cast<char>( numInputs );
+	out[2] = static_cast<char>( numOutputs );
+	putU16( out + 3, sequence++ );
+	int pos = HEADER_SIZE;
+
+	if ( keyframe ) {
+		putI64( out + pos, timestampNs );
+		pos += 8;
+		for ( int i = 0; i < numSlots; i++ ) {
+			if ( wide ) {
+				putU16( out + pos, codes[i] );
+				pos += 2;
+			} else {
+				out[pos++] = static_cast<char>( codes[i] );
+			}
+		}
+
+		std::memcpy( sent, codes, numSlots * sizeof( codes[0] ) );
+		this->numInputs = numInputs;
+		this->numOutputs = numOutputs;
+		this->timestampNs = timestampNs;
+		keyframePending = false;
+		sinceKeyframe = 1;
+		return pos;
+	}
+
+	putU32( out + pos, static_cast<unsigned long>( elapsedUs ) );
+	pos += 4;
+	// Track the timestamp the decoder rebuilds so the truncation never adds up
+	this->timestampNs += elapsedUs * 1000;
+	sinceKeyframe++;
+
+	char* mask = out + pos;
+	int maskBytes = ( numSlots + 7 ) / 8;
+	std::memset( mask, 0, maskBytes );
+	pos += maskBytes;
+
+	int changed = 0;
+	for ( int i = 0; i < numSlots; i++ ) {
+		int delta = codes[i] - sent[i];
+		// Going silent or coming back is always sent, the dB distance is unbounded
+		bool silenceChanged = ( codes[i] == 0 ) != ( sent[i] == 0 );
+		if ( !silenceChanged && delta <= epsilonSteps && -delta <= epsilonSteps ) {
+			continue;
+		}
+
+		mask[i / 8] |= static_cast<char>( 1 << ( i % 8 ) );
+		if ( wide ) {
+			putU16( out + pos, codes[i] );
+			pos += 2;
+		} else {
+			out[pos++] = static_cast<char>( codes[i] );
+		}
+		sent[i] = codes[i];
+		changed++;
+	}
+
+	if ( changed == 0 ) {
+		out[0] = static_cast<char>( out[0] | UNCHANGED );
+		return HEADER_SIZE + 4;
+	}
+
+	return pos;
+}
+
+VBLevelCodec::Decoder::Result VBLevelCodec::Decoder::decode( const char* data, int size, Frame& frame ) {
+	if ( size < HEADER_SIZE ) {
+		return MALFORMED;
+	}
+
+	int flags = static_cast<unsigned char>( data[0] );
+	int numInputs = static_cast<unsigned char>( data[1] );
+	int numOutputs = static_cast<unsigned char>( data[2] );
+	unsigned short sequence = static_cast<unsigned short>( getU16( data + 3 ) );
+	if ( numInputs > MAX_INPUTS || numOutputs > MAX_OUTPUTS ) {
+		return MALFORMED;
+	}
+
+	bool wide = ( flags & WIDE ) != 0;
+	int codeSize = wide ? 2 : 1;
+	int numSlots = numInputs + numOutputs;
+	int pos = HEADER_SIZE;
+	int changed = 0;
+
+	if ( flags & KEYFRAME ) {
+		if ( size != HEADER_SIZE + 8 + numSlots * codeSize ) {
+			return MALFORMED;
+		}
+
+		timestampNs = getI64( data + pos );
+		pos += 8;
+		for ( int i = 0; i < numSlots; i++ ) {
+			codes[i] = wide ? static_cast<unsigned short>( getU16( data + pos ) ) : static_cast<unsigned char>( data[pos] );
+			pos += codeSize;
+		}
+
+		this->wide = wide;
+		this->numInputs = numInputs;
+		this->numOutputs = numOutputs;
+		synced = true;
+		changed = numSlots;
+	} else {
+		if ( size < HEADER_SIZE + 4 ) {
+			return MALFORMED;
+		}
+
+		if ( !synced || sequence != static_cast<unsigned short>( this->sequence + 1 )
+			|| wide != this->wide || numInputs != this->numInputs || numOutputs != this->numOutputs ) {
+			synced = false;
+			return NEED_KEYFRAME;
+		}
+
+		long long elapsedUs = static_cast<long long>( getU32( data + pos ) );
+		pos += 4;
+
+		if ( flags & UNCHANGED ) {
+			if ( size != pos ) {
+				return MALFORMED;
+			}
+		} else {
+			const char* mask = data + pos;
+			int maskBytes = ( numSlots + 7 ) / 8;
+			if ( size < pos + maskBytes ) {
+				return MALFORMED;
+			}
+			pos += maskBytes;
+
+			changed = countBits( mask, maskBytes );
+			if ( size != pos + changed * codeSize ) {
+				return MALFORMED;
+			}
+
+			for ( int i = 0; i < numSlots; i++ ) {
+				if ( mask[i / 8] & ( 1 << ( i % 8 ) ) ) {
+					codes[i] = wide ? static_cast<unsigned short>( getU16( data + pos ) ) : static_cast<unsigned char>( data[pos] );
+					pos += codeSize;
+				}
+			}
+		}
+
+		timestampNs += elapsedUs * 1000;
+	}
+
+	this->sequence = sequence;
+
+	static const Level_Table table;
+	frame.timestampNs = timestampNs;
+	frame.keyframe = ( flags & KEYFRAME ) != 0;
+	frame.changed = changed;
+	frame.numInputs = numInputs;
+	frame.numOutputs = numOutputs;
+	for ( int i = 0; i < numInputs; i++ ) {
+		frame.input[i] = wide ? dequantize( codes[i], STEP_16 ) : table.levels[codes[i]];
+	}
+	for ( int i = 0; i < numOutputs; i++ ) {
+		frame.output[i] = wide ? dequantize( codes[numInputs + i], STEP_16 ) : table.levels[codes[numInputs + i]];
+	}
+
+	return DECODED;
+}
+
+void VBLevelCodec::Decoder::reset() {
+	synced = false;
+}
+
+VBLevelCodec::Benchmark_Result VBLevelCodec::benchmark( int numInputs, int numOutputs, int numFrames, const Settings& settings ) {
+	Benchmark_Result result;
+	if ( numInputs < 0 || numInputs > MAX_INPUTS || numOutputs < 0 || numOutputs > MAX_OUTPUTS || numFrames <= 0 ) {
+		return result;
+	}
+
+	// Every third slot stays silent like the unused slots of two channel strips,
+	// the others mostly hold still with small moves and the odd jump
+	int numSlots = numInputs + numOutputs;
+	std::vector<float> levels( static_cast<size_t>( numFrames ) * numSlots );
+	std::vector<float> db( numSlots, -40.f );
+	Random random;
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		float* slots = &levels[static_cast<size_t>( frame ) * numSlots];
+		for ( int i = 0; i < numSlots; i++ ) {
+			if ( i % 3 == 2 ) {
+				slots[i] = 0.f;
+				continue;
+			}
+
+			float roll = random.next();
+			if ( roll < 0.005f ) {
+				db[i] = -60.f + 60.f * random.next();
+			} else if ( roll < 0.15f ) {
+				db[i] += 3.f * random.next() - 1.5f;
+			}
+			db[i] = std::fmin( std::fmax( db[i], -90.f ), 6.f );
+			slots[i] = std::pow( 10.f, db[i] / 20.f );
+		}
+	}
+
+	std::vector<char> packets( static_cast<size_t>( numFrames ) * MAX_PACKET_SIZE );
+	std::vector<int> sizes( numFrames );
+	const long long frameNs = 10000000;
+
+	Encoder encoder( settings );
+	auto start = std::chrono::steady_clock::now();
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		const float* slots = &levels[static_cast<size_t>( frame ) * numSlots];
+		sizes[frame] = encoder.encode( slots, numInputs, slots + numInputs, numOutputs, frame * frameNs, &packets[static_cast<size_t>( frame ) * MAX_PACKET_SIZE] );
+	}
+	auto encoded = std::chrono::steady_clock::now();
+
+	Decoder decoder;
+	Frame decodedFrame;
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		decoder.decode( &packets[static_cast<size_t>( frame ) * MAX_PACKET_SIZE], sizes[frame], decodedFrame );
+	}
+	auto decoded = std::chrono::steady_clock::now();
+
+	// Check the bound outside the timed loops
+	long long totalBytes = 0;
+	decoder.reset();
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		totalBytes += sizes[frame];
+		if ( decoder.decode( &packets[static_cast<size_t>( frame ) * MAX_PACKET_SIZE], sizes[frame], decodedFrame ) != Decoder::DECODED ) {
+			result.maxErrorDb = INFINITY;
+			continue;
+		}
+		if ( decodedFrame.keyframe ) {
+			result.keyframes++;
+		}
+
+		const float* slots = &levels[static_cast<size_t>( frame ) * numSlots];
+		for ( int i = 0; i < numSlots; i++ ) {
+			float original = slots[i];
+			float restored = i < numInputs ? decodedFrame.input[i] : decodedFrame.output[i - numInputs];
+			if ( original <= 0.f || restored <= 0.f ) {
+				if ( original != restored ) {
+					result.maxErrorDb = INFINITY;
+				}
+				continue;
+			}
+
+			float error = static_cast<float>( std::fabs( 20.0 * std::log10( static_cast<double>( restored ) / original ) ) );
+			result.maxErrorDb = std::fmax( result.maxErrorDb, error );
+		}
+	}
+
+	result.frames = numFrames;
+	result.encodeNs = std::chrono::duration<double, std::nano>( encoded - start ).count() / numFrames;
+	result.decodeNs = std::chrono::duration<double, std::nano>( decoded - encoded ).count() / numFrames;
+	result.bytesPerFrame = static_cast<double>( totalBytes ) / numFrames;
+	result.rawBytesPerFrame = numSlots * static_cast<int>( sizeof( float ) );
+	result.errorBoundDb = errorBoundDb( settings );
+	return result;
+}
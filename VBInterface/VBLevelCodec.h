@@ -0,0 +1,147 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBLayout.h"
+
+/**
+* Delta-quantized level stream codec
+*
+* Levels are quantized to 8 bit (0.5 dB) or 16 bit (1/512 dB) steps between
+* FLOOR_DB and CEILING_DB. A delta packet only carries the slots whose code
+* moved by more than the epsilon since the decoder last saw them, behind a
+* bitmask of the changed slots; keyframes carry every slot and are sent
+* periodically, on request and whenever the layout or settings change.
+*
+* Since the encoder compares against what the decoder holds rather than the
+* previous frame, errors do not accumulate: a decoded level is within
+* errorBoundDb() of the encoded one, levels below FLOOR_DB decode as 0 and
+* levels above CEILING_DB as CEILING_DB.
+*
+* Packets are little-endian:
+*   flags u8, numInputs u8, numOutputs u8, sequence u16,
+*   keyframe: timestamp i64 ns, delta: u32 us since the previous packet,
+*   delta: changed slot bitmask, inputs then outputs, unless UNCHANGED,
+*   one u8 or u16 code per slot sent, 0 is silence.
+*
+* This header does not depend on Qt.
+**/
+namespace VBLevelCodec {
+	const int MAX_INPUTS = VBLayout::MAX_INPUT_SLOTS;
+	const int MAX_OUTPUTS = VBLayout::MAX_OUTPUT_SLOTS;
+	const int MAX_SLOTS = MAX_INPUTS + MAX_OUTPUTS;
+
+	const float FLOOR_DB = -116.f;
+	const float CEILING_DB = 11.f;
+
+	const int HEADER_SIZE = 5;
+	const int MAX_PACKET_SIZE = HEADER_SIZE + 8 + ( MAX_SLOTS + 7 ) / 8 + MAX_SLOTS * 2;
+
+	enum Flags {
+		KEYFRAME = 1,
+		/** Codes are 16 bit */
+		WIDE = 2,
+		/** Delta without changes, the bitmask is left out */
+		UNCHANGED = 4
+	};
+
+	enum Precision {
+		/** 0.5 dB steps */
+		BITS_8,
+		/** 1/512 dB steps */
+		BITS_16
+	};
+
+	struct Settings {
+		Precision precision = BITS_8;
+		/** Slots are resent once they move by more than this, 0 sends every change of code */
+		float epsilonDb = 0.5f;
+		/** Frames between keyframes, 0 only sends them when needed */
+		int keyframeInterval = 100;
+	};
+
+	struct Frame {
+		long long timestampNs = 0;
+		bool keyframe = false;
+		/** Slots the packet carried */
+		int changed = 0;
+		int numInputs = 0;
+		int numOutputs = 0;
+		/** Linear, as VBVMR_GetLevel returns them */
+		float input[MAX_INPUTS] = {};
+		float output[MAX_OUTPUTS] = {};
+	};
+
+	/** Size of a dB step */
+	VBINTERFACE_EXPORT float stepDb( Precision precision );
+	/** Worst difference in dB between an encoded and a decoded level within FLOOR_DB and CEILING_DB */
+	VBINTERFACE_EXPORT float errorBoundDb( const Settings& settings );
+
+	class VBINTERFACE_EXPORT Encoder {
+	public:
+		explicit Encoder( const Settings& settings = Settings() );
+
+		/** Takes effect with a keyframe on the next frame */
+		void setSettings( const Settings& settings );
+		const Settings& getSettings() const;
+		/** Make the next frame a keyframe, e.g. when a receiver joins or lost packets */
+		void requestKeyframe();
+
+		/** Encode one sweep into out, which holds MAX_PACKET_SIZE bytes, returns the packet size or 0 if the counts are out of range */
+		int encode( const float* input, int numInputs, const float* output, int numOutputs, long long timestampNs, char* out );
+
+	private:
+		Settings settings;
+		int epsilonSteps = 0;
+		bool keyframePending = true;
+		int sinceKeyframe = 0;
+		unsigned short sequence = 0;
+		int numInputs = -1;
+		int numOutputs = -1;
+		/** Timestamp as the decoder reconstructs it */
+		long long timestampNs = 0;
+		/** Codes the decoder holds */
+		unsigned short sent[MAX_SLOTS] = {};
+	};
+
+	class VBINTERFACE_EXPORT Decoder {
+	public:
+		enum Result {
+			DECODED,
+			/** A delta whose base is missing, i.e. packets were lost, wait for a keyframe */
+			NEED_KEYFRAME,
+			MALFORMED
+		};
+
+		/** Decode a packet, frame holds every slot of the stream afterwards */
+		Result decode( const char* data, int size, Frame& frame );
+		/** Forget the stream, only a keyframe decodes next */
+		void reset();
+
+	private:
+		bool synced = false;
+		bool wide = false;
+		unsigned short sequence = 0;
+		int numInputs = 0;
+		int numOutputs = 0;
+		long long timestampNs = 0;
+		unsigned short codes[MAX_SLOTS] = {};
+	};
+
+	struct Benchmark_Result {
+		int frames = 0;
+		/** Average time per frame */
+		double encodeNs = 0;
+		double decodeNs = 0;
+		double bytesPerFrame = 0;
+		/** Size of the same frame as floats */
+		int rawBytesPerFrame = 0;
+		int keyframes = 0;
+		/** Worst error seen within FLOOR_DB and CEILING_DB, at most errorBoundDb give or take float rounding */
+		float maxErrorDb = 0;
+		float errorBoundDb = 0;
+	};
+
+	/** Encode and decode a synthetic stream of mostly steady levels, e.g. with a layout's numLevels */
+	VBINTERFACE_EXPORT Benchmark_Result benchmark( int numInputs, int numOutputs, int numFrames = 10000, const Settings& settings = Settings() );
+}
@@ -0,0 +1,243 @@
+#include "VBLevelDetector.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+# define VB_DETECTOR_SSE2 1
+# include <emmintrin.h>
+#else
+# define VB_DETECTOR_SSE2 0
+#endif
+
+namespace {
+	const float NEVER_ABOVE = std::numeric_limits<float>::infinity();
+	const float NEVER_BELOW = -std::numeric_limits<float>::infinity();
+
+	float dbToLinear( float db ) {
+		return std::pow( 10.f, db / 20.f );
+	}
+
+	float linearToDb( float level ) {
+		return level > 0 ? 20.f * std::log10( level ) : -200.f;
+	}
+
+	float peakOf( const float* levels, int count ) {
+#if VB_DETECTOR_SSE2
+		__m128 peak = _mm_setzero_ps();
+		int i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			peak = _mm_max_ps( peak, _mm_loadu_ps( levels + i ) );
+		}
+		peak = _mm_max_ps( peak, _mm_shuffle_ps( peak, peak, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		peak = _mm_max_ps( peak, _mm_shuffle_ps( peak, peak, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		float result = _mm_cvtss_f32( peak );
+#else
+		float result = 0;
+		int i = 0;
+#endif
+		for ( ; i < count; i++ ) {
+			result = levels[i] > result ? levels[i] : result;
+		}
+		return result;
+	}
+
+	/** Bit c set where peaks[c] > limits[c] */
+	unsigned greaterMask( const float* peaks, const float* limits ) {
+		unsigned mask = 0;
+#if VB_DETECTOR_SSE2
+		for ( int i = 0; i < VBLevelDetector::NUM_CHANNELS; i += 4 ) {
+			mask |= (unsigned) _mm_movemask_ps( _mm_cmpgt_ps( _mm_load_ps( peaks + i ), _mm_load_ps( limits + i ) ) ) << i;
+		}
+#else
+		for ( int i = 0; i < VBLevelDetector::NUM_CHANNELS; i++ ) {
+			mask |= (unsigned) ( peaks[i] > limits[i] ) << i;
+		}
+#endif
+		return mask;
+	}
+
+	/** Bit c set where peaks[c] < limits[c] */
+	unsigned lessMask( const float* peaks, const float* limits ) {
+		unsigned mask = 0;
+#if VB_DETECTOR_SSE2
+		for ( int i = 0; i < VBLevelDetector::NUM_CHANNELS; i += 4 ) {
+			mask |= (unsigned) _mm_movemask_ps( _mm_cmplt_ps( _mm_load_ps( peaks + i ), _mm_load_ps( limits + i ) ) ) << i;
+		}
+#else
+		for ( int i = 0; i < VBLevelDetector::NUM_CHANNELS; i++ ) {
+			mask |= (unsigned) ( peaks[i] < limits[i] ) << i;
+		}
+#endif
+		return mask;
+	}
+
+	int lowestBit( unsigned mask ) {
+		int bit = 0;
+		while ( ( mask & 1 ) == 0 ) {
+			mask >>= 1;
+			bit++;
+		}
+		return bit;
+	}
+}
+
+VBLevelDetector::VBLevelDetector() : version( 0 ), head( 0 ), tail( 0 ), lost( 0 ) {
+	clearRules();
+}
+
+void VBLevelDetector::setChannels( const Channel_Slots mapping[NUM_CHANNELS] ) {
+	std::lock_guard<std::mutex> lock( editMutex );
+	for ( int i = 0; i < NUM_CHANNELS; i++ ) {
+		editingChannels[i] = mapping[i];
+	}
+	publish();
+}
+
+void VBLevelDetector::setAboveRule( int channel, const Rule& rule ) {
+	if ( channel < 0 || channel >= NUM_CHANNELS ) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( editMutex );
+	editing.aboveOn[channel] = rule.enabled ? dbToLinear( rule.thresholdDb ) : NEVER_ABOVE;
+	editing.aboveOff[channel] = rule.enabled ? dbToLinear( rule.thresholdDb - rule.hysteresisDb ) : NEVER_ABOVE;
+	editing.aboveHoldNs[channel] = rule.holdMs * 1000000LL;
+	publish();
+}
+
+void VBLevelDetector::setBelowRule( int channel, const Rule& rule ) {
+	if ( channel < 0 || channel >= NUM_CHANNELS ) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( editMutex );
+	editing.belowOn[channel] = rule.enabled ? dbToLinear( rule.thresholdDb ) : NEVER_BELOW;
+	editing.belowOff[channel] = rule.enabled ? dbToLinear( rule.thresholdDb + rule.hysteresisDb ) : NEVER_BELOW;
+	editing.belowHoldNs[channel] = rule.holdMs * 1000000LL;
+	publish();
+}
+
+void VBLevelDetector::clearRules() {
+	std::lock_guard<std::mutex> lock( editMutex );
+	for ( int i = 0; i < NUM_CHANNELS; i++ ) {
+		editing.aboveOn[i] = NEVER_ABOVE;
+		editing.aboveOff[i] = NEVER_ABOVE;
+		editing.belowOn[i] = NEVER_BELOW;
+		editing.belowOff[i] = NEVER_BELOW;
+		editing.aboveHoldNs[i] = 0;
+		editing.belowHoldNs[i] = 0;
+	}
+	publish();
+}
+
+void VBLevelDetector::publish() {
+	// Odd while the shared copy is being written, process() keeps its old rules meanwhile
+	version.fetch_add( 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	shared = editing;
+	memcpy( sharedChannels, editingChannels, sizeof( sharedChannels ) );
+
+	version.fetch_add( 1, std::memory_order_release );
+}
+
+void VBLevelDetector::refreshRules() {
+	unsigned current = version.load( std::memory_order_acquire );
+	if ( current == seenVersion || ( current & 1 ) != 0 ) {
+		return;
+	}
+
+	Rule_Set copy = shared;
+	Channel_Slots copyChannels[NUM_CHANNELS];
+	memcpy( copyChannels, sharedChannels, sizeof( copyChannels ) );
+
+	std::atomic_thread_fence( std::memory_order_acquire );
+	if ( version.load( std::memory_order_relaxed ) != current ) {
+		return;
+	}
+
+	rules = copy;
+	memcpy( channels, copyChannels, sizeof( channels ) );
+	seenVersion = current;
+}
+
+void VBLevelDetector::process( const float* input, int numInputs, const float* output, int numOutputs, long long timestampNs ) {
+	refreshRules();
+
+	alignas( 16 ) float peaks[NUM_CHANNELS];
+	unsigned present = 0;
+
+	for ( int i = 0; i < NUM_CHANNELS; i++ ) {
+		const Channel_Slots& channel = channels[i];
+		const float* levels = channel.output ? output : input;
+		int available = channel.output ? numOutputs : numInputs;
+
+		if ( !channel.present || channel.first + channel.count > available ) {
+			peaks[i] = 0;
+			continue;
+		}
+
+		peaks[i] = peakOf( levels + channel.first, channel.count );
+		present |= 1u << i;
+	}
+
+	update( above, greaterMask( peaks, rules.aboveOn ) & present, lessMask( peaks, rules.aboveOff ) | ~present, rules.aboveHoldNs, peaks, timestampNs, ABOVE_START, ABOVE_END );
+	update( below, lessMask( peaks, rules.belowOn ) & present, greaterMask( peaks, rules.belowOff ) | ~present, rules.belowHoldNs, peaks, timestampNs, BELOW_START, BELOW_END );
+}
+
+void VBLevelDetector::update( Direction_State& state, unsigned on, unsigned off, const long long* holdNs, const float* peaks, long long timestampNs, Kind start, Kind end ) {
+	for ( unsigned ended = state.active & off; ended != 0; ended &= ended - 1 ) {
+		int channel = lowestBit( ended );
+		push( channel, end, peaks[channel], timestampNs );
+	}
+	state.active &= ~off;
+
+	// Waiting restarts whenever the condition lapses
+	unsigned started = on & ~state.active & ~state.pending;
+	for ( unsigned bits = started; bits != 0; bits &= bits - 1 ) {
+		state.since[lowestBit( bits )] = timestampNs;
+	}
+	state.pending = ( state.pending | started ) & on;
+
+	for ( unsigned bits = state.pending; bits != 0; bits &= bits - 1 ) {
+		int channel = lowestBit( bits );
+		if ( timestampNs - state.since[channel] >= holdNs[channel] ) {
+			push( channel, start, peaks[channel], timestampNs );
+			state.active |= 1u << channel;
+			state.pending &= ~( 1u << channel );
+		}
+	}
+}
+
+void VBLevelDetector::push( int channel, Kind kind, float peak, long long timestampNs ) {
+	unsigned position = head.load( std::memory_order_relaxed );
+	if ( position - tail.load( std::memory_order_acquire ) >= (unsigned) QUEUE_SIZE ) {
+		lost.fetch_add( 1, std::memory_order_relaxed );
+		return;
+	}
+
+	Event& event = queue[position % QUEUE_SIZE];
+	event.channel = (unsigned char) channel;
+	event.kind = (unsigned char) kind;
+	event.levelDb = linearToDb( peak );
+	event.timestampNs = timestampNs;
+
+	head.store( position + 1, std::memory_order_release );
+}
+
+bool VBLevelDetector::poll( Event& event ) {
+	unsigned position = tail.load( std::memory_order_relaxed );
+	if ( position == head.load( std::memory_order_acquire ) ) {
+		return false;
+	}
+
+	event = queue[position % QUEUE_SIZE];
+	tail.store( position + 1, std::memory_order_release );
+	return true;
+}
+
+unsigned long long VBLevelDetector::dropped() const {
+	return lost.load( std::memory_order_relaxed );
+}
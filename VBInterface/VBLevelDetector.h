@@ -0,0 +1,128 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <atomic>
+#include <mutex>
+
+/**
+* Level event detector
+*
+* Every channel has an ABOVE rule (clipping, loud) and a BELOW rule
+* (silence). A rule fires once the channel's peak has stayed past its
+* threshold for the hold time and ends once the peak comes back by more
+* than the hysteresis. All 16 channels are evaluated together with SIMD
+* compares, disabled rules use thresholds that never trigger, so a frame
+* costs the same whatever rules are set; only channels whose state changes
+* do scalar work.
+*
+* Rules can be edited from any thread while frames are processed, the
+* detector picks the new set up on its next frame. Events go through a
+* single producer single consumer queue: process() on one thread, poll()
+* on one other thread.
+*
+* This header does not depend on Qt.
+**/
+class VBINTERFACE_EXPORT VBLevelDetector {
+public:
+	/** Same numbering as VBInterface::Channel */
+	static const int NUM_CHANNELS = 16;
+	static const int QUEUE_SIZE = 1024;
+
+	enum Kind {
+		/** Peak went above the ABOVE threshold for its hold time */
+		ABOVE_START,
+		ABOVE_END,
+		/** Peak stayed below the BELOW threshold for its hold time */
+		BELOW_START,
+		BELOW_END
+	};
+
+	struct Event {
+		unsigned char channel;
+		unsigned char kind;
+		/** Peak in dB when the event fired */
+		float levelDb;
+		/** Timestamp of the frame that fired it */
+		long long timestampNs;
+	};
+
+	/** Where a channel's level slots are in a frame */
+	struct Channel_Slots {
+		bool present = false;
+		bool output = false;
+		int first = 0;
+		int count = 0;
+	};
+
+	struct Rule {
+		bool enabled = false;
+		float thresholdDb = 0;
+		float hysteresisDb = 3;
+		int holdMs = 0;
+	};
+
+	VBLevelDetector();
+
+	/** Map channels to level slots, see VBInterface::Layout */
+	void setChannels( const Channel_Slots channels[NUM_CHANNELS] );
+
+	/** Replace a rule, safe while another thread calls process() */
+	void setAboveRule( int channel, const Rule& rule );
+	void setBelowRule( int channel, const Rule& rule );
+	/** Disable every rule */
+	void clearRules();
+
+	/** Evaluate one level sweep, levels are linear as VBVMR_GetLevel returns them */
+	void process( const float* input, int numInputs, const float* output, int numOutputs, long long timestampNs );
+
+	/** Take the oldest event, false if there is none */
+	bool poll( Event& event );
+	/** Events lost because the queue was full */
+	unsigned long long dropped() const;
+
+private:
+	/** Rules as linear thresholds, structure of arrays for the SIMD compares */
+	struct Rule_Set {
+		alignas( 16 ) float aboveOn[NUM_CHANNELS];
+		alignas( 16 ) float aboveOff[NUM_CHANNELS];
+		alignas( 16 ) float belowOn[NUM_CHANNELS];
+		alignas( 16 ) float belowOff[NUM_CHANNELS];
+		long long aboveHoldNs[NUM_CHANNELS];
+		long long belowHoldNs[NUM_CHANNELS];
+	};
+
+	struct Direction_State {
+		/** Channels whose event fired and has not ended */
+		unsigned active = 0;
+		/** Channels past the threshold, waiting out the hold time */
+		unsigned pending = 0;
+		long long since[NUM_CHANNELS] = {};
+	};
+
+	// Written by editors under editMutex, published through the version seqlock
+	std::mutex editMutex;
+	std::atomic<unsigned> version;
+	Rule_Set shared;
+	Rule_Set editing;
+	Channel_Slots sharedChannels[NUM_CHANNELS];
+	Channel_Slots editingChannels[NUM_CHANNELS];
+
+	// Only touched by process()
+	unsigned seenVersion = ~0u;
+	Rule_Set rules;
+	Channel_Slots channels[NUM_CHANNELS];
+	Direction_State above;
+	Direction_State below;
+
+	// Single producer single consumer ring
+	Event queue[QUEUE_SIZE];
+	std::atomic<unsigned> head;
+	std::atomic<unsigned> tail;
+	std::atomic<unsigned long long> lost;
+
+	void publish();
+	void refreshRules();
+	void update( Direction_State& state, unsigned on, unsigned off, const long long* holdNs, const float* peaks, long long timestampNs, Kind start, Kind end );
+	void push( int channel, Kind kind, float peak, long long timestampNs );
+};
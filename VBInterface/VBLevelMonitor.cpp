@@ -0,0 +1,105 @@
+#include "VBLevelMonitor.h"
+
+#include <chrono>
+
+static_assert( VBLevelDetector::NUM_CHANNELS == VBInterface::NUM_CHANNELS, "Detector must cover every channel" );
+
+VBLevelMonitor::VBLevelMonitor( VBInterface* vb, QObject* parent ) : QObject( parent ), vb( vb ) {
+	job = vb->getScheduler().add( "level monitor", 20, 20, [this]() {
+		poll();
+		return false;
+	} );
+}
+
+VBLevelMonitor::~VBLevelMonitor() {
+	vb->getScheduler().remove( job );
+}
+
+VBLevelDetector& VBLevelMonitor::getDetector() {
+	return detector;
+}
+
+void VBLevelMonitor::start( int msecs ) {
+	vb->getScheduler().setIntervals( job, msecs, msecs );
+	vb->getScheduler().setEnabled( job, true );
+}
+
+void VBLevelMonitor::stop() {
+	vb->getScheduler().setEnabled( job, false );
+}
+
+bool VBLevelMonitor::isRunning() {
+	return vb->getScheduler().isEnabled( job );
+}
+
+void VBLevelMonitor::setInterval( int msecs ) {
+	vb->getScheduler().setIntervals( job, msecs, msecs );
+}
+
+void VBLevelMonitor::setInputTap( VBInterface::Level_Tap tap ) {
+	inputTap = tap == VBInterface::OUTPUT ? VBInterface::PRE_FADER : tap;
+}
+
+void VBLevelMonitor::setAboveRule( VBInterface::Channel channel, float thresholdDb, float hysteresisDb, int holdMs ) {
+	VBLevelDetector::Rule rule;
+	rule.enabled = true;
+	rule.thresholdDb = thresholdDb;
+	rule.hysteresisDb = hysteresisDb;
+	rule.holdMs = holdMs;
+	detector.setAboveRule( channel, rule );
+}
+
+void VBLevelMonitor::setBelowRule( VBInterface::Channel channel, float thresholdDb, float hysteresisDb, int holdMs ) {
+	VBLevelDetector::Rule rule;
+	rule.enabled = true;
+	rule.thresholdDb = thresholdDb;
+	rule.hysteresisDb = hysteresisDb;
+	rule.holdMs = holdMs;
+	detector.setBelowRule( channel, rule );
+}
+
+void VBLevelMonitor::removeAboveRule( VBInterface::Channel channel ) {
+	detector.setAboveRule( channel, VBLevelDetector::Rule() );
+}
+
+void VBLevelMonitor::removeBelowRule( VBInterface::Channel channel ) {
+	detector.setBelowRule( channel, VBLevelDetector::Rule() );
+}
+
+void VBLevelMonitor::clearRules() {
+	detector.clearRules();
+}
+
+void VBLevelMonitor::mapChannels() {
+	layout = &vb->getLayout();
+
+	VBLevelDetector::Channel_Slots mapping[VBLevelDetector::NUM_CHANNELS];
+	for ( int i = 0; i < VBInterface::NUM_CHANNELS; i++ ) {
+		const VBInterface::Channel_Info& info = layout->channels[i];
+		mapping[i].present = info.present;
+		mapping[i].output = info.output;
+		mapping[i].first = info.levelFirst;
+		mapping[i].count = info.levelCount;
+	}
+
+	detector.setChannels( mapping );
+}
+
+void VBLevelMonitor::poll() {
+	if ( !vb->isReady() ) {
+		return;
+	}
+
+	if ( layout != &vb->getLayout() ) {
+		mapChannels();
+	}
+
+	VBInterface::Level_Frame frame = vb->getLevelFrame( inputTap );
+	long long now = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	detector.process( frame.input, frame.numInputs, frame.output, frame.numOutputs, now );
+
+	VBLevelDetector::Event event;
+	while ( detector.poll( event ) ) {
+		emit levelEvent( (VBInterface::Channel) event.channel, (VBLevelDetector::Kind) event.kind, event.levelDb, event.timestampNs );
+	}
+}
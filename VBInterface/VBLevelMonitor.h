@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+
+#include "VBInterface.h"
+#include "VBLevelDetector.h"
+
+/**
+* Raises level events (clipping, silence, thresholds) for strips and buses
+*
+* Polls level frames from a VBInterface and runs them through a
+* VBLevelDetector, see there for how rules are evaluated.
+**/
+class VBINTERFACE_EXPORT VBLevelMonitor : public QObject {
+	Q_OBJECT
+
+public:
+	/** vb must outlive the monitor, polling runs on vb's scheduler */
+	VBLevelMonitor( VBInterface* vb, QObject* parent = nullptr );
+	~VBLevelMonitor();
+
+	/** Rules can be edited through the detector from any thread while the monitor runs */
+	VBLevelDetector& getDetector();
+
+public slots:
+	void start( int msecs = 20 );
+	void stop();
+	bool isRunning();
+	void setInterval( int msecs );
+	/** Tap strips are evaluated at, buses always use OUTPUT */
+	void setInputTap( VBInterface::Level_Tap tap );
+
+	/** Event while the channel's peak is above thresholdDb, e.g. -0.1 for clipping */
+	void setAboveRule( VBInterface::Channel channel, float thresholdDb, float hysteresisDb = 3, int holdMs = 0 );
+	/** Event while the channel's peak is below thresholdDb, e.g. -60 with a hold time for silence */
+	void setBelowRule( VBInterface::Channel channel, float thresholdDb, float hysteresisDb = 3, int holdMs = 0 );
+	void removeAboveRule( VBInterface::Channel channel );
+	void removeBelowRule( VBInterface::Channel channel );
+	void clearRules();
+
+signals:
+	/** timestampNs is std::chrono::steady_clock of the frame that fired the event */
+	void levelEvent( VBInterface::Channel channel, VBLevelDetector::Kind kind, float levelDb, qint64 timestampNs );
+
+private:
+	VBInterface* vb;
+	VBLevelDetector detector;
+	int job;
+	VBInterface::Level_Tap inputTap = VBInterface::PRE_FADER;
+	/** Layout the detector's channels were mapped from */
+	const VBInterface::Layout* layout = nullptr;
+
+	void mapChannels();
+	void poll();
+};
+
+Q_DECLARE_METATYPE( VBLevelDetector::Kind )
@@ -0,0 +1,72 @@
+#include "VBLevelPublisher.h"
+
+#include <QDebug>
+#include <cstring>
+
+namespace {
+	const int PUBLISH_INTERVAL = 20;
+}
+
+static_assert( VBLevelShm::MAX_INPUTS == MAX_INPUT_LEVELS, "Shared frame must hold every input level" );
+static_assert( VBLevelShm::MAX_OUTPUTS == MAX_OUTPUT_LEVELS, "Shared frame must hold every output level" );
+
+VBLevelPublisher::VBLevelPublisher( VBInterface* vb, QObject* parent ) : QObject( parent ), vb( vb ) {
+	job = vb->getScheduler().add( "level publisher", PUBLISH_INTERVAL, PUBLISH_INTERVAL, [this]() {
+		publish();
+		return false;
+	} );
+}
+
+VBLevelPublisher::~VBLevelPublisher() {
+	stop();
+	vb->getScheduler().remove( job );
+}
+
+bool VBLevelPublisher::start( QString name ) {
+	if ( !writer.create( name.toUtf8().constData() ) ) {
+		qCritical() << "Cannot create shared level segment" << name;
+		return false;
+	}
+
+	qInfo() << "Publishing levels on" << name;
+	vb->getScheduler().setEnabled( job, true );
+	return true;
+}
+
+void VBLevelPublisher::stop() {
+	vb->getScheduler().setEnabled( job, false );
+	writer.close();
+}
+
+bool VBLevelPublisher::isPublishing() {
+	return writer.isOpen();
+}
+
+void VBLevelPublisher::setInterval( int msecs ) {
+	vb->getScheduler().setIntervals( job, msecs, msecs );
+}
+
+void VBLevelPublisher::setInputTap( VBInterface::Level_Tap tap ) {
+	inputTap = tap;
+}
+
+void VBLevelPublisher::publish() {
+	if ( !vb->isReady() ) {
+		return;
+	}
+
+	VBInterface::Level_Frame levels = vb->getLevelFrame( inputTap );
+	if ( levels.numInputs == 0 && levels.numOutputs == 0 ) {
+		return;
+	}
+
+	VBLevelShm::Frame frame;
+	frame.voicemeeterType = (unsigned char) vb->getType();
+	frame.inputTap = (unsigned char) levels.inputTap;
+	frame.numInputs = (unsigned char) levels.numInputs;
+	frame.numOutputs = (unsigned char) levels.numOutputs;
+	memcpy( frame.input, levels.input, levels.numInputs * sizeof( float ) );
+	memcpy( frame.output, levels.output, levels.numOutputs * sizeof( float ) );
+
+	writer.publish( frame );
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QString>
+
+#include "VBInterface.h"
+#include "VBLevelShm.h"
+
+/** Polls level frames from a VBInterface and broadcasts them through shared memory, see VBLevelShm::Reader */
+class VBINTERFACE_EXPORT VBLevelPublisher : public QObject {
+	Q_OBJECT
+
+public:
+	/** vb must outlive the publisher, polling runs on vb's scheduler */
+	VBLevelPublisher( VBInterface* vb, QObject* parent = nullptr );
+	~VBLevelPublisher();
+
+public slots:
+	/** Create the segment and start publishing */
+	bool start( QString name = VBLevelShm::DEFAULT_NAME );
+	/** Stop publishing and remove the segment */
+	void stop();
+	bool isPublishing();
+	void setInterval( int msecs );
+	void setInputTap( VBInterface::Level_Tap tap );
+
+private:
+	VBInterface* vb;
+	VBLevelShm::Writer writer;
+	int job;
+	VBInterface::Level_Tap inputTap = VBInterface::PRE_FADER;
+
+	void publish();
+};
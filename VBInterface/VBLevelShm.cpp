@@ -0,0 +1,238 @@
+#include "VBLevelShm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	const int MAX_RETRIES = 4;
+
+	void segmentName( const char* name, char* out, size_t size ) {
+#ifdef _WIN32
+		snprintf( out, size, "Local\\%s", name );
+#else
+		snprintf( out, size, "/%s", name );
+#endif
+	}
+
+	void* mapSegment( const char* name, bool create, void** handle ) {
+		char path[160];
+		segmentName( name, path, sizeof( path ) );
+
+#ifdef _WIN32
+		HANDLE mapping = create
+			? CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof( VBLevelShm::Segment ), path )
+			: OpenFileMappingA( FILE_MAP_READ, FALSE, path );
+		if ( mapping == NULL ) {
+			return nullptr;
+		}
+
+		void* memory = MapViewOfFile( mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof( VBLevelShm::Segment ) );
+		if ( memory == NULL ) {
+			CloseHandle( mapping );
+			return nullptr;
+		}
+
+		*handle = mapping;
+		return memory;
+#else
+		int fd = create ? shm_open( path, O_RDWR | O_CREAT, 0644 ) : shm_open( path, O_RDONLY, 0 );
+		if ( fd < 0 ) {
+			return nullptr;
+		}
+
+		if ( create && ftruncate( fd, sizeof( VBLevelShm::Segment ) ) != 0 ) {
+			::close( fd );
+			return nullptr;
+		}
+
+		void* memory = mmap( nullptr, sizeof( VBLevelShm::Segment ), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+		::close( fd );
+		if ( memory == MAP_FAILED ) {
+			return nullptr;
+		}
+
+		*handle = nullptr;
+		return memory;
+#endif
+	}
+
+	void unmapSegment( const void* memory, void* handle ) {
+#ifdef _WIN32
+		UnmapViewOfFile( memory );
+		CloseHandle( (HANDLE) handle );
+#else
+		(void) handle;
+		munmap( const_cast<void*>( memory ), sizeof( VBLevelShm::Segment ) );
+#endif
+	}
+}
+
+namespace VBLevelShm {
+	Writer::~Writer() {
+		close();
+	}
+
+	bool Writer::create( const char* segmentName ) {
+		close();
+
+		void* memory = mapSegment( segmentName, true, &handle );
+		if ( memory == nullptr ) {
+			return false;
+		}
+
+		strncpy( name, segmentName, sizeof( name ) - 1 );
+
+		// Fresh header, readers check magic and version before trusting the slots
+		segment = new ( memory ) Segment;
+		segment->magic = 0;
+		segment->version = VERSION;
+		segment->numSlots = NUM_SLOTS;
+		segment->slotSize = sizeof( Slot );
+		segment->latest.store( 0, std::memory_order_relaxed );
+		for ( Slot& slot : segment->ring ) {
+			slot.guard.store( 0, std::memory_order_relaxed );
+		}
+		sequence = 0;
+
+		std::atomic_thread_fence( std::memory_order_release );
+		segment->magic = MAGIC;
+		return true;
+	}
+
+	void Writer::close() {
+		if ( segment == nullptr ) {
+			return;
+		}
+
+		segment->magic = 0;
+		unmapSegment( segment, handle );
+		segment = nullptr;
+		handle = nullptr;
+
+#ifndef _WIN32
+		char path[160];
+		segmentName( name, path, sizeof( path ) );
+		shm_unlink( path );
+#endif
+	}
+
+	bool Writer::isOpen() const {
+		return segment != nullptr;
+	}
+
+	void Writer::publish( const Frame& frame ) {
+		if ( segment == nullptr ) {
+			return;
+		}
+
+		sequence++;
+		Slot& slot = segment->ring[sequence % NUM_SLOTS];
+
+		slot.guard.store( sequence * 2 - 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+
+		slot.frame = frame;
+		slot.frame.sequence = sequence;
+		slot.frame.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+
+		slot.guard.store( sequence * 2, std::memory_order_release );
+		segment->latest.store( sequence, std::memory_order_release );
+	}
+
+	Reader::~Reader() {
+		close();
+	}
+
+	bool Reader::open( const char* name ) {
+		close();
+
+		void* memory = mapSegment( name, false, &handle );
+		if ( memory == nullptr ) {
+			return false;
+		}
+
+		segment = static_cast<const Segment*>( memory );
+		std::atomic_thread_fence( std::memory_order_acquire );
+
+		if ( segment->magic != MAGIC || segment->version != VERSION || segment->numSlots != NUM_SLOTS || segment->slotSize != sizeof( Slot ) ) {
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void Reader::close() {
+		if ( segment == nullptr ) {
+			return;
+		}
+
+		unmapSegment( segment, handle );
+		segment = nullptr;
+		handle = nullptr;
+	}
+
+	bool Reader::isOpen() const {
+		return segment != nullptr;
+	}
+
+	unsigned long long Reader::latestSequence() const {
+		return segment == nullptr ? 0 : segment->latest.load( std::memory_order_acquire );
+	}
+
+	bool Reader::latest( Frame& frame ) const {
+		// Bounded retries keep this wait-free, failing only if the writer laps us repeatedly
+		for ( int i = 0; i < MAX_RETRIES; i++ ) {
+			unsigned long long sequence = latestSequence();
+			if ( sequence == 0 ) {
+				return false;
+			}
+
+			if ( read( sequence, frame ) ) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool Reader::read( unsigned long long sequence, Frame& frame ) const {
+		if ( segment == nullptr || sequence == 0 ) {
+			return false;
+		}
+
+		const Slot& slot = segment->ring[sequence % NUM_SLOTS];
+
+		if ( slot.guard.load( std::memory_order_acquire ) != sequence * 2 ) {
+			return false;
+		}
+
+		memcpy( &frame, &slot.frame, sizeof( Frame ) );
+
+		std::atomic_thread_fence( std::memory_order_acquire );
+		return slot.guard.load( std::memory_order_relaxed ) == sequence * 2;
+	}
+
+	int Reader::history( Frame* frames, int count ) const {
+		unsigned long long sequence = latestSequence();
+		int copied = 0;
+
+		for ( int i = 0; i < count && i < NUM_SLOTS && sequence > (unsigned long long) i; i++ ) {
+			if ( read( sequence - i, frames[copied] ) ) {
+				copied++;
+			}
+		}
+
+		return copied;
+	}
+}
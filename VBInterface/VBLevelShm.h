@@ -0,0 +1,110 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBLayout.h"
+
+#include <atomic>
+
+/**
+* Shared-memory level broadcast
+*
+* One writer publishes level frames into a ring of slots in a named segment,
+* any number of readers in other processes copy them out without locks,
+* sockets or DLL calls. Each slot is guarded by its own sequence number
+* (seqlock), so a reader only retries if the writer laps it mid-copy.
+*
+* This header does not depend on Qt so readers can use it on their own.
+**/
+namespace VBLevelShm {
+	const char* const DEFAULT_NAME = "VBInterfaceLevels";
+
+	const int MAX_INPUTS = VBLayout::MAX_INPUT_SLOTS;
+	const int MAX_OUTPUTS = VBLayout::MAX_OUTPUT_SLOTS;
+
+	/** Frames kept for history() */
+	const int NUM_SLOTS = 64;
+
+	const unsigned MAGIC = 0x56424c56; // "VBLV"
+	const unsigned VERSION = 1;
+
+	struct Frame {
+		/** Increases by one per published frame, starts at 1 */
+		unsigned long long sequence = 0;
+		/** std::chrono::steady_clock nanoseconds, system wide monotonic */
+		long long timestampNs = 0;
+		/** Voicemeeter type of the publisher's layout */
+		unsigned char voicemeeterType = 0;
+		unsigned char inputTap = 0;
+		unsigned char numInputs = 0;
+		unsigned char numOutputs = 0;
+		float input[MAX_INPUTS] = {};
+		float output[MAX_OUTPUTS] = {};
+	};
+
+	static_assert( ATOMIC_LLONG_LOCK_FREE == 2, "Shared segment needs address-free atomics" );
+
+	struct Slot {
+		/** Odd while the writer fills the slot, 2 * frame sequence once complete */
+		std::atomic<unsigned long long> guard;
+		Frame frame;
+	};
+
+	struct Segment {
+		unsigned magic;
+		unsigned version;
+		unsigned numSlots;
+		unsigned slotSize;
+		/** Sequence of the newest complete frame, 0 before the first one */
+		std::atomic<unsigned long long> latest;
+		Slot ring[NUM_SLOTS];
+	};
+
+	/** Creates the segment and publishes frames into it, one per process */
+	class VBINTERFACE_EXPORT Writer {
+	public:
+		Writer() = default;
+		~Writer();
+		Writer( const Writer& ) = delete;
+		Writer& operator=( const Writer& ) = delete;
+
+		bool create( const char* name = DEFAULT_NAME );
+		void close();
+		bool isOpen() const;
+
+		/** Publish a frame, its sequence and timestamp are filled in */
+		void publish( const Frame& frame );
+
+	private:
+		Segment* segment = nullptr;
+		void* handle = nullptr;
+		char name[128] = {};
+		unsigned long long sequence = 0;
+	};
+
+	/** Attaches to a published segment, reads are wait-free */
+	class VBINTERFACE_EXPORT Reader {
+	public:
+		Reader() = default;
+		~Reader();
+		Reader( const Reader& ) = delete;
+		Reader& operator=( const Reader& ) = delete;
+
+		bool open( const char* name = DEFAULT_NAME );
+		void close();
+		bool isOpen() const;
+
+		/** Sequence of the newest frame, 0 if nothing was published yet */
+		unsigned long long latestSequence() const;
+		/** Copy the newest frame, false if there is none */
+		bool latest( Frame& frame ) const;
+		/** Copy a frame by sequence, false if it was overwritten or not published yet */
+		bool read( unsigned long long sequence, Frame& frame ) const;
+		/** Copy up to count of the newest frames, newest first, returns how many were copied */
+		int history( Frame* frames, int count ) const;
+
+	private:
+		const Segment* segment = nullptr;
+		void* handle = nullptr;
+	};
+}
@@ -0,0 +1,209 @@
+#include "VBMetrics.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+	const char* functionNames[VBMetrics::NUM_FUNCTIONS] = {
+		"VBVMR_Login",
+		"VBVMR_Logout",
+		"VBVMR_RunVoicemeeter",
+		"VBVMR_GetVoicemeeterType",
+		"VBVMR_GetVoicemeeterVersion",
+		"VBVMR_IsParametersDirty",
+		"VBVMR_GetParameterFloat",
+		"VBVMR_GetParameterStringA",
+		"VBVMR_GetParameterStringW",
+		"VBVMR_GetLevel",
+		"VBVMR_GetMidiMessage",
+		"VBVMR_SetParameterFloat",
+		"VBVMR_SetParameters",
+		"VBVMR_SetParametersW",
+		"VBVMR_SetParameterStringA",
+		"VBVMR_SetParameterStringW",
+		"VBVMR_Output_GetDeviceNumber",
+		"VBVMR_Output_GetDeviceDescA",
+		"VBVMR_Output_GetDeviceDescW",
+		"VBVMR_Input_GetDeviceNumber",
+		"VBVMR_Input_GetDeviceDescA",
+		"VBVMR_Input_GetDeviceDescW",
+		"VBVMR_AudioCallbackRegister",
+		"VBVMR_AudioCallbackStart",
+		"VBVMR_AudioCallbackStop",
+		"VBVMR_AudioCallbackUnregister",
+		"waitForClean"
+	};
+
+	int highestBit( unsigned long long value ) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64( &index, value );
+		return (int) index;
+#else
+		return 63 - __builtin_clzll( value );
+#endif
+	}
+}
+
+namespace VBMetrics {
+	const char* functionName( Function function ) {
+		if ( function < 0 || function >= NUM_FUNCTIONS ) {
+			return "";
+		}
+
+		return functionNames[function];
+	}
+
+	int bucketFor( unsigned long long ns ) {
+		// Values below SUB_BUCKETS are counted exactly
+		if ( ns < (unsigned long long) SUB_BUCKETS ) {
+			return (int) ns;
+		}
+
+		int exponent = highestBit( ns );
+		if ( exponent >= MAX_EXPONENT ) {
+			return NUM_BUCKETS - 1;
+		}
+
+		int sub = (int) ( ns >> ( exponent - SUB_BUCKET_BITS ) ) & ( SUB_BUCKETS - 1 );
+		return ( exponent - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS + sub;
+	}
+
+	unsigned long long bucketLowerBound( int bucket ) {
+		if ( bucket < SUB_BUCKETS ) {
+			return (unsigned long long) bucket;
+		}
+
+		int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+		unsigned long long sub = (unsigned long long) ( bucket % SUB_BUCKETS );
+		return ( SUB_BUCKETS + sub ) << ( exponent - SUB_BUCKET_BITS );
+	}
+
+	unsigned long long Function_Metrics::percentile( double p ) const {
+		if ( calls == 0 ) {
+			return 0;
+		}
+
+		unsigned long long target = (unsigned long long) ( p / 100.0 * calls + 0.5 );
+		if ( target < 1 ) {
+			target = 1;
+		}
+
+		unsigned long long seen = 0;
+		for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+			seen += histogram[i];
+			if ( seen >= target ) {
+				return i + 1 < NUM_BUCKETS ? bucketLowerBound( i + 1 ) - 1 : bucketLowerBound( i );
+			}
+		}
+
+		return bucketLowerBound( NUM_BUCKETS - 1 );
+	}
+
+	unsigned long long Function_Metrics::meanNs() const {
+		return calls == 0 ? 0 : totalNs / calls;
+	}
+}
+
+#if VB_METRICS_ENABLED
+
+namespace {
+	struct Counters {
+		std::atomic<unsigned long long> calls;
+		std::atomic<unsigned long long> totalNs;
+		std::atomic<unsigned long long> errors[VBMetrics::NUM_ERROR_CODES + 1];
+		std::atomic<unsigned long long> histogram[VBMetrics::NUM_BUCKETS];
+	};
+
+	// Each thread writes to its own shard, padded so shards never share a cache line
+	struct alignas( 64 ) Shard {
+		Counters functions[VBMetrics::NUM_FUNCTIONS];
+		std::atomic<unsigned long long> allocations;
+	};
+
+	Shard shards[VBMetrics::NUM_SHARDS];
+	std::atomic<unsigned> nextShard( 0 );
+
+	Shard& localShard() {
+		thread_local Shard& shard = shards[nextShard.fetch_add( 1, std::memory_order_relaxed ) % VBMetrics::NUM_SHARDS];
+		return shard;
+	}
+
+	int errorSlot( long result ) {
+		if ( result > 0 ) {
+			return 0;
+		}
+
+		return -result > VBMetrics::NUM_ERROR_CODES ? VBMetrics::NUM_ERROR_CODES : (int) -result;
+	}
+}
+
+namespace VBMetrics {
+	void record( Function function, unsigned long long ns, long result ) {
+		Counters& counters = localShard().functions[function];
+
+		counters.calls.fetch_add( 1, std::memory_order_relaxed );
+		counters.totalNs.fetch_add( ns, std::memory_order_relaxed );
+		counters.histogram[bucketFor( ns )].fetch_add( 1, std::memory_order_relaxed );
+
+		// Device counts are positive, only SetParameters reports failures above zero
+		if ( result < 0 || ( result > 0 && ( function == SET_PARAMETERS || function == SET_PARAMETERS_W ) ) ) {
+			counters.errors[errorSlot( result )].fetch_add( 1, std::memory_order_relaxed );
+		}
+	}
+
+	void countAllocation() {
+		localShard().allocations.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	Snapshot snapshot() {
+		Snapshot snap;
+
+		for ( int f = 0; f < NUM_FUNCTIONS; f++ ) {
+			Function_Metrics& metrics = snap.functions[f];
+			metrics.name = functionNames[f];
+
+			for ( const Shard& shard : shards ) {
+				const Counters& counters = shard.functions[f];
+				metrics.calls += counters.calls.load( std::memory_order_relaxed );
+				metrics.totalNs += counters.totalNs.load( std::memory_order_relaxed );
+
+				for ( int e = 0; e <= NUM_ERROR_CODES; e++ ) {
+					metrics.errors[e] += counters.errors[e].load( std::memory_order_relaxed );
+				}
+
+				for ( int b = 0; b < NUM_BUCKETS; b++ ) {
+					metrics.histogram[b] += counters.histogram[b].load( std::memory_order_relaxed );
+				}
+			}
+		}
+
+		for ( const Shard& shard : shards ) {
+			snap.allocations += shard.allocations.load( std::memory_order_relaxed );
+		}
+
+		return snap;
+	}
+
+	void reset() {
+		for ( Shard& shard : shards ) {
+			for ( Counters& counters : shard.functions ) {
+				counters.calls.store( 0, std::memory_order_relaxed );
+				counters.totalNs.store( 0, std::memory_order_relaxed );
+
+				for ( auto& error : counters.errors ) {
+					error.store( 0, std::memory_order_relaxed );
+				}
+
+				for ( auto& bucket : counters.histogram ) {
+					bucket.store( 0, std::memory_order_relaxed );
+				}
+			}
+
+			shard.allocations.store( 0, std::memory_order_relaxed );
+		}
+	}
+}
+
+#endif
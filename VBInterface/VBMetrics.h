@@ -0,0 +1,119 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <atomic>
+#include <chrono>
+
+// Define VBINTERFACE_NO_METRICS to compile all instrumentation out
+#ifndef VBINTERFACE_NO_METRICS
+# define VB_METRICS_ENABLED 1
+#else
+# define VB_METRICS_ENABLED 0
+#endif
+
+namespace VBMetrics {
+	/** Timed operations, the VBVMR_* functions in T_VBVMR_INTERFACE order followed by internal waits */
+	enum Function {
+		LOGIN,
+		LOGOUT,
+		RUN_VOICEMEETER,
+		GET_VOICEMEETER_TYPE,
+		GET_VOICEMEETER_VERSION,
+		IS_PARAMETERS_DIRTY,
+		GET_PARAMETER_FLOAT,
+		GET_PARAMETER_STRING_A,
+		GET_PARAMETER_STRING_W,
+		GET_LEVEL,
+		GET_MIDI_MESSAGE,
+		SET_PARAMETER_FLOAT,
+		SET_PARAMETERS,
+		SET_PARAMETERS_W,
+		SET_PARAMETER_STRING_A,
+		SET_PARAMETER_STRING_W,
+		OUTPUT_GET_DEVICE_NUMBER,
+		OUTPUT_GET_DEVICE_DESC_A,
+		OUTPUT_GET_DEVICE_DESC_W,
+		INPUT_GET_DEVICE_NUMBER,
+		INPUT_GET_DEVICE_DESC_A,
+		INPUT_GET_DEVICE_DESC_W,
+		AUDIO_CALLBACK_REGISTER,
+		AUDIO_CALLBACK_START,
+		AUDIO_CALLBACK_STOP,
+		AUDIO_CALLBACK_UNREGISTER,
+		NUM_DLL_FUNCTIONS,
+
+		/** Time spent in waitForClean() */
+		WAIT_FOR_CLEAN = NUM_DLL_FUNCTIONS,
+		NUM_FUNCTIONS
+	};
+
+	// Log-linear histogram, 8 sub-buckets per power of two (12.5% precision) up to ~17s
+	const int SUB_BUCKET_BITS = 3;
+	const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	const int MAX_EXPONENT = 34;
+	const int NUM_BUCKETS = ( MAX_EXPONENT - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS;
+
+	/** Slot 0 counts positive failures (script error lines), slot n counts return code -n */
+	const int NUM_ERROR_CODES = 8;
+
+	const int NUM_SHARDS = 8;
+
+	struct VBINTERFACE_EXPORT Function_Metrics {
+		const char* name = "";
+		unsigned long long calls = 0;
+		unsigned long long totalNs = 0;
+		unsigned long long errors[NUM_ERROR_CODES + 1] = {};
+		unsigned long long histogram[NUM_BUCKETS] = {};
+
+		/** Approximate latency at percentile p (0-100) in nanoseconds */
+		unsigned long long percentile( double p ) const;
+		unsigned long long meanNs() const;
+	};
+
+	struct VBINTERFACE_EXPORT Snapshot {
+		bool enabled = VB_METRICS_ENABLED;
+		Function_Metrics functions[NUM_FUNCTIONS];
+		/** Heap allocations made by the library on behalf of callers */
+		unsigned long long allocations = 0;
+	};
+
+	VBINTERFACE_EXPORT const char* functionName( Function function );
+	VBINTERFACE_EXPORT int bucketFor( unsigned long long ns );
+	/** Lowest value counted in a bucket */
+	VBINTERFACE_EXPORT unsigned long long bucketLowerBound( int bucket );
+
+#if VB_METRICS_ENABLED
+	VBINTERFACE_EXPORT void record( Function function, unsigned long long ns, long result );
+	VBINTERFACE_EXPORT void countAllocation();
+	VBINTERFACE_EXPORT Snapshot snapshot();
+	VBINTERFACE_EXPORT void reset();
+
+	/** Time a call and record its result */
+	template<typename Call>
+	inline long timed( Function function, Call call ) {
+		auto start = std::chrono::steady_clock::now();
+		long result = call();
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+		record( function, (unsigned long long) ns, result );
+		return result;
+	}
+#else
+	inline void record( Function, unsigned long long, long ) {}
+	inline void countAllocation() {}
+	inline Snapshot snapshot() { return Snapshot(); }
+	inline void reset() {}
+
+	template<typename Call>
+	inline long timed( Function, Call call ) {
+		return call();
+	}
+#endif
+}
+
+/** Count and time a VBVMR_* call, see VB_CALL in VBTrace.h */
+#if VB_METRICS_ENABLED
+# define VB_METRICS_CALL( function, call ) VBMetrics::timed( VBMetrics::function, [&]() -> long { return (long) ( call ); } )
+#else
+# define VB_METRICS_CALL( function, call ) ( (long) ( call ) )
+#endif
@@ -0,0 +1,296 @@
+#include "VBOsc.h"
+
+#include <cstring>
+
+namespace {
+	int padded( int length ) {
+		return ( length + 3 ) & ~3;
+	}
+
+	/** Length of a NUL terminated, 4 byte padded string at data, -1 if it overruns end */
+	int stringSize( const char* data, const char* end, int& length ) {
+		const char* nul = static_cast<const char*>( memchr( data, 0, end - data ) );
+		if ( nul == nullptr ) {
+			return -1;
+		}
+
+		length = (int) ( nul - data );
+		int size = padded( length + 1 );
+		return size <= end - data ? size : -1;
+	}
+
+	unsigned readUInt( const char* data ) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>( data );
+		return ( (unsigned) bytes[0] << 24 ) | ( (unsigned) bytes[1] << 16 ) | ( (unsigned) bytes[2] << 8 ) | bytes[3];
+	}
+
+	unsigned long long readULong( const char* data ) {
+		return ( (unsigned long long) readUInt( data ) << 32 ) | readUInt( data + 4 );
+	}
+
+	void writeUInt( char* data, unsigned value ) {
+		data[0] = (char) ( value >> 24 );
+		data[1] = (char) ( value >> 16 );
+		data[2] = (char) ( value >> 8 );
+		data[3] = (char) value;
+	}
+}
+
+namespace VBOsc {
+	int readInt( const char* data ) {
+		return (int) readUInt( data );
+	}
+
+	bool isBundle( const char* data, int size ) {
+		return size >= 16 && memcmp( data, "#bundle", 8 ) == 0;
+	}
+
+	bool parseMessage( const char* data, int size, Message& message ) {
+		const char* end = data + size;
+		if ( size < 4 || size % 4 != 0 || data[0] != '/' ) {
+			return false;
+		}
+
+		int addressLength;
+		int addressSize = stringSize( data, end, addressLength );
+		if ( addressSize < 0 ) {
+			return false;
+		}
+
+		message.address = data;
+		message.addressLength = addressLength;
+		message.end = end;
+
+		// Type tags are optional in OSC 1.0, a message without them has no arguments
+		const char* tags = data + addressSize;
+		if ( tags == end || *tags != ',' ) {
+			message.types = "";
+			message.numArgs = 0;
+			message.args = tags;
+			return true;
+		}
+
+		int tagsLength;
+		int tagsSize = stringSize( tags, end, tagsLength );
+		if ( tagsSize < 0 ) {
+			return false;
+		}
+
+		message.types = tags + 1;
+		message.numArgs = tagsLength - 1;
+		message.args = tags + tagsSize;
+		return true;
+	}
+
+	bool addressIs( const Message& message, const char* address ) {
+		return strncmp( message.address, address, message.addressLength ) == 0 && address[message.addressLength] == 0;
+	}
+
+	Argument_Reader::Argument_Reader( const Message& message ) : message( message ), pos( message.args ) {}
+
+	char Argument_Reader::type() const {
+		return valid && index < message.numArgs ? message.types[index] : 0;
+	}
+
+	bool Argument_Reader::atEnd() const {
+		return type() == 0;
+	}
+
+	bool Argument_Reader::getFloat( float& value ) {
+		int size;
+		switch ( type() ) {
+			case 'i': size = 4; break;
+			case 'f': size = 4; break;
+			case 'h': size = 8; break;
+			case 'd': size = 8; break;
+			case 'T': value = 1; index++; return true;
+			case 'F': value = 0; index++; return true;
+			default: return false;
+		}
+
+		if ( message.end - pos < size ) {
+			valid = false;
+			return false;
+		}
+
+		switch ( type() ) {
+			case 'i':
+				value = (float) readInt( pos );
+				break;
+			case 'f': {
+				unsigned bits = readUInt( pos );
+				memcpy( &value, &bits, sizeof( value ) );
+				break;
+			}
+			case 'h':
+				value = (float) (long long) readULong( pos );
+				break;
+			case 'd': {
+				unsigned long long bits = readULong( pos );
+				double number;
+				memcpy( &number, &bits, sizeof( number ) );
+				value = (float) number;
+				break;
+			}
+		}
+
+		pos += size;
+		index++;
+		return true;
+	}
+
+	bool Argument_Reader::getString( const char*& value, int& length ) {
+		if ( type() != 's' && type() != 'S' ) {
+			return false;
+		}
+
+		int size = stringSize( pos, message.end, length );
+		if ( size < 0 ) {
+			valid = false;
+			return false;
+		}
+
+		value = pos;
+		pos += size;
+		index++;
+		return true;
+	}
+
+	bool Argument_Reader::getBlob( const char*& data, int& length ) {
+		if ( type() != 'b' ) {
+			return false;
+		}
+
+		if ( message.end - pos < 4 ) {
+			valid = false;
+			return false;
+		}
+
+		length = readInt( pos );
+		if ( length < 0 || padded( length ) > message.end - pos - 4 ) {
+			valid = false;
+			return false;
+		}
+
+		data = pos + 4;
+		pos += 4 + padded( length );
+		index++;
+		return true;
+	}
+
+	bool Argument_Reader::skip() {
+		float number;
+		const char* data;
+		int length;
+
+		switch ( type() ) {
+			case 0:
+				return false;
+			case 's':
+			case 'S':
+				return getString( data, length );
+			case 'b':
+				return getBlob( data, length );
+			case 'i':
+			case 'f':
+			case 'h':
+			case 'd':
+			case 'T':
+			case 'F':
+				return getFloat( number );
+			case 'c':
+			case 'r':
+			case 'm':
+				if ( message.end - pos < 4 ) {
+					valid = false;
+					return false;
+				}
+				pos += 4;
+				break;
+			case 't':
+				if ( message.end - pos < 8 ) {
+					valid = false;
+					return false;
+				}
+				pos += 8;
+				break;
+			case 'N':
+			case 'I':
+				break;
+			default:
+				// Unknown type, its size can't be known
+				valid = false;
+				return false;
+		}
+
+		index++;
+		return true;
+	}
+
+	Writer::Writer( char* buffer, int capacity ) : buffer( buffer ), capacity( capacity ) {}
+
+	void Writer::begin( const char* address, const char* types ) {
+		pos = 0;
+		valid = true;
+
+		putRaw( address, (int) strlen( address ) );
+		putRaw( "", 1 );
+		pad();
+		putRaw( ",", 1 );
+		putRaw( types, (int) strlen( types ) );
+		putRaw( "", 1 );
+		pad();
+	}
+
+	void Writer::putInt( int value ) {
+		if ( reserve( 4 ) ) {
+			writeUInt( buffer + pos, (unsigned) value );
+			pos += 4;
+		}
+	}
+
+	void Writer::putFloat( float value ) {
+		unsigned bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		putInt( (int) bits );
+	}
+
+	void Writer::putString( const char* value, int length ) {
+		putRaw( value, length );
+		putRaw( "", 1 );
+		pad();
+	}
+
+	void Writer::putFloatBlob( const float* values, int count ) {
+		putInt( count * 4 );
+		for ( int i = 0; i < count; i++ ) {
+			putFloat( values[i] );
+		}
+	}
+
+	int Writer::size() const {
+		return valid ? pos : 0;
+	}
+
+	bool Writer::reserve( int bytes ) {
+		if ( !valid || capacity - pos < bytes ) {
+			valid = false;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Writer::putRaw( const char* data, int length ) {
+		if ( reserve( length ) ) {
+			memcpy( buffer + pos, data, length );
+			pos += length;
+		}
+	}
+
+	void Writer::pad() {
+		while ( valid && pos % 4 != 0 ) {
+			putRaw( "", 1 );
+		}
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+/**
+* Minimal OSC 1.0 codec
+*
+* Parsing works in place on the receive buffer, messages and arguments are
+* views into it so nothing is copied or allocated. Writing goes into a
+* caller owned buffer. Values are big-endian on the wire as OSC requires.
+*
+* This header does not depend on Qt.
+**/
+namespace VBOsc {
+	/** Nested bundles deeper than this are rejected */
+	const int MAX_BUNDLE_DEPTH = 8;
+
+	struct Message {
+		/** Address pattern, NUL terminated inside the packet */
+		const char* address = nullptr;
+		int addressLength = 0;
+		/** Type tags without the leading ',' */
+		const char* types = nullptr;
+		int numArgs = 0;
+		const char* args = nullptr;
+		const char* end = nullptr;
+	};
+
+	/** Walks the arguments of a message in order */
+	class VBINTERFACE_EXPORT Argument_Reader {
+	public:
+		explicit Argument_Reader( const Message& message );
+
+		/** Type tag of the next argument, 0 once exhausted or malformed */
+		char type() const;
+		bool atEnd() const;
+
+		/** Read i, f, h, d, T or F as a float */
+		bool getFloat( float& value );
+		/** Read an s or S argument */
+		bool getString( const char*& value, int& length );
+		/** Read a b argument */
+		bool getBlob( const char*& data, int& length );
+		/** Skip any argument */
+		bool skip();
+
+	private:
+		const Message& message;
+		const char* pos;
+		int index = 0;
+		bool valid = true;
+	};
+
+	/** Parse one message, false if it is malformed */
+	VBINTERFACE_EXPORT bool parseMessage( const char* data, int size, Message& message );
+
+	/** True if data holds a bundle rather than a single message */
+	VBINTERFACE_EXPORT bool isBundle( const char* data, int size );
+
+	/** Returns true if the address equals the NUL terminated string */
+	VBINTERFACE_EXPORT bool addressIs( const Message& message, const char* address );
+
+	/** Call fn( const Message& ) for every message in a packet, recursing into bundles, false if malformed */
+	template<typename F>
+	bool forEachMessage( const char* data, int size, F&& fn, int depth = 0 );
+
+	/** Builds a message into a fixed buffer, size() is 0 if it overflowed */
+	class VBINTERFACE_EXPORT Writer {
+	public:
+		Writer( char* buffer, int capacity );
+
+		/** Start a message, types is the tag string without ',' */
+		void begin( const char* address, const char* types );
+		void putInt( int value );
+		void putFloat( float value );
+		void putString( const char* value, int length );
+		/** Blob of big-endian float32 values */
+		void putFloatBlob( const float* values, int count );
+
+		int size() const;
+
+	private:
+		char* buffer;
+		int capacity;
+		int pos = 0;
+		bool valid = true;
+
+		bool reserve( int bytes );
+		void putRaw( const char* data, int length );
+		void pad();
+	};
+
+	// Implementation details used by forEachMessage
+
+	/** Big-endian int32 at data */
+	VBINTERFACE_EXPORT int readInt( const char* data );
+
+	template<typename F>
+	bool forEachMessage( const char* data, int size, F&& fn, int depth ) {
+		if ( !isBundle( data, size ) ) {
+			Message message;
+			if ( !parseMessage( data, size, message ) ) {
+				return false;
+			}
+
+			fn( static_cast<const Message&>( message ) );
+			return true;
+		}
+
+		if ( depth >= MAX_BUNDLE_DEPTH ) {
+			return false;
+		}
+
+		// "#bundle\0" and the 8 byte time tag, then size prefixed elements
+		int pos = 16;
+		while ( pos < size ) {
+			if ( size - pos < 4 ) {
+				return false;
+			}
+
+			int length = readInt( data + pos );
+			pos += 4;
+			if ( length < 0 || length > size - pos || length % 4 != 0 ) {
+				return false;
+			}
+
+			if ( !forEachMessage( data + pos, length, fn, depth + 1 ) ) {
+				return false;
+			}
+			pos += length;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,286 @@
+#include "VBOscBridge.h"
+
+#include <QDebug>
+#include <cstring>
+
+namespace {
+	const int METER_INTERVAL = 50;
+	/** Least time between warnings about dropped messages */
+	const int WARNING_INTERVAL = 10000;
+
+	struct Param_Info {
+		const char* address;
+		const char* req;
+		bool strip;
+		bool bus;
+		/** Boolean parameter, values are snapped to 0 or 1 */
+		bool toggle;
+	};
+
+	// Same order as VBOscBridge::Param, names spelled as VBInterface spells them so both share the core's cache entries
+	const Param_Info params[] = {
+		{ "gain", "gain", true, true, false },
+		{ "mute", "mute", true, true, true },
+		{ "solo", "solo", true, false, true },
+		{ "mono", "mono", true, true, true },
+		{ "eq", "eq.on", false, true, true },
+		{ "a1", "A1", true, false, true },
+		{ "a2", "A2", true, false, true },
+		{ "a3", "A3", true, false, true },
+		{ "a4", "A4", true, false, true },
+		{ "a5", "A5", true, false, true },
+		{ "b1", "B1", true, false, true },
+		{ "b2", "B2", true, false, true },
+		{ "b3", "B3", true, false, true },
+	};
+
+	/** A buses are the physical ones, B buses follow them, as in VBInterface::routeName() */
+	int physicalBusCount( const VBInterface::Layout& layout ) {
+		int count = 0;
+		while ( count < layout.numBuses && layout.channels[VBInterface::BUS1 + count].physical ) {
+			count++;
+		}
+		return count;
+	}
+
+	/** Matches prefix at pos and advances past it */
+	bool consume( const char*& pos, const char* end, const char* prefix ) {
+		size_t length = strlen( prefix );
+		if ( (size_t) ( end - pos ) < length || memcmp( pos, prefix, length ) != 0 ) {
+			return false;
+		}
+
+		pos += length;
+		return true;
+	}
+}
+
+VBOscBridge::VBOscBridge( VBInterface* vb, QObject* parent ) : QObject( parent ), vb( vb ) {
+	static_assert( sizeof( params ) / sizeof( params[0] ) == NUM_PARAMS, "Every Param needs an entry" );
+	static_assert( MAX_STRIPS == MAX_BUSES, "reqs assumes as many strips as buses" );
+
+	for ( int i = 0; i < MAX_STRIPS; i++ ) {
+		for ( int p = 0; p < NUM_PARAMS; p++ ) {
+			reqs[0][i][p] = QString( "Strip[%1].%2" ).arg( i ).arg( params[p].req );
+			reqs[1][i][p] = QString( "Bus[%1].%2" ).arg( i ).arg( params[p].req );
+		}
+	}
+
+	meterInterval = METER_INTERVAL;
+	meterJob = vb->getScheduler().add( "osc meters", METER_INTERVAL, METER_INTERVAL, [this]() {
+		sendLevels();
+		return false;
+	} );
+
+	QObject::connect( &socket, &QUdpSocket::readyRead, this, &VBOscBridge::onReadyRead );
+}
+
+VBOscBridge::~VBOscBridge() {
+	close();
+	vb->getScheduler().remove( meterJob );
+}
+
+bool VBOscBridge::listen( quint16 port, QHostAddress address ) {
+	close();
+
+	if ( !socket.bind( address, port ) ) {
+		qCritical() << "Cannot listen for OSC on" << address.toString() << port << socket.errorString();
+		return false;
+	}
+
+	qInfo() << "Listening for OSC on" << address.toString() << port;
+	updateMetering();
+	return true;
+}
+
+void VBOscBridge::close() {
+	socket.close();
+	vb->getScheduler().setEnabled( meterJob, false );
+}
+
+bool VBOscBridge::isListening() {
+	return socket.state() == QAbstractSocket::BoundState;
+}
+
+void VBOscBridge::setMeterTarget( QHostAddress address, quint16 port ) {
+	meterAddress = address;
+	meterPort = port;
+	updateMetering();
+}
+
+void VBOscBridge::setMeterInterval( int msecs ) {
+	meterInterval = msecs;
+	if ( msecs > 0 ) {
+		vb->getScheduler().setIntervals( meterJob, msecs, msecs );
+	}
+	updateMetering();
+}
+
+void VBOscBridge::setMeterTap( VBInterface::Level_Tap tap ) {
+	meterTap = tap;
+}
+
+void VBOscBridge::onReadyRead() {
+	while ( socket.hasPendingDatagrams() ) {
+		qint64 size = socket.pendingDatagramSize();
+		if ( size < 0 ) {
+			break;
+		}
+
+		// Only grows, resize() keeps the capacity once it is large enough
+		receiveBuffer.resize( (int) size );
+		size = socket.readDatagram( receiveBuffer.data(), size, &sender, &senderPort );
+		if ( size < 0 ) {
+			break;
+		}
+
+		bool valid = VBOsc::forEachMessage( receiveBuffer.constData(), (int) size, [this]( const VBOsc::Message& message ) {
+			handle( message );
+		} );
+
+		if ( !valid ) {
+			totals.malformedPackets++;
+			dropped( "malformed packet", "" );
+		}
+	}
+
+	flushWrites();
+}
+
+void VBOscBridge::handle( const VBOsc::Message& message ) {
+	VBInterface::Channel channel;
+	Param param;
+	totals.messages++;
+	if ( !resolve( message, channel, param ) ) {
+		totals.unknownAddresses++;
+		dropped( "unknown address", message.address );
+		return;
+	}
+
+	bool isBus = channel >= VBInterface::BUS1;
+	const QString& req = reqs[isBus][channel - ( isBus ? VBInterface::BUS1 : VBInterface::STRIP1 )][param];
+
+	VBOsc::Argument_Reader args( message );
+
+	// No value, answer with the current one
+	if ( args.atEnd() ) {
+		flushWrites();
+
+		VBOsc::Writer writer( sendBuffer, sizeof( sendBuffer ) );
+		writer.begin( message.address, "f" );
+		writer.putFloat( vb->readFloat( req ) );
+		if ( writer.size() > 0 ) {
+			socket.writeDatagram( sendBuffer, writer.size(), sender, senderPort );
+		}
+		return;
+	}
+
+	float value;
+	if ( !args.getFloat( value ) ) {
+		totals.badArguments++;
+		dropped( "value that is not a number for", message.address );
+		return;
+	}
+
+	if ( params[param].toggle ) {
+		value = value >= 0.5f ? 1.0f : 0.0f;
+	}
+
+	writes.setFloat( req, value );
+}
+
+bool VBOscBridge::resolve( const VBOsc::Message& message, VBInterface::Channel& channel, Param& param ) {
+	const char* pos = message.address;
+	const char* end = message.address + message.addressLength;
+
+	bool isBus;
+	if ( consume( pos, end, "/strip/" ) ) {
+		isBus = false;
+	} else if ( consume( pos, end, "/bus/" ) ) {
+		isBus = true;
+	} else {
+		return false;
+	}
+
+	if ( end - pos < 2 || pos[0] < '0' || pos[0] >= '0' + MAX_STRIPS || pos[1] != '/' ) {
+		return false;
+	}
+
+	int index = pos[0] - '0';
+	pos += 2;
+
+	channel = (VBInterface::Channel) ( ( isBus ? VBInterface::BUS1 : VBInterface::STRIP1 ) + index );
+	if ( !vb->hasChannel( channel ) ) {
+		return false;
+	}
+
+	int p = 0;
+	for ( ; p < NUM_PARAMS; p++ ) {
+		const Param_Info& info = params[p];
+		if ( ( isBus ? info.bus : info.strip ) && strlen( info.address ) == (size_t) ( end - pos ) && memcmp( pos, info.address, end - pos ) == 0 ) {
+			break;
+		}
+	}
+	if ( p == NUM_PARAMS ) {
+		return false;
+	}
+	param = (Param) p;
+
+	// Routes to buses the detected layout does not have, e.g. a4 on Banana
+	if ( param >= A1 && param <= B3 ) {
+		const VBInterface::Layout& layout = vb->getLayout();
+		int physical = physicalBusCount( layout );
+		return param <= A5 ? param - A1 < physical : param - B1 < layout.numBuses - physical;
+	}
+
+	return true;
+}
+
+VBOscBridge::Stats VBOscBridge::stats() {
+	return totals;
+}
+
+void VBOscBridge::dropped( const char* reason, const char* address ) {
+	unreported++;
+	if ( lastWarning.isValid() && lastWarning.elapsed() < WARNING_INTERVAL ) {
+		return;
+	}
+
+	qWarning() << "Dropped" << unreported << "OSC messages, the last a" << reason << address << "from" << sender.toString();
+	unreported = 0;
+	lastWarning.start();
+}
+
+void VBOscBridge::flushWrites() {
+	if ( writes.isEmpty() ) {
+		return;
+	}
+
+	vb->apply( writes );
+	writes.clear();
+}
+
+void VBOscBridge::sendLevels() {
+	if ( !vb->isReady() ) {
+		return;
+	}
+
+	VBInterface::Level_Frame frame = vb->getLevelFrame( meterTap );
+	if ( frame.numInputs == 0 && frame.numOutputs == 0 ) {
+		return;
+	}
+
+	VBOsc::Writer writer( sendBuffer, sizeof( sendBuffer ) );
+	writer.begin( "/levels", "ibb" );
+	writer.putInt( frame.inputTap );
+	writer.putFloatBlob( frame.input, frame.numInputs );
+	writer.putFloatBlob( frame.output, frame.numOutputs );
+
+	if ( writer.size() > 0 ) {
+		socket.writeDatagram( sendBuffer, writer.size(), meterAddress, meterPort );
+	}
+}
+
+void VBOscBridge::updateMetering() {
+	vb->getScheduler().setEnabled( meterJob, isListening() && meterPort != 0 && meterInterval > 0 );
+}
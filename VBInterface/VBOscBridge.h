@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QUdpSocket>
+
+#include "VBInterface.h"
+#include "VBOsc.h"
+
+/**
+* OSC bridge over UDP
+*
+* Controls parameters with /strip/<n>/<param> and /bus/<n>/<param>, where n is
+* the Voicemeeter index and param is one of gain, mute, solo, mono, eq,
+* a1..a5 or b1..b3. A message with a value sets the parameter, one without
+* arguments is answered with the current value. All messages of a bundle,
+* and all datagrams waiting at once, are applied as one script; time tags
+* are not honoured. Level frames are sent as /levels ,ibb (input tap, input
+* and output levels as blobs of big-endian float32) to the meter target.
+**/
+class VBINTERFACE_EXPORT VBOscBridge : public QObject {
+	Q_OBJECT
+
+public:
+	static const quint16 DEFAULT_PORT = 9000;
+
+	/** What came in since the bridge was created, dropped messages are logged at most every few seconds */
+	struct Stats {
+		qint64 messages = 0;
+		/** Datagrams that are not OSC */
+		qint64 malformedPackets = 0;
+		qint64 unknownAddresses = 0;
+		/** Values that are not a number */
+		qint64 badArguments = 0;
+	};
+
+	/** vb must outlive the bridge and live on the bridge's thread, all DLL calls happen there */
+	VBOscBridge( VBInterface* vb, QObject* parent = nullptr );
+	~VBOscBridge();
+
+	Stats stats();
+
+public slots:
+	/** Start receiving on a port, localhost only by default */
+	bool listen( quint16 port = DEFAULT_PORT, QHostAddress address = QHostAddress::LocalHost );
+	void close();
+	bool isListening();
+	/** Where level frames go, they stop if no target is set or msecs is 0 */
+	void setMeterTarget( QHostAddress address, quint16 port );
+	void setMeterInterval( int msecs );
+	void setMeterTap( VBInterface::Level_Tap tap );
+
+private slots:
+	void onReadyRead();
+
+private:
+	enum Param {
+		GAIN,
+		MUTE,
+		SOLO,
+		MONO,
+		EQ,
+		A1, A2, A3, A4, A5,
+		B1, B2, B3,
+		NUM_PARAMS
+	};
+
+	VBInterface* vb;
+	QUdpSocket socket;
+	int meterJob;
+	int meterInterval;
+
+	QHostAddress meterAddress;
+	quint16 meterPort = 0;
+	VBInterface::Level_Tap meterTap = VBInterface::PRE_FADER;
+
+	/** Parameter names built once so queuing a write only bumps a reference count */
+	QString reqs[2][MAX_STRIPS][NUM_PARAMS];
+
+	// Reused between datagrams so steady state handling does not allocate
+	QByteArray receiveBuffer;
+	char sendBuffer[1024];
+	QHostAddress sender;
+	quint16 senderPort = 0;
+	VBScript writes;
+
+	Stats totals;
+	/** Dropped since the last warning, any peer can send garbage so they are not logged one by one */
+	qint64 unreported = 0;
+	QElapsedTimer lastWarning;
+
+	void handle( const VBOsc::Message& message );
+	bool resolve( const VBOsc::Message& message, VBInterface::Channel& channel, Param& param );
+	void flushWrites();
+	void dropped( const char* reason, const char* address );
+	void updateMetering();
+	void sendLevels();
+};
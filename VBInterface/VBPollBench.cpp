@@ -0,0 +1,207 @@
+#include "VBPollBench.h"
+
+#include "VBSimulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+	long long nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	void appendHistogram( std::string& out, const char* name, const VBPollBench::Histogram& histogram ) {
+		char text[256];
+		snprintf( text, sizeof( text ), ",\"%s\":{\"count\":%lld,\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+			name, histogram.count, histogram.meanNs() / 1000.0, histogram.percentile( 50 ) / 1000.0, histogram.percentile( 90 ) / 1000.0,
+			histogram.percentile( 99 ) / 1000.0, histogram.percentile( 99.9 ) / 1000.0, histogram.maxNs / 1000.0 );
+		out += text;
+	}
+}
+
+namespace VBPollBench {
+	void Histogram::add( long long ns ) {
+		if ( ns < 0 ) {
+			ns = 0;
+		}
+
+		count++;
+		totalNs += ns;
+		if ( ns > maxNs ) {
+			maxNs = ns;
+		}
+		buckets[VBMetrics::bucketFor( (unsigned long long) ns )]++;
+	}
+
+	void Histogram::merge( const Histogram& other ) {
+		count += other.count;
+		totalNs += other.totalNs;
+		if ( other.maxNs > maxNs ) {
+			maxNs = other.maxNs;
+		}
+		for ( int i = 0; i < VBMetrics::NUM_BUCKETS; i++ ) {
+			buckets[i] += other.buckets[i];
+		}
+	}
+
+	long long Histogram::percentile( double p ) const {
+		if ( count == 0 ) {
+			return 0;
+		}
+
+		unsigned long long target = (unsigned long long) ( p / 100.0 * count + 0.5 );
+		if ( target < 1 ) {
+			target = 1;
+		}
+
+		unsigned long long seen = 0;
+		for ( int i = 0; i < VBMetrics::NUM_BUCKETS; i++ ) {
+			seen += buckets[i];
+			if ( seen >= target ) {
+				// Upper end of the bucket, never past the largest value seen
+				long long upper = i + 1 < VBMetrics::NUM_BUCKETS ? (long long) VBMetrics::bucketLowerBound( i + 1 ) - 1 : maxNs;
+				return upper < maxNs ? upper : maxNs;
+			}
+		}
+
+		return maxNs;
+	}
+
+	long long Histogram::meanNs() const {
+		return count == 0 ? 0 : totalNs / count;
+	}
+
+	Result run( const Settings& settings ) {
+		Result result;
+		result.settings = settings;
+
+		VBSimulator::Settings server;
+		server.type = settings.type;
+		server.callLatencyUs = settings.callLatencyUs;
+		server.latencyJitterUs = settings.latencyJitterUs;
+		VBSimulator::setSettings( server );
+		VBSimulator::reset();
+
+		VBCore core;
+		core.setBackend( VBSimulator::backend() );
+		core.login();
+		core.probe();
+
+		long long lastRoundNs = 0;
+
+		// The callbacks run on the poller thread
+		VBCore::Poll_Callbacks callbacks;
+		callbacks.round = [&]( long long latenessNs, int intervalMs ) {
+			long long now = nowNs();
+			if ( lastRoundNs > 0 ) {
+				result.roundInterval.add( now - lastRoundNs );
+			}
+			result.roundLateness.add( latenessNs );
+			if ( latenessNs > intervalMs * 1e6 * ( settings.deadlineFactor - 1 ) ) {
+				result.missedDeadlines++;
+			}
+			lastRoundNs = now;
+			result.rounds++;
+		};
+		if ( settings.sweepLevels ) {
+			callbacks.levels = [&]( const VBCore::Level_Sweep& ) {
+				result.frames++;
+			};
+		}
+		callbacks.dirty = [&]( unsigned long long ) {
+			long long raised = VBSimulator::lastDirtyRaisedNs();
+			if ( raised > 0 ) {
+				result.dirtyDelay.add( nowNs() - raised );
+			}
+		};
+
+		std::atomic<bool> stop( false );
+		std::vector<Histogram> writeLatencies( settings.writerThreads );
+		std::vector<long long> writes( settings.writerThreads );
+		std::vector<std::thread> writers;
+
+		core.startPolling( settings.minIntervalMs, settings.maxIntervalMs, callbacks );
+
+		for ( int w = 0; w < settings.writerThreads; w++ ) {
+			writers.emplace_back( [&, w]() {
+				char name[32];
+				snprintf( name, sizeof( name ), "Strip[%d].gain", w % 8 );
+				float gain = 0;
+				while ( !stop ) {
+					long long start = nowNs();
+					core.setFloat( name, gain );
+					writeLatencies[w].add( nowNs() - start );
+					writes[w]++;
+					gain = gain > -60 ? gain - 0.5f : 0;
+
+					if ( settings.writeIntervalUs > 0 ) {
+						std::this_thread::sleep_for( std::chrono::microseconds( settings.writeIntervalUs ) );
+					}
+				}
+			} );
+		}
+
+		// Without writers a write every half idle interval still times dirty detection, waking a poller that backed off
+		long long end = nowNs() + settings.durationMs * 1000000LL;
+		int probeUs = settings.maxIntervalMs * 500 + 1300;
+		float probe = 0;
+		while ( nowNs() < end ) {
+			if ( settings.writerThreads == 0 ) {
+				core.setFloat( "Bus[0].gain", probe );
+				probe = probe > -60 ? probe - 1 : 0;
+			}
+			std::this_thread::sleep_for( std::chrono::microseconds( probeUs ) );
+		}
+
+		stop = true;
+		for ( std::thread& writer : writers ) {
+			writer.join();
+		}
+		core.stopPolling();
+
+		for ( int w = 0; w < settings.writerThreads; w++ ) {
+			result.writeLatency.merge( writeLatencies[w] );
+			result.writes += writes[w];
+		}
+
+		VBSimulator::Stats stats = VBSimulator::stats();
+		result.serverCalls = stats.calls;
+		result.maxServerWaitNs = stats.maxWaitNs;
+		return result;
+	}
+
+	std::vector<Settings> standardRuns() {
+		std::vector<Settings> runs;
+		for ( int latencyUs : { 1, 20 } ) {
+			for ( int writers : { 0, 1, 4 } ) {
+				Settings settings;
+				settings.callLatencyUs = latencyUs;
+				settings.writerThreads = writers;
+				runs.push_back( settings );
+			}
+		}
+		return runs;
+	}
+
+	std::string toJson( const Result& result ) {
+		const Settings& settings = result.settings;
+		char text[512];
+		snprintf( text, sizeof( text ),
+			"{\"type\":%d,\"minIntervalMs\":%d,\"maxIntervalMs\":%d,\"durationMs\":%d,\"callLatencyUs\":%d,\"latencyJitterUs\":%d,\"writerThreads\":%d,\"writeIntervalUs\":%d,\"deadlineFactor\":%.2f,\"sweepLevels\":%s"
+			",\"rounds\":%lld,\"frames\":%lld,\"missedDeadlines\":%lld,\"writes\":%lld,\"serverCalls\":%lld,\"maxServerWaitUs\":%.1f",
+			settings.type, settings.minIntervalMs, settings.maxIntervalMs, settings.durationMs, settings.callLatencyUs, settings.latencyJitterUs, settings.writerThreads,
+			settings.writeIntervalUs, settings.deadlineFactor, settings.sweepLevels ? "true" : "false", result.rounds, result.frames,
+			result.missedDeadlines, result.writes, result.serverCalls, result.maxServerWaitNs / 1000.0 );
+
+		std::string out = text;
+		appendHistogram( out, "roundIntervalUs", result.roundInterval );
+		appendHistogram( out, "roundLatenessUs", result.roundLateness );
+		appendHistogram( out, "dirtyDelayUs", result.dirtyDelay );
+		appendHistogram( out, "writeLatencyUs", result.writeLatency );
+		out += "}";
+		return out;
+	}
+}
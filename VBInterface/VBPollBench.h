@@ -0,0 +1,82 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBCore.h"
+#include "VBMetrics.h"
+
+#include <string>
+#include <vector>
+
+/**
+* Latency and jitter of periodic polling under load
+*
+* Runs VBCore's poller against VBSimulator for a while, with the intervals
+* VBConnection runs it at, while writer threads set parameters through the
+* same core. Every round polls the dirty flag and reads back the writes'
+* shadow, as in the library, and sweeps levels if asked to. It records how
+* far apart rounds finish, how late they start, how long a write takes to
+* be reported by the dirty callback and how long writers wait, each as a
+* log-linear histogram like VBMetrics'. A round starting later than
+* deadlineFactor - 1 of its interval misses its deadline.
+*
+* Uses the process-wide VBSimulator, nothing else should use it meanwhile.
+*
+* This header does not depend on Qt.
+**/
+namespace VBPollBench {
+	struct Settings {
+		/** VBLayout::Type of the simulated server */
+		int type = 3;
+		int minIntervalMs = VBCore::POLL_INTERVAL;
+		int maxIntervalMs = VBCore::POLL_IDLE_INTERVAL;
+		int durationMs = 2000;
+		int callLatencyUs = 1;
+		int latencyJitterUs = 0;
+		/** Threads setting parameters through the poller's core */
+		int writerThreads = 0;
+		/** Pause between a writer's writes, 0 writes back to back */
+		int writeIntervalUs = 1000;
+		double deadlineFactor = 1.5;
+		/** Also sweep levels every round, as programs without Qt may have the poller do */
+		bool sweepLevels = false;
+	};
+
+	struct VBINTERFACE_EXPORT Histogram {
+		long long count = 0;
+		long long totalNs = 0;
+		long long maxNs = 0;
+		unsigned long long buckets[VBMetrics::NUM_BUCKETS] = {};
+
+		void add( long long ns );
+		void merge( const Histogram& other );
+		/** Approximate value at percentile p (0-100) in nanoseconds */
+		long long percentile( double p ) const;
+		long long meanNs() const;
+	};
+
+	struct Result {
+		Settings settings;
+		/** Between the ends of consecutive rounds */
+		Histogram roundInterval;
+		/** From a round's deadline to its start */
+		Histogram roundLateness;
+		/** From a write to the dirty callback reporting it */
+		Histogram dirtyDelay;
+		/** Time a writer spent in setFloat, mostly waiting for the poller */
+		Histogram writeLatency;
+		long long rounds = 0;
+		long long frames = 0;
+		long long missedDeadlines = 0;
+		long long writes = 0;
+		long long serverCalls = 0;
+		/** Longest a call waited for another one to leave the server */
+		long long maxServerWaitNs = 0;
+	};
+
+	VBINTERFACE_EXPORT Result run( const Settings& settings = Settings() );
+	/** Runs of VBTest --poll-bench and the PollBench program: fast and slow calls, each without and with writers */
+	VBINTERFACE_EXPORT std::vector<Settings> standardRuns();
+	/** One JSON object on one line, durations in microseconds */
+	VBINTERFACE_EXPORT std::string toJson( const Result& result );
+}
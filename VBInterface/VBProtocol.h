@@ -0,0 +1,151 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QByteArray>
+#include <QString>
+#include <cstring>
+
+/**
+* Binary protocol between VBServer and VBClient
+*
+* Both ends run on the same machine so values are in native byte order.
+* Every frame is [quint32 size][quint32 id][quint8 opcode][payload], size
+* counting everything after itself. Requests with id 0 get no reply, which
+* lets clients pipeline writes without waiting. Replies echo the request id,
+* notifications pushed by the server use id 0.
+**/
+namespace VBProtocol {
+	const char* const DEFAULT_SERVER_NAME = "VBInterface";
+
+	const int HEADER_SIZE = 9;
+	const quint32 MAX_FRAME_SIZE = 1 << 20;
+	/** Most entries one BATCH frame counts, longer batches go out as several */
+	const int MAX_BATCH_ENTRIES = 0xFFFF;
+
+	enum Opcode : quint8 {
+		// Requests
+		READ_FLOAT = 1,		// name -> float
+		READ_STRING,		// name -> string
+		SET_FLOAT,			// name, float
+		SET_STRING,			// name, string
+		SET_PARAMETERS,		// script
+		BATCH,				// quint16 count, { quint8 kind, name, float | name, string | script } in order
+		GET_LEVEL_FRAME,	// quint8 tap -> frame
+		GET_DEVICES,		// quint8 output -> quint16 count, { quint8 type, name, hardwareID }
+		SET_DEVICE,			// quint8 output, quint8 channel, quint8 type, name
+		GET_STATE,			// -> quint8 connection state, quint8 voicemeeter type
+		SUBSCRIBE,			// quint8 enable
+
+		// Replies
+		REPLY = 0x80,
+
+		// Notifications
+		NOTIFY_DIRTY = 0xC0,	// parameters changed
+		NOTIFY_STATE			// quint8 connection state, quint8 voicemeeter type
+	};
+
+	/** Appends values to a frame */
+	class Writer {
+	public:
+		explicit Writer( QByteArray& buffer ) : buffer( buffer ) {}
+
+		/** Start a frame, finish() fills in its size */
+		void begin( quint32 id, Opcode op ) {
+			start = buffer.size();
+			put<quint32>( 0 );
+			put<quint32>( id );
+			put<quint8>( op );
+		}
+
+		void finish() {
+			quint32 size = (quint32) ( buffer.size() - start - sizeof( quint32 ) );
+			memcpy( buffer.data() + start, &size, sizeof( size ) );
+		}
+
+		template<typename T>
+		void put( T value ) {
+			buffer.append( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+		}
+
+		void putString( const QString& value ) {
+			QByteArray utf8 = value.toUtf8();
+			put<quint16>( (quint16) utf8.size() );
+			buffer.append( utf8.constData(), utf8.size() );
+		}
+
+		void putBytes( const char* data, int size ) {
+			buffer.append( data, size );
+		}
+
+	private:
+		QByteArray& buffer;
+		int start = 0;
+	};
+
+	/** Reads values out of a frame payload, ok() turns false on overrun */
+	class Reader {
+	public:
+		Reader( const char* data, int size ) : data( data ), size( size ) {}
+
+		template<typename T>
+		T get() {
+			T value = T();
+			if ( pos + (int) sizeof( T ) > size ) {
+				valid = false;
+				return value;
+			}
+
+			memcpy( &value, data + pos, sizeof( T ) );
+			pos += sizeof( T );
+			return value;
+		}
+
+		QString getString() {
+			int length = get<quint16>();
+			if ( pos + length > size ) {
+				valid = false;
+				return QString();
+			}
+
+			QString value = QString::fromUtf8( data + pos, length );
+			pos += length;
+			return value;
+		}
+
+		bool getBytes( char* out, int length ) {
+			if ( pos + length > size ) {
+				valid = false;
+				return false;
+			}
+
+			memcpy( out, data + pos, length );
+			pos += length;
+			return true;
+		}
+
+		bool ok() const { return valid; }
+
+	private:
+		const char* data;
+		int size;
+		int pos = 0;
+		bool valid = true;
+	};
+
+	/** Size of the next complete frame in buffer, 0 if incomplete, -1 if malformed */
+	inline int frameSize( const QByteArray& buffer, int offset ) {
+		if ( buffer.size() - offset < (int) sizeof( quint32 ) ) {
+			return 0;
+		}
+
+		quint32 size;
+		memcpy( &size, buffer.constData() + offset, sizeof( size ) );
+		if ( size < HEADER_SIZE - sizeof( quint32 ) || size > MAX_FRAME_SIZE ) {
+			return -1;
+		}
+
+		int total = (int) ( size + sizeof( quint32 ) );
+		return buffer.size() - offset >= total ? total : 0;
+	}
+}
@@ -0,0 +1,429 @@
+#include "VBRecord.h"
+
+#include "VBMetrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+	const size_t FLUSH_SIZE = 1 << 16;
+
+	// Sizes of the buffers VBInterface passes, outputs are never longer
+	const int PARAMETER_STRING_SIZE = 512;
+	const int DEVICE_STRING_SIZE = 256;
+	const int CLIENT_NAME_SIZE = 64;
+
+	T_VBVMR_INTERFACE target;
+
+	std::mutex mutex;
+	FILE* file = nullptr;
+	std::vector<char> buffer;
+	long long previousStart = 0;
+
+	long long now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	void flush() {
+		if ( file != nullptr && !buffer.empty() ) {
+			fwrite( buffer.data(), 1, buffer.size(), file );
+		}
+		buffer.clear();
+	}
+
+	/** Appends one call to the trace, does nothing unless recording */
+	class Record {
+	public:
+		Record( VBMetrics::Function function, long long start, long result ) : lock( mutex ) {
+			if ( file == nullptr ) {
+				return;
+			}
+
+			long long end = now();
+			buffer.push_back( (char) function );
+			putUnsigned( previousStart == 0 ? 0 : start - previousStart );
+			putUnsigned( end - start );
+			putSigned( result );
+			previousStart = start;
+		}
+
+		~Record() {
+			if ( buffer.size() >= FLUSH_SIZE ) {
+				flush();
+			}
+		}
+
+		void putUnsigned( unsigned long long value ) {
+			if ( file == nullptr ) {
+				return;
+			}
+
+			while ( value >= 0x80 ) {
+				buffer.push_back( (char) ( value | 0x80 ) );
+				value >>= 7;
+			}
+			buffer.push_back( (char) value );
+		}
+
+		void putSigned( long long value ) {
+			putUnsigned( ( (unsigned long long) value << 1 ) ^ (unsigned long long) ( value >> 63 ) );
+		}
+
+		void putFloat( float value ) {
+			if ( file == nullptr ) {
+				return;
+			}
+
+			char bytes[sizeof( value )];
+			memcpy( bytes, &value, sizeof( value ) );
+			buffer.insert( buffer.end(), bytes, bytes + sizeof( bytes ) );
+		}
+
+		void putString( const char* value, int maxLength ) {
+			if ( file == nullptr ) {
+				return;
+			}
+
+			int length = 0;
+			while ( value != nullptr && length < maxLength && value[length] != 0 ) {
+				length++;
+			}
+
+			putUnsigned( length );
+			buffer.insert( buffer.end(), value, value + length );
+		}
+
+		void putBytes( const unsigned char* data, long length ) {
+			if ( file == nullptr ) {
+				return;
+			}
+
+			putUnsigned( length );
+			buffer.insert( buffer.end(), data, data + length );
+		}
+
+		void putWideString( const unsigned short* value, int maxLength ) {
+			if ( file == nullptr ) {
+				return;
+			}
+
+			int length = 0;
+			while ( value != nullptr && length < maxLength && value[length] != 0 ) {
+				length++;
+			}
+
+			putUnsigned( length );
+			for ( int i = 0; i < length; i++ ) {
+				putUnsigned( value[i] );
+			}
+		}
+
+	private:
+		std::lock_guard<std::mutex> lock;
+	};
+
+	const int NO_LIMIT = 1 << 30;
+
+	long __stdcall login() {
+		long long start = now();
+		long result = target.VBVMR_Login();
+		Record record( VBMetrics::LOGIN, start, result );
+		return result;
+	}
+
+	long __stdcall logout() {
+		long long start = now();
+		long result = target.VBVMR_Logout();
+		Record record( VBMetrics::LOGOUT, start, result );
+		return result;
+	}
+
+	long __stdcall runVoicemeeter( long vType ) {
+		long long start = now();
+		long result = target.VBVMR_RunVoicemeeter( vType );
+		Record record( VBMetrics::RUN_VOICEMEETER, start, result );
+		record.putSigned( vType );
+		return result;
+	}
+
+	long __stdcall getVoicemeeterType( long* pType ) {
+		long long start = now();
+		long result = target.VBVMR_GetVoicemeeterType( pType );
+		Record record( VBMetrics::GET_VOICEMEETER_TYPE, start, result );
+		record.putSigned( result == 0 ? *pType : 0 );
+		return result;
+	}
+
+	long __stdcall getVoicemeeterVersion( long* pVersion ) {
+		long long start = now();
+		long result = target.VBVMR_GetVoicemeeterVersion( pVersion );
+		Record record( VBMetrics::GET_VOICEMEETER_VERSION, start, result );
+		record.putSigned( result == 0 ? *pVersion : 0 );
+		return result;
+	}
+
+	long __stdcall isParametersDirty() {
+		long long start = now();
+		long result = target.VBVMR_IsParametersDirty();
+		Record record( VBMetrics::IS_PARAMETERS_DIRTY, start, result );
+		return result;
+	}
+
+	long __stdcall getParameterFloat( char* szParamName, float* pValue ) {
+		long long start = now();
+		long result = target.VBVMR_GetParameterFloat( szParamName, pValue );
+		Record record( VBMetrics::GET_PARAMETER_FLOAT, start, result );
+		record.putString( szParamName, NO_LIMIT );
+		record.putFloat( result == 0 ? *pValue : 0 );
+		return result;
+	}
+
+	long __stdcall getParameterStringA( char* szParamName, char* szString ) {
+		long long start = now();
+		long result = target.VBVMR_GetParameterStringA( szParamName, szString );
+		Record record( VBMetrics::GET_PARAMETER_STRING_A, start, result );
+		record.putString( szParamName, NO_LIMIT );
+		record.putString( result == 0 ? szString : nullptr, PARAMETER_STRING_SIZE );
+		return result;
+	}
+
+	long __stdcall getParameterStringW( char* szParamName, unsigned short* wszString ) {
+		long long start = now();
+		long result = target.VBVMR_GetParameterStringW( szParamName, wszString );
+		Record record( VBMetrics::GET_PARAMETER_STRING_W, start, result );
+		record.putString( szParamName, NO_LIMIT );
+		record.putWideString( result == 0 ? wszString : nullptr, PARAMETER_STRING_SIZE );
+		return result;
+	}
+
+	long __stdcall getLevel( long nType, long nuChannel, float* pValue ) {
+		long long start = now();
+		long result = target.VBVMR_GetLevel( nType, nuChannel, pValue );
+		Record record( VBMetrics::GET_LEVEL, start, result );
+		record.putSigned( nType );
+		record.putSigned( nuChannel );
+		record.putFloat( result == 0 ? *pValue : 0 );
+		return result;
+	}
+
+	long __stdcall getMidiMessage( unsigned char* pMIDIBuffer, long nbByteMax ) {
+		long long start = now();
+		long result = target.VBVMR_GetMidiMessage( pMIDIBuffer, nbByteMax );
+		Record record( VBMetrics::GET_MIDI_MESSAGE, start, result );
+		record.putSigned( nbByteMax );
+		record.putBytes( pMIDIBuffer, result > 0 ? result : 0 );
+		return result;
+	}
+
+	long __stdcall setParameterFloat( char* szParamName, float Value ) {
+		long long start = now();
+		long result = target.VBVMR_SetParameterFloat( szParamName, Value );
+		Record record( VBMetrics::SET_PARAMETER_FLOAT, start, result );
+		record.putString( szParamName, NO_LIMIT );
+		record.putFloat( Value );
+		return result;
+	}
+
+	long __stdcall setParameters( char* szParamScript ) {
+		long long start = now();
+		long result = target.VBVMR_SetParameters( szParamScript );
+		Record record( VBMetrics::SET_PARAMETERS, start, result );
+		record.putString( szParamScript, NO_LIMIT );
+		return result;
+	}
+
+	long __stdcall setParametersW( unsigned short* szParamScript ) {
+		long long start = now();
+		long result = target.VBVMR_SetParametersW( szParamScript );
+		Record record( VBMetrics::SET_PARAMETERS_W, start, result );
+		record.putWideString( szParamScript, NO_LIMIT );
+		return result;
+	}
+
+	long __stdcall setParameterStringA( char* szParamName, char* szString ) {
+		long long start = now();
+		long result = target.VBVMR_SetParameterStringA( szParamName, szString );
+		Record record( VBMetrics::SET_PARAMETER_STRING_A, start, result );
+		record.putString( szParamName, NO_LIMIT );
+		record.putString( szString, NO_LIMIT );
+		return result;
+	}
+
+	long __stdcall setParameterStringW( char* szParamName, unsigned short* wszString ) {
+		long long start = now();
+		long result = target.VBVMR_SetParameterStringW( szParamName, wszString );
+		Record record( VBMetrics::SET_PARAMETER_STRING_W, start, result );
+		record.putString( szParamName, NO_LIMIT );
+		record.putWideString( wszString, NO_LIMIT );
+		return result;
+	}
+
+	long __stdcall outputGetDeviceNumber() {
+		long long start = now();
+		long result = target.VBVMR_Output_GetDeviceNumber();
+		Record record( VBMetrics::OUTPUT_GET_DEVICE_NUMBER, start, result );
+		return result;
+	}
+
+	long __stdcall inputGetDeviceNumber() {
+		long long start = now();
+		long result = target.VBVMR_Input_GetDeviceNumber();
+		Record record( VBMetrics::INPUT_GET_DEVICE_NUMBER, start, result );
+		return result;
+	}
+
+	void putDeviceDesc( Record& record, long zindex, long result, long* nType, const char* szDeviceName, const char* szHardwareId ) {
+		record.putSigned( zindex );
+		record.putSigned( result == 0 ? *nType : 0 );
+		record.putString( result == 0 ? szDeviceName : nullptr, DEVICE_STRING_SIZE );
+		record.putString( result == 0 ? szHardwareId : nullptr, DEVICE_STRING_SIZE );
+	}
+
+	void putDeviceDescW( Record& record, long zindex, long result, long* nType, const unsigned short* wszDeviceName, const unsigned short* wszHardwareId ) {
+		record.putSigned( zindex );
+		record.putSigned( result == 0 ? *nType : 0 );
+		record.putWideString( result == 0 ? wszDeviceName : nullptr, DEVICE_STRING_SIZE );
+		record.putWideString( result == 0 ? wszHardwareId : nullptr, DEVICE_STRING_SIZE );
+	}
+
+	long __stdcall outputGetDeviceDescA( long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		long long start = now();
+		long result = target.VBVMR_Output_GetDeviceDescA( zindex, nType, szDeviceName, szHardwareId );
+		Record record( VBMetrics::OUTPUT_GET_DEVICE_DESC_A, start, result );
+		putDeviceDesc( record, zindex, result, nType, szDeviceName, szHardwareId );
+		return result;
+	}
+
+	long __stdcall outputGetDeviceDescW( long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		long long start = now();
+		long result = target.VBVMR_Output_GetDeviceDescW( zindex, nType, wszDeviceName, wszHardwareId );
+		Record record( VBMetrics::OUTPUT_GET_DEVICE_DESC_W, start, result );
+		putDeviceDescW( record, zindex, result, nType, wszDeviceName, wszHardwareId );
+		return result;
+	}
+
+	long __stdcall inputGetDeviceDescA( long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		long long start = now();
+		long result = target.VBVMR_Input_GetDeviceDescA( zindex, nType, szDeviceName, szHardwareId );
+		Record record( VBMetrics::INPUT_GET_DEVICE_DESC_A, start, result );
+		putDeviceDesc( record, zindex, result, nType, szDeviceName, szHardwareId );
+		return result;
+	}
+
+	long __stdcall inputGetDeviceDescW( long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		long long start = now();
+		long result = target.VBVMR_Input_GetDeviceDescW( zindex, nType, wszDeviceName, wszHardwareId );
+		Record record( VBMetrics::INPUT_GET_DEVICE_DESC_W, start, result );
+		putDeviceDescW( record, zindex, result, nType, wszDeviceName, wszHardwareId );
+		return result;
+	}
+
+	long __stdcall audioCallbackRegister( long mode, T_VBVMR_VBAUDIOCALLBACK pCallback, void* lpUser, char szClientName[64] ) {
+		long long start = now();
+		long result = target.VBVMR_AudioCallbackRegister( mode, pCallback, lpUser, szClientName );
+		Record record( VBMetrics::AUDIO_CALLBACK_REGISTER, start, result );
+		record.putSigned( mode );
+		// In and out, the other client's name when it is already registered
+		record.putString( szClientName, CLIENT_NAME_SIZE );
+		return result;
+	}
+
+	long __stdcall audioCallbackStart() {
+		long long start = now();
+		long result = target.VBVMR_AudioCallbackStart();
+		Record record( VBMetrics::AUDIO_CALLBACK_START, start, result );
+		return result;
+	}
+
+	long __stdcall audioCallbackStop() {
+		long long start = now();
+		long result = target.VBVMR_AudioCallbackStop();
+		Record record( VBMetrics::AUDIO_CALLBACK_STOP, start, result );
+		return result;
+	}
+
+	long __stdcall audioCallbackUnregister() {
+		long long start = now();
+		long result = target.VBVMR_AudioCallbackUnregister();
+		Record record( VBMetrics::AUDIO_CALLBACK_UNREGISTER, start, result );
+		return result;
+	}
+}
+
+namespace VBRecord {
+	bool start( const char* path ) {
+		std::lock_guard<std::mutex> lock( mutex );
+
+		if ( file != nullptr ) {
+			flush();
+			fclose( file );
+		}
+
+		file = fopen( path, "wb" );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		buffer.reserve( FLUSH_SIZE * 2 );
+		buffer.assign( MAGIC, MAGIC + sizeof( MAGIC ) );
+		unsigned version = VERSION;
+		buffer.insert( buffer.end(), reinterpret_cast<const char*>( &version ), reinterpret_cast<const char*>( &version ) + sizeof( version ) );
+		previousStart = 0;
+		return true;
+	}
+
+	void stop() {
+		std::lock_guard<std::mutex> lock( mutex );
+
+		if ( file == nullptr ) {
+			return;
+		}
+
+		flush();
+		fclose( file );
+		file = nullptr;
+	}
+
+	bool isRecording() {
+		std::lock_guard<std::mutex> lock( mutex );
+		return file != nullptr;
+	}
+
+	T_VBVMR_INTERFACE wrap( const T_VBVMR_INTERFACE& functions ) {
+		target = functions;
+
+		T_VBVMR_INTERFACE wrapped;
+		wrapped.VBVMR_Login = login;
+		wrapped.VBVMR_Logout = logout;
+		wrapped.VBVMR_RunVoicemeeter = runVoicemeeter;
+		wrapped.VBVMR_GetVoicemeeterType = getVoicemeeterType;
+		wrapped.VBVMR_GetVoicemeeterVersion = getVoicemeeterVersion;
+		wrapped.VBVMR_IsParametersDirty = isParametersDirty;
+		wrapped.VBVMR_GetParameterFloat = getParameterFloat;
+		wrapped.VBVMR_GetParameterStringA = getParameterStringA;
+		wrapped.VBVMR_GetParameterStringW = getParameterStringW;
+		wrapped.VBVMR_GetLevel = getLevel;
+		wrapped.VBVMR_GetMidiMessage = getMidiMessage;
+		wrapped.VBVMR_SetParameterFloat = setParameterFloat;
+		wrapped.VBVMR_SetParameters = setParameters;
+		wrapped.VBVMR_SetParametersW = setParametersW;
+		wrapped.VBVMR_SetParameterStringA = setParameterStringA;
+		wrapped.VBVMR_SetParameterStringW = setParameterStringW;
+		wrapped.VBVMR_Output_GetDeviceNumber = outputGetDeviceNumber;
+		wrapped.VBVMR_Output_GetDeviceDescA = outputGetDeviceDescA;
+		wrapped.VBVMR_Output_GetDeviceDescW = outputGetDeviceDescW;
+		wrapped.VBVMR_Input_GetDeviceNumber = inputGetDeviceNumber;
+		wrapped.VBVMR_Input_GetDeviceDescA = inputGetDeviceDescA;
+		wrapped.VBVMR_Input_GetDeviceDescW = inputGetDeviceDescW;
+
+		// Optional, left out when the target does not have them
+		wrapped.VBVMR_AudioCallbackRegister = functions.VBVMR_AudioCallbackRegister ? audioCallbackRegister : nullptr;
+		wrapped.VBVMR_AudioCallbackStart = functions.VBVMR_AudioCallbackStart ? audioCallbackStart : nullptr;
+		wrapped.VBVMR_AudioCallbackStop = functions.VBVMR_AudioCallbackStop ? audioCallbackStop : nullptr;
+		wrapped.VBVMR_AudioCallbackUnregister = functions.VBVMR_AudioCallbackUnregister ? audioCallbackUnregister : nullptr;
+		return wrapped;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#ifndef _WIN32
+# ifndef __stdcall
+#  define __stdcall
+# endif
+#endif
+
+#include "VoicemeeterRemote.h"
+
+/**
+* Records every VBVMR_* call into a compact binary trace, see VBReplay
+*
+* wrap() returns a T_VBVMR_INTERFACE whose functions forward to the target
+* and, while recording, log the function, its arguments, its outputs, its
+* result and when it started and how long it took. There is one recorder
+* per process since the wrappers are plain function pointers.
+*
+* File layout, integers are LEB128 varints and signed ones zigzag encoded:
+*   "VBRT" u32 version
+*   per call: u8 function (VBMetrics::Function), start delta ns, duration ns,
+*   signed result, then the arguments and outputs of that function in
+*   parameter order. Strings and MIDI data are a length and bytes, wide
+*   strings a length and one varint per unit, floats 4 raw
+*   bytes. Outputs of failed calls are left empty. Audio callback
+*   registrations are recorded, the audio itself is not.
+**/
+namespace VBRecord {
+	const char MAGIC[4] = { 'V', 'B', 'R', 'T' };
+	const unsigned VERSION = 1;
+
+	/** Start writing calls to path, replaces a recording in progress */
+	VBINTERFACE_EXPORT bool start( const char* path );
+	/** Flush and close the trace */
+	VBINTERFACE_EXPORT void stop();
+	VBINTERFACE_EXPORT bool isRecording();
+
+	/** Wrappers forwarding to target, which must stay valid while they are in use */
+	VBINTERFACE_EXPORT T_VBVMR_INTERFACE wrap( const T_VBVMR_INTERFACE& target );
+}
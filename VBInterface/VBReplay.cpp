@@ -0,0 +1,605 @@
+#include "VBReplay.h"
+
+#include "VBMetrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	const long MISMATCH = -1;
+
+	// Same limits as the recorder, outputs are clamped to the caller's buffers
+	const int PARAMETER_STRING_SIZE = 512;
+	const int DEVICE_STRING_SIZE = 256;
+	const int CLIENT_NAME_SIZE = 64;
+
+	struct Function_Layout {
+		/** Fields in order: I signed, F float, S string or bytes, W wide string */
+		const char* fields;
+		/** Leading fields that identify the call */
+		int keyFields;
+	};
+
+	// In VBMetrics::Function order
+	const Function_Layout layouts[] = {
+		{ "", 0 },		// LOGIN
+		{ "", 0 },		// LOGOUT
+		{ "I", 0 },		// RUN_VOICEMEETER
+		{ "I", 0 },		// GET_VOICEMEETER_TYPE
+		{ "I", 0 },		// GET_VOICEMEETER_VERSION
+		{ "", 0 },		// IS_PARAMETERS_DIRTY
+		{ "SF", 1 },	// GET_PARAMETER_FLOAT
+		{ "SS", 1 },	// GET_PARAMETER_STRING_A
+		{ "SW", 1 },	// GET_PARAMETER_STRING_W
+		{ "IIF", 2 },	// GET_LEVEL
+		{ "IS", 0 },	// GET_MIDI_MESSAGE
+		{ "SF", 1 },	// SET_PARAMETER_FLOAT
+		{ "S", 0 },		// SET_PARAMETERS
+		{ "W", 0 },		// SET_PARAMETERS_W
+		{ "SS", 1 },	// SET_PARAMETER_STRING_A
+		{ "SW", 1 },	// SET_PARAMETER_STRING_W
+		{ "", 0 },		// OUTPUT_GET_DEVICE_NUMBER
+		{ "IISS", 1 },	// OUTPUT_GET_DEVICE_DESC_A
+		{ "IIWW", 1 },	// OUTPUT_GET_DEVICE_DESC_W
+		{ "", 0 },		// INPUT_GET_DEVICE_NUMBER
+		{ "IISS", 1 },	// INPUT_GET_DEVICE_DESC_A
+		{ "IIWW", 1 },	// INPUT_GET_DEVICE_DESC_W
+		{ "IS", 1 },	// AUDIO_CALLBACK_REGISTER
+		{ "", 0 },		// AUDIO_CALLBACK_START
+		{ "", 0 },		// AUDIO_CALLBACK_STOP
+		{ "", 0 }		// AUDIO_CALLBACK_UNREGISTER
+	};
+
+	static_assert( sizeof( layouts ) / sizeof( layouts[0] ) == VBMetrics::NUM_DLL_FUNCTIONS, "Every function needs a layout" );
+
+	/** Reads the varint encoded fields written by VBRecord */
+	class Decoder {
+	public:
+		Decoder( const char* pos = nullptr, const char* end = nullptr ) : pos( pos ), end( end ) {}
+
+		unsigned long long getUnsigned() {
+			unsigned long long value = 0;
+			for ( int shift = 0; shift < 64; shift += 7 ) {
+				if ( pos >= end ) {
+					valid = false;
+					return 0;
+				}
+
+				unsigned char byte = (unsigned char) *pos++;
+				value |= (unsigned long long) ( byte & 0x7f ) << shift;
+				if ( ( byte & 0x80 ) == 0 ) {
+					return value;
+				}
+			}
+
+			valid = false;
+			return 0;
+		}
+
+		long long getSigned() {
+			unsigned long long value = getUnsigned();
+			return (long long) ( value >> 1 ) ^ -(long long) ( value & 1 );
+		}
+
+		float getFloat() {
+			float value = 0;
+			if ( end - pos < (long) sizeof( value ) ) {
+				valid = false;
+				return value;
+			}
+
+			memcpy( &value, pos, sizeof( value ) );
+			pos += sizeof( value );
+			return value;
+		}
+
+		/** Bytes of a string field, not NUL terminated */
+		const char* getString( int& length ) {
+			length = (int) getUnsigned();
+			if ( length < 0 || length > end - pos ) {
+				valid = false;
+				length = 0;
+				return pos;
+			}
+
+			const char* value = pos;
+			pos += length;
+			return value;
+		}
+
+		/** Copy a string field into a buffer of size bytes, NUL terminated */
+		void copyString( char* out, int size ) {
+			int length;
+			const char* value = getString( length );
+			if ( out == nullptr || size <= 0 ) {
+				return;
+			}
+
+			length = length < size - 1 ? length : size - 1;
+			memcpy( out, value, length );
+			out[length] = 0;
+		}
+
+		void copyWideString( unsigned short* out, int size ) {
+			int length = (int) getUnsigned();
+			for ( int i = 0; i < length && valid; i++ ) {
+				unsigned short unit = (unsigned short) getUnsigned();
+				if ( out != nullptr && i < size - 1 ) {
+					out[i] = unit;
+				}
+			}
+
+			if ( out != nullptr && size > 0 ) {
+				out[length < size - 1 ? length : size - 1] = 0;
+			}
+		}
+
+		void skip( char field ) {
+			int length;
+			switch ( field ) {
+				case 'I': getUnsigned(); break;
+				case 'F': getFloat(); break;
+				case 'S': getString( length ); break;
+				case 'W': copyWideString( nullptr, 0 ); break;
+			}
+		}
+
+		bool ok() const { return valid; }
+		const char* position() const { return pos; }
+
+	private:
+		const char* pos;
+		const char* end;
+		bool valid = true;
+	};
+
+	struct Call {
+		VBMetrics::Function function;
+		long long startNs;
+		long long durationNs;
+		long result;
+		const char* payload;
+		const char* end;
+	};
+
+	/** What identifies a call, compared against the recorded key fields */
+	struct Key {
+		const char* name = nullptr;
+		long values[2] = { 0, 0 };
+	};
+
+	std::mutex mutex;
+	std::vector<char> data;
+	std::vector<Call> calls;
+	size_t cursor = 0;
+	VBReplay::Mode mode = VBReplay::FAST;
+	VBReplay::Stats counters;
+	bool clockStarted = false;
+	Clock::time_point clockStart;
+
+	bool keyMatches( const Call& call, const Key& key, Decoder& payload ) {
+		payload = Decoder( call.payload, call.end );
+		const Function_Layout& layout = layouts[call.function];
+
+		int value = 0;
+		for ( int i = 0; i < layout.keyFields; i++ ) {
+			if ( layout.fields[i] == 'S' ) {
+				int length;
+				const char* name = payload.getString( length );
+				if ( key.name == nullptr || strncmp( name, key.name, length ) != 0 || key.name[length] != 0 ) {
+					return false;
+				}
+			} else if ( payload.getSigned() != key.values[value++] ) {
+				return false;
+			}
+		}
+
+		return payload.ok();
+	}
+
+	/** Consumes the recorded call matching a library call, paces it in real time mode */
+	class Match {
+	public:
+		Match( VBMetrics::Function function, const Key& key = Key() ) : lock( mutex ) {
+			counters.calls++;
+
+			size_t last = cursor + VBReplay::MATCH_WINDOW < calls.size() ? cursor + VBReplay::MATCH_WINDOW : calls.size();
+			for ( size_t i = cursor; i < last; i++ ) {
+				if ( calls[i].function == function && keyMatches( calls[i], key, payload ) ) {
+					call = &calls[i];
+					counters.skipped += i - cursor;
+					counters.matched++;
+					cursor = i + 1;
+					break;
+				}
+			}
+
+			if ( call == nullptr ) {
+				counters.mismatched++;
+				return;
+			}
+
+			if ( mode == VBReplay::REAL_TIME ) {
+				if ( !clockStarted ) {
+					clockStart = Clock::now() - std::chrono::nanoseconds( call->startNs );
+					clockStarted = true;
+				}
+				startAt = clockStart + std::chrono::nanoseconds( call->startNs );
+			}
+		}
+
+		~Match() {
+			if ( call == nullptr || mode != VBReplay::REAL_TIME ) {
+				return;
+			}
+
+			long long durationNs = call->durationNs;
+			Clock::time_point start = startAt;
+			lock.unlock();
+
+			std::this_thread::sleep_until( start );
+
+			// Calls take microseconds, too short to sleep for
+			Clock::time_point done = Clock::now() + std::chrono::nanoseconds( durationNs );
+			while ( Clock::now() < done ) {
+			}
+		}
+
+		explicit operator bool() const { return call != nullptr; }
+		long result() const { return call->result; }
+
+		Decoder payload;
+
+	private:
+		std::unique_lock<std::mutex> lock;
+		const Call* call = nullptr;
+		Clock::time_point startAt;
+	};
+
+	Key nameKey( const char* name ) {
+		Key key;
+		key.name = name;
+		return key;
+	}
+
+	Key valueKey( long first, long second = 0 ) {
+		Key key;
+		key.values[0] = first;
+		key.values[1] = second;
+		return key;
+	}
+
+	long __stdcall login() {
+		Match match( VBMetrics::LOGIN );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall logout() {
+		Match match( VBMetrics::LOGOUT );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall runVoicemeeter( long ) {
+		Match match( VBMetrics::RUN_VOICEMEETER );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall getVoicemeeterType( long* pType ) {
+		Match match( VBMetrics::GET_VOICEMEETER_TYPE );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		*pType = (long) match.payload.getSigned();
+		return match.result();
+	}
+
+	long __stdcall getVoicemeeterVersion( long* pVersion ) {
+		Match match( VBMetrics::GET_VOICEMEETER_VERSION );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		*pVersion = (long) match.payload.getSigned();
+		return match.result();
+	}
+
+	long __stdcall isParametersDirty() {
+		Match match( VBMetrics::IS_PARAMETERS_DIRTY );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall getParameterFloat( char* szParamName, float* pValue ) {
+		Match match( VBMetrics::GET_PARAMETER_FLOAT, nameKey( szParamName ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		*pValue = match.payload.getFloat();
+		return match.result();
+	}
+
+	long __stdcall getParameterStringA( char* szParamName, char* szString ) {
+		Match match( VBMetrics::GET_PARAMETER_STRING_A, nameKey( szParamName ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		match.payload.copyString( szString, PARAMETER_STRING_SIZE );
+		return match.result();
+	}
+
+	long __stdcall getParameterStringW( char* szParamName, unsigned short* wszString ) {
+		Match match( VBMetrics::GET_PARAMETER_STRING_W, nameKey( szParamName ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		match.payload.copyWideString( wszString, PARAMETER_STRING_SIZE );
+		return match.result();
+	}
+
+	long __stdcall getLevel( long nType, long nuChannel, float* pValue ) {
+		Match match( VBMetrics::GET_LEVEL, valueKey( nType, nuChannel ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		*pValue = match.payload.getFloat();
+		return match.result();
+	}
+
+	long __stdcall getMidiMessage( unsigned char* pMIDIBuffer, long nbByteMax ) {
+		Match match( VBMetrics::GET_MIDI_MESSAGE );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		match.payload.getSigned();
+		int length;
+		const char* bytes = match.payload.getString( length );
+		memcpy( pMIDIBuffer, bytes, length < nbByteMax ? length : nbByteMax );
+		return match.result();
+	}
+
+	long __stdcall setParameterFloat( char* szParamName, float ) {
+		Match match( VBMetrics::SET_PARAMETER_FLOAT, nameKey( szParamName ) );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall setParameters( char* ) {
+		Match match( VBMetrics::SET_PARAMETERS );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall setParametersW( unsigned short* ) {
+		Match match( VBMetrics::SET_PARAMETERS_W );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall setParameterStringA( char* szParamName, char* ) {
+		Match match( VBMetrics::SET_PARAMETER_STRING_A, nameKey( szParamName ) );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall setParameterStringW( char* szParamName, unsigned short* ) {
+		Match match( VBMetrics::SET_PARAMETER_STRING_W, nameKey( szParamName ) );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall outputGetDeviceNumber() {
+		Match match( VBMetrics::OUTPUT_GET_DEVICE_NUMBER );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall inputGetDeviceNumber() {
+		Match match( VBMetrics::INPUT_GET_DEVICE_NUMBER );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long deviceDesc( VBMetrics::Function function, long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		Match match( function, valueKey( zindex ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		*nType = (long) match.payload.getSigned();
+		match.payload.copyString( szDeviceName, DEVICE_STRING_SIZE );
+		match.payload.copyString( szHardwareId, DEVICE_STRING_SIZE );
+		return match.result();
+	}
+
+	long deviceDescW( VBMetrics::Function function, long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		Match match( function, valueKey( zindex ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		*nType = (long) match.payload.getSigned();
+		match.payload.copyWideString( wszDeviceName, DEVICE_STRING_SIZE );
+		match.payload.copyWideString( wszHardwareId, DEVICE_STRING_SIZE );
+		return match.result();
+	}
+
+	long __stdcall outputGetDeviceDescA( long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		return deviceDesc( VBMetrics::OUTPUT_GET_DEVICE_DESC_A, zindex, nType, szDeviceName, szHardwareId );
+	}
+
+	long __stdcall outputGetDeviceDescW( long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		return deviceDescW( VBMetrics::OUTPUT_GET_DEVICE_DESC_W, zindex, nType, wszDeviceName, wszHardwareId );
+	}
+
+	long __stdcall inputGetDeviceDescA( long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		return deviceDesc( VBMetrics::INPUT_GET_DEVICE_DESC_A, zindex, nType, szDeviceName, szHardwareId );
+	}
+
+	long __stdcall inputGetDeviceDescW( long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		return deviceDescW( VBMetrics::INPUT_GET_DEVICE_DESC_W, zindex, nType, wszDeviceName, wszHardwareId );
+	}
+
+	long __stdcall audioCallbackRegister( long mode, T_VBVMR_VBAUDIOCALLBACK, void*, char szClientName[64] ) {
+		Match match( VBMetrics::AUDIO_CALLBACK_REGISTER, valueKey( mode ) );
+		if ( !match ) {
+			return MISMATCH;
+		}
+
+		match.payload.copyString( szClientName, CLIENT_NAME_SIZE );
+		return match.result();
+	}
+
+	long __stdcall audioCallbackStart() {
+		Match match( VBMetrics::AUDIO_CALLBACK_START );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall audioCallbackStop() {
+		Match match( VBMetrics::AUDIO_CALLBACK_STOP );
+		return match ? match.result() : MISMATCH;
+	}
+
+	long __stdcall audioCallbackUnregister() {
+		Match match( VBMetrics::AUDIO_CALLBACK_UNREGISTER );
+		return match ? match.result() : MISMATCH;
+	}
+}
+
+namespace VBReplay {
+	bool open( const char* path ) {
+		close();
+
+		FILE* file = fopen( path, "rb" );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		std::vector<char> contents;
+		char chunk[1 << 16];
+		size_t read;
+		while ( ( read = fread( chunk, 1, sizeof( chunk ), file ) ) > 0 ) {
+			contents.insert( contents.end(), chunk, chunk + read );
+		}
+		fclose( file );
+
+		unsigned version = 0;
+		if ( contents.size() < sizeof( VBRecord::MAGIC ) + sizeof( version ) || memcmp( contents.data(), VBRecord::MAGIC, sizeof( VBRecord::MAGIC ) ) != 0 ) {
+			return false;
+		}
+
+		memcpy( &version, contents.data() + sizeof( VBRecord::MAGIC ), sizeof( version ) );
+		if ( version != VBRecord::VERSION ) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock( mutex );
+		data.swap( contents );
+
+		// Index the calls, a trace cut short by a crash keeps its complete calls
+		Decoder decoder( data.data() + sizeof( VBRecord::MAGIC ) + sizeof( version ), data.data() + data.size() );
+		long long start = 0;
+		while ( decoder.position() < data.data() + data.size() ) {
+			Call call;
+			unsigned char function = (unsigned char) *decoder.position();
+			decoder = Decoder( decoder.position() + 1, data.data() + data.size() );
+			if ( function >= VBMetrics::NUM_DLL_FUNCTIONS ) {
+				break;
+			}
+
+			call.function = (VBMetrics::Function) function;
+			start += (long long) decoder.getUnsigned();
+			call.startNs = start;
+			call.durationNs = (long long) decoder.getUnsigned();
+			call.result = (long) decoder.getSigned();
+			call.payload = decoder.position();
+
+			for ( const char* field = layouts[function].fields; *field != 0; field++ ) {
+				decoder.skip( *field );
+			}
+
+			if ( !decoder.ok() ) {
+				break;
+			}
+
+			call.end = decoder.position();
+			calls.push_back( call );
+		}
+
+		cursor = 0;
+		counters = Stats();
+		clockStarted = false;
+		return true;
+	}
+
+	void close() {
+		std::lock_guard<std::mutex> lock( mutex );
+		calls.clear();
+		data.clear();
+		cursor = 0;
+		counters = Stats();
+		clockStarted = false;
+	}
+
+	void setMode( Mode replayMode ) {
+		std::lock_guard<std::mutex> lock( mutex );
+		mode = replayMode;
+		clockStarted = false;
+	}
+
+	void rewind() {
+		std::lock_guard<std::mutex> lock( mutex );
+		cursor = 0;
+		counters = Stats();
+		clockStarted = false;
+	}
+
+	long long size() {
+		std::lock_guard<std::mutex> lock( mutex );
+		return (long long) calls.size();
+	}
+
+	bool atEnd() {
+		std::lock_guard<std::mutex> lock( mutex );
+		return cursor >= calls.size();
+	}
+
+	Stats stats() {
+		std::lock_guard<std::mutex> lock( mutex );
+		return counters;
+	}
+
+	T_VBVMR_INTERFACE backend() {
+		T_VBVMR_INTERFACE functions;
+		functions.VBVMR_Login = login;
+		functions.VBVMR_Logout = logout;
+		functions.VBVMR_RunVoicemeeter = runVoicemeeter;
+		functions.VBVMR_GetVoicemeeterType = getVoicemeeterType;
+		functions.VBVMR_GetVoicemeeterVersion = getVoicemeeterVersion;
+		functions.VBVMR_IsParametersDirty = isParametersDirty;
+		functions.VBVMR_GetParameterFloat = getParameterFloat;
+		functions.VBVMR_GetParameterStringA = getParameterStringA;
+		functions.VBVMR_GetParameterStringW = getParameterStringW;
+		functions.VBVMR_GetLevel = getLevel;
+		functions.VBVMR_GetMidiMessage = getMidiMessage;
+		functions.VBVMR_SetParameterFloat = setParameterFloat;
+		functions.VBVMR_SetParameters = setParameters;
+		functions.VBVMR_SetParametersW = setParametersW;
+		functions.VBVMR_SetParameterStringA = setParameterStringA;
+		functions.VBVMR_SetParameterStringW = setParameterStringW;
+		functions.VBVMR_Output_GetDeviceNumber = outputGetDeviceNumber;
+		functions.VBVMR_Output_GetDeviceDescA = outputGetDeviceDescA;
+		functions.VBVMR_Output_GetDeviceDescW = outputGetDeviceDescW;
+		functions.VBVMR_Input_GetDeviceNumber = inputGetDeviceNumber;
+		functions.VBVMR_Input_GetDeviceDescA = inputGetDeviceDescA;
+		functions.VBVMR_Input_GetDeviceDescW = inputGetDeviceDescW;
+		functions.VBVMR_AudioCallbackRegister = audioCallbackRegister;
+		functions.VBVMR_AudioCallbackStart = audioCallbackStart;
+		functions.VBVMR_AudioCallbackStop = audioCallbackStop;
+		functions.VBVMR_AudioCallbackUnregister = audioCallbackUnregister;
+		return functions;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBRecord.h"
+
+/**
+* Plays a VBRecord trace back as a T_VBVMR_INTERFACE, no DLL or Voicemeeter needed
+*
+* Each call consumes the next recorded call of the same function and hands
+* back its recorded outputs and result. Reads are matched on their key too
+* (parameter name, level channel, device index). If the library makes calls
+* the trace does not have, up to MATCH_WINDOW recorded calls are skipped
+* looking for a match, otherwise the call fails with -1 and counts as a
+* mismatch. Audio callbacks register and start as recorded but are never
+* called. Like the recorder there is one replay per process.
+**/
+namespace VBReplay {
+	const int MATCH_WINDOW = 256;
+
+	enum Mode {
+		/** Return immediately */
+		FAST,
+		/** Wait for each call's recorded start time and take its recorded duration */
+		REAL_TIME
+	};
+
+	struct Stats {
+		long long calls = 0;
+		long long matched = 0;
+		/** Recorded calls the library never made */
+		long long skipped = 0;
+		/** Calls the trace had no match for */
+		long long mismatched = 0;
+	};
+
+	/** Load a trace, false if it can't be read or is not a VBRecord trace */
+	VBINTERFACE_EXPORT bool open( const char* path );
+	VBINTERFACE_EXPORT void close();
+	VBINTERFACE_EXPORT void setMode( Mode mode );
+	/** Start again from the first call */
+	VBINTERFACE_EXPORT void rewind();
+	/** Number of recorded calls */
+	VBINTERFACE_EXPORT long long size();
+	VBINTERFACE_EXPORT bool atEnd();
+	VBINTERFACE_EXPORT Stats stats();
+
+	/** Functions replaying the open trace */
+	VBINTERFACE_EXPORT T_VBVMR_INTERFACE backend();
+}
@@ -0,0 +1,203 @@
+#include "VBScheduler.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+	/** Interval growth per idle run */
+	const double BACKOFF = 1.5;
+	/** Part of its interval a job may run early to share a wakeup */
+	const int EARLY_DIVISOR = 4;
+
+	const qint64 NS_PER_MS = 1000000;
+}
+
+VBScheduler::VBScheduler( QObject* parent ) : QObject( parent ) {
+	timer.setSingleShot( true );
+	timer.setTimerType( Qt::PreciseTimer );
+	clock.start();
+
+	QObject::connect( &timer, &QTimer::timeout, this, &VBScheduler::run );
+}
+
+int VBScheduler::add( const QString& name, int minMs, int maxMs, Task task ) {
+	Job job;
+	job.name = name;
+	job.task = task;
+	job.minMs = qMax( minMs, 1 );
+	job.maxMs = qMax( maxMs, job.minMs );
+	job.intervalMs = job.minMs;
+	job.stats.name = name;
+
+	jobs[nextId] = job;
+	return nextId++;
+}
+
+void VBScheduler::remove( int id ) {
+	if ( jobs.erase( id ) != 0 ) {
+		rearm();
+	}
+}
+
+void VBScheduler::setEnabled( int id, bool enabled ) {
+	auto it = jobs.find( id );
+	if ( it == jobs.end() || it->second.enabled == enabled ) {
+		return;
+	}
+
+	Job& job = it->second;
+	job.enabled = enabled;
+	job.intervalMs = job.minMs;
+	if ( enabled ) {
+		plan( job, clock.nsecsElapsed() );
+	}
+
+	rearm();
+}
+
+bool VBScheduler::isEnabled( int id ) {
+	auto it = jobs.find( id );
+	return it != jobs.end() && it->second.enabled;
+}
+
+void VBScheduler::setIntervals( int id, int minMs, int maxMs ) {
+	auto it = jobs.find( id );
+	if ( it == jobs.end() ) {
+		return;
+	}
+
+	Job& job = it->second;
+	job.minMs = qMax( minMs, 1 );
+	job.maxMs = qMax( maxMs, job.minMs );
+	job.intervalMs = job.minMs;
+	if ( job.enabled ) {
+		plan( job, clock.nsecsElapsed() );
+		rearm();
+	}
+}
+
+void VBScheduler::wake( int id ) {
+	auto it = jobs.find( id );
+	if ( it == jobs.end() || !it->second.enabled || it->second.intervalMs == it->second.minMs ) {
+		return;
+	}
+
+	// Pull the deadline in if the stretched interval would keep it waiting longer
+	Job& job = it->second;
+	job.intervalMs = job.minMs;
+	qint64 now = clock.nsecsElapsed();
+	if ( job.dueNs > now + job.minMs * NS_PER_MS ) {
+		plan( job, now );
+		rearm();
+	}
+}
+
+VBScheduler::Job_Stats VBScheduler::jobStats( int id ) {
+	auto it = jobs.find( id );
+	if ( it == jobs.end() ) {
+		return Job_Stats();
+	}
+
+	Job_Stats stats = it->second.stats;
+	stats.enabled = it->second.enabled;
+	stats.intervalMs = it->second.intervalMs;
+	return stats;
+}
+
+VBScheduler::Stats VBScheduler::stats() {
+	return totals;
+}
+
+void VBScheduler::resetStats() {
+	totals = Stats();
+	for ( auto& entry : jobs ) {
+		entry.second.stats = Job_Stats();
+		entry.second.stats.name = entry.second.name;
+	}
+}
+
+void VBScheduler::plan( Job& job, qint64 fromNs ) {
+	qint64 intervalNs = job.intervalMs * NS_PER_MS;
+	job.dueNs = fromNs + intervalNs;
+	job.earliestNs = job.dueNs - intervalNs / EARLY_DIVISOR;
+}
+
+void VBScheduler::rearm() {
+	qint64 next = -1;
+	for ( const auto& entry : jobs ) {
+		if ( entry.second.enabled && ( next < 0 || entry.second.dueNs < next ) ) {
+			next = entry.second.dueNs;
+		}
+	}
+
+	if ( next < 0 ) {
+		timer.stop();
+		return;
+	}
+
+	// Round up, waking before the deadline would only find nothing to do
+	qint64 wait = next - clock.nsecsElapsed();
+	timer.start( wait <= 0 ? 0 : (int) ( ( wait + NS_PER_MS - 1 ) / NS_PER_MS ) );
+}
+
+void VBScheduler::run() {
+	qint64 now = clock.nsecsElapsed();
+
+	std::vector<int> due;
+	for ( const auto& entry : jobs ) {
+		if ( entry.second.enabled && entry.second.earliestNs <= now ) {
+			due.push_back( entry.first );
+		}
+	}
+
+	if ( !due.empty() ) {
+		totals.wakeups++;
+	}
+
+	for ( int id : due ) {
+		// An earlier task may have removed or disabled it
+		auto it = jobs.find( id );
+		if ( it == jobs.end() || !it->second.enabled ) {
+			continue;
+		}
+
+		Job& job = it->second;
+		qint64 start = clock.nsecsElapsed();
+		qint64 lateness = ( start - job.dueNs ) / 1000;
+
+		// RFC 3550 D(i-1,i): run interval minus deadline interval, i.e. the change in lateness
+		if ( job.stats.runs > 0 ) {
+			double difference = (double) ( lateness - job.stats.lastLatenessUs );
+			job.stats.jitterUs += ( std::fabs( difference ) - job.stats.jitterUs ) / 16;
+		}
+
+		job.stats.runs++;
+		job.stats.sharedRuns += due.size() > 1 ? 1 : 0;
+		job.stats.lastLatenessUs = lateness;
+		job.stats.maxLatenessUs = std::max( job.stats.maxLatenessUs, lateness );
+		totals.runs++;
+
+		// Copied, the task may remove its own job
+		Task task = job.task;
+		bool active = task();
+
+		it = jobs.find( id );
+		if ( it == jobs.end() || !it->second.enabled ) {
+			continue;
+		}
+
+		Job& after = it->second;
+		if ( active ) {
+			after.intervalMs = after.minMs;
+		} else {
+			after.intervalMs = std::min( after.maxMs, (int) std::ceil( after.intervalMs * BACKOFF ) );
+		}
+
+		// From the deadline rather than now keeps jobs in phase, unless it fell a whole interval behind
+		plan( after, start - after.dueNs < after.intervalMs * NS_PER_MS ? after.dueNs : start );
+	}
+
+	rearm();
+}
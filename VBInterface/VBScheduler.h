@@ -0,0 +1,94 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QTimer>
+#include <functional>
+#include <map>
+
+/**
+* Runs the library's periodic work off one timer
+*
+* Every job has a minimum and a maximum interval. A job that reports
+* activity runs at its minimum interval, every idle run stretches its
+* interval until it reaches the maximum, so an idle connection costs a few
+* wakeups per second and a busy one is polled at full rate.
+*
+* Jobs may run up to a quarter of their interval early, the scheduler
+* sleeps until the first job cannot wait any longer and then runs every job
+* whose window has opened, so independent jobs share wakeups. How late each
+* job runs compared to its deadline is tracked per job.
+**/
+class VBINTERFACE_EXPORT VBScheduler : public QObject {
+	Q_OBJECT
+
+public:
+	/** Does the job's work, returns whether there was activity */
+	typedef std::function<bool()> Task;
+
+	struct Job_Stats {
+		QString name;
+		bool enabled = false;
+		qint64 runs = 0;
+		/** Runs that shared their wakeup with another job */
+		qint64 sharedRuns = 0;
+		/** Interval the job is currently at */
+		int intervalMs = 0;
+		/** Run time compared to the deadline, negative when run early */
+		qint64 lastLatenessUs = 0;
+		qint64 maxLatenessUs = 0;
+		/** RFC 3550 interarrival jitter, the smoothed difference between consecutive run intervals and their deadline intervals */
+		double jitterUs = 0;
+	};
+
+	struct Stats {
+		qint64 wakeups = 0;
+		qint64 runs = 0;
+	};
+
+	explicit VBScheduler( QObject* parent = nullptr );
+
+	/** Add a disabled job, returns its id */
+	int add( const QString& name, int minMs, int maxMs, Task task );
+	/** Safe from inside a task */
+	void remove( int id );
+	/** Enabled jobs first run one minimum interval from now */
+	void setEnabled( int id, bool enabled );
+	bool isEnabled( int id );
+	/** minMs == maxMs keeps a job at a fixed rate */
+	void setIntervals( int id, int minMs, int maxMs );
+	/** Activity seen outside the job, e.g. a write, drops it back to its minimum interval */
+	void wake( int id );
+
+	Job_Stats jobStats( int id );
+	Stats stats();
+	void resetStats();
+
+private slots:
+	void run();
+
+private:
+	struct Job {
+		QString name;
+		Task task;
+		bool enabled = false;
+		int minMs = 0;
+		int maxMs = 0;
+		int intervalMs = 0;
+		/** Deadline and earliest run time, clock nanoseconds */
+		qint64 dueNs = 0;
+		qint64 earliestNs = 0;
+		Job_Stats stats;
+	};
+
+	QTimer timer;
+	QElapsedTimer clock;
+	std::map<int, Job> jobs;
+	int nextId = 1;
+	Stats totals;
+
+	void plan( Job& job, qint64 fromNs );
+	void rearm();
+};
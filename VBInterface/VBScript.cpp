@@ -0,0 +1,110 @@
+#include "VBScript.h"
+
+void VBScript::setFloat( const QString& req, float val ) {
+	Entry* entry = find( req );
+	if ( entry == nullptr ) {
+		list.push_back( Entry() );
+		entry = &list.back();
+	}
+
+	entry->kind = FLOAT;
+	entry->req = req;
+	entry->number = val;
+	entry->text.clear();
+}
+
+void VBScript::setString( const QString& req, const QString& val ) {
+	Entry* entry = find( req );
+	if ( entry == nullptr ) {
+		list.push_back( Entry() );
+		entry = &list.back();
+	}
+
+	entry->kind = STRING;
+	entry->req = req;
+	entry->number = 0;
+	entry->text = val;
+}
+
+void VBScript::appendRaw( const QString& script ) {
+	Entry entry;
+	entry.kind = RAW;
+	entry.number = 0;
+	entry.text = script;
+	list.push_back( entry );
+}
+
+void VBScript::append( const VBScript& other ) {
+	for ( const Entry& entry : other.list ) {
+		switch ( entry.kind ) {
+			case FLOAT:
+				setFloat( entry.req, entry.number );
+				break;
+			case STRING:
+				setString( entry.req, entry.text );
+				break;
+			case RAW:
+				appendRaw( entry.text );
+				break;
+		}
+	}
+}
+
+bool VBScript::isEmpty() const {
+	return list.empty();
+}
+
+int VBScript::size() const {
+	return (int) list.size();
+}
+
+void VBScript::clear() {
+	list.clear();
+}
+
+const std::vector<VBScript::Entry>& VBScript::entries() const {
+	return list;
+}
+
+QString VBScript::toString() const {
+	QString script;
+
+	for ( const Entry& entry : list ) {
+		switch ( entry.kind ) {
+			case FLOAT:
+				script.append( entry.req + " = " + QString::number( entry.number ) );
+				break;
+			case STRING:
+				if ( !canQuote( entry.text ) ) {
+					continue;
+				}
+				script.append( entry.req + " = \"" + entry.text + "\"" );
+				break;
+			case RAW:
+				script.append( entry.text );
+				break;
+		}
+		script.append( "\n" );
+	}
+
+	return script;
+}
+
+bool VBScript::canQuote( const QString& text ) {
+	return !text.contains( '"' ) && !text.contains( '\n' ) && !text.contains( '\r' );
+}
+
+VBScript::Entry* VBScript::find( const QString& req ) {
+	// Raw lines may touch anything, only merge writes made after the last one
+	for ( auto it = list.rbegin(); it != list.rend(); ++it ) {
+		if ( it->kind == RAW ) {
+			return nullptr;
+		}
+
+		if ( it->req == req ) {
+			return &*it;
+		}
+	}
+
+	return nullptr;
+}
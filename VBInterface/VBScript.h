@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QString>
+#include <vector>
+
+/** Parameter writes collected into one VBVMR_SetParameters script */
+class VBINTERFACE_EXPORT VBScript {
+public:
+	enum Kind {
+		FLOAT,
+		STRING,
+		/** Script text passed through as is */
+		RAW
+	};
+
+	struct Entry {
+		Kind kind;
+		QString req;
+		float number;
+		QString text;
+	};
+
+	/** Set a float, replaces an earlier write to the same parameter */
+	void setFloat( const QString& req, float val );
+	/** Set a string, replaces an earlier write to the same parameter */
+	void setString( const QString& req, const QString& val );
+	/** Append raw script lines */
+	void appendRaw( const QString& script );
+	void append( const VBScript& other );
+
+	bool isEmpty() const;
+	int size() const;
+	void clear();
+
+	const std::vector<Entry>& entries() const;
+	/** Script text, one instruction per line, leaving out strings canQuote() rejects */
+	QString toString() const;
+
+	/** Scripts have no escapes, a value holding a quote or a line break has to be set on its own */
+	static bool canQuote( const QString& text );
+
+private:
+	std::vector<Entry> list;
+
+	Entry* find( const QString& req );
+};
@@ -0,0 +1,340 @@
+#include "VBServer.h"
+
+#include <QDebug>
+
+VBServer::VBServer( VBInterface* vb, QObject* parent ) : QObject( parent ), vb( vb ) {
+	QObject::connect( &server, &QLocalServer::newConnection, this, &VBServer::onNewConnection );
+
+	QObject::connect( vb, &VBInterface::ready, this, &VBServer::broadcastState );
+	QObject::connect( vb, &VBInterface::connectionLost, this, &VBServer::broadcastState );
+	QObject::connect( vb, &VBInterface::reconnected, this, &VBServer::broadcastState );
+
+	// The connection's poller owns the dirty flag, asking it here as well could take a change from it
+	QObject::connect( vb, &VBInterface::parametersChanged, this, &VBServer::notifyDirty );
+}
+
+VBServer::~VBServer() {
+	close();
+}
+
+bool VBServer::listen( QString name ) {
+	// A crashed server may have left its socket behind
+	QLocalServer::removeServer( name );
+
+	if ( !server.listen( name ) ) {
+		qCritical() << "Cannot listen on" << name << server.errorString();
+		return false;
+	}
+
+	qInfo() << "Sharing Voicemeeter connection on" << name;
+	return true;
+}
+
+void VBServer::close() {
+	server.close();
+
+	std::map<QLocalSocket*, Client> dropped;
+	dropped.swap( clients );
+	for ( auto& entry : dropped ) {
+		entry.first->disconnect( this );
+		entry.first->abort();
+		entry.first->deleteLater();
+	}
+}
+
+bool VBServer::isListening() {
+	return server.isListening();
+}
+
+int VBServer::clientCount() {
+	return (int) clients.size();
+}
+
+void VBServer::setDirtyPollInterval( int msecs, int idleMsecs ) {
+	vb->setPollInterval( msecs, idleMsecs );
+}
+
+void VBServer::onNewConnection() {
+	while ( QLocalSocket* socket = server.nextPendingConnection() ) {
+		clients[socket] = Client();
+
+		QObject::connect( socket, &QLocalSocket::readyRead, this, &VBServer::onReadyRead );
+		QObject::connect( socket, &QLocalSocket::disconnected, this, &VBServer::onDisconnected );
+
+		emit clientConnected();
+	}
+}
+
+void VBServer::onDisconnected() {
+	QLocalSocket* socket = qobject_cast<QLocalSocket*>( sender() );
+	if ( socket == nullptr || clients.erase( socket ) == 0 ) {
+		return;
+	}
+
+	socket->deleteLater();
+	emit clientDisconnected();
+}
+
+void VBServer::onReadyRead() {
+	QLocalSocket* socket = qobject_cast<QLocalSocket*>( sender() );
+	auto it = clients.find( socket );
+	if ( it == clients.end() ) {
+		return;
+	}
+
+	Client& client = it->second;
+	client.in.append( socket->readAll() );
+
+	// Handle every complete frame, consecutive writes go out as one script
+	VBScript writes;
+	int offset = 0;
+	for ( ;; ) {
+		int size = VBProtocol::frameSize( client.in, offset );
+		if ( size == 0 ) {
+			break;
+		}
+
+		if ( size < 0 ) {
+			qWarning() << "Dropping client sending a malformed frame";
+			socket->abort();
+			return;
+		}
+
+		VBProtocol::Reader reader( client.in.constData() + offset + sizeof( quint32 ), size - (int) sizeof( quint32 ) );
+		quint32 id = reader.get<quint32>();
+		quint8 op = reader.get<quint8>();
+		if ( !handle( client, id, op, reader, writes ) ) {
+			qWarning() << "Dropping client sending a truncated request" << op;
+			socket->abort();
+			return;
+		}
+
+		offset += size;
+	}
+
+	flushWrites( writes );
+	client.in.remove( 0, offset );
+
+	if ( !client.out.isEmpty() ) {
+		socket->write( client.out );
+		client.out.clear();
+	}
+}
+
+bool VBServer::handle( Client& client, quint32 id, quint8 op, VBProtocol::Reader& reader, VBScript& writes ) {
+	using namespace VBProtocol;
+	Writer reply( client.out );
+
+	switch ( op ) {
+		case SET_FLOAT: {
+			QString req = reader.getString();
+			float val = reader.get<float>();
+			if ( reader.ok() ) {
+				writes.setFloat( req, val );
+			}
+			break;
+		}
+
+		case SET_STRING: {
+			QString req = reader.getString();
+			QString val = reader.getString();
+			if ( reader.ok() ) {
+				writes.setString( req, val );
+			}
+			break;
+		}
+
+		case SET_PARAMETERS: {
+			QString script = reader.getString();
+			if ( reader.ok() ) {
+				writes.appendRaw( script );
+			}
+			break;
+		}
+
+		case BATCH: {
+			int count = reader.get<quint16>();
+			for ( int i = 0; i < count && reader.ok(); i++ ) {
+				quint8 kind = reader.get<quint8>();
+				if ( kind == VBScript::RAW ) {
+					QString script = reader.getString();
+					if ( reader.ok() ) {
+						writes.appendRaw( script );
+					}
+					continue;
+				}
+
+				QString req = reader.getString();
+				if ( kind == VBScript::FLOAT ) {
+					float val = reader.get<float>();
+					if ( reader.ok() ) {
+						writes.setFloat( req, val );
+					}
+				} else if ( kind == VBScript::STRING ) {
+					QString val = reader.getString();
+					if ( reader.ok() ) {
+						writes.setString( req, val );
+					}
+				} else {
+					qWarning() << "Unknown batch entry" << kind;
+					break;
+				}
+			}
+			break;
+		}
+
+		case READ_FLOAT: {
+			QString req = reader.getString();
+			if ( !reader.ok() ) {
+				return false;
+			}
+			flushWrites( writes );
+
+			float val = vb->readFloat( req );
+			reply.begin( id, REPLY );
+			reply.put<float>( val );
+			reply.finish();
+			break;
+		}
+
+		case READ_STRING: {
+			QString req = reader.getString();
+			if ( !reader.ok() ) {
+				return false;
+			}
+			flushWrites( writes );
+
+			QString val = vb->readString( req );
+			reply.begin( id, REPLY );
+			reply.putString( val );
+			reply.finish();
+			break;
+		}
+
+		case GET_LEVEL_FRAME: {
+			VBInterface::Level_Tap tap = (VBInterface::Level_Tap) reader.get<quint8>();
+			if ( !reader.ok() ) {
+				return false;
+			}
+			VBInterface::Level_Frame frame = vb->getLevelFrame( tap );
+
+			reply.begin( id, REPLY );
+			reply.put<quint8>( frame.inputTap );
+			reply.put<quint8>( (quint8) frame.numInputs );
+			reply.put<quint8>( (quint8) frame.numOutputs );
+			reply.putBytes( reinterpret_cast<const char*>( frame.input ), frame.numInputs * sizeof( float ) );
+			reply.putBytes( reinterpret_cast<const char*>( frame.output ), frame.numOutputs * sizeof( float ) );
+			reply.finish();
+			break;
+		}
+
+		case GET_DEVICES: {
+			bool output = reader.get<quint8>() != 0;
+			if ( !reader.ok() ) {
+				return false;
+			}
+			std::vector<VBInterface::Device> devices = output ? vb->getOutputDevices() : vb->getInputDevices();
+
+			reply.begin( id, REPLY );
+			reply.put<quint16>( (quint16) devices.size() );
+			for ( const VBInterface::Device& device : devices ) {
+				reply.put<quint8>( device.type );
+				reply.putString( device.name );
+				reply.putString( device.hardwareID );
+			}
+			reply.finish();
+			break;
+		}
+
+		case SET_DEVICE: {
+			bool output = reader.get<quint8>() != 0;
+			VBInterface::Channel channel = (VBInterface::Channel) reader.get<quint8>();
+			VBInterface::Device device;
+			device.type = (VBInterface::Device_Type) reader.get<quint8>();
+			device.name = reader.getString();
+			if ( !reader.ok() ) {
+				break;
+			}
+
+			flushWrites( writes );
+
+			// Without a type the server picks one from its preferred types
+			if ( output && device.type == VBInterface::UNKNOWN ) {
+				vb->setOutputDevice( channel, device.name );
+			} else if ( output ) {
+				vb->setOutputDevice( channel, device );
+			} else if ( device.type == VBInterface::UNKNOWN ) {
+				vb->setInputDevice( channel, device.name );
+			} else {
+				vb->setInputDevice( channel, device );
+			}
+			break;
+		}
+
+		case GET_STATE:
+			reply.begin( id, REPLY );
+			reply.put<quint8>( vb->getConnectionState() );
+			reply.put<quint8>( vb->getType() );
+			reply.finish();
+			break;
+
+		case SUBSCRIBE:
+			client.subscribed = reader.get<quint8>() != 0;
+			break;
+
+		default:
+			qWarning() << "Unknown request" << op;
+			return true;
+	}
+
+	// Writes and subscriptions are only acknowledged when the client asks for it
+	if ( id != 0 && ( op == SET_FLOAT || op == SET_STRING || op == SET_PARAMETERS || op == BATCH || op == SET_DEVICE || op == SUBSCRIBE ) ) {
+		flushWrites( writes );
+		reply.begin( id, REPLY );
+		reply.finish();
+	}
+	return true;
+}
+
+void VBServer::flushWrites( VBScript& writes ) {
+	if ( writes.isEmpty() ) {
+		return;
+	}
+
+	vb->apply( writes );
+	writes.clear();
+}
+
+void VBServer::notifyDirty() {
+	if ( !vb->isReady() ) {
+		return;
+	}
+
+	QByteArray frame;
+	VBProtocol::Writer notify( frame );
+	notify.begin( 0, VBProtocol::NOTIFY_DIRTY );
+	notify.finish();
+
+	for ( auto& entry : clients ) {
+		if ( entry.second.subscribed ) {
+			entry.first->write( frame );
+		}
+	}
+}
+
+void VBServer::broadcastState() {
+	QByteArray frame;
+	writeState( frame );
+
+	for ( auto& entry : clients ) {
+		entry.first->write( frame );
+	}
+}
+
+void VBServer::writeState( QByteArray& out ) {
+	VBProtocol::Writer notify( out );
+	notify.begin( 0, VBProtocol::NOTIFY_STATE );
+	notify.put<quint8>( vb->getConnectionState() );
+	notify.put<quint8>( vb->getType() );
+	notify.finish();
+}
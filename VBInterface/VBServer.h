@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <map>
+
+#include "VBInterface.h"
+#include "VBProtocol.h"
+
+/** Shares one VBInterface connection with other processes over a local socket, see VBClient */
+class VBINTERFACE_EXPORT VBServer : public QObject {
+	Q_OBJECT
+
+public:
+	/** vb must outlive the server and live on the server's thread, all DLL calls happen there */
+	VBServer( VBInterface* vb, QObject* parent = nullptr );
+	~VBServer();
+
+public slots:
+	/** Start accepting clients */
+	bool listen( QString name = VBProtocol::DEFAULT_SERVER_NAME );
+	/** Stop accepting clients and drop the connected ones */
+	void close();
+	bool isListening();
+	/** Number of connected clients */
+	int clientCount();
+	/** How often the connection checks parameters for changes, slowing down to idleMsecs while nothing changes, see VBInterface::setPollInterval() */
+	void setDirtyPollInterval( int msecs, int idleMsecs = 500 );
+
+signals:
+	void clientConnected();
+	void clientDisconnected();
+
+private slots:
+	void onNewConnection();
+	void onReadyRead();
+	void onDisconnected();
+	void broadcastState();
+	void notifyDirty();
+
+private:
+	struct Client {
+		QByteArray in;
+		QByteArray out;
+		bool subscribed = false;
+	};
+
+	VBInterface* vb;
+	QLocalServer server;
+	std::map<QLocalSocket*, Client> clients;
+
+	/** Returns false for a request too short to answer, the client is dropped */
+	bool handle( Client& client, quint32 id, quint8 op, VBProtocol::Reader& reader, VBScript& writes );
+	void flushWrites( VBScript& writes );
+	void writeState( QByteArray& out );
+};
@@ -0,0 +1,606 @@
+#include "VBSimulator.h"
+
+#include "VBLayout.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	const long NO_SERVER = -2;
+	const long NO_LEVEL = -3;
+	const long OUT_OF_RANGE = -4;
+
+	// Same limits as the recorder
+	const int PARAMETER_STRING_SIZE = 512;
+	const int DEVICE_STRING_SIZE = 256;
+	const int CLIENT_NAME_SIZE = 64;
+	const int MAX_AUDIO_CHANNELS = 128;
+
+	const double PI = 3.14159265358979323846;
+
+	std::mutex mutex;
+	VBSimulator::Settings current;
+	VBSimulator::Stats counters;
+	std::map<std::string, float, std::less<>> floats;
+	std::map<std::string, std::string, std::less<>> strings;
+	bool dirty = false;
+	long long raisedNs = 0;
+	long long reportedNs = 0;
+	unsigned long long random = 0x9e3779b97f4a7c15ull;
+
+	// Audio callback, set under the server lock, the driver thread gets its own copy
+	struct Audio_Client {
+		long modes = 0;
+		T_VBVMR_VBAUDIOCALLBACK callback = nullptr;
+		void* user = nullptr;
+		std::string name;
+	};
+
+	Audio_Client audioClient;
+	bool audioRegistered = false;
+	std::thread driver;
+	std::atomic<bool> driving( false );
+	std::atomic<long long> audioBuffers( 0 );
+	std::atomic<long long> clicks( 0 );
+
+	long long nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+	}
+
+	/** Holds the server for one call, for as long as the settings say a call takes */
+	class Call {
+	public:
+		Call() : lock( mutex, std::defer_lock ) {
+			long long start = nowNs();
+			lock.lock();
+			long long acquired = nowNs();
+			if ( acquired - start > counters.maxWaitNs ) {
+				counters.maxWaitNs = acquired - start;
+			}
+			counters.calls++;
+
+			long long latencyNs = current.callLatencyUs * 1000LL;
+			if ( current.latencyJitterUs > 0 ) {
+				random ^= random << 13;
+				random ^= random >> 7;
+				random ^= random << 17;
+				latencyNs += (long long) ( random % ( current.latencyJitterUs * 1000ull ) );
+			}
+
+			// Spin, sleeping takes far longer than a call does
+			while ( nowNs() - acquired < latencyNs ) {
+			}
+		}
+
+		bool offline() const {
+			return current.offline;
+		}
+
+	private:
+		std::unique_lock<std::mutex> lock;
+	};
+
+	void raiseDirty() {
+		counters.writes++;
+		if ( !dirty ) {
+			dirty = true;
+			raisedNs = nowNs();
+		}
+	}
+
+	void copyString( const std::string& value, char* out, int size ) {
+		strncpy( out, value.c_str(), size - 1 );
+		out[size - 1] = 0;
+	}
+
+	void copyWideString( const std::string& value, unsigned short* out, int size ) {
+		int length = (int) value.size() < size - 1 ? (int) value.size() : size - 1;
+		for ( int i = 0; i < length; i++ ) {
+			out[i] = (unsigned char) value[i];
+		}
+		out[length] = 0;
+	}
+
+	long __stdcall login() {
+		Call call;
+		return 0;
+	}
+
+	long __stdcall logout() {
+		Call call;
+		return 0;
+	}
+
+	long __stdcall runVoicemeeter( long ) {
+		Call call;
+		return 0;
+	}
+
+	long __stdcall getVoicemeeterType( long* pType ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		*pType = current.type;
+		return 0;
+	}
+
+	long __stdcall getVoicemeeterVersion( long* pVersion ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		// v.0.9.0, with the type as major version like the real servers
+		*pVersion = ( current.type << 24 ) | ( 9 << 8 );
+		return 0;
+	}
+
+	long __stdcall isParametersDirty() {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		if ( !dirty ) {
+			return 0;
+		}
+
+		dirty = false;
+		reportedNs = raisedNs;
+		counters.dirtyReads++;
+		return 1;
+	}
+
+	long __stdcall getParameterFloat( char* szParamName, float* pValue ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		auto it = floats.find( std::string_view( szParamName ) );
+		*pValue = it != floats.end() ? it->second : 0;
+		return 0;
+	}
+
+	long __stdcall getParameterStringA( char* szParamName, char* szString ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		auto it = strings.find( std::string_view( szParamName ) );
+		copyString( it != strings.end() ? it->second : std::string(), szString, PARAMETER_STRING_SIZE );
+		return 0;
+	}
+
+	long __stdcall getParameterStringW( char* szParamName, unsigned short* wszString ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		auto it = strings.find( std::string_view( szParamName ) );
+		copyWideString( it != strings.end() ? it->second : std::string(), wszString, PARAMETER_STRING_SIZE );
+		return 0;
+	}
+
+	long __stdcall getLevel( long nType, long nuChannel, float* pValue ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		if ( nType < 0 || nType > 3 ) {
+			return NO_LEVEL;
+		}
+
+		VBLayout::Counts layout = VBLayout::countsOf( current.type );
+		int slots = nType == 3 ? layout.numOutputLevels : layout.numInputLevels;
+		if ( nuChannel < 0 || nuChannel >= slots ) {
+			return OUT_OF_RANGE;
+		}
+
+		// A slow swell, each slot out of phase with the next
+		double seconds = nowNs() / 1e9;
+		*pValue = (float) ( 0.25 + 0.25 * sin( seconds * 2 + nuChannel + nType * 0.5 ) );
+		return 0;
+	}
+
+	long __stdcall getMidiMessage( unsigned char*, long ) {
+		Call call;
+		return call.offline() ? NO_SERVER : 0;
+	}
+
+	long __stdcall setParameterFloat( char* szParamName, float Value ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		auto it = floats.find( std::string_view( szParamName ) );
+		if ( it != floats.end() ) {
+			it->second = Value;
+		} else {
+			floats.emplace( szParamName, Value );
+		}
+		raiseDirty();
+		return 0;
+	}
+
+	std::string_view trim( std::string_view text ) {
+		size_t first = text.find_first_not_of( " \t\r" );
+		if ( first == std::string_view::npos ) {
+			return std::string_view();
+		}
+		size_t last = text.find_last_not_of( " \t\r" );
+		return text.substr( first, last - first + 1 );
+	}
+
+	/** name = number and name = "text", one per line or ';' apart, anything else is skipped */
+	void applyScript( std::string_view script ) {
+		while ( !script.empty() ) {
+			size_t end = script.find_first_of( "\n;" );
+			std::string_view line = script.substr( 0, end );
+			script = end == std::string_view::npos ? std::string_view() : script.substr( end + 1 );
+
+			size_t equals = line.find( '=' );
+			if ( equals == std::string_view::npos ) {
+				continue;
+			}
+
+			std::string name( trim( line.substr( 0, equals ) ) );
+			std::string_view value = trim( line.substr( equals + 1 ) );
+			if ( name.empty() || value.empty() ) {
+				continue;
+			}
+
+			if ( value.front() == '"' ) {
+				size_t close = value.find( '"', 1 );
+				strings[name] = std::string( value.substr( 1, close == std::string_view::npos ? std::string_view::npos : close - 1 ) );
+			} else {
+				floats[name] = strtof( std::string( value ).c_str(), nullptr );
+			}
+		}
+	}
+
+	long __stdcall setParameters( char* szParamScript ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		applyScript( szParamScript );
+		raiseDirty();
+		return 0;
+	}
+
+	long __stdcall setParametersW( unsigned short* ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		raiseDirty();
+		return 0;
+	}
+
+	long __stdcall setParameterStringA( char* szParamName, char* szString ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		strings[szParamName] = szString;
+		raiseDirty();
+		return 0;
+	}
+
+	long __stdcall setParameterStringW( char* szParamName, unsigned short* wszString ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+
+		std::string value;
+		for ( const unsigned short* c = wszString; *c; c++ ) {
+			value += (char) ( *c < 0x80 ? *c : '?' );
+		}
+		strings[szParamName] = value;
+		raiseDirty();
+		return 0;
+	}
+
+	long __stdcall outputGetDeviceNumber() {
+		Call call;
+		return call.offline() ? NO_SERVER : 1;
+	}
+
+	long __stdcall inputGetDeviceNumber() {
+		Call call;
+		return call.offline() ? NO_SERVER : 1;
+	}
+
+	long deviceDesc( bool output, long zindex, long* nType, std::string& name, std::string& hardwareId ) {
+		Call call;
+		if ( call.offline() ) {
+			return NO_SERVER;
+		}
+		if ( zindex != 0 ) {
+			return -1;
+		}
+
+		*nType = VBVMR_DEVTYPE_WDM;
+		name = output ? "Simulated Output" : "Simulated Input";
+		hardwareId = output ? "SIM_OUT" : "SIM_IN";
+		return 0;
+	}
+
+	long __stdcall outputGetDeviceDescA( long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		std::string name, hardwareId;
+		long result = deviceDesc( true, zindex, nType, name, hardwareId );
+		if ( result == 0 ) {
+			copyString( name, szDeviceName, DEVICE_STRING_SIZE );
+			copyString( hardwareId, szHardwareId, DEVICE_STRING_SIZE );
+		}
+		return result;
+	}
+
+	long __stdcall outputGetDeviceDescW( long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		std::string name, hardwareId;
+		long result = deviceDesc( true, zindex, nType, name, hardwareId );
+		if ( result == 0 ) {
+			copyWideString( name, wszDeviceName, DEVICE_STRING_SIZE );
+			copyWideString( hardwareId, wszHardwareId, DEVICE_STRING_SIZE );
+		}
+		return result;
+	}
+
+	long __stdcall inputGetDeviceDescA( long zindex, long* nType, char* szDeviceName, char* szHardwareId ) {
+		std::string name, hardwareId;
+		long result = deviceDesc( false, zindex, nType, name, hardwareId );
+		if ( result == 0 ) {
+			copyString( name, szDeviceName, DEVICE_STRING_SIZE );
+			copyString( hardwareId, szHardwareId, DEVICE_STRING_SIZE );
+		}
+		return result;
+	}
+
+	long __stdcall inputGetDeviceDescW( long zindex, long* nType, unsigned short* wszDeviceName, unsigned short* wszHardwareId ) {
+		std::string name, hardwareId;
+		long result = deviceDesc( false, zindex, nType, name, hardwareId );
+		if ( result == 0 ) {
+			copyWideString( name, wszDeviceName, DEVICE_STRING_SIZE );
+			copyWideString( hardwareId, wszHardwareId, DEVICE_STRING_SIZE );
+		}
+		return result;
+	}
+
+	/** One stream's buffers, inserts write to their own outputs, the main stream reads inputs then buses */
+	struct Audio_Stream {
+		long command;
+		std::vector<float> reads;
+		std::vector<float> writes;
+		VBVMR_T_AUDIOBUFFER buffer;
+
+		Audio_Stream( long command, int numInputs, int numOutputs, int frames ) : command( command ),
+			reads( (size_t) numInputs * frames ), writes( (size_t) numOutputs * frames ) {
+			memset( &buffer, 0, sizeof( buffer ) );
+			buffer.audiobuffer_nbs = frames;
+			buffer.audiobuffer_nbi = numInputs;
+			buffer.audiobuffer_nbo = numOutputs;
+			for ( int c = 0; c < numInputs; c++ ) {
+				buffer.audiobuffer_r[c] = &reads[(size_t) c * frames];
+			}
+			for ( int c = 0; c < numOutputs; c++ ) {
+				buffer.audiobuffer_w[c] = &writes[(size_t) c * frames];
+			}
+		}
+	};
+
+	void driveAudio( VBSimulator::Settings settings, Audio_Client client ) {
+		int frames = settings.audioFrames > 0 ? settings.audioFrames : 480;
+		int sampleRate = settings.sampleRate > 0 ? settings.sampleRate : 48000;
+		VBLayout::Counts layout = VBLayout::countsOf( settings.type );
+
+		std::vector<Audio_Stream> streams;
+		streams.reserve( 3 );
+		if ( client.modes & VBVMR_AUDIOCALLBACK_IN ) {
+			streams.emplace_back( VBVMR_CBCOMMAND_BUFFER_IN, layout.numInputLevels, layout.numInputLevels, frames );
+		}
+		if ( client.modes & VBVMR_AUDIOCALLBACK_OUT ) {
+			streams.emplace_back( VBVMR_CBCOMMAND_BUFFER_OUT, layout.numOutputLevels, layout.numOutputLevels, frames );
+		}
+		if ( client.modes & VBVMR_AUDIOCALLBACK_MAIN ) {
+			streams.emplace_back( VBVMR_CBCOMMAND_BUFFER_MAIN, layout.numInputLevels + layout.numOutputLevels, layout.numOutputLevels, frames );
+		}
+		static_assert( VBLayout::MAX_INPUT_SLOTS + VBLayout::MAX_OUTPUT_SLOTS <= MAX_AUDIO_CHANNELS, "Main stream does not fit a VBVMR_T_AUDIOBUFFER" );
+
+		VBVMR_T_AUDIOINFO info;
+		info.samplerate = sampleRate;
+		info.nbSamplePerFrame = frames;
+		client.callback( client.user, VBVMR_CBCOMMAND_STARTING, &info, 0 );
+
+		Clock::duration period = std::chrono::nanoseconds( frames * 1000000000LL / sampleRate );
+		Clock::time_point next = Clock::now();
+		long long sampleClock = 0;
+		long long count = 0;
+
+		while ( driving.load( std::memory_order_acquire ) ) {
+			for ( Audio_Stream& stream : streams ) {
+				stream.buffer.audiobuffer_sr = sampleRate;
+				int channels = stream.buffer.audiobuffer_nbi;
+				for ( int c = 0; c < channels; c++ ) {
+					float* samples = stream.buffer.audiobuffer_r[c];
+					double step = 2 * PI * 110 * ( c % 8 + 1 ) / sampleRate;
+					for ( int i = 0; i < frames; i++ ) {
+						samples[i] = VBSimulator::SIGNAL_LEVEL * (float) sin( step * ( sampleClock + i ) );
+					}
+				}
+				memset( stream.writes.data(), 0, stream.writes.size() * sizeof( float ) );
+
+				if ( settings.clickInterval > 0 && count % settings.clickInterval == settings.clickInterval - 1 ) {
+					stream.buffer.audiobuffer_r[0][( count * 37 ) % frames] = 1.0f;
+					clicks++;
+				}
+
+				client.callback( client.user, stream.command, &stream.buffer, 0 );
+				audioBuffers++;
+			}
+
+			sampleClock += frames;
+			count++;
+
+			next += period;
+			std::this_thread::sleep_until( next );
+		}
+
+		client.callback( client.user, VBVMR_CBCOMMAND_ENDING, nullptr, 0 );
+	}
+
+	long __stdcall audioCallbackRegister( long mode, T_VBVMR_VBAUDIOCALLBACK pCallback, void* lpUser, char szClientName[64] ) {
+		Call call;
+		if ( call.offline() || pCallback == nullptr || ( mode & ( VBVMR_AUDIOCALLBACK_IN | VBVMR_AUDIOCALLBACK_OUT | VBVMR_AUDIOCALLBACK_MAIN ) ) == 0 ) {
+			return -1;
+		}
+
+		if ( audioRegistered ) {
+			copyString( audioClient.name, szClientName, CLIENT_NAME_SIZE );
+			return 1;
+		}
+
+		audioClient.modes = mode;
+		audioClient.callback = pCallback;
+		audioClient.user = lpUser;
+		audioClient.name.assign( szClientName, strnlen( szClientName, CLIENT_NAME_SIZE ) );
+		audioRegistered = true;
+		return 0;
+	}
+
+	long __stdcall audioCallbackStart() {
+		Call call;
+		if ( call.offline() ) {
+			return -1;
+		}
+		if ( !audioRegistered ) {
+			return -2;
+		}
+		if ( driving ) {
+			return 0;
+		}
+
+		driving = true;
+		driver = std::thread( driveAudio, current, audioClient );
+		return 0;
+	}
+
+	long __stdcall audioCallbackStop() {
+		std::thread stopping;
+		{
+			Call call;
+			if ( !audioRegistered ) {
+				return -2;
+			}
+			driving = false;
+			stopping.swap( driver );
+		}
+
+		// Outside the server lock, the callback may still make calls while it finishes
+		if ( stopping.joinable() ) {
+			stopping.join();
+		}
+		return 0;
+	}
+
+	long __stdcall audioCallbackUnregister() {
+		audioCallbackStop();
+
+		Call call;
+		if ( !audioRegistered ) {
+			return 1;
+		}
+		audioRegistered = false;
+		audioClient = Audio_Client();
+		return 0;
+	}
+}
+
+namespace VBSimulator {
+	void setSettings( const Settings& settings ) {
+		std::lock_guard<std::mutex> lock( mutex );
+		current = settings;
+	}
+
+	Settings settings() {
+		std::lock_guard<std::mutex> lock( mutex );
+		return current;
+	}
+
+	void reset() {
+		std::lock_guard<std::mutex> lock( mutex );
+		counters = Stats();
+		floats.clear();
+		strings.clear();
+		dirty = false;
+		raisedNs = 0;
+		reportedNs = 0;
+		audioBuffers = 0;
+		clicks = 0;
+	}
+
+	Stats stats() {
+		std::lock_guard<std::mutex> lock( mutex );
+		Stats stats = counters;
+		stats.audioBuffers = audioBuffers;
+		stats.clicks = clicks;
+		return stats;
+	}
+
+	long long lastDirtyRaisedNs() {
+		std::lock_guard<std::mutex> lock( mutex );
+		return reportedNs;
+	}
+
+	T_VBVMR_INTERFACE backend() {
+		T_VBVMR_INTERFACE functions;
+		functions.VBVMR_Login = login;
+		functions.VBVMR_Logout = logout;
+		functions.VBVMR_RunVoicemeeter = runVoicemeeter;
+		functions.VBVMR_GetVoicemeeterType = getVoicemeeterType;
+		functions.VBVMR_GetVoicemeeterVersion = getVoicemeeterVersion;
+		functions.VBVMR_IsParametersDirty = isParametersDirty;
+		functions.VBVMR_GetParameterFloat = getParameterFloat;
+		functions.VBVMR_GetParameterStringA = getParameterStringA;
+		functions.VBVMR_GetParameterStringW = getParameterStringW;
+		functions.VBVMR_GetLevel = getLevel;
+		functions.VBVMR_GetMidiMessage = getMidiMessage;
+		functions.VBVMR_SetParameterFloat = setParameterFloat;
+		functions.VBVMR_SetParameters = setParameters;
+		functions.VBVMR_SetParametersW = setParametersW;
+		functions.VBVMR_SetParameterStringA = setParameterStringA;
+		functions.VBVMR_SetParameterStringW = setParameterStringW;
+		functions.VBVMR_Output_GetDeviceNumber = outputGetDeviceNumber;
+		functions.VBVMR_Output_GetDeviceDescA = outputGetDeviceDescA;
+		functions.VBVMR_Output_GetDeviceDescW = outputGetDeviceDescW;
+		functions.VBVMR_Input_GetDeviceNumber = inputGetDeviceNumber;
+		functions.VBVMR_Input_GetDeviceDescA = inputGetDeviceDescA;
+		functions.VBVMR_Input_GetDeviceDescW = inputGetDeviceDescW;
+		functions.VBVMR_AudioCallbackRegister = audioCallbackRegister;
+		functions.VBVMR_AudioCallbackStart = audioCallbackStart;
+		functions.VBVMR_AudioCallbackStop = audioCallbackStop;
+		functions.VBVMR_AudioCallbackUnregister = audioCallbackUnregister;
+		return functions;
+	}
+}
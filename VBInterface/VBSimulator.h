@@ -0,0 +1,72 @@
+#pragma once
+
+#include "vbinterface_global.h"
+
+#include "VBRecord.h"
+
+/**
+* Simulated Voicemeeter server as a T_VBVMR_INTERFACE, no DLL or Voicemeeter needed
+*
+* Parameters written are kept and read back, ones never written read as 0
+* or an empty string. Scripts set the name = number and name = "text"
+* lines they hold, anything fancier only raises the dirty flag.
+* Levels move slowly per slot, there is one output and one input device.
+*
+* A registered audio callback is driven from its own thread once started,
+* with a buffer of audioFrames samples per registered stream at the pace
+* of sampleRate. Every channel carries a quiet sine, and every
+* clickInterval buffers channel 0 of each stream gets one full scale
+* sample, a transient polled levels will usually miss. Inserts get output
+* buffers apart from their inputs, so nothing reaches the outputs unless
+* the client copies it.
+*
+* Every call holds one server lock, as the DLL does, for callLatencyUs plus
+* up to latencyJitterUs. The lock is held spinning rather than sleeping so
+* short latencies stay accurate. Like VBReplay there is one simulator per
+* process.
+*
+* This header does not depend on Qt.
+**/
+namespace VBSimulator {
+	struct Settings {
+		/** VBLayout::Type the server reports */
+		int type = 3;
+		int callLatencyUs = 1;
+		/** Random extra latency per call */
+		int latencyJitterUs = 0;
+		/** Answer every call with -2 as if Voicemeeter quit */
+		bool offline = false;
+		/** Audio stream format, taken when the callback starts */
+		int sampleRate = 48000;
+		int audioFrames = 480;
+		/** Buffers between clicks, 0 for none */
+		int clickInterval = 10;
+	};
+
+	/** Sine amplitude of every channel, clicks are 1.0 */
+	const float SIGNAL_LEVEL = 0.25f;
+
+	struct Stats {
+		long long calls = 0;
+		/** Parameter writes and scripts */
+		long long writes = 0;
+		/** Dirty flag reads that reported a change */
+		long long dirtyReads = 0;
+		/** Longest a call waited for another one to leave the server */
+		long long maxWaitNs = 0;
+		/** Audio buffers handed to the callback, one per stream */
+		long long audioBuffers = 0;
+		long long clicks = 0;
+	};
+
+	VBINTERFACE_EXPORT void setSettings( const Settings& settings );
+	VBINTERFACE_EXPORT Settings settings();
+	/** Forget written parameters, the dirty flag and stats, a registered audio callback stays */
+	VBINTERFACE_EXPORT void reset();
+	VBINTERFACE_EXPORT Stats stats();
+	/** std::chrono::steady_clock nanoseconds of the write that raised the flag the last dirty read reported */
+	VBINTERFACE_EXPORT long long lastDirtyRaisedNs();
+
+	/** Functions of the simulated server */
+	VBINTERFACE_EXPORT T_VBVMR_INTERFACE backend();
+}
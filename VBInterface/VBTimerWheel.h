@@ -0,0 +1,288 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+* Hierarchical timer wheel
+*
+* Four levels of 64 slots, each level's slot spans 64 of the level below,
+* so timers up to 2^24 ticks out are placed directly and later ones wait in
+* the top level until they come in range. Timers live in one pool and are
+* linked into their slot, adding and cancelling is O(1) whatever the
+* number pending; a timer moves down at most once per level before it
+* fires. advance() jumps straight to the next tick with work.
+*
+* Ids carry a generation, a stale id never cancels a newer timer reusing
+* the same pool entry.
+*
+* This header does not depend on Qt.
+**/
+template<typename T>
+class VBTimerWheel {
+public:
+	typedef unsigned long long Id;
+
+	static const int LEVELS = 4;
+	static const int SLOT_BITS = 6;
+	static const int SLOTS = 1 << SLOT_BITS;
+
+	explicit VBTimerWheel( long long startTick = 0 ) : current( startTick ) {
+		for ( int level = 0; level < LEVELS; level++ ) {
+			occupied[level] = 0;
+			for ( int slot = 0; slot < SLOTS; slot++ ) {
+				heads[level][slot] = NONE;
+				tails[level][slot] = NONE;
+			}
+		}
+	}
+
+	/** Add a timer, one due at or before the current tick fires on the next advance(), returns its id, never 0 */
+	Id add( long long dueTick, T value ) {
+		int index;
+		if ( freeList != NONE ) {
+			index = freeList;
+			freeList = nodes[index].next;
+		} else {
+			index = (int) nodes.size();
+			nodes.emplace_back();
+		}
+
+		Node& node = nodes[index];
+		node.dueTick = dueTick;
+		node.value = std::move( value );
+		node.pending = true;
+		link( index );
+		count++;
+		return makeId( index, node.generation );
+	}
+
+	/** False if the timer already fired or was cancelled */
+	bool cancel( Id id ) {
+		int index = indexOf( id );
+		if ( index == NONE ) {
+			return false;
+		}
+
+		unlink( index );
+		release( index );
+		count--;
+		return true;
+	}
+
+	bool contains( Id id ) const {
+		return indexOf( id ) != NONE;
+	}
+
+	/** Pending timers */
+	int size() const {
+		return count;
+	}
+
+	bool isEmpty() const {
+		return count == 0;
+	}
+
+	/** Next tick advance() processes */
+	long long currentTick() const {
+		return current;
+	}
+
+	/** Earliest tick advance() has work at, a timer due or a slot to move down, -1 if empty */
+	long long nextTick() const {
+		if ( count == 0 ) {
+			return -1;
+		}
+
+		long long next = -1;
+		for ( int level = 0; level < LEVELS; level++ ) {
+			if ( !occupied[level] ) {
+				continue;
+			}
+
+			// The level's slots stand for the 64 blocks from the first one not moved down yet
+			int shift = SLOT_BITS * level;
+			long long first = ( current + ( 1ll << shift ) - 1 ) >> shift;
+			int offset = lowestBit( rotate( occupied[level], (int) ( first & ( SLOTS - 1 ) ) ) );
+			long long tick = ( first + offset ) << shift;
+			if ( next < 0 || tick < next ) {
+				next = tick;
+			}
+		}
+		return next;
+	}
+
+	/** Fire every timer due up to and including tick, tick by tick, calls fn( Id, T&&, long long dueTick ), fn may add timers */
+	template<typename F>
+	int advance( long long tick, F&& fn ) {
+		int fired = 0;
+		while ( current <= tick ) {
+			int slot = (int) ( current & ( SLOTS - 1 ) );
+			if ( slot == 0 ) {
+				cascade();
+			}
+
+			int index = heads[0][slot];
+			heads[0][slot] = NONE;
+			tails[0][slot] = NONE;
+			occupied[0] &= ~( 1ull << slot );
+			// Timers added by fn land on the next tick at the earliest
+			current++;
+
+			while ( index != NONE ) {
+				int next = nodes[index].next;
+				Node& node = nodes[index];
+				T value = std::move( node.value );
+				long long dueTick = node.dueTick;
+				Id id = makeId( index, node.generation );
+				release( index );
+				count--;
+				fired++;
+				fn( id, std::move( value ), dueTick );
+				index = next;
+			}
+
+			long long next = nextTick();
+			if ( next < 0 || next > tick ) {
+				current = tick + 1 > current ? tick + 1 : current;
+			} else {
+				current = next;
+			}
+		}
+		return fired;
+	}
+
+private:
+	static const int NONE = -1;
+
+	struct Node {
+		long long dueTick = 0;
+		T value = T();
+		unsigned generation = 1;
+		bool pending = false;
+		int level = 0;
+		int slot = 0;
+		int prev = NONE;
+		int next = NONE;
+	};
+
+	std::vector<Node> nodes;
+	int freeList = NONE;
+	int count = 0;
+	long long current;
+	int heads[LEVELS][SLOTS];
+	int tails[LEVELS][SLOTS];
+	/** Bit per non-empty slot */
+	unsigned long long occupied[LEVELS];
+
+	static Id makeId( int index, unsigned generation ) {
+		return ( (Id) generation << 32 ) | (unsigned) index;
+	}
+
+	int indexOf( Id id ) const {
+		unsigned index = (unsigned) ( id & 0xffffffffu );
+		if ( index >= nodes.size() ) {
+			return NONE;
+		}
+
+		const Node& node = nodes[index];
+		return node.pending && node.generation == (unsigned) ( id >> 32 ) ? (int) index : NONE;
+	}
+
+	/** Bits from position on first, wrapping around */
+	static unsigned long long rotate( unsigned long long value, int position ) {
+		return position ? ( value >> position ) | ( value << ( SLOTS - position ) ) : value;
+	}
+
+	static int lowestBit( unsigned long long value ) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64( &index, value );
+		return (int) index;
+#else
+		return __builtin_ctzll( value );
+#endif
+	}
+
+	/** Put a timer in the slot matching its distance from the current tick */
+	void link( int index ) {
+		Node& node = nodes[index];
+		long long due = node.dueTick > current ? node.dueTick : current;
+		long long distance = due - current;
+
+		int level = 0;
+		while ( level < LEVELS - 1 && distance >= ( 1ll << ( SLOT_BITS * ( level + 1 ) ) ) ) {
+			level++;
+		}
+
+		long long position = due >> ( SLOT_BITS * level );
+		if ( distance >= ( 1ll << ( SLOT_BITS * LEVELS ) ) ) {
+			// Out of range, park in the last slot of the top level and place it again when that cascades
+			position = ( current >> ( SLOT_BITS * level ) ) + SLOTS - 1;
+		}
+		int slot = (int) ( position & ( SLOTS - 1 ) );
+
+		node.level = level;
+		node.slot = slot;
+		node.next = NONE;
+		node.prev = tails[level][slot];
+		if ( node.prev != NONE ) {
+			nodes[node.prev].next = index;
+		} else {
+			heads[level][slot] = index;
+		}
+		tails[level][slot] = index;
+		occupied[level] |= 1ull << slot;
+	}
+
+	void unlink( int index ) {
+		Node& node = nodes[index];
+		if ( node.prev != NONE ) {
+			nodes[node.prev].next = node.next;
+		} else {
+			heads[node.level][node.slot] = node.next;
+		}
+		if ( node.next != NONE ) {
+			nodes[node.next].prev = node.prev;
+		} else {
+			tails[node.level][node.slot] = node.prev;
+		}
+		if ( heads[node.level][node.slot] == NONE ) {
+			occupied[node.level] &= ~( 1ull << node.slot );
+		}
+	}
+
+	void release( int index ) {
+		Node& node = nodes[index];
+		node.value = T();
+		node.pending = false;
+		node.generation++;
+		node.next = freeList;
+		freeList = index;
+	}
+
+	/** Move the timers of the upper level slots starting at the current tick down, top level first */
+	void cascade() {
+		for ( int level = LEVELS - 1; level > 0; level-- ) {
+			long long span = 1ll << ( SLOT_BITS * level );
+			if ( current & ( span - 1 ) ) {
+				continue;
+			}
+
+			int slot = (int) ( ( current >> ( SLOT_BITS * level ) ) & ( SLOTS - 1 ) );
+			int index = heads[level][slot];
+			heads[level][slot] = NONE;
+			tails[level][slot] = NONE;
+			occupied[level] &= ~( 1ull << slot );
+			while ( index != NONE ) {
+				int next = nodes[index].next;
+				link( index );
+				index = next;
+			}
+		}
+	}
+};
@@ -0,0 +1,202 @@
+#include "VBTrace.h"
+
+#if VB_TRACE_ENABLED
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+	struct Event {
+		/** 2 * ticket + 1 while being written, 2 * ticket + 2 once complete */
+		std::atomic<unsigned long long> sequence;
+		unsigned long long begin;
+		unsigned long long end;
+		const char* name;
+		VBTrace::Kind kind;
+		unsigned thread;
+		long result;
+		char param[VBTrace::PARAM_SIZE];
+	};
+
+	struct Copy {
+		unsigned long long begin;
+		unsigned long long end;
+		const char* name;
+		VBTrace::Kind kind;
+		unsigned thread;
+		long result;
+		char param[VBTrace::PARAM_SIZE];
+	};
+
+	static_assert( ( VBTrace::CAPACITY & ( VBTrace::CAPACITY - 1 ) ) == 0, "Trace capacity must be a power of two" );
+
+	Event ring[VBTrace::CAPACITY];
+	std::atomic<unsigned long long> head( 0 );
+	std::atomic<unsigned> nextThread( 1 );
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	thread_local const char* scopeParam = nullptr;
+
+	unsigned threadId() {
+		thread_local unsigned id = nextThread.fetch_add( 1, std::memory_order_relaxed );
+		return id;
+	}
+
+	void copyParam( char* dest, const char* param ) {
+		if ( param == nullptr ) {
+			dest[0] = '\0';
+			return;
+		}
+
+		strncpy( dest, param, VBTrace::PARAM_SIZE - 1 );
+		dest[VBTrace::PARAM_SIZE - 1] = '\0';
+	}
+
+	void appendEscaped( std::string& out, const char* text ) {
+		for ( const char* c = text; *c; c++ ) {
+			switch ( *c ) {
+				case '"':
+					out += "\\\"";
+					break;
+				case '\\':
+					out += "\\\\";
+					break;
+				default:
+					if ( (unsigned char) *c < 0x20 ) {
+						out += ' ';
+					} else {
+						out += *c;
+					}
+					break;
+			}
+		}
+	}
+}
+
+namespace VBTrace {
+	std::atomic<bool> enabled( false );
+
+	void setEnabled( bool enable ) {
+		enabled.store( enable, std::memory_order_relaxed );
+	}
+
+	unsigned long long now() {
+		return (unsigned long long) std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - epoch ).count();
+	}
+
+	void record( Kind kind, const char* name, unsigned long long begin, unsigned long long end, long result, const char* param ) {
+		unsigned long long ticket = head.fetch_add( 1, std::memory_order_relaxed );
+		Event& event = ring[ticket & ( CAPACITY - 1 )];
+
+		event.sequence.store( ticket * 2 + 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+
+		event.begin = begin;
+		event.end = end;
+		event.name = name;
+		event.kind = kind;
+		event.thread = threadId();
+		event.result = result;
+		copyParam( event.param, param );
+
+		event.sequence.store( ticket * 2 + 2, std::memory_order_release );
+	}
+
+	const char* currentParam() {
+		return scopeParam;
+	}
+
+	void clear() {
+		unsigned long long last = head.load( std::memory_order_relaxed );
+		for ( Event& event : ring ) {
+			event.sequence.store( 0, std::memory_order_relaxed );
+		}
+		head.store( last + CAPACITY, std::memory_order_release );
+	}
+
+	std::string exportJson() {
+		unsigned long long last = head.load( std::memory_order_acquire );
+		unsigned long long first = last > (unsigned long long) CAPACITY ? last - CAPACITY : 0;
+
+		std::vector<Copy> events;
+		events.reserve( (size_t) ( last - first ) );
+
+		for ( unsigned long long ticket = first; ticket < last; ticket++ ) {
+			Event& event = ring[ticket & ( CAPACITY - 1 )];
+
+			// Skip slots being written or already overwritten
+			unsigned long long sequence = event.sequence.load( std::memory_order_acquire );
+			if ( sequence != ticket * 2 + 2 ) {
+				continue;
+			}
+
+			Copy copy;
+			copy.begin = event.begin;
+			copy.end = event.end;
+			copy.name = event.name;
+			copy.kind = event.kind;
+			copy.thread = event.thread;
+			copy.result = event.result;
+			memcpy( copy.param, event.param, PARAM_SIZE );
+
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if ( event.sequence.load( std::memory_order_relaxed ) != sequence ) {
+				continue;
+			}
+
+			events.push_back( copy );
+		}
+
+		std::sort( events.begin(), events.end(), []( const Copy& a, const Copy& b ) { return a.begin < b.begin; } );
+
+		std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		char number[96];
+		bool firstEvent = true;
+
+		for ( const Copy& event : events ) {
+			out += firstEvent ? "\n" : ",\n";
+			firstEvent = false;
+
+			out += "{\"name\":\"";
+			appendEscaped( out, event.name );
+			out += event.kind == API ? "\",\"cat\":\"api\"" : "\",\"cat\":\"dll\"";
+
+			snprintf( number, sizeof( number ), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+				event.begin / 1000.0, ( event.end - event.begin ) / 1000.0, event.thread );
+			out += number;
+
+			out += ",\"args\":{\"param\":\"";
+			appendEscaped( out, event.param );
+			out += "\"";
+			if ( event.kind == DLL ) {
+				snprintf( number, sizeof( number ), ",\"result\":%ld", event.result );
+				out += number;
+			}
+			out += "}}";
+		}
+
+		out += "\n]}\n";
+		return out;
+	}
+
+	void Scope::begin() {
+		param[0] = '\0';
+		parentParam = scopeParam;
+		beginNs = now();
+	}
+
+	void Scope::end() {
+		record( API, name, beginNs, now(), 0, param );
+		scopeParam = parentParam;
+	}
+
+	void Scope::setParam( const char* value ) {
+		copyParam( param, value );
+		scopeParam = param;
+	}
+}
+
+#endif
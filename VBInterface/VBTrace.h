@@ -0,0 +1,118 @@
+#pragma once
+
+#include "vbinterface_global.h"
+#include "VBMetrics.h"
+
+#include <atomic>
+#include <string>
+
+// Define VBINTERFACE_NO_TRACE to compile tracing out
+#ifndef VBINTERFACE_NO_TRACE
+# define VB_TRACE_ENABLED 1
+#else
+# define VB_TRACE_ENABLED 0
+#endif
+
+namespace VBTrace {
+	enum Kind {
+		/** VBInterface public call */
+		API,
+		/** VBVMR_* call */
+		DLL
+	};
+
+	/** Events kept in the ring, older ones are overwritten */
+	const int CAPACITY = 1 << 14;
+	const int PARAM_SIZE = 48;
+
+#if VB_TRACE_ENABLED
+	extern VBINTERFACE_EXPORT std::atomic<bool> enabled;
+
+	inline bool isEnabled() {
+		return enabled.load( std::memory_order_relaxed );
+	}
+
+	VBINTERFACE_EXPORT void setEnabled( bool enable );
+	/** Nanoseconds since the trace epoch */
+	VBINTERFACE_EXPORT unsigned long long now();
+	VBINTERFACE_EXPORT void record( Kind kind, const char* name, unsigned long long begin, unsigned long long end, long result, const char* param );
+	/** Parameter of the innermost API scope on this thread */
+	VBINTERFACE_EXPORT const char* currentParam();
+	VBINTERFACE_EXPORT void clear();
+	/** Chrome trace-event JSON, loadable in Perfetto or chrome://tracing */
+	VBINTERFACE_EXPORT std::string exportJson();
+
+	/** Records an API event from construction to destruction if tracing was on when it started, costing one inline flag check otherwise */
+	class VBINTERFACE_EXPORT Scope {
+	public:
+		explicit Scope( const char* name ) : name( name ), tracing( isEnabled() ) {
+			if ( tracing ) {
+				begin();
+			}
+		}
+
+		/** describe( *this ) only runs while tracing, e.g. to set the parameter */
+		template<typename Describe>
+		Scope( const char* name, Describe describe ) : name( name ), tracing( isEnabled() ) {
+			if ( tracing ) {
+				begin();
+				describe( *this );
+			}
+		}
+
+		~Scope() {
+			if ( tracing ) {
+				end();
+			}
+		}
+
+		Scope( const Scope& ) = delete;
+		Scope& operator=( const Scope& ) = delete;
+
+		bool active() const { return tracing; }
+		void setParam( const char* value );
+		void setParam( const std::string& value ) { setParam( value.c_str() ); }
+
+	private:
+		const char* name;
+		bool tracing;
+		unsigned long long beginNs = 0;
+		const char* parentParam = nullptr;
+		char param[PARAM_SIZE];
+
+		void begin();
+		void end();
+	};
+
+	template<typename Call>
+	inline long traced( VBMetrics::Function function, Call call ) {
+		if ( !isEnabled() ) {
+			return call();
+		}
+
+		unsigned long long begin = now();
+		long result = call();
+		record( DLL, VBMetrics::functionName( function ), begin, now(), result, currentParam() );
+		return result;
+	}
+#else
+	inline bool isEnabled() { return false; }
+	inline void setEnabled( bool ) {}
+	inline void clear() {}
+	inline std::string exportJson() { return "{\"traceEvents\":[]}"; }
+#endif
+}
+
+/** Trace the enclosing public call, param is only evaluated while tracing. One declaration, so at most one per block */
+#if VB_TRACE_ENABLED
+# define VB_TRACE_SCOPE( name, param ) VBTrace::Scope vbTraceScope( name, [&]( VBTrace::Scope& vbScope ) { vbScope.setParam( param ); } )
+#else
+# define VB_TRACE_SCOPE( name, param ) do {} while ( 0 )
+#endif
+
+/** Wrap a VBVMR_* call so it is counted, timed and traced */
+#if VB_TRACE_ENABLED
+# define VB_CALL( function, call ) VBTrace::traced( VBMetrics::function, [&]() -> long { return VB_METRICS_CALL( function, call ); } )
+#else
+# define VB_CALL( function, call ) VB_METRICS_CALL( function, call )
+#endif
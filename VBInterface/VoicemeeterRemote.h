@@ -449,6 +449,124 @@ long __stdcall VBVMR_Input_GetDeviceDescW(long zindex, long * nType, unsigned sh
 
 
 
+/******************************************************************************/
+/*                             VB-AUDIO CALLBACK                              */
+/******************************************************************************/
+/* 4x Functions to process all voicemeeter audio input and output channels    */
+/*                                                                            */
+/* VBVMR_AudioCallbackRegister	 :to register Audio callback function.        */
+/* VBVMR_AudioCallbackStart      :to start the audio stream.                  */
+/* VBVMR_AudioCallbackStop       :to stop the audio stream.                   */
+/* VBVMR_AudioCallbackUnregister :to unregister / Release callback function.  */
+/******************************************************************************/
+
+/** @name Audio Callback Functions
+* @{ */
+
+typedef struct tagVBVMR_AUDIOINFO
+{
+	long samplerate;
+	long nbSamplePerFrame;
+} VBVMR_T_AUDIOINFO, *VBVMR_PT_AUDIOINFO, *VBVMR_LPT_AUDIOINFO;
+
+typedef struct tagVBVMR_AUDIOBUFFER
+{
+	long audiobuffer_sr;			//Sampling Rate
+	long audiobuffer_nbs;			//number of sample per frame
+	long audiobuffer_nbi;			//number of inputs
+	long audiobuffer_nbo;			//number of outputs
+	float * audiobuffer_r[128];		//nbi input pointers containing frame of nbs sample (of 32bits float)
+	float * audiobuffer_w[128];		//nbo output pointers containing frame of nbs sample (of 32bits float)
+} VBVMR_T_AUDIOBUFFER, *VBVMR_PT_AUDIOBUFFER, *VBVMR_LPT_AUDIOBUFFER;
+
+	/**
+	@brief VB-AUDIO Callback is called for different task to Initialize, perform and end your process.
+	VB-AUDIO Callback is part of single TIME CRITICAL Thread.
+	VB-AUDIO Callback is non re-entrant (cannot be called while in process)
+	VB-AUDIO Callback is supposed to be REAL TIME when called to process buffer.
+	(it means that the process has to be performed as fast as possible, waiting cycles are forbidden.
+	do not use O/S synchronization object, even Critical_Section can generate waiting cycle. Do not use
+	system functions that can generate waiting cycle like display, disk or communication functions for example).
+
+	@param lpUser: User pointer given on callback registration.
+	@param nCommand: reason why the callback is called.
+	@param lpData: pointer on structure, pending on nCommand.
+	@param nnn: additional data, unused
+
+	@return :	 0: always 0 (unused).
+	*/
+
+typedef long (__stdcall *T_VBVMR_VBAUDIOCALLBACK)(void * lpUser, long nCommand, void * lpData, long nnn);
+
+#define VBVMR_CBCOMMAND_STARTING	1	//command to initialize data according SR and buffer size
+										//info = (VBVMR_LPT_AUDIOINFO)lpData
+#define VBVMR_CBCOMMAND_ENDING		2	//command to release data
+#define VBVMR_CBCOMMAND_CHANGE		3	//If change in audio stream, you will have to restart audio
+#define VBVMR_CBCOMMAND_BUFFER_IN	10	//input insert
+										//info = (VBVMR_LPT_AUDIOBUFFER)lpData
+#define VBVMR_CBCOMMAND_BUFFER_OUT	11	//bus output insert
+										//info = (VBVMR_LPT_AUDIOBUFFER)lpData
+#define VBVMR_CBCOMMAND_BUFFER_MAIN	20	//all i/o
+										//info = (VBVMR_LPT_AUDIOBUFFER)lpData
+
+	/**
+	@brief register your audio callback function to receive real time audio buffer
+	it's possible to register up to 3x different Audio Callback in the same application or in 3x different applications.
+	In the same application, this is possible because Voicemeeter provides 3 kind of audio Streams:
+		- AUDIO INPUT INSERT (to process all Voicemeeter inputs as insert)
+		- AUDIO OUTPUT INSERT (to process all Voicemeeter BUS outputs as insert)
+		- ALL AUDIO I/O (to process all Voicemeeter i/o).
+	Note: a single callback can be used to receive the 3 possible audio streams.
+
+	@param mode : callback type (main, input or bus output) see define below
+	@param pCallback : Pointer on your callback function.
+	@param lpUser : user pointer (pointer that will be passed in callback first argument).
+	@param szClientName[64]: IN: Name of the application registering the Callback.
+							 OUT: Name of the application already registered.
+	@return :	 0: OK (no error).
+				-1: error
+				 1: callback already registered (by another application).
+	*/
+
+long __stdcall VBVMR_AudioCallbackRegister(long mode, T_VBVMR_VBAUDIOCALLBACK pCallback, void * lpUser, char szClientName[64]);
+
+#define VBVMR_AUDIOCALLBACK_IN		0x00000001	//to process input insert
+#define VBVMR_AUDIOCALLBACK_OUT		0x00000002	//to process output bus insert
+#define VBVMR_AUDIOCALLBACK_MAIN	0x00000004	//to receive all i/o
+
+	/**
+	@brief	Start / Stop Audio processing
+	the Callback will be called with VBVMR_CBCOMMAND_STARTING first and VBVMR_CBCOMMAND_ENDING last.
+	@return :	 0: OK (no error).
+				-1: error
+				-2: no callback registred.
+	*/
+
+long __stdcall VBVMR_AudioCallbackStart(void);
+long __stdcall VBVMR_AudioCallbackStop(void);
+
+	/**
+	@brief unregister your callback to release voicemeeter virtual driver
+	(this function will automatically call VBVMR_AudioCallbackStop() function)
+	@return :	 0: OK (no error).
+				-1: error
+				 1: callback already unregistered.
+	*/
+
+long __stdcall VBVMR_AudioCallbackUnregister(void);
+
+
+/** @}  */
+
+
+
+
+
+
+
+
+
+
 /******************************************************************************/
 /*                          'C' STRUCTURED INTERFACE                          */
 /******************************************************************************/
@@ -482,6 +600,11 @@ typedef long (__stdcall *T_VBVMR_Input_GetDeviceNumber)(void);
 typedef long (__stdcall *T_VBVMR_Input_GetDeviceDescA)(long zindex, long * nType, char * szDeviceName, char * szHardwareId);
 typedef long (__stdcall *T_VBVMR_Input_GetDeviceDescW)(long zindex, long * nType, unsigned short * wszDeviceName, unsigned short * wszHardwareId);
 
+typedef long (__stdcall *T_VBVMR_AudioCallbackRegister)(long mode, T_VBVMR_VBAUDIOCALLBACK pCallback, void * lpUser, char szClientName[64]);
+typedef long (__stdcall *T_VBVMR_AudioCallbackStart)(void);
+typedef long (__stdcall *T_VBVMR_AudioCallbackStop)(void);
+typedef long (__stdcall *T_VBVMR_AudioCallbackUnregister)(void);
+
 
 
 typedef struct tagVBVMR_INTERFACE
@@ -512,6 +635,11 @@ typedef struct tagVBVMR_INTERFACE
 	T_VBVMR_Input_GetDeviceDescA	VBVMR_Input_GetDeviceDescA;
 	T_VBVMR_Input_GetDeviceDescW	VBVMR_Input_GetDeviceDescW;
 
+	T_VBVMR_AudioCallbackRegister	VBVMR_AudioCallbackRegister;
+	T_VBVMR_AudioCallbackStart		VBVMR_AudioCallbackStart;
+	T_VBVMR_AudioCallbackStop		VBVMR_AudioCallbackStop;
+	T_VBVMR_AudioCallbackUnregister	VBVMR_AudioCallbackUnregister;
+
 } T_VBVMR_INTERFACE, *PT_VBVMR_INTERFACE, *LPT_VBVMR_INTERFACE;
 
 #ifdef VBUSE_LOCALLIB
@@ -1,12 +1,19 @@
 #pragma once
 
-#include <QtCore/qglobal.h>
+// Kept free of Qt so the plain C++ parts of the library can be used on their own
+#if defined(_WIN32)
+# define VBINTERFACE_DECL_EXPORT __declspec(dllexport)
+# define VBINTERFACE_DECL_IMPORT __declspec(dllimport)
+#else
+# define VBINTERFACE_DECL_EXPORT __attribute__((visibility("default")))
+# define VBINTERFACE_DECL_IMPORT __attribute__((visibility("default")))
+#endif
 
 #ifndef BUILD_STATIC
 # if defined(VBINTERFACE_LIB)
-#  define VBINTERFACE_EXPORT Q_DECL_EXPORT
+#  define VBINTERFACE_EXPORT VBINTERFACE_DECL_EXPORT
 # else
-#  define VBINTERFACE_EXPORT Q_DECL_IMPORT
+#  define VBINTERFACE_EXPORT VBINTERFACE_DECL_IMPORT
 # endif
 #else
 # define VBINTERFACE_EXPORT
@@ -0,0 +1,593 @@
+// Checks of VBCore against VBSimulator and VBReplay, no Qt or Voicemeeter needed
+#include "VBCore.h"
+#include "VBRecord.h"
+#include "VBReplay.h"
+#include "VBSimulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	int failures = 0;
+
+	#define CHECK( condition ) check( condition, #condition, __LINE__ )
+
+	void check( bool condition, const char* text, int line ) {
+		if ( !condition ) {
+			printf( "  line %d: %s\n", line, text );
+			failures++;
+		}
+	}
+
+	void setOffline( bool offline, int type = VBLayout::POTATO ) {
+		VBSimulator::Settings settings;
+		settings.type = type;
+		settings.offline = offline;
+		VBSimulator::setSettings( settings );
+	}
+
+	/** A fresh simulator and a core logged in to it, connected unless offline */
+	void start( VBCore& core, bool offline = false, int type = VBLayout::POTATO ) {
+		VBSimulator::reset();
+		setOffline( offline, type );
+		core.setBackend( VBSimulator::backend() );
+		core.login();
+		core.probe();
+	}
+
+	/** Read the simulated server directly, behind the core's back */
+	float serverFloat( const char* name ) {
+		float value = 0;
+		VBSimulator::backend().VBVMR_GetParameterFloat( const_cast<char*>( name ), &value );
+		return value;
+	}
+
+	std::string serverString( const char* name ) {
+		char value[VBCore::MAX_STRING] = {};
+		VBSimulator::backend().VBVMR_GetParameterStringA( const_cast<char*>( name ), value );
+		return value;
+	}
+
+	void testReadWrite() {
+		VBCore core;
+		start( core );
+		CHECK( core.state() == VBCore::CONNECTED );
+		CHECK( core.layout().type == VBLayout::POTATO );
+		CHECK( core.connectTimings().waitForServerUs >= 0 );
+
+		CHECK( core.setFloat( "Strip[0].gain", -6 ) == 0 );
+		CHECK( serverFloat( "Strip[0].gain" ) == -6 );
+		float value = 0;
+		CHECK( core.getFloat( "Strip[0].gain", value ) == 0 );
+		CHECK( value == -6 );
+
+		CHECK( core.setString( "Strip[0].label", "Mic" ) == 0 );
+		char text[VBCore::MAX_STRING];
+		CHECK( core.getString( "Strip[0].label", text ) == 0 );
+		CHECK( strcmp( text, "Mic" ) == 0 );
+
+		// A batch goes out as one script, the string with a quote on its own
+		std::vector<VBCore::Write> writes( 3 );
+		writes[0].kind = VBCore::FLOAT;
+		writes[0].name = "Bus[0].gain";
+		writes[0].number = -12.5f;
+		writes[1].kind = VBCore::STRING;
+		writes[1].name = "Bus[0].label";
+		writes[1].text = "Main";
+		writes[2].kind = VBCore::STRING;
+		writes[2].name = "Bus[1].label";
+		writes[2].text = "Say \"hi\"";
+		long long before = VBSimulator::stats().writes;
+		CHECK( core.apply( writes ) == 0 );
+		CHECK( VBSimulator::stats().writes - before == 2 );
+		CHECK( serverFloat( "Bus[0].gain" ) == -12.5f );
+		CHECK( serverString( "Bus[0].label" ) == "Main" );
+		CHECK( serverString( "Bus[1].label" ) == "Say \"hi\"" );
+
+		std::string_view names[] = { "Strip[0].gain", "Bus[0].gain", "Strip[1].gain" };
+		float values[3];
+		CHECK( core.getFloats( names, 3, values ) == 0 );
+		CHECK( values[0] == -6 && values[1] == -12.5f && values[2] == 0 );
+	}
+
+	void testQueuedWrites() {
+		VBCore core;
+		start( core, true );
+		CHECK( core.state() == VBCore::WAITING );
+		CHECK( core.waitingUs() >= 0 );
+
+		// Queued and merged per name, reads answer from the cache
+		CHECK( core.setFloat( "Strip[0].gain", -3 ) == VBCore::NO_SERVER );
+		CHECK( core.setFloat( "Strip[0].gain", -4 ) == VBCore::NO_SERVER );
+		CHECK( core.setString( "Strip[0].label", "A \"quoted\" name" ) == VBCore::NO_SERVER );
+		CHECK( core.pendingWrites() == 2 );
+		float value = 0;
+		core.getFloat( "Strip[0].gain", value );
+		CHECK( value == -4 );
+
+		setOffline( false );
+		CHECK( core.probe() );
+		CHECK( core.state() == VBCore::CONNECTED );
+		CHECK( core.pendingWrites() == 0 );
+		CHECK( serverFloat( "Strip[0].gain" ) == -4 );
+		CHECK( serverString( "Strip[0].label" ) == "A \"quoted\" name" );
+	}
+
+	void testLostAndResync() {
+		VBCore core;
+		start( core );
+		float value = 0;
+		VBSimulator::backend().VBVMR_SetParameterFloat( const_cast<char*>( "Bus[2].gain" ), -20 );
+		CHECK( core.getFloat( "Bus[2].gain", value ) == 0 && value == -20 );
+
+		setOffline( true );
+		CHECK( core.getFloat( "Bus[2].gain", value ) == VBCore::NO_SERVER );
+		CHECK( core.state() == VBCore::LOST );
+		CHECK( value == -20 );
+		CHECK( !core.probe() );
+
+		CHECK( core.setFloat( "Bus[3].mute", 1 ) == VBCore::NO_SERVER );
+		CHECK( core.pendingWrites() == 1 );
+
+		// Changed while the core was away, reconnecting reads the cache again
+		setOffline( false );
+		VBSimulator::backend().VBVMR_SetParameterFloat( const_cast<char*>( "Bus[2].gain" ), -30 );
+		CHECK( core.probe() );
+		CHECK( core.pendingWrites() == 0 );
+		CHECK( serverFloat( "Bus[3].mute" ) == 1 );
+		CHECK( core.cachedFloat( "Bus[2].gain", value ) && value == -30 );
+	}
+
+	void testShadow() {
+		VBCore core;
+		start( core );
+		CHECK( core.setFloat( "Strip[2].gain", 1 ) == 0 );
+		CHECK( core.hasShadow() );
+
+		// Someone else wins meanwhile, the shadow still serves the written value
+		VBSimulator::backend().VBVMR_SetParameterFloat( const_cast<char*>( "Strip[2].gain" ), 2 );
+		float value = 0;
+		core.getFloat( "Strip[2].gain", value );
+		CHECK( value == 1 );
+
+		std::vector<VBCore::Conflict> conflicts;
+		CHECK( !core.reconcileShadow( conflicts ) );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 60 ) );
+		core.pollDirty();
+		unsigned long long generation = core.dirtyGeneration();
+		CHECK( core.reconcileShadow( conflicts ) );
+		CHECK( conflicts.size() == 1 );
+		CHECK( !conflicts.empty() && conflicts[0].written == 1 && conflicts[0].server == 2 );
+		CHECK( !core.hasShadow() );
+		CHECK( core.dirtyGeneration() != generation );
+		CHECK( core.getFloat( "Strip[2].gain", value ) == 0 && value == 2 );
+
+		// Strings are shadowed the same way
+		CHECK( core.setString( "Strip[2].label", "Mine" ) == 0 );
+		CHECK( core.hasShadow() );
+		VBSimulator::backend().VBVMR_SetParameterStringA( const_cast<char*>( "Strip[2].label" ), const_cast<char*>( "Theirs" ) );
+		char text[VBCore::MAX_STRING];
+		CHECK( core.getString( "Strip[2].label", text ) == 0 );
+		CHECK( strcmp( text, "Mine" ) == 0 );
+
+		conflicts.clear();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 60 ) );
+		core.pollDirty();
+		CHECK( core.reconcileShadow( conflicts ) );
+		CHECK( conflicts.size() == 1 );
+		CHECK( !conflicts.empty() && conflicts[0].kind == VBCore::STRING && conflicts[0].writtenText == "Mine" && conflicts[0].serverText == "Theirs" );
+		CHECK( !core.hasShadow() );
+		CHECK( core.getString( "Strip[2].label", text ) == 0 && strcmp( text, "Theirs" ) == 0 );
+
+		// A raw script may touch anything
+		core.setFloat( "Strip[3].gain", 1 );
+		core.setParameters( "Strip[3].gain = 3; Strip[3].label = \"Raw\"" );
+		CHECK( !core.hasShadow() );
+		CHECK( serverFloat( "Strip[3].gain" ) == 3 );
+		CHECK( serverString( "Strip[3].label" ) == "Raw" );
+	}
+
+	/** Wait up to timeoutMs for done() */
+	template<typename Condition>
+	bool waitFor( Condition done, int timeoutMs = 1000 ) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMs );
+		while ( !done() ) {
+			if ( std::chrono::steady_clock::now() >= deadline ) {
+				return false;
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		return true;
+	}
+
+	void testPoller() {
+		VBCore core;
+		start( core, true );
+
+		// Reported on the poller thread
+		std::mutex mutex;
+		std::vector<VBCore::State> states;
+		std::vector<VBCore::Conflict> conflicts;
+		VBCore::Poll_Callbacks callbacks;
+		callbacks.state = [&]( VBCore::State state ) {
+			std::lock_guard<std::mutex> lock( mutex );
+			states.push_back( state );
+		};
+		callbacks.conflicts = [&]( const std::vector<VBCore::Conflict>& found ) {
+			std::lock_guard<std::mutex> lock( mutex );
+			conflicts.insert( conflicts.end(), found.begin(), found.end() );
+		};
+		std::atomic<int> interval( 0 );
+		callbacks.round = [&]( long long, int intervalMs ) {
+			interval = intervalMs;
+		};
+		auto last = [&]() {
+			std::lock_guard<std::mutex> lock( mutex );
+			return states.empty() ? VBCore::DISCONNECTED : states.back();
+		};
+
+		core.startPolling( 5, 100, callbacks );
+		CHECK( core.isPolling() );
+
+		// Probed until the server answers
+		setOffline( false );
+		CHECK( waitFor( [&]() { return last() == VBCore::CONNECTED; } ) );
+
+		// The shadow is read back without anyone asking
+		core.setFloat( "Strip[2].gain", 1 );
+		VBSimulator::backend().VBVMR_SetParameterFloat( const_cast<char*>( "Strip[2].gain" ), 2 );
+		CHECK( waitFor( [&]() { std::lock_guard<std::mutex> lock( mutex ); return !conflicts.empty(); } ) );
+		CHECK( !core.hasShadow() );
+
+		// Idle rounds back off to the slowest interval, a write pulls the next one in
+		CHECK( waitFor( [&]() { return interval == 100; } ) );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+		auto wroteAt = std::chrono::steady_clock::now();
+		core.setFloat( "Strip[3].gain", -3 );
+		CHECK( waitFor( [&]() { return interval == 5; }, 50 ) );
+		CHECK( std::chrono::steady_clock::now() - wroteAt < std::chrono::milliseconds( 50 ) );
+
+		// A loss noticed by a call is reported too, reconnecting waits for the first backoff
+		setOffline( true );
+		float value = 0;
+		CHECK( core.getFloat( "Strip[2].gain", value ) == VBCore::NO_SERVER );
+		CHECK( waitFor( [&]() { return last() == VBCore::LOST; } ) );
+		auto lostAt = std::chrono::steady_clock::now();
+		setOffline( false );
+		CHECK( waitFor( [&]() { return last() == VBCore::CONNECTED; } ) );
+		CHECK( std::chrono::steady_clock::now() - lostAt >= std::chrono::milliseconds( VBCore::RECONNECT_MIN_DELAY / 2 ) );
+
+		core.stopPolling();
+		CHECK( !core.isPolling() );
+		std::lock_guard<std::mutex> lock( mutex );
+		CHECK( states.size() == 3 );
+	}
+
+	/** Shadow rules as VBConnection applied them before the core took them over */
+	void testShadowRules() {
+		VBCore core;
+		start( core );
+
+		// Within the tolerance the server's rounding is no conflict, the written value stays
+		core.setFloat( "Strip[1].gain", 1 );
+		VBSimulator::backend().VBVMR_SetParameterFloat( const_cast<char*>( "Strip[1].gain" ), 1.005f );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 60 ) );
+		core.pollDirty();
+		std::vector<VBCore::Conflict> conflicts;
+		CHECK( core.reconcileShadow( conflicts ) );
+		CHECK( conflicts.empty() );
+		float value = 0;
+		CHECK( core.cachedFloat( "Strip[1].gain", value ) && value == 1 );
+
+		// Held while the server is away, the wait starts over once the queued write went out
+		core.setFloat( "Strip[1].gain", 2 );
+		setOffline( true );
+		CHECK( core.getFloat( "Strip[0].gain", value ) == VBCore::NO_SERVER );
+		core.setFloat( "Strip[1].gain", 3 );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 60 ) );
+		CHECK( !core.reconcileShadow( conflicts ) );
+		CHECK( core.hasShadow() );
+		setOffline( false );
+		CHECK( core.probe() );
+		CHECK( serverFloat( "Strip[1].gain" ) == 3 );
+		CHECK( !core.reconcileShadow( conflicts ) );
+		CHECK( core.hasShadow() );
+		CHECK( core.cachedFloat( "Strip[1].gain", value ) && value == 3 );
+
+		// Without a change reported the shadow is read back once it is old enough
+		core.clearShadow();
+		core.setFloat( "Strip[4].gain", -1 );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 60 ) );
+		CHECK( !core.reconcileShadow( conflicts ) );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1000 ) );
+		CHECK( core.reconcileShadow( conflicts ) );
+		CHECK( conflicts.empty() );
+		CHECK( !core.hasShadow() );
+	}
+
+	/** Reconnect rules as VBConnection applied them before the core took them over */
+	void testReconnectRules() {
+		VBCore core;
+		start( core, true );
+
+		// Writes made before the server answered go out as one script
+		core.setFloat( "Bus[0].gain", -1 );
+		core.setFloat( "Bus[1].gain", -2 );
+		core.setString( "Bus[0].label", "Queued" );
+		long long before = VBSimulator::stats().writes;
+		setOffline( false );
+		CHECK( core.probe() );
+		CHECK( VBSimulator::stats().writes - before == 1 );
+		CHECK( serverFloat( "Bus[1].gain" ) == -2 );
+		CHECK( serverString( "Bus[0].label" ) == "Queued" );
+
+		// Cached strings are read again after a loss
+		core.clearShadow();
+		char text[VBCore::MAX_STRING];
+		CHECK( core.getString( "Bus[0].label", text ) == 0 );
+		setOffline( true );
+		CHECK( core.getString( "Bus[0].label", text ) == VBCore::NO_SERVER );
+		CHECK( strcmp( text, "Queued" ) == 0 );
+		setOffline( false );
+		VBSimulator::backend().VBVMR_SetParameterStringA( const_cast<char*>( "Bus[0].label" ), const_cast<char*>( "Changed" ) );
+		CHECK( core.probe() );
+		std::string cached;
+		CHECK( core.cachedString( "Bus[0].label", cached ) && cached == "Changed" );
+
+		// A lost server is probed with a doubling delay, 100, 200, 400 ms... rather than every round
+		core.startPolling( 5, 20, VBCore::Poll_Callbacks() );
+		setOffline( true );
+		float value = 0;
+		CHECK( core.getFloat( "Bus[1].gain", value ) == VBCore::NO_SERVER );
+		long long calls = VBSimulator::stats().calls;
+		std::this_thread::sleep_for( std::chrono::milliseconds( 750 ) );
+		long long probes = VBSimulator::stats().calls - calls;
+		CHECK( probes >= 2 && probes <= 4 );
+		setOffline( false );
+		CHECK( waitFor( [&]() { return core.state() == VBCore::CONNECTED; }, 2000 ) );
+		core.stopPolling();
+	}
+
+	/** Warm values are read back in batches of 64, devices after the last one */
+	void testWarmBatches() {
+		const char* path = "CoreTest.state";
+		remove( path );
+
+		char name[VBCore::MAX_NAME];
+		{
+			VBCore core;
+			start( core );
+			core.setStateFile( path );
+			core.loadState();
+			// Every strip to bus route of Potato, and the first buses muted
+			for ( int i = 0; i < 64; i++ ) {
+				int bus = i % 8;
+				snprintf( name, sizeof( name ), "Strip[%d].%c%d", i / 8, bus < 5 ? 'A' : 'B', bus < 5 ? bus + 1 : bus - 4 );
+				core.setFloat( name, 1 );
+			}
+			for ( int i = 0; i < 6; i++ ) {
+				snprintf( name, sizeof( name ), "Bus[%d].mute", i );
+				core.setFloat( name, 1 );
+			}
+			std::vector<VBCore::Device> devices;
+			core.getDevices( false, devices );
+			core.logout();
+		}
+
+		VBCore core;
+		start( core, true );
+		core.logout();
+		core.setStateFile( path );
+		CHECK( core.loadState() == 70 );
+		core.login();
+		setOffline( false );
+		CHECK( core.probe() );
+
+		VBCore::Warm_Result result;
+		CHECK( core.verifyWarm( result ) );
+		CHECK( !result.finished );
+		CHECK( core.hasWarm() );
+		CHECK( core.verifyWarm( result ) );
+		CHECK( result.finished );
+		// The simulator started over, every saved value changed meanwhile
+		CHECK( result.changed == 70 );
+		CHECK( !core.hasWarm() );
+		CHECK( !core.verifyWarm( result ) );
+
+		core.logout();
+		remove( path );
+	}
+
+	void testStateFile() {
+		const char* path = "CoreTest.state";
+		remove( path );
+
+		{
+			VBCore core;
+			start( core );
+			core.setStateFile( path );
+			CHECK( core.loadState() == 0 );
+			core.setFloat( "Strip[0].gain", -9 );
+			core.setString( "Strip[0].label", "Saved" );
+			std::vector<VBCore::Device> devices;
+			CHECK( core.getDevices( true, devices ) == 0 && devices.size() == 1 );
+			core.logout();
+		}
+
+		// Next session: warm values serve reads before the server answers
+		VBCore core;
+		start( core, true );
+		core.logout();
+		core.setStateFile( path );
+		CHECK( core.loadState() == 2 );
+		CHECK( core.hasWarm() );
+		core.login();
+		float value = 0;
+		CHECK( core.getFloat( "Strip[0].gain", value ) == 0 && value == -9 );
+		std::vector<VBCore::Device> devices;
+		CHECK( core.getDevices( true, devices ) == VBCore::NO_SERVER && devices.size() == 1 );
+		CHECK( !devices.empty() && devices[0].name == "Simulated Output" );
+
+		// One value changed while the client was gone
+		setOffline( false );
+		VBSimulator::backend().VBVMR_SetParameterFloat( const_cast<char*>( "Strip[0].gain" ), -1 );
+		VBSimulator::backend().VBVMR_SetParameterStringA( const_cast<char*>( "Strip[0].label" ), const_cast<char*>( "Saved" ) );
+		CHECK( core.probe() );
+		VBCore::Warm_Result result;
+		CHECK( core.verifyWarm( result ) );
+		CHECK( result.finished && !result.discarded );
+		CHECK( result.changed == 1 );
+		CHECK( !core.hasWarm() );
+		CHECK( core.getFloat( "Strip[0].gain", value ) == 0 && value == -1 );
+
+		// A state saved with another type is thrown away
+		core.logout();
+		VBCore other;
+		start( other, false, VBLayout::BANANA );
+		other.setStateFile( path );
+		CHECK( other.loadState() > 0 );
+		CHECK( other.verifyWarm( result ) );
+		CHECK( result.discarded );
+		CHECK( !other.cachedFloat( "Strip[0].gain", value ) );
+		other.setStateFile( std::string() );
+
+		FILE* file = fopen( path, "wb" );
+		fputs( "VBWS damaged", file );
+		fclose( file );
+		VBCore damaged;
+		damaged.setStateFile( path );
+		CHECK( damaged.loadState() == -1 );
+		remove( path );
+	}
+
+	void testDevicesAndLevels() {
+		VBCore core;
+		start( core, false, VBLayout::STANDARD );
+		CHECK( core.layout().numInputLevels == 12 );
+		CHECK( core.layout().numOutputLevels == 16 );
+
+		std::vector<VBCore::Device> devices;
+		CHECK( core.getDevices( false, devices ) == 0 && devices.size() == 1 );
+		CHECK( !devices.empty() && devices[0].hardwareID == "SIM_IN" && devices[0].type == VBVMR_DEVTYPE_WDM );
+		unsigned long long hash = 0, again = 0;
+		CHECK( core.getDeviceListHash( false, hash ) == 0 && hash != 0 );
+		core.getDeviceListHash( false, again );
+		CHECK( hash == again );
+		core.getDeviceListHash( true, again );
+		CHECK( hash != again );
+
+		VBCore::Level_Sweep sweep, reused;
+		CHECK( core.sweepLevels( 0, sweep ) == 0 );
+		CHECK( sweep.numInputs == 12 && sweep.numOutputs == 16 );
+		bool inRange = true;
+		for ( int i = 0; i < sweep.numInputs; i++ ) {
+			inRange = inRange && sweep.input[i] >= 0 && sweep.input[i] <= 0.5f;
+		}
+		CHECK( inRange );
+		CHECK( core.sweepLevels( 0, reused ) == 0 );
+		CHECK( reused.timestampNs == sweep.timestampNs );
+		float level = -1;
+		CHECK( core.getLevel( 3, 0, level ) == 0 && level >= 0 && level <= 0.5f );
+
+		setOffline( true, VBLayout::STANDARD );
+		CHECK( core.sweepLevels( 1, sweep ) == VBCore::NO_SERVER );
+		CHECK( core.state() == VBCore::LOST );
+		CHECK( core.getDevices( false, devices ) == VBCore::NO_SERVER && devices.size() == 1 );
+		CHECK( core.getDeviceListHash( false, hash ) == VBCore::NO_SERVER && hash == 0 );
+	}
+
+	void testCachingOff() {
+		VBCore core;
+		core.setCaching( false );
+		start( core, true );
+		CHECK( core.setFloat( "Strip[0].gain", -3 ) == VBCore::NO_SERVER );
+		CHECK( core.pendingWrites() == 0 );
+		float value;
+		CHECK( !core.cachedFloat( "Strip[0].gain", value ) );
+	}
+
+	/** The same session against the simulator while recording, then against the recording */
+	void session( VBCore& core, float& gain, VBCore::Level_Sweep& sweep, std::vector<VBCore::Device>& devices ) {
+		core.login();
+		core.probe();
+		core.setFloat( "Strip[0].gain", -7 );
+		core.clearShadow();
+		core.getFloat( "Strip[0].gain", gain );
+		core.sweepLevels( 1, sweep );
+		core.getDevices( true, devices );
+		core.logout();
+	}
+
+	void testReplay() {
+		const char* path = "CoreTest.trace";
+		VBSimulator::reset();
+		setOffline( false );
+
+		float recordedGain = 0;
+		VBCore::Level_Sweep recordedSweep;
+		std::vector<VBCore::Device> recordedDevices;
+		{
+			VBCore core;
+			core.setBackend( VBSimulator::backend() );
+			CHECK( VBRecord::start( path ) );
+			core.setRecording( true );
+			session( core, recordedGain, recordedSweep, recordedDevices );
+			VBRecord::stop();
+		}
+
+		CHECK( VBReplay::open( path ) );
+		CHECK( VBReplay::size() > 0 );
+		float gain = 0;
+		VBCore::Level_Sweep sweep;
+		std::vector<VBCore::Device> devices;
+		{
+			VBCore core;
+			core.setBackend( VBReplay::backend() );
+			session( core, gain, sweep, devices );
+		}
+
+		CHECK( VBReplay::stats().mismatched == 0 );
+		CHECK( gain == -7 && gain == recordedGain );
+		CHECK( sweep.numInputs == recordedSweep.numInputs );
+		CHECK( memcmp( sweep.input, recordedSweep.input, sizeof( sweep.input ) ) == 0 );
+		CHECK( devices.size() == 1 && recordedDevices.size() == 1 && devices[0].name == recordedDevices[0].name );
+		VBReplay::close();
+		remove( path );
+	}
+
+	struct Test {
+		const char* name;
+		void ( *run )();
+	};
+}
+
+int main() {
+	const Test tests[] = {
+		{ "readWrite", testReadWrite },
+		{ "queuedWrites", testQueuedWrites },
+		{ "lostAndResync", testLostAndResync },
+		{ "shadow", testShadow },
+		{ "poller", testPoller },
+		{ "shadowRules", testShadowRules },
+		{ "reconnectRules", testReconnectRules },
+		{ "stateFile", testStateFile },
+		{ "warmBatches", testWarmBatches },
+		{ "devicesAndLevels", testDevicesAndLevels },
+		{ "cachingOff", testCachingOff },
+		{ "replay", testReplay }
+	};
+
+	for ( const Test& test : tests ) {
+		int before = failures;
+		test.run();
+		printf( "%s %s\n", failures == before ? "PASS" : "FAIL", test.name );
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+// VBCore's poller against the simulated server, one JSON line per run, no Qt needed
+#include "VBPollBench.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+int main( int argc, char* argv[] ) {
+	// PollBench [durationMs], shorter runs make a quick check
+	int durationMs = argc > 1 ? atoi( argv[1] ) : 0;
+
+	for ( VBPollBench::Settings settings : VBPollBench::standardRuns() ) {
+		if ( durationMs > 0 ) {
+			settings.durationMs = durationMs;
+		}
+
+		VBPollBench::Result result = VBPollBench::run( settings );
+		printf( "%s\n", VBPollBench::toJson( result ).c_str() );
+		fflush( stdout );
+
+		// A poller that never ran a round is broken, not slow
+		if ( result.rounds == 0 ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
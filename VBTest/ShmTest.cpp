@@ -0,0 +1,163 @@
+// Publisher and reader of VBLevelShm in two processes, no Qt or Voicemeeter needed
+#include "VBLevelShm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+namespace {
+	const char* NAME = "VBInterfaceShmTest";
+	const int NUM_FRAMES = 200000;
+
+	/** Every value follows from the sequence, a torn copy mixes two of them */
+	float valueOf( unsigned long long sequence, int slot ) {
+		return (float) ( ( sequence * 131 + slot ) % 1000 ) / 1000;
+	}
+
+	bool consistent( const VBLevelShm::Frame& frame ) {
+		if ( frame.numInputs != VBLevelShm::MAX_INPUTS || frame.numOutputs != VBLevelShm::MAX_OUTPUTS ) {
+			return false;
+		}
+		for ( int i = 0; i < VBLevelShm::MAX_INPUTS; i++ ) {
+			if ( frame.input[i] != valueOf( frame.sequence, i ) ) {
+				return false;
+			}
+		}
+		for ( int i = 0; i < VBLevelShm::MAX_OUTPUTS; i++ ) {
+			if ( frame.output[i] != valueOf( frame.sequence, VBLevelShm::MAX_INPUTS + i ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Publishes NUM_FRAMES frames as fast as it can, then keeps the segment up until the reader is done */
+	int publish() {
+		VBLevelShm::Writer writer;
+		if ( !writer.create( NAME ) ) {
+			printf( "cannot create %s\n", NAME );
+			return 1;
+		}
+
+		VBLevelShm::Frame frame;
+		frame.voicemeeterType = VBLayout::POTATO;
+		frame.numInputs = VBLevelShm::MAX_INPUTS;
+		frame.numOutputs = VBLevelShm::MAX_OUTPUTS;
+		for ( unsigned long long sequence = 1; sequence <= NUM_FRAMES; sequence++ ) {
+			for ( int i = 0; i < VBLevelShm::MAX_INPUTS; i++ ) {
+				frame.input[i] = valueOf( sequence, i );
+			}
+			for ( int i = 0; i < VBLevelShm::MAX_OUTPUTS; i++ ) {
+				frame.output[i] = valueOf( sequence, VBLevelShm::MAX_INPUTS + i );
+			}
+			writer.publish( frame );
+		}
+
+		std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+		return 0;
+	}
+
+	int read() {
+		VBLevelShm::Reader reader;
+		for ( int attempt = 0; attempt < 500 && !reader.open( NAME ); attempt++ ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		if ( !reader.isOpen() ) {
+			printf( "cannot open %s\n", NAME );
+			return 1;
+		}
+
+		int failures = 0;
+		long long reads = 0;
+		long long torn = 0;
+		unsigned long long last = 0;
+		VBLevelShm::Frame frame;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+		while ( last < NUM_FRAMES && std::chrono::steady_clock::now() < deadline ) {
+			if ( !reader.latest( frame ) ) {
+				continue;
+			}
+
+			reads++;
+			if ( !consistent( frame ) ) {
+				torn++;
+			}
+			if ( frame.sequence < last ) {
+				printf( "sequence went back from %llu to %llu\n", last, frame.sequence );
+				failures++;
+			}
+			last = frame.sequence;
+		}
+
+		if ( last != NUM_FRAMES || reader.latestSequence() != NUM_FRAMES ) {
+			printf( "saw frame %llu of %d\n", last, NUM_FRAMES );
+			failures++;
+		}
+		if ( torn > 0 ) {
+			printf( "%lld of %lld frames were torn\n", torn, reads );
+			failures++;
+		}
+
+		// The whole ring is intact once the writer stopped, newest first
+		VBLevelShm::Frame history[VBLevelShm::NUM_SLOTS];
+		int count = reader.history( history, VBLevelShm::NUM_SLOTS );
+		for ( int i = 0; i < count; i++ ) {
+			if ( history[i].sequence != NUM_FRAMES - (unsigned long long) i || !consistent( history[i] ) ) {
+				printf( "history entry %d holds frame %llu\n", i, history[i].sequence );
+				failures++;
+				break;
+			}
+		}
+		if ( count != VBLevelShm::NUM_SLOTS ) {
+			printf( "history held %d of %d frames\n", count, VBLevelShm::NUM_SLOTS );
+			failures++;
+		}
+
+		// A frame lapped by the writer is refused rather than copied torn
+		if ( reader.read( 1, frame ) ) {
+			printf( "frame 1 was still readable\n" );
+			failures++;
+		}
+
+		printf( "%lld reads up to frame %llu\n", reads, last );
+		return failures == 0 ? 0 : 1;
+	}
+}
+
+int main() {
+#ifdef _WIN32
+	// A mapping lives as long as a handle to it, the writer runs on a thread here
+	int published = 0;
+	std::thread writer( [&]() { published = publish(); } );
+	int result = read();
+	writer.join();
+	return result != 0 || published != 0 ? 1 : 0;
+#else
+	// Drop a segment a crashed run left behind, closing the writer unlinks it
+	VBLevelShm::Writer stale;
+	stale.create( NAME );
+	stale.close();
+
+	pid_t child = fork();
+	if ( child < 0 ) {
+		perror( "fork" );
+		return 1;
+	}
+	if ( child == 0 ) {
+		_exit( publish() );
+	}
+
+	int result = read();
+	int status = 0;
+	waitpid( child, &status, 0 );
+	bool published = WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+	return result != 0 || !published ? 1 : 0;
+#endif
+}
@@ -2,18 +2,79 @@
 
 #include <QDebug>
 #include <VBInterface>
+#include <VBLevelCodec.h>
+#include <VBPollBench.h>
+#include <VBAudioMeter>
+#include <VBSimulator.h>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
 	QCoreApplication a(argc, argv);
+
+	// VBTest --poll-bench: poller jitter against the simulated server, one JSON line per run
+	if ( argc > 1 && strcmp( argv[1], "--poll-bench" ) == 0 ) {
+		for ( const VBPollBench::Settings& settings : VBPollBench::standardRuns() ) {
+			printf( "%s\n", VBPollBench::toJson( VBPollBench::run( settings ) ).c_str() );
+			fflush( stdout );
+		}
+		return 0;
+	}
+
+	// VBTest --audio-meter: peaks of the simulated audio stream against polled levels, the clicks only show in the former
+	if ( argc > 1 && strcmp( argv[1], "--audio-meter" ) == 0 ) {
+		VBCore core;
+		core.setBackend( VBSimulator::backend() );
+		core.login();
+		core.probe();
+
+		VBAudioMeter meter( VBAudioStream::MAIN );
+		VBAudioStream stream( core );
+		stream.addProcessor( &meter );
+		if ( stream.start( VBAudioStream::MAIN, "VBTest" ) != 0 ) {
+			qCritical() << "Audio callback did not start";
+			return 1;
+		}
+
+		unsigned long long cursor = 0;
+		VBAudioMeter::Reading reading;
+		for ( int i = 0; i < 10; i++ ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+			float polled = 0;
+			core.getLevel( 0, 0, polled );
+			if ( meter.read( cursor, reading ) ) {
+				printf( "windows %d missed %d peak %.3f rms %.3f polled %.3f\n", reading.windows, reading.missed, reading.peak[0], reading.rms[0], polled );
+			}
+		}
+
+		stream.stop();
+		printf( "%lld buffers, %lld clicks\n", VBSimulator::stats().audioBuffers, VBSimulator::stats().clicks );
+		return 0;
+	}
 	
 	VBInterface* vb = new VBInterface;
 	vb->login();
+	if ( !vb->waitForReady() ) {
+		qCritical() << "Voicemeeter did not answer";
+	}
+
+	VBInterface::Startup_Timings timings = vb->getStartupTimings();
+	qInfo() << "Startup took" << timings.total << "us, DLL path" << ( timings.cachedPath ? "cached" : "from registry" );
 	qInfo() << "\nStarting tests\n";
 
 	qInfo() << "Current output device: " << vb->getOutputDevice( VBInterface::BUS1 ).toString();
 	qInfo() << "Current output volume: "  << vb->getVolume( VBInterface::BUS1 ) << "dB";
 
+	for ( VBInterface::Voicemeeter_Type type : { VBInterface::BANANA, VBInterface::POTATO } ) {
+		const VBInterface::Layout& layout = VBInterface::getLayout( type );
+		VBLevelCodec::Benchmark_Result codec = VBLevelCodec::benchmark( layout.numLevels[VBInterface::PRE_FADER], layout.numLevels[VBInterface::OUTPUT] );
+		qInfo() << "Level codec, type" << type << ":" << codec.bytesPerFrame << "of" << codec.rawBytesPerFrame << "bytes per frame, encode"
+			<< codec.encodeNs << "ns, decode" << codec.decodeNs << "ns, max error" << codec.maxErrorDb << "of" << codec.errorBoundDb << "dB";
+	}
+
 	qInfo() << "\nFinished Tests\n";
 	vb->disconnect();
 